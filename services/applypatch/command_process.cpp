@@ -151,7 +151,7 @@ CommandResult DiffAndMoveCommandFn::Execute(const Command &params)
 CommandResult FreeCommandFn::Execute(const Command &params)
 {
     std::string shaStr = params.GetArgumentByPos(1);
-    blocksetMap.erase(shaStr);
+    TransferManager::GetTransferManagerInstance()->GetGlobalParams()->blocksetMap.erase(shaStr);
     std::string storeBase = TransferManager::GetTransferManagerInstance()->GetGlobalParams()->storeBase;
     UPDATER_CHECK_ONLY_RETURN(!(TransferManager::GetTransferManagerInstance()->GetGlobalParams()->storeCreated),
         return CommandResult(Store::FreeStore(storeBase, shaStr)));
@@ -176,7 +176,7 @@ CommandResult StashCommandFn::Execute(const Command &params)
     LOG(INFO) << "Read block data to buffer";
     UPDATER_ERROR_CHECK(srcBlk.ReadDataFromBlock(params.GetFileDescriptor(), buffer) > 0,
         "Error to load block data", return FAILED);
-    blocksetMap[shaStr] = srcBlk;
+    TransferManager::GetTransferManagerInstance()->GetGlobalParams()->blocksetMap[shaStr] = srcBlk;
     UPDATER_CHECK_ONLY_RETURN(srcBlk.VerifySha256(buffer, srcBlockSize, shaStr) == 0, return FAILED);
     LOG(INFO) << "store " << srcBlockSize << " blocks to " << shaStr;
     int ret = Store::WriteDataToStore(storeBase, shaStr, buffer, srcBlockSize * H_BLOCK_SIZE);
@@ -23,6 +23,7 @@
 #include "fs_manager/mount.h"
 #include "log/log.h"
 #include "raw_writer.h"
+#include "sparse_writer.h"
 
 namespace updater {
 UpdaterEnv *DataWriter::env_ = nullptr;
@@ -60,6 +61,11 @@ std::unique_ptr<DataWriter> DataWriter::CreateDataWriter(WriteMode mode, const s
             std::unique_ptr<RawWriter> writer(std::make_unique<RawWriter>(partitionName));
             return std::move(writer);
         }
+        case WRITE_SPARSE:
+        {
+            std::unique_ptr<SparseWriter> writer(std::make_unique<SparseWriter>(partitionName));
+            return std::move(writer);
+        }
         case WRITE_DECRYPT:
             LOG(WARNING) << "Unsupported writer mode.";
             break;
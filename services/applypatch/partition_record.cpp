@@ -29,6 +29,7 @@ PartitionRecord &PartitionRecord::GetInstance()
 }
 bool PartitionRecord::IsPartitionUpdated(const std::string &partitionName)
 {
+    std::lock_guard<std::mutex> lock(mutex_);
     auto miscBlockDevice = GetMiscPartitionPath();
     uint8_t buffer[PARTITION_UPDATER_RECORD_MSG_SIZE];
     if (!miscBlockDevice.empty()) {
@@ -59,6 +60,7 @@ bool PartitionRecord::IsPartitionUpdated(const std::string &partitionName)
 
 bool PartitionRecord::RecordPartitionUpdateStatus(const std::string &partitionName, bool updated)
 {
+    std::lock_guard<std::mutex> lock(mutex_);
     auto miscBlockDevice = GetMiscPartitionPath();
     if (!miscBlockDevice.empty()) {
         char *realPath = realpath(miscBlockDevice.c_str(), NULL);
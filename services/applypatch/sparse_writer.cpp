@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "sparse_writer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include "log/log.h"
+#include "securec.h"
+
+namespace updater {
+SparseWriter::~SparseWriter()
+{
+    if (fd_ >= 0) {
+        fsync(fd_);
+        close(fd_);
+    }
+    fd_ = -1;
+}
+
+bool SparseWriter::Write(const uint8_t *addr, size_t len, WriteMode mode, const std::string &partitionName)
+{
+    UPDATER_ERROR_CHECK(addr != nullptr && len != 0, "SparseWriter: invalid data", return false);
+    if (fd_ < 0) {
+        fd_ = OpenPartition(partitionName_);
+        UPDATER_CHECK_ONLY_RETURN(fd_ >= 0, return false);
+    }
+    while (len > 0) {
+        size_t size = 0;
+        if (skip_ > 0) {
+            size = std::min(len, skip_);
+            skip_ -= size;
+        } else if (state_ == STATE_RAW_DATA) {
+            size = static_cast<size_t>(std::min<uint64_t>(len, rawRest_));
+            UPDATER_CHECK_ONLY_RETURN(WriteRaw(addr, size), return false);
+            rawRest_ -= size;
+            if (rawRest_ == 0) {
+                EndChunk();
+            }
+        } else {
+            UPDATER_ERROR_CHECK(state_ != STATE_DONE, "SparseWriter: unexpected data after last chunk",
+                return false);
+            // 头部可能跨越多次写入，先收集完整
+            size = std::min(len, headerSize_ - headerBuffer_.size());
+            headerBuffer_.insert(headerBuffer_.end(), addr, addr + size);
+            if (headerBuffer_.size() == headerSize_) {
+                UPDATER_CHECK_ONLY_RETURN(ParseHeader(), return false);
+            }
+        }
+        addr += size;
+        len -= size;
+    }
+    return (state_ == STATE_DONE) ? FlushPending() : true;
+}
+
+bool SparseWriter::Finish()
+{
+    UPDATER_CHECK_ONLY_RETURN(FlushPending(), return false);
+    UPDATER_ERROR_CHECK(state_ == STATE_DONE, "SparseWriter: incomplete image, chunk " << chunkIndex_ <<
+        " of " << header_.totalChunks, return false);
+    return true;
+}
+
+bool SparseWriter::ParseHeader()
+{
+    bool ret = true;
+    switch (state_) {
+        case STATE_FILE_HEADER:
+            ret = ParseFileHeader();
+            break;
+        case STATE_CHUNK_HEADER:
+            ret = ParseChunkHeader();
+            break;
+        case STATE_FILL_VALUE: {
+            uint32_t value = 0;
+            UPDATER_CHECK_ONLY_RETURN(memcpy_s(&value, sizeof(value), headerBuffer_.data(), sizeof(value)) == 0,
+                return false);
+            uint64_t size = static_cast<uint64_t>(chunk_.chunkSize) * header_.blockSize;
+            ret = FlushPending() && FillBlocks(size, value);
+            offset_ += size;
+            EndChunk();
+            break;
+        }
+        case STATE_CRC32:
+            // 升级包已经校验过签名，这里不再计算 CRC
+            EndChunk();
+            break;
+        default:
+            ret = false;
+            break;
+    }
+    headerBuffer_.clear();
+    return ret;
+}
+
+bool SparseWriter::ParseFileHeader()
+{
+    UPDATER_CHECK_ONLY_RETURN(memcpy_s(&header_, sizeof(header_), headerBuffer_.data(), sizeof(header_)) == 0,
+        return false);
+    UPDATER_ERROR_CHECK(header_.magic == SPARSE_HEADER_MAGIC && header_.majorVersion == SPARSE_MAJOR_VERSION,
+        "SparseWriter: invalid sparse image, magic " << header_.magic, return false);
+    UPDATER_ERROR_CHECK(header_.fileHeaderSize >= sizeof(SparseHeader) &&
+        header_.chunkHeaderSize >= sizeof(SparseChunkHeader), "SparseWriter: invalid header size", return false);
+    // BLKZEROOUT 和 BLKDISCARD 要求按扇区对齐
+    UPDATER_ERROR_CHECK(header_.blockSize > 0 && header_.blockSize % DEFAULT_SECTOR_SIZE == 0,
+        "SparseWriter: invalid block size " << header_.blockSize, return false);
+    LOG(INFO) << "SparseWriter: " << header_.totalBlocks << " blocks of " << header_.blockSize << " bytes in " <<
+        header_.totalChunks << " chunks";
+    totalSize_ = static_cast<uint64_t>(header_.totalBlocks) * header_.blockSize;
+    skip_ = header_.fileHeaderSize - sizeof(SparseHeader);
+    state_ = (header_.totalChunks == 0) ? STATE_DONE : STATE_CHUNK_HEADER;
+    headerSize_ = sizeof(SparseChunkHeader);
+    return true;
+}
+
+bool SparseWriter::ParseChunkHeader()
+{
+    UPDATER_CHECK_ONLY_RETURN(memcpy_s(&chunk_, sizeof(chunk_), headerBuffer_.data(), sizeof(chunk_)) == 0,
+        return false);
+    uint64_t size = static_cast<uint64_t>(chunk_.chunkSize) * header_.blockSize;
+    UPDATER_ERROR_CHECK(offset_ + size <= totalSize_, "SparseWriter: chunk " << chunkIndex_ <<
+        " exceeds image size", return false);
+    // 扩展的 chunk 头部字段不使用
+    skip_ = header_.chunkHeaderSize - sizeof(SparseChunkHeader);
+    UPDATER_ERROR_CHECK(chunk_.totalSize >= header_.chunkHeaderSize, "SparseWriter: invalid chunk size",
+        return false);
+    uint64_t dataSize = chunk_.totalSize - header_.chunkHeaderSize;
+    switch (chunk_.chunkType) {
+        case CHUNK_TYPE_RAW:
+            UPDATER_ERROR_CHECK(dataSize == size, "SparseWriter: invalid raw chunk " << chunkIndex_, return false);
+            state_ = STATE_RAW_DATA;
+            rawRest_ = size;
+            if (rawRest_ == 0) {
+                EndChunk();
+            }
+            break;
+        case CHUNK_TYPE_FILL:
+            UPDATER_ERROR_CHECK(dataSize == sizeof(uint32_t), "SparseWriter: invalid fill chunk " << chunkIndex_,
+                return false);
+            state_ = STATE_FILL_VALUE;
+            headerSize_ = sizeof(uint32_t);
+            break;
+        case CHUNK_TYPE_DONT_CARE:
+            UPDATER_ERROR_CHECK(dataSize == 0, "SparseWriter: invalid don't care chunk " << chunkIndex_,
+                return false);
+            UPDATER_CHECK_ONLY_RETURN(FlushPending(), return false);
+            DiscardBlocks(size);
+            offset_ += size;
+            EndChunk();
+            break;
+        case CHUNK_TYPE_CRC32:
+            UPDATER_ERROR_CHECK(dataSize == sizeof(uint32_t), "SparseWriter: invalid crc chunk " << chunkIndex_,
+                return false);
+            state_ = STATE_CRC32;
+            headerSize_ = sizeof(uint32_t);
+            break;
+        default:
+            LOG(ERROR) << "SparseWriter: unknown chunk type " << chunk_.chunkType;
+            return false;
+    }
+    return true;
+}
+
+void SparseWriter::EndChunk()
+{
+    chunkIndex_++;
+    state_ = (chunkIndex_ >= header_.totalChunks) ? STATE_DONE : STATE_CHUNK_HEADER;
+    headerSize_ = sizeof(SparseChunkHeader);
+}
+
+bool SparseWriter::WriteRaw(const uint8_t *data, size_t len)
+{
+    // 没有缓存时大块数据直接写入，避免复制
+    if (pending_.empty() && len >= MAX_SPARSE_WRITE_SIZE) {
+        UPDATER_CHECK_ONLY_RETURN(WriteAt(data, len, offset_), return false);
+        offset_ += len;
+        return true;
+    }
+    if (pending_.empty()) {
+        pending_.reserve(MAX_SPARSE_WRITE_SIZE);
+        pendingOffset_ = offset_;
+    }
+    while (len > 0) {
+        size_t size = std::min(len, MAX_SPARSE_WRITE_SIZE - pending_.size());
+        pending_.insert(pending_.end(), data, data + size);
+        data += size;
+        len -= size;
+        offset_ += size;
+        if (pending_.size() == MAX_SPARSE_WRITE_SIZE) {
+            UPDATER_CHECK_ONLY_RETURN(FlushPending(), return false);
+            pendingOffset_ = offset_;
+        }
+    }
+    return true;
+}
+
+bool SparseWriter::FlushPending()
+{
+    if (pending_.empty()) {
+        return true;
+    }
+    bool ret = WriteAt(pending_.data(), pending_.size(), pendingOffset_);
+    pending_.clear();
+    return ret;
+}
+
+bool SparseWriter::FillBlocks(uint64_t size, uint32_t value)
+{
+    if (size == 0) {
+        return true;
+    }
+    if (value == 0) {
+        uint64_t range[2] = { offset_, size };
+        if (ioctl(fd_, BLKZEROOUT, &range) == 0) {
+            return true;
+        }
+        // 不是块设备时直接写入 0
+        LOG(DEBUG) << "SparseWriter: zero out failed, write zero instead : " << strerror(errno);
+    }
+    std::vector<uint32_t> buffer(static_cast<size_t>(std::min<uint64_t>(size, MAX_SPARSE_WRITE_SIZE)) /
+        sizeof(uint32_t), value);
+    size_t bufferSize = buffer.size() * sizeof(uint32_t);
+    uint64_t offset = offset_;
+    while (size > 0) {
+        size_t len = static_cast<size_t>(std::min<uint64_t>(size, bufferSize));
+        UPDATER_CHECK_ONLY_RETURN(WriteAt(reinterpret_cast<const uint8_t *>(buffer.data()), len, offset),
+            return false);
+        offset += len;
+        size -= len;
+    }
+    return true;
+}
+
+void SparseWriter::DiscardBlocks(uint64_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    uint64_t range[2] = { offset_, size };
+    // DONT_CARE 的内容没有要求，不支持 discard 时跳过即可
+    if (ioctl(fd_, BLKDISCARD, &range) != 0) {
+        LOG(DEBUG) << "SparseWriter: discard " << size << " bytes failed : " << strerror(errno);
+    }
+}
+
+bool SparseWriter::WriteAt(const uint8_t *data, size_t len, uint64_t offset)
+{
+    while (len > 0) {
+        ssize_t written = pwrite64(fd_, data, len, static_cast<off64_t>(offset));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        UPDATER_FILE_CHECK(written > 0, "SparseWriter: failed to write " << len << " bytes at " << offset,
+            return false);
+        data += written;
+        len -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+} // namespace updater
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UPDATER_SPARSE_WRITER_H
+#define UPDATER_SPARSE_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+#include "applypatch/data_writer.h"
+
+namespace updater {
+constexpr uint32_t SPARSE_HEADER_MAGIC = 0xed26ff3a;
+constexpr uint16_t SPARSE_MAJOR_VERSION = 1;
+constexpr uint16_t CHUNK_TYPE_RAW = 0xCAC1;
+constexpr uint16_t CHUNK_TYPE_FILL = 0xCAC2;
+constexpr uint16_t CHUNK_TYPE_DONT_CARE = 0xCAC3;
+constexpr uint16_t CHUNK_TYPE_CRC32 = 0xCAC4;
+// RAW 数据合并到这个大小再写入，同时也是 FILL 缓冲区的上限
+constexpr size_t MAX_SPARSE_WRITE_SIZE = 1024 * 1024;
+
+// Android sparse 镜像格式，小端
+struct SparseHeader {
+    uint32_t magic;
+    uint16_t majorVersion;
+    uint16_t minorVersion;
+    uint16_t fileHeaderSize;
+    uint16_t chunkHeaderSize;
+    uint32_t blockSize;
+    uint32_t totalBlocks;
+    uint32_t totalChunks;
+    uint32_t imageChecksum;
+};
+
+struct SparseChunkHeader {
+    uint16_t chunkType;
+    uint16_t reserved;
+    uint32_t chunkSize; // 输出的块数
+    uint32_t totalSize; // 包括头部在内的字节数
+};
+
+static_assert(sizeof(SparseHeader) == 28, "Invalid sparse header size");
+static_assert(sizeof(SparseChunkHeader) == 12, "Invalid sparse chunk header size");
+
+/**
+ * 按 Android sparse 格式边解析边写入分区，数据可以分多次传入。
+ * RAW 数据合并后按位置写入，FILL 为 0 时使用 BLKZEROOUT，DONT_CARE 使用 BLKDISCARD，CRC32 块只做解析。
+ * 内存占用不超过 MAX_SPARSE_WRITE_SIZE 的两倍，与镜像大小无关。
+ */
+class SparseWriter : public DataWriter {
+public:
+    explicit SparseWriter(const std::string partitionName) : partitionName_(partitionName) {}
+
+    virtual ~SparseWriter();
+
+    virtual bool Write(const uint8_t *addr, size_t len, WriteMode mode, const std::string &partitionName);
+
+    // 写出缓存的数据，镜像没有解析完时返回 false
+    virtual bool Finish();
+private:
+    enum ParseState {
+        STATE_FILE_HEADER,
+        STATE_CHUNK_HEADER,
+        STATE_RAW_DATA,
+        STATE_FILL_VALUE,
+        STATE_CRC32,
+        STATE_DONE,
+    };
+
+    bool ParseHeader();
+    bool ParseFileHeader();
+    bool ParseChunkHeader();
+    bool WriteRaw(const uint8_t *data, size_t len);
+    bool FillBlocks(uint64_t size, uint32_t value);
+    void DiscardBlocks(uint64_t size);
+    bool FlushPending();
+    bool WriteAt(const uint8_t *data, size_t len, uint64_t offset);
+    void EndChunk();
+
+    SparseWriter(const SparseWriter&) = delete;
+
+    const SparseWriter& operator=(const SparseWriter&) = delete;
+    std::string partitionName_;
+    int fd_ = -1;
+    ParseState state_ = STATE_FILE_HEADER;
+    SparseHeader header_ {};
+    SparseChunkHeader chunk_ {};
+    // 未收完整的头部
+    std::vector<uint8_t> headerBuffer_ {};
+    size_t headerSize_ = sizeof(SparseHeader);
+    // 头部后面需要跳过的扩展字段
+    size_t skip_ = 0;
+    uint64_t rawRest_ = 0;
+    uint32_t chunkIndex_ = 0;
+    uint64_t totalSize_ = 0;
+    uint64_t offset_ = 0;
+    std::vector<uint8_t> pending_ {};
+    uint64_t pendingOffset_ = 0;
+};
+} // namespace updater
+#endif /* UPDATER_SPARSE_WRITER_H */
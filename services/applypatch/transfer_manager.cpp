@@ -23,7 +23,7 @@
 
 namespace updater {
 using namespace updater::utils;
-static TransferManagerPtr g_transferManagerInstance = nullptr;
+static thread_local TransferManagerPtr g_transferManagerInstance = nullptr;
 TransferManagerPtr TransferManager::GetTransferManagerInstance()
 {
     if (g_transferManagerInstance == nullptr) {
@@ -40,6 +40,18 @@ void TransferManager::ReleaseTransferManagerInstance(TransferManagerPtr transfer
     transferManager = nullptr;
 }
 
+TransferManagerPtr TransferManager::DetachTransferManagerInstance()
+{
+    TransferManagerPtr transferManager = g_transferManagerInstance;
+    g_transferManagerInstance = nullptr;
+    return transferManager;
+}
+
+void TransferManager::AttachTransferManagerInstance(TransferManagerPtr transferManager)
+{
+    g_transferManagerInstance = transferManager;
+}
+
 TransferManager::~TransferManager()
 {
     if (globalParams != nullptr) {
@@ -96,8 +108,7 @@ bool TransferManager::CommandsParser(int fd, const std::vector<std::string> &con
                 cmd->GetCommandType() == CommandType::BSDIFF ||
                 cmd->GetCommandType() == CommandType::ZERO;
             if (totalSize != 0 && globalParams->env != nullptr && typeResult) {
-                globalParams->env->PostMessage("set_progress",
-                    std::to_string((float)(globalParams->written - initBlock) / totalSize));
+                globalParams->env->PostProgress((float)(globalParams->written - initBlock) / totalSize);
             }
             LOG(INFO) << "Running command : " << cmd->GetArgumentByPos(0) << " success";
         }
@@ -111,7 +122,6 @@ void TransferManager::Init()
 {
     globalParams = std::make_unique<GlobalParams>();
     globalParams->writerThreadInfo = std::make_unique<WriterThreadInfo>();
-    blocksetMap.clear();
 }
 
 bool TransferManager::RegisterForRetry(const std::string &cmd)
@@ -15,8 +15,11 @@
 
 #ifndef DEFLATE_ADAPTER_H
 #define DEFLATE_ADAPTER_H
+#include <fstream>
 #include <iostream>
+#include <vector>
 #include "diffpatch.h"
+#include "securec.h"
 
 namespace updatepatch {
 class DeflateAdapter {
@@ -47,5 +50,39 @@ public:
 protected:
     bool init_ = false;
 };
+
+// 补丁中ctrl/diff/extra数据块的压缩基类, 压缩结果写入buffer或者文件
+class PatchDeflateAdapter : public DeflateAdapter {
+public:
+    PatchDeflateAdapter(std::vector<uint8_t> &buffer, size_t offset)
+        : DeflateAdapter(), buffer_(&buffer), offset_(offset) {}
+    explicit PatchDeflateAdapter(std::fstream &stream) : DeflateAdapter(), stream_(&stream) {}
+    ~PatchDeflateAdapter() override {}
+protected:
+    int32_t OutputData(const uint8_t *data, size_t size)
+    {
+        if (size == 0) {
+            return 0;
+        }
+        if (stream_ != nullptr) {
+            stream_->write(reinterpret_cast<const char *>(data), size);
+            PATCH_CHECK(!stream_->fail(), return -1, "Failed to write data %zu", size);
+        } else {
+            if (offset_ + dataSize_ + size > buffer_->size()) {
+                buffer_->resize(offset_ + dataSize_ + size);
+            }
+            int32_t ret = memcpy_s(buffer_->data() + offset_ + dataSize_, buffer_->size() - offset_ - dataSize_,
+                data, size);
+            PATCH_CHECK(ret == 0, return -1, "Failed to copy data %zu", size);
+        }
+        dataSize_ += size;
+        return 0;
+    }
+
+    std::vector<uint8_t> *buffer_ { nullptr };
+    std::fstream *stream_ { nullptr };
+    size_t offset_ { 0 };
+    size_t dataSize_ { 0 };
+};
 } // namespace updatepatch
 #endif // DEFLATE_ADAPTER_H
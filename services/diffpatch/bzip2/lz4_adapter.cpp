@@ -14,6 +14,7 @@
  */
 
 #include "lz4_adapter.h"
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include "lz4.h"
@@ -223,4 +224,97 @@ int32_t Lz4BlockAdapter::FlushData(size_t &offset)
     offset = offset_;
     return 0;
 }
+
+int32_t Lz4PatchAdapter::Open()
+{
+    PATCH_ONLY_CHECK(!init_, return 0);
+    PATCH_CHECK(!memset_s(&preferences_, sizeof(preferences_), 0, sizeof(preferences_)), return -1, "Memset failed");
+    preferences_.compressionLevel = LZ4HC_CLEVEL_MAX;
+    preferences_.frameInfo.blockMode = LZ4F_blockLinked;
+    preferences_.frameInfo.blockSizeID = LZ4F_max64KB;
+    outData_.resize(LZ4F_compressBound(BUFFER_SIZE, &preferences_));
+
+    LZ4F_errorCode_t errorCode = LZ4F_createCompressionContext(&compressionContext_, LZ4F_VERSION);
+    PATCH_CHECK(!LZ4F_isError(errorCode), return -1,
+        "Failed to create compress context %s", LZ4F_getErrorName(errorCode));
+    size_t dataSize = LZ4F_compressBegin(compressionContext_, outData_.data(), outData_.size(), &preferences_);
+    PATCH_CHECK(!LZ4F_isError(dataSize), LZ4F_freeCompressionContext(compressionContext_);
+        compressionContext_ = nullptr; return -1, "Failed to generate header %s", LZ4F_getErrorName(dataSize));
+    init_ = true;
+    return OutputData(outData_.data(), dataSize);
+}
+
+int32_t Lz4PatchAdapter::Close()
+{
+    PATCH_ONLY_CHECK(init_, return 0);
+    LZ4F_errorCode_t errorCode = LZ4F_freeCompressionContext(compressionContext_);
+    PATCH_CHECK(!LZ4F_isError(errorCode), return -1,
+        "Failed to free compress context %s", LZ4F_getErrorName(errorCode));
+    compressionContext_ = nullptr;
+    init_ = false;
+    return 0;
+}
+
+int32_t Lz4PatchAdapter::WriteData(const BlockBuffer &srcData)
+{
+    PATCH_CHECK(init_, return -1, "State error %d", init_);
+    size_t offset = 0;
+    while (offset < srcData.length) {
+        size_t length = std::min(srcData.length - offset, static_cast<size_t>(BUFFER_SIZE));
+        size_t dataSize = LZ4F_compressUpdate(compressionContext_, outData_.data(), outData_.size(),
+            srcData.buffer + offset, length, nullptr);
+        PATCH_CHECK(!LZ4F_isError(dataSize), return -1, "Failed to compress update %s", LZ4F_getErrorName(dataSize));
+        PATCH_CHECK(OutputData(outData_.data(), dataSize) == 0, return -1, "Failed to write data");
+        offset += length;
+    }
+    return 0;
+}
+
+int32_t Lz4PatchAdapter::FlushData(size_t &dataSize)
+{
+    PATCH_CHECK(init_, return -1, "State error %d", init_);
+    size_t endSize = LZ4F_compressEnd(compressionContext_, outData_.data(), outData_.size(), nullptr);
+    PATCH_CHECK(!LZ4F_isError(endSize), return -1, "Failed to compress end %s", LZ4F_getErrorName(endSize));
+    PATCH_CHECK(OutputData(outData_.data(), endSize) == 0, return -1, "Failed to write data");
+    dataSize = dataSize_;
+    return 0;
+}
+
+int32_t Lz4BufferReadAdapter::Open()
+{
+    PATCH_CHECK(!init_, return -1, "State error %d", init_);
+    PATCH_CHECK(offset_ + dataLength_ <= buffer_.length, return -1, "Invalid buffer length");
+    LZ4F_errorCode_t errorCode = LZ4F_createDecompressionContext(&decompressionContext_, LZ4F_VERSION);
+    PATCH_CHECK(!LZ4F_isError(errorCode), return -1,
+        "Failed to create decompress context %s", LZ4F_getErrorName(errorCode));
+    readOffset_ = 0;
+    init_ = true;
+    return PATCH_SUCCESS;
+}
+
+int32_t Lz4BufferReadAdapter::Close()
+{
+    PATCH_ONLY_CHECK(init_, return PATCH_SUCCESS);
+    LZ4F_freeDecompressionContext(decompressionContext_);
+    decompressionContext_ = nullptr;
+    init_ = false;
+    return PATCH_SUCCESS;
+}
+
+int32_t Lz4BufferReadAdapter::ReadData(BlockBuffer &info)
+{
+    PATCH_CHECK(init_, return -1, "State error %d", init_);
+    size_t readLen = 0;
+    while (readLen < info.length) {
+        size_t outSize = info.length - readLen;
+        size_t inSize = dataLength_ - readOffset_;
+        size_t ret = LZ4F_decompress(decompressionContext_, info.buffer + readLen, &outSize,
+            buffer_.buffer + offset_ + readOffset_, &inSize, nullptr);
+        PATCH_CHECK(!LZ4F_isError(ret), return -1, "Failed to decompress %s", LZ4F_getErrorName(ret));
+        PATCH_CHECK(outSize != 0 || inSize != 0, return -1, "Not enough buffer to decompress");
+        readLen += outSize;
+        readOffset_ += inSize;
+    }
+    return 0;
+}
 } // namespace updatepatch
@@ -17,6 +17,7 @@
 #define LZ4_ADAPTER_H
 #include <iostream>
 #include <vector>
+#include "bzip2_adapter.h"
 #include "deflate_adapter.h"
 #include "diffpatch.h"
 #include "lz4.h"
@@ -84,5 +85,44 @@ public:
 private:
     int32_t CompressData(const BlockBuffer &srcData) override;
 };
+
+// lz4 frame压缩补丁中的ctrl/diff/extra数据块
+class Lz4PatchAdapter : public PatchDeflateAdapter {
+public:
+    Lz4PatchAdapter(std::vector<uint8_t> &buffer, size_t offset) : PatchDeflateAdapter(buffer, offset) {}
+    explicit Lz4PatchAdapter(std::fstream &stream) : PatchDeflateAdapter(stream) {}
+    ~Lz4PatchAdapter() override
+    {
+        Close();
+    }
+
+    int32_t Open() override;
+    int32_t Close() override;
+    int32_t WriteData(const BlockBuffer &srcData) override;
+    int32_t FlushData(size_t &dataSize) override;
+private:
+    LZ4F_preferences_t preferences_ {};
+    LZ4F_compressionContext_t compressionContext_ { nullptr };
+    std::vector<uint8_t> outData_ {};
+};
+
+class Lz4BufferReadAdapter : public BZip2ReadAdapter {
+public:
+    Lz4BufferReadAdapter(size_t offset, size_t length, const BlockBuffer &info)
+        : BZip2ReadAdapter(offset, length), buffer_(info) {}
+    ~Lz4BufferReadAdapter() override
+    {
+        Close();
+    }
+
+    int32_t Open() override;
+    int32_t Close() override;
+
+    int32_t ReadData(BlockBuffer &info) override;
+private:
+    BlockBuffer buffer_ {};
+    size_t readOffset_ { 0 };
+    LZ4F_decompressionContext_t decompressionContext_ { nullptr };
+};
 } // namespace updatepatch
 #endif // LZ4_ADAPTER_H
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "zstd_adapter.h"
+#include <iostream>
+#include <vector>
+#include "zstd.h"
+
+using namespace hpackage;
+
+namespace updatepatch {
+int32_t ZstdPatchAdapter::Open()
+{
+    PATCH_ONLY_CHECK(!init_, return 0);
+    context_ = ZSTD_createCCtx();
+    PATCH_CHECK(context_ != nullptr, return -1, "Failed to create zstd context");
+    size_t ret = ZSTD_CCtx_setParameter(context_, ZSTD_c_compressionLevel, COMPRESSION_LEVEL);
+    PATCH_CHECK(!ZSTD_isError(ret), ZSTD_freeCCtx(context_); context_ = nullptr;
+        return -1, "Failed to set level %s", ZSTD_getErrorName(ret));
+    outData_.resize(ZSTD_CStreamOutSize());
+    init_ = true;
+    return 0;
+}
+
+int32_t ZstdPatchAdapter::Close()
+{
+    PATCH_ONLY_CHECK(init_, return 0);
+    ZSTD_freeCCtx(context_);
+    context_ = nullptr;
+    init_ = false;
+    return 0;
+}
+
+int32_t ZstdPatchAdapter::WriteData(const BlockBuffer &srcData)
+{
+    PATCH_CHECK(init_, return -1, "State error %d", init_);
+    ZSTD_inBuffer input = { srcData.buffer, srcData.length, 0 };
+    while (input.pos < input.size) {
+        ZSTD_outBuffer output = { outData_.data(), outData_.size(), 0 };
+        size_t ret = ZSTD_compressStream2(context_, &output, &input, ZSTD_e_continue);
+        PATCH_CHECK(!ZSTD_isError(ret), return -1, "Failed to compress data %s", ZSTD_getErrorName(ret));
+        PATCH_CHECK(OutputData(outData_.data(), output.pos) == 0, return -1, "Failed to write data");
+    }
+    return PATCH_SUCCESS;
+}
+
+int32_t ZstdPatchAdapter::FlushData(size_t &dataSize)
+{
+    PATCH_CHECK(init_, return -1, "State error %d", init_);
+    ZSTD_inBuffer input = { nullptr, 0, 0 };
+    size_t remaining = 0;
+    do {
+        ZSTD_outBuffer output = { outData_.data(), outData_.size(), 0 };
+        remaining = ZSTD_compressStream2(context_, &output, &input, ZSTD_e_end);
+        PATCH_CHECK(!ZSTD_isError(remaining), return -1, "Failed to flush data %s", ZSTD_getErrorName(remaining));
+        PATCH_CHECK(OutputData(outData_.data(), output.pos) == 0, return -1, "Failed to write data");
+    } while (remaining != 0);
+    PATCH_DEBUG("FlushData offset_ %zu dataSize_ %zu ", offset_, dataSize_);
+    dataSize = dataSize_;
+    return 0;
+}
+
+int32_t ZstdBufferReadAdapter::Open()
+{
+    PATCH_CHECK(!init_, return -1, "State error %d", init_);
+    PATCH_CHECK(offset_ + dataLength_ <= buffer_.length, return -1, "Invalid buffer length");
+    context_ = ZSTD_createDCtx();
+    PATCH_CHECK(context_ != nullptr, return -1, "Failed to create zstd context");
+    input_ = { buffer_.buffer + offset_, dataLength_, 0 };
+    init_ = true;
+    return PATCH_SUCCESS;
+}
+
+int32_t ZstdBufferReadAdapter::Close()
+{
+    PATCH_ONLY_CHECK(init_, return PATCH_SUCCESS);
+    ZSTD_freeDCtx(context_);
+    context_ = nullptr;
+    init_ = false;
+    return PATCH_SUCCESS;
+}
+
+int32_t ZstdBufferReadAdapter::ReadData(BlockBuffer &info)
+{
+    PATCH_CHECK(init_, return -1, "State error %d", init_);
+    ZSTD_outBuffer output = { info.buffer, info.length, 0 };
+    while (output.pos < output.size) {
+        size_t lastIn = input_.pos;
+        size_t lastOut = output.pos;
+        size_t ret = ZSTD_decompressStream(context_, &output, &input_);
+        PATCH_CHECK(!ZSTD_isError(ret), return -1, "Failed to decompress %s", ZSTD_getErrorName(ret));
+        PATCH_CHECK(input_.pos != lastIn || output.pos != lastOut, return -1, "Not enough buffer to decompress");
+    }
+    return 0;
+}
+} // namespace updatepatch
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ZSTD_ADAPTER_H
+#define ZSTD_ADAPTER_H
+#include <iostream>
+#include <vector>
+#include "bzip2_adapter.h"
+#include "deflate_adapter.h"
+#include "diffpatch.h"
+#include "zstd.h"
+
+namespace updatepatch {
+class ZstdPatchAdapter : public PatchDeflateAdapter {
+public:
+    ZstdPatchAdapter(std::vector<uint8_t> &buffer, size_t offset) : PatchDeflateAdapter(buffer, offset) {}
+    explicit ZstdPatchAdapter(std::fstream &stream) : PatchDeflateAdapter(stream) {}
+    ~ZstdPatchAdapter() override
+    {
+        Close();
+    }
+
+    int32_t Open() override;
+    int32_t Close() override;
+    int32_t WriteData(const BlockBuffer &srcData) override;
+    int32_t FlushData(size_t &dataSize) override;
+private:
+    static constexpr int32_t COMPRESSION_LEVEL = 19;
+    ZSTD_CCtx *context_ { nullptr };
+    std::vector<uint8_t> outData_ {};
+};
+
+class ZstdBufferReadAdapter : public BZip2ReadAdapter {
+public:
+    ZstdBufferReadAdapter(size_t offset, size_t length, const BlockBuffer &info)
+        : BZip2ReadAdapter(offset, length), buffer_(info) {}
+    ~ZstdBufferReadAdapter() override
+    {
+        Close();
+    }
+
+    int32_t Open() override;
+    int32_t Close() override;
+
+    int32_t ReadData(BlockBuffer &info) override;
+private:
+    BlockBuffer buffer_ {};
+    ZSTD_DCtx *context_ { nullptr };
+    ZSTD_inBuffer input_ {};
+};
+} // namespace updatepatch
+#endif // ZSTD_ADAPTER_H
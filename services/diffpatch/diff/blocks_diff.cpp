@@ -14,16 +14,20 @@
  */
 
 #include "blocks_diff.h"
+#include <algorithm>
 #include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <vector>
+#include "lz4_adapter.h"
 #include "update_diff.h"
+#include "zstd_adapter.h"
 
 using namespace hpackage;
 using namespace std;
 
 namespace updatepatch {
-#define SWAP(a, b) auto swapTmp = (a); (a) = (b); (b) = swapTmp
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 #define SET_BUFFER(y, buffer, index) \
     (buffer)[index] = (y) % 256;  (y) -= (buffer)[index];  (y) =  (y) / 256
@@ -31,7 +35,18 @@ namespace updatepatch {
 constexpr uint32_t BUCKET_SIZE = 256;
 constexpr uint32_t MULTIPLE_TWO = 2;
 constexpr int64_t BLOCK_SCORE = 8;
-constexpr int64_t MIN_LENGTH = 16;
+// 按固定大小切分新镜像, 保证生成的补丁与线程数无关
+constexpr size_t DIFF_SEGMENT_SIZE = 4 * 1024 * 1024;
+static const std::string SUFFIX_ARRAY_MAGIC = "SUFARR01";
+
+// 后缀数组文件头, 之后为 (oldLength + 1) 个本机字节序的索引
+struct SuffixArrayHeader {
+    char magic[8] {};
+    uint32_t indexSize { 0 };
+    uint32_t reserved { 0 };
+    uint64_t oldLength { 0 };
+    char oldHash[64] {}; // 旧镜像的 sha256, 防止误用其他镜像的后缀数组
+};
 
 static void WriteLE64(const BlockBuffer &buffer, int64_t value)
 {
@@ -58,7 +73,7 @@ static void WriteLE64(const BlockBuffer &buffer, int64_t value)
 }
 
 int32_t BlocksDiff::MakePatch(const std::string &oldFileName, const std::string &newFileName,
-    const std::string &patchFileName)
+    const std::string &patchFileName, int32_t compressMethod)
 {
     PATCH_LOGI("BlocksDiff::MakePatch %s ", patchFileName.c_str());
     std::fstream patchFile(patchFileName, std::ios::out | std::ios::trunc | std::ios::binary);
@@ -72,6 +87,7 @@ int32_t BlocksDiff::MakePatch(const std::string &oldFileName, const std::string
     BlockBuffer newInfo = {newBuffer.memory, newBuffer.length};
     BlockBuffer oldInfo = {oldBuffer.memory, oldBuffer.length};
     std::unique_ptr<BlocksDiff> blockdiff = std::make_unique<BlocksStreamDiff>(patchFile, 0);
+    blockdiff->SetCompressMethod(compressMethod);
     size_t patchSize = 0;
     ret = blockdiff->MakePatch(newInfo, oldInfo, patchSize);
     PATCH_CHECK(ret == PATCH_SUCCESS, return ret, "Failed to generate patch");
@@ -81,13 +97,14 @@ int32_t BlocksDiff::MakePatch(const std::string &oldFileName, const std::string
     return ret;
 }
 
-int32_t BlocksDiff::MakePatch(const BlockBuffer &newInfo,
-    const BlockBuffer &oldInfo, std::vector<uint8_t> &patchData, size_t offset, size_t &patchSize)
+int32_t BlocksDiff::MakePatch(const BlockBuffer &newInfo, const BlockBuffer &oldInfo,
+    std::vector<uint8_t> &patchData, size_t offset, size_t &patchSize, int32_t compressMethod)
 {
     if (patchData.empty()) {
         patchData.resize(IGMDIFF_LIMIT_UNIT);
     }
     std::unique_ptr<BlocksDiff> blockdiff = std::make_unique<BlocksBufferDiff>(patchData, offset);
+    blockdiff->SetCompressMethod(compressMethod);
     int32_t ret = blockdiff->MakePatch(newInfo, oldInfo, patchSize);
     PATCH_CHECK(ret == PATCH_SUCCESS, return ret, "Failed to generate patch");
     PATCH_CHECK(patchData.size() >= patchSize, return -1, "Failed to make block patch");
@@ -96,11 +113,12 @@ int32_t BlocksDiff::MakePatch(const BlockBuffer &newInfo,
     return ret;
 }
 
-int32_t BlocksDiff::MakePatch(const BlockBuffer &newInfo,
-    const BlockBuffer &oldInfo, std::fstream &patchFile, size_t &patchSize)
+int32_t BlocksDiff::MakePatch(const BlockBuffer &newInfo, const BlockBuffer &oldInfo,
+    std::fstream &patchFile, size_t &patchSize, int32_t compressMethod)
 {
     std::unique_ptr<BlocksDiff> blockdiff = std::make_unique<BlocksStreamDiff>(
         patchFile, static_cast<size_t>(patchFile.tellp()));
+    blockdiff->SetCompressMethod(compressMethod);
     int32_t ret = blockdiff->MakePatch(newInfo, oldInfo, patchSize);
     PATCH_CHECK(ret == PATCH_SUCCESS, return ret, "Failed to generate patch");
     PATCH_LOGI("BlocksDiff::MakePatch success %zu patchFile %zu",
@@ -108,10 +126,61 @@ int32_t BlocksDiff::MakePatch(const BlockBuffer &newInfo,
     return ret;
 }
 
+std::shared_ptr<SuffixArrayBase> BlocksDiff::GetSuffixArray(const BlockBuffer &oldInfo,
+    const std::string &suffixArrayFile)
+{
+    std::shared_ptr<SuffixArrayBase> suffixArray = nullptr;
+    if (!suffixArrayFile.empty()) {
+        suffixArray = SuffixArrayBase::Load(suffixArrayFile, oldInfo);
+        if (suffixArray != nullptr) {
+            return suffixArray;
+        }
+    }
+    suffixArray = SuffixArrayBase::Create(oldInfo.length);
+    PATCH_CHECK(suffixArray != nullptr, return nullptr, "Failed to create SuffixArray");
+    suffixArray->Init(oldInfo);
+    if (!suffixArrayFile.empty() && suffixArray->Save(suffixArrayFile, oldInfo) != 0) {
+        // 保存失败不影响本次差分
+        PATCH_LOGE("Failed to save suffix array %s", suffixArrayFile.c_str());
+    }
+    return suffixArray;
+}
+
+int32_t BlocksDiff::MakePatch(const std::string &oldFileName,
+    const std::vector<std::pair<std::string, std::string>> &targets,
+    int32_t compressMethod, const std::string &suffixArrayFile)
+{
+    MemMapInfo oldBuffer {};
+    int32_t ret = PatchMapFile(oldFileName, oldBuffer);
+    PATCH_CHECK(ret == 0, return -1, "Failed to open %s", oldFileName.c_str());
+    BlockBuffer oldInfo = {oldBuffer.memory, oldBuffer.length};
+    std::shared_ptr<SuffixArrayBase> suffixArray = GetSuffixArray(oldInfo, suffixArrayFile);
+    PATCH_CHECK(suffixArray != nullptr, return -1, "Failed to get SuffixArray");
+
+    for (auto &target : targets) {
+        PATCH_LOGI("BlocksDiff::MakePatch %s ", target.second.c_str());
+        std::fstream patchFile(target.second, std::ios::out | std::ios::trunc | std::ios::binary);
+        PATCH_CHECK(!patchFile.fail(), return -1, "Failed to open %s", strerror(errno));
+        MemMapInfo newBuffer {};
+        ret = PatchMapFile(target.first, newBuffer);
+        PATCH_CHECK(ret == 0, return -1, "Failed to open %s", target.first.c_str());
+        BlockBuffer newInfo = {newBuffer.memory, newBuffer.length};
+        std::unique_ptr<BlocksDiff> blockdiff = std::make_unique<BlocksStreamDiff>(patchFile, 0);
+        blockdiff->SetCompressMethod(compressMethod);
+        blockdiff->SetSuffixArray(suffixArray);
+        size_t patchSize = 0;
+        ret = blockdiff->MakePatch(newInfo, oldInfo, patchSize);
+        PATCH_CHECK(ret == PATCH_SUCCESS, return ret, "Failed to generate patch");
+        patchFile.close();
+        PATCH_LOGI("BlocksDiff::MakePatch success %zu", patchSize);
+    }
+    return 0;
+}
+
 int32_t BlocksDiff::MakePatch(const BlockBuffer &newInfo, const BlockBuffer &oldInfo, size_t &patchSize)
 {
     if (suffixArray_ == nullptr) {
-        suffixArray_.reset(new SuffixArray<int32_t>());
+        suffixArray_ = SuffixArrayBase::Create(oldInfo.length);
         PATCH_CHECK(suffixArray_ != nullptr, return -1, "Failed to create SuffixArray");
         suffixArray_->Init(oldInfo);
     }
@@ -150,21 +219,42 @@ int32_t BlocksDiff::MakePatch(const BlockBuffer &newInfo, const BlockBuffer &old
     return 0;
 }
 
-std::unique_ptr<DeflateAdapter> BlocksBufferDiff::CreateBZip2Adapter(size_t patchOffset)
+std::unique_ptr<DeflateAdapter> BlocksBufferDiff::CreateDeflateAdapter(size_t patchOffset)
 {
-    std::unique_ptr<DeflateAdapter> bzip2Adapter = std::make_unique<BZipBuffer2Adapter>(patchData_,
-        offset_ + patchOffset);
-    PATCH_CHECK(bzip2Adapter != nullptr, return nullptr, "Failed to create bzip2Adapter");
-    bzip2Adapter->Open();
-    return bzip2Adapter;
+    std::unique_ptr<DeflateAdapter> deflateAdapter = nullptr;
+    switch (compressMethod_) {
+        case BSDIFF_COMPRESS_ZSTD:
+            deflateAdapter = std::make_unique<ZstdPatchAdapter>(patchData_, offset_ + patchOffset);
+            break;
+        case BSDIFF_COMPRESS_LZ4:
+            deflateAdapter = std::make_unique<Lz4PatchAdapter>(patchData_, offset_ + patchOffset);
+            break;
+        default:
+            deflateAdapter = std::make_unique<BZipBuffer2Adapter>(patchData_, offset_ + patchOffset);
+            break;
+    }
+    PATCH_CHECK(deflateAdapter != nullptr, return nullptr, "Failed to create deflateAdapter");
+    PATCH_CHECK(deflateAdapter->Open() == 0, return nullptr, "Failed to open deflateAdapter");
+    return deflateAdapter;
 }
 
-std::unique_ptr<DeflateAdapter> BlocksStreamDiff::CreateBZip2Adapter(size_t patchOffset)
+std::unique_ptr<DeflateAdapter> BlocksStreamDiff::CreateDeflateAdapter(size_t patchOffset)
 {
-    std::unique_ptr<DeflateAdapter> bzip2Adapter = std::make_unique<BZip2StreamAdapter>(stream_);
-    PATCH_CHECK(bzip2Adapter != nullptr, return nullptr, "Failed to create bzip2Adapter");
-    bzip2Adapter->Open();
-    return bzip2Adapter;
+    std::unique_ptr<DeflateAdapter> deflateAdapter = nullptr;
+    switch (compressMethod_) {
+        case BSDIFF_COMPRESS_ZSTD:
+            deflateAdapter = std::make_unique<ZstdPatchAdapter>(stream_);
+            break;
+        case BSDIFF_COMPRESS_LZ4:
+            deflateAdapter = std::make_unique<Lz4PatchAdapter>(stream_);
+            break;
+        default:
+            deflateAdapter = std::make_unique<BZip2StreamAdapter>(stream_);
+            break;
+    }
+    PATCH_CHECK(deflateAdapter != nullptr, return nullptr, "Failed to create deflateAdapter");
+    PATCH_CHECK(deflateAdapter->Open() == 0, return nullptr, "Failed to open deflateAdapter");
+    return deflateAdapter;
 }
 
 int32_t BlocksBufferDiff::WritePatchHeader(int64_t controlSize,
@@ -173,7 +263,8 @@ int32_t BlocksBufferDiff::WritePatchHeader(int64_t controlSize,
     headerLen = BSDIFF_MAGIC.size() + sizeof(int64_t) + sizeof(int64_t) + sizeof(int64_t);
     PATCH_CHECK(patchData_.size() > headerLen + offset_, return -1, "Invalid patch size");
 
-    int32_t ret = memcpy_s(patchData_.data() + offset_, patchData_.size(), BSDIFF_MAGIC.c_str(), BSDIFF_MAGIC.size());
+    std::string magic = GetBsdiffMagic(compressMethod_);
+    int32_t ret = memcpy_s(patchData_.data() + offset_, patchData_.size(), magic.c_str(), magic.size());
     PATCH_CHECK(ret == 0, return ret, "Failed to copy magic");
     headerLen = BSDIFF_MAGIC.size();
     BlockBuffer data = {patchData_.data() + offset_ + headerLen, patchData_.size()};
@@ -193,7 +284,8 @@ int32_t BlocksStreamDiff::WritePatchHeader(int64_t controlSize,
 {
     PATCH_DEBUG("WritePatchHeader %zu", static_cast<size_t>(stream_.tellp()));
     stream_.seekp(offset_, std::ios::beg);
-    stream_.write(BSDIFF_MAGIC.c_str(), BSDIFF_MAGIC.size());
+    std::string magic = GetBsdiffMagic(compressMethod_);
+    stream_.write(magic.c_str(), magic.size());
     PkgBuffer buffer(sizeof(int64_t));
     WriteLE64(buffer, controlSize);
     stream_.write(reinterpret_cast<const char*>(buffer.buffer), sizeof(int64_t));
@@ -206,39 +298,45 @@ int32_t BlocksStreamDiff::WritePatchHeader(int64_t controlSize,
     return 0;
 }
 
-void BlocksDiff::ComputeOldScore(const BlockBuffer &newInfo,
-    const BlockBuffer &oldInfo, int64_t &oldScore, int64_t &matchLen)
+void BlocksDiff::ComputeOldScore(const BlockBuffer &newInfo, const BlockBuffer &oldInfo,
+    DiffSegment &segment, int64_t &oldScore, int64_t &matchLen) const
 {
     int64_t newSize = static_cast<int64_t>(newInfo.length);
-    for (int64_t begin = currentOffset_ += matchLen; currentOffset_ < newSize; currentOffset_++) {
-        BlockBuffer newBuff = {newInfo.buffer + currentOffset_, newInfo.length - currentOffset_};
-        matchLen = suffixArray_->Search(newBuff, { oldInfo.buffer, oldInfo.length }, 0, oldInfo.length, matchPos_);
-        for (; begin < currentOffset_ + matchLen; begin++) {
-            if ((begin + lastOffset_ < static_cast<int64_t>(oldInfo.length))
-                && (oldInfo.buffer[begin + lastOffset_] == newInfo.buffer[begin])) {
+    for (int64_t begin = segment.currentOffset += matchLen; segment.currentOffset < newSize;
+        segment.currentOffset++) {
+        BlockBuffer newBuff = {newInfo.buffer + segment.currentOffset, newInfo.length - segment.currentOffset};
+        matchLen = suffixArray_->Search(newBuff, { oldInfo.buffer, oldInfo.length },
+            0, oldInfo.length, segment.matchPos);
+        for (; begin < segment.currentOffset + matchLen; begin++) {
+            if ((begin + segment.lastOffset < static_cast<int64_t>(oldInfo.length))
+                && (oldInfo.buffer[begin + segment.lastOffset] == newInfo.buffer[begin])) {
                 oldScore++;
             }
         }
         if (((matchLen == oldScore) && (matchLen != 0)) || (matchLen > (oldScore + BLOCK_SCORE))) {
             break;
         }
-        if ((currentOffset_ + lastOffset_ < static_cast<int64_t>(oldInfo.length)) &&
-            (oldInfo.buffer[currentOffset_ + lastOffset_] == newInfo.buffer[currentOffset_])) {
+        if ((segment.currentOffset + segment.lastOffset < static_cast<int64_t>(oldInfo.length)) &&
+            (oldInfo.buffer[segment.currentOffset + segment.lastOffset] == newInfo.buffer[segment.currentOffset])) {
             oldScore--;
         }
     }
 }
 
-void BlocksDiff::ComputeLength(const BlockBuffer &newInfo,
-    const BlockBuffer &oldInfo, int64_t &lengthFront, int64_t &lengthBack)
+void BlocksDiff::ComputeLength(const BlockBuffer &newInfo, const BlockBuffer &oldInfo,
+    const DiffSegment &segment, int64_t &lengthFront, int64_t &lengthBack) const
 {
+    const int64_t currentOffset = segment.currentOffset;
+    const int64_t lastScan = segment.lastScan;
+    const int64_t lastPos = segment.lastPos;
+    const int64_t matchPos = segment.matchPos;
     lengthFront = 0;
     lengthBack = 0;
     int64_t i = 0;
     int64_t s = 0;
     int64_t tmp = 0;
-    for (; ((lastScan_ + i) < currentOffset_) && ((lastPos_ + i) < static_cast<int64_t>(oldInfo.length)); ) {
-        if (oldInfo.buffer[lastPos_ + i] == newInfo.buffer[lastScan_ + i]) {
+    for (; ((lastScan + i) < currentOffset) && ((lastPos + i) < static_cast<int64_t>(oldInfo.length)); ) {
+        if (oldInfo.buffer[lastPos + i] == newInfo.buffer[lastScan + i]) {
             s++;
         }
         i++;
@@ -249,9 +347,9 @@ void BlocksDiff::ComputeLength(const BlockBuffer &newInfo,
     }
     s = 0;
     tmp = 0;
-    if (currentOffset_ < static_cast<int64_t>(newInfo.length)) {
-        for (i = 1; (currentOffset_ >= lastScan_ + i) && (matchPos_ >= i); i++) {
-            if (oldInfo.buffer[matchPos_ - i] == newInfo.buffer[currentOffset_ - i]) {
+    if (currentOffset < static_cast<int64_t>(newInfo.length)) {
+        for (i = 1; (currentOffset >= lastScan + i) && (matchPos >= i); i++) {
+            if (oldInfo.buffer[matchPos - i] == newInfo.buffer[currentOffset - i]) {
                 s++;
             }
             if ((s * MULTIPLE_TWO - i) > (tmp * MULTIPLE_TWO - lengthBack)) {
@@ -261,17 +359,17 @@ void BlocksDiff::ComputeLength(const BlockBuffer &newInfo,
         }
     }
 
-    if (lastScan_ + lengthFront > currentOffset_ - lengthBack) {
+    if (lastScan + lengthFront > currentOffset - lengthBack) {
         int64_t lens = 0;
-        int64_t overlap = (lastScan_ + lengthFront) - (currentOffset_ - lengthBack);
+        int64_t overlap = (lastScan + lengthFront) - (currentOffset - lengthBack);
         s = 0;
         tmp = 0;
         for (i = 0; i < overlap; i++) {
-            if (newInfo.buffer[lastScan_ + lengthFront - overlap + i] ==
-                oldInfo.buffer[lastPos_ + lengthFront - overlap + i]) {
+            if (newInfo.buffer[lastScan + lengthFront - overlap + i] ==
+                oldInfo.buffer[lastPos + lengthFront - overlap + i]) {
                 s++;
             }
-            if (newInfo.buffer[currentOffset_ - lengthBack + i] == oldInfo.buffer[matchPos_ - lengthBack + i]) {
+            if (newInfo.buffer[currentOffset - lengthBack + i] == oldInfo.buffer[matchPos - lengthBack + i]) {
                 s--;
             }
             if (s > tmp) {
@@ -284,41 +382,77 @@ void BlocksDiff::ComputeLength(const BlockBuffer &newInfo,
     }
 }
 
-int32_t BlocksDiff::GetCtrlDatas(const BlockBuffer &newInfo,
-    const BlockBuffer &oldInfo, std::vector<ControlData> &controlDatas)
+void BlocksDiff::GetSegmentCtrlDatas(const BlockBuffer &newInfo,
+    const BlockBuffer &oldInfo, DiffSegment &segment) const
 {
     int64_t matchLen = 0;
-    while (currentOffset_ < static_cast<int64_t>(newInfo.length)) {
+    while (segment.currentOffset < static_cast<int64_t>(newInfo.length)) {
         int64_t oldScore = 0;
         int64_t lenFront = 0;
         int64_t lenBack = 0;
-        ComputeOldScore(newInfo, oldInfo, oldScore, matchLen);
-        if ((matchLen == oldScore) && (currentOffset_ != static_cast<int64_t>(newInfo.length))) {
+        ComputeOldScore(newInfo, oldInfo, segment, oldScore, matchLen);
+        if ((matchLen == oldScore) && (segment.currentOffset != static_cast<int64_t>(newInfo.length))) {
             continue;
         }
-        ComputeLength(newInfo, oldInfo, lenFront, lenBack);
+        ComputeLength(newInfo, oldInfo, segment, lenFront, lenBack);
 
         // save ctrl data
         ControlData ctrlData;
         ctrlData.diffLength = lenFront;
-        ctrlData.extraLength = (currentOffset_ - lenBack) - (lastScan_ + lenFront);
-        ctrlData.offsetIncrement = (matchPos_ - lenBack) - (lastPos_ + lenFront);
-        ctrlData.diffNewStart = &newInfo.buffer[lastScan_];
-        ctrlData.diffOldStart = &oldInfo.buffer[lastPos_];
-        ctrlData.extraNewStart = &newInfo.buffer[lastScan_ + lenFront];
-        controlDatas.push_back(ctrlData);
-        lastScan_ = currentOffset_ - lenBack;
-        lastPos_ = matchPos_ - lenBack;
-        lastOffset_ = matchPos_ - currentOffset_;
+        ctrlData.extraLength = (segment.currentOffset - lenBack) - (segment.lastScan + lenFront);
+        ctrlData.offsetIncrement = (segment.matchPos - lenBack) - (segment.lastPos + lenFront);
+        ctrlData.diffNewStart = &newInfo.buffer[segment.lastScan];
+        ctrlData.diffOldStart = &oldInfo.buffer[segment.lastPos];
+        ctrlData.extraNewStart = &newInfo.buffer[segment.lastScan + lenFront];
+        segment.controlDatas.push_back(ctrlData);
+        segment.lastScan = segment.currentOffset - lenBack;
+        segment.lastPos = segment.matchPos - lenBack;
+        segment.lastOffset = segment.matchPos - segment.currentOffset;
+    }
+}
+
+int32_t BlocksDiff::GetCtrlDatas(const BlockBuffer &newInfo,
+    const BlockBuffer &oldInfo, std::vector<ControlData> &controlDatas)
+{
+    size_t segmentCount = (newInfo.length + DIFF_SEGMENT_SIZE - 1) / DIFF_SEGMENT_SIZE;
+    if (segmentCount <= 1) {
+        DiffSegment segment {};
+        GetSegmentCtrlDatas(newInfo, oldInfo, segment);
+        controlDatas = std::move(segment.controlDatas);
+        return 0;
+    }
+
+    // 每段从与新镜像相同的偏移开始匹配, 各段独立扫描
+    std::vector<DiffSegment> segments(segmentCount);
+    for (size_t i = 0; i < segmentCount; i++) {
+        int64_t start = static_cast<int64_t>(i * DIFF_SEGMENT_SIZE);
+        segments[i].currentOffset = start;
+        segments[i].lastScan = start;
+        segments[i].lastPos = std::min(start, static_cast<int64_t>(oldInfo.length));
+        segments[i].lastOffset = segments[i].lastPos - start;
+        segments[i].startPos = segments[i].lastPos;
+    }
+    PATCH_LOGI("GetCtrlDatas segments %zu", segmentCount);
+    RunParallelTasks(segmentCount, [&](size_t i) {
+        size_t end = std::min((i + 1) * DIFF_SEGMENT_SIZE, newInfo.length);
+        GetSegmentCtrlDatas({ newInfo.buffer, end }, oldInfo, segments[i]);
+    });
+
+    for (size_t i = 0; i < segmentCount; i++) {
+        PATCH_CHECK(!segments[i].controlDatas.empty(), return -1, "Invalid segment %zu", i);
+        if (i + 1 < segmentCount) {
+            // 将旧文件位置调整到下一段的起始位置
+            segments[i].controlDatas.back().offsetIncrement += segments[i + 1].startPos - segments[i].lastPos;
+        }
+        controlDatas.insert(controlDatas.end(), segments[i].controlDatas.begin(), segments[i].controlDatas.end());
     }
     return 0;
 }
 
 int32_t BlocksDiff::WriteControlData(const std::vector<ControlData> controlDatas, size_t &patchSize)
 {
-    std::unique_ptr<DeflateAdapter> bzip2Adapter = CreateBZip2Adapter(patchSize);
-    PATCH_CHECK(bzip2Adapter != nullptr, return -1, "Failed to create bzip2Adapter");
-    bzip2Adapter->Open();
+    std::unique_ptr<DeflateAdapter> deflateAdapter = CreateDeflateAdapter(patchSize);
+    PATCH_CHECK(deflateAdapter != nullptr, return -1, "Failed to create deflateAdapter");
     int32_t ret = 0;
     uint8_t buffer[sizeof(int64_t)] = {0};
     BlockBuffer srcData = {buffer, sizeof(int64_t)};
@@ -326,18 +460,19 @@ int32_t BlocksDiff::WriteControlData(const std::vector<ControlData> controlDatas
     std::vector<int64_t> data;
     for (size_t i = 0; i < controlDatas.size(); i++) {
         WriteLE64(srcData, controlDatas[i].diffLength);
-        ret = bzip2Adapter->WriteData(srcData);
+        ret = deflateAdapter->WriteData(srcData);
         PATCH_CHECK(ret == 0, return ret, "Failed to write data");
         WriteLE64(srcData, controlDatas[i].extraLength);
-        ret = bzip2Adapter->WriteData(srcData);
+        ret = deflateAdapter->WriteData(srcData);
         PATCH_CHECK(ret == 0, return ret, "Failed to write data");
         WriteLE64(srcData, controlDatas[i].offsetIncrement);
-        ret = bzip2Adapter->WriteData(srcData);
+        ret = deflateAdapter->WriteData(srcData);
         PATCH_CHECK(ret == 0, return ret, "Failed to write data");
     }
     size_t dataSize = 0;
-    ret = bzip2Adapter->FlushData(dataSize);
-    bzip2Adapter->Close();
+    ret = deflateAdapter->FlushData(dataSize);
+    deflateAdapter->Close();
+    PATCH_CHECK(ret == 0, return ret, "Failed to flush data");
     patchSize += dataSize;
     PATCH_DEBUG("WriteControlData exit patchSize %zu", patchSize);
     return 0;
@@ -346,9 +481,8 @@ int32_t BlocksDiff::WriteControlData(const std::vector<ControlData> controlDatas
 int32_t BlocksDiff::WriteDiffData(const std::vector<ControlData> controlDatas, size_t &patchSize)
 {
     PATCH_DEBUG("WriteDiffData patchSize %zu", patchSize);
-    std::unique_ptr<DeflateAdapter> bzip2Adapter = CreateBZip2Adapter(patchSize);
-    PATCH_CHECK(bzip2Adapter != nullptr, return -1, "Failed to create bzip2Adapter");
-    bzip2Adapter->Open();
+    std::unique_ptr<DeflateAdapter> deflateAdapter = CreateDeflateAdapter(patchSize);
+    PATCH_CHECK(deflateAdapter != nullptr, return -1, "Failed to create deflateAdapter");
 
     std::vector<uint8_t> diffData(IGMDIFF_LIMIT_UNIT, 0);
     int32_t ret = 0;
@@ -366,14 +500,15 @@ int32_t BlocksDiff::WriteDiffData(const std::vector<ControlData> controlDatas, s
             }
 
             BlockBuffer srcData = {reinterpret_cast<uint8_t*>(diffData.data()), static_cast<size_t>(cpyLen)};
-            ret = bzip2Adapter->WriteData(srcData);
+            ret = deflateAdapter->WriteData(srcData);
             PATCH_CHECK(ret == 0, return ret, "Failed to write data");
             offset += cpyLen;
         }
     }
     size_t dataSize = 0;
-    ret = bzip2Adapter->FlushData(dataSize);
-    bzip2Adapter->Close();
+    ret = deflateAdapter->FlushData(dataSize);
+    deflateAdapter->Close();
+    PATCH_CHECK(ret == 0, return ret, "Failed to flush data");
     patchSize += dataSize;
     PATCH_DEBUG("WriteDiffData exit patchSize %zu dataSize %zu ", patchSize, dataSize);
     return 0;
@@ -382,142 +517,246 @@ int32_t BlocksDiff::WriteDiffData(const std::vector<ControlData> controlDatas, s
 int32_t BlocksDiff::WriteExtraData(const std::vector<ControlData> controlDatas, size_t &patchSize)
 {
     PATCH_DEBUG("WriteExtraData patchSize %zu ", patchSize);
-    std::unique_ptr<DeflateAdapter> bzip2Adapter = CreateBZip2Adapter(patchSize);
-    PATCH_CHECK(bzip2Adapter != nullptr, return -1, "Failed to create bzip2Adapter");
-    bzip2Adapter->Open();
+    std::unique_ptr<DeflateAdapter> deflateAdapter = CreateDeflateAdapter(patchSize);
+    PATCH_CHECK(deflateAdapter != nullptr, return -1, "Failed to create deflateAdapter");
     int32_t ret = 0;
     for (size_t i = 0; i < controlDatas.size(); i++) {
         if (controlDatas[i].extraLength <= 0) {
             continue;
         }
         BlockBuffer srcData = {controlDatas[i].extraNewStart, static_cast<size_t>(controlDatas[i].extraLength)};
-        ret = bzip2Adapter->WriteData(srcData);
+        ret = deflateAdapter->WriteData(srcData);
         PATCH_CHECK(ret == 0, return ret, "Failed to write data");
     }
     size_t dataSize = 0;
-    ret = bzip2Adapter->FlushData(dataSize);
-    bzip2Adapter->Close();
+    ret = deflateAdapter->FlushData(dataSize);
+    deflateAdapter->Close();
+    PATCH_CHECK(ret == 0, return ret, "Failed to flush data");
     patchSize += dataSize;
     PATCH_DEBUG("WriteExtraData exit patchSize %zu", patchSize);
     return 0;
 }
 
-template<class DataType>
-void SuffixArray<DataType>::Init(const BlockBuffer &oldInfo)
+std::unique_ptr<SuffixArrayBase> SuffixArrayBase::Create(size_t oldLength)
 {
-    std::vector<DataType> suffixArrayTemp;
-    std::vector<DataType> buckets;
-    InitBuckets(oldInfo, buckets, suffixArrayTemp);
-    DataType i = 0;
-    DataType h = 0;
-    DataType len = 0;
-    for (h = 1; suffixArray_[0] != -(static_cast<DataType>(oldInfo.length) + 1); h += h) {
-        len = 0;
-        for (i = 0; i < (static_cast<DataType>(oldInfo.length) + 1); ) {
-            if (suffixArray_[i] < 0) {
-                len -= suffixArray_[i];
-                i -= suffixArray_[i];
-            } else {
-                if (len) {
-                    suffixArray_[i - len] = -len;
-                }
-                len = suffixArrayTemp[suffixArray_[i]] + 1 - i;
-                Split(suffixArrayTemp, i, len, h);
-                i += len;
-                len = 0;
-            }
-        }
-        if (len) {
-            suffixArray_[i - len] = -len;
-        }
+    if (oldLength < static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        return std::make_unique<SuffixArray<int32_t>>();
     }
+    PATCH_LOGI("SuffixArray use 64 bit index for %zu", oldLength);
+    return std::make_unique<SuffixArray<int64_t>>();
+}
 
-    for (i = 0; i < static_cast<DataType>(oldInfo.length) + 1; i++) {
-        suffixArray_[suffixArrayTemp[i]] = i;
+std::unique_ptr<SuffixArrayBase> SuffixArrayBase::Load(const std::string &fileName, const BlockBuffer &oldInfo)
+{
+    std::ifstream stream(fileName, std::ios::in | std::ios::binary);
+    if (!stream.is_open()) {
+        PATCH_LOGI("No suffix array file %s", fileName.c_str());
+        return nullptr;
     }
+    SuffixArrayHeader header {};
+    stream.read(reinterpret_cast<char *>(&header), sizeof(header));
+    PATCH_CHECK(!stream.fail() && memcmp(header.magic, SUFFIX_ARRAY_MAGIC.c_str(), sizeof(header.magic)) == 0,
+        return nullptr, "Invalid suffix array file %s", fileName.c_str());
+    PATCH_CHECK(header.oldLength == oldInfo.length, return nullptr,
+        "Suffix array length mismatch %zu %zu", static_cast<size_t>(header.oldLength), oldInfo.length);
+    std::string oldHash = GeneraterBufferHash(oldInfo);
+    PATCH_CHECK(oldHash.size() == sizeof(header.oldHash) &&
+        memcmp(header.oldHash, oldHash.c_str(), sizeof(header.oldHash)) == 0,
+        return nullptr, "Suffix array is not built from this image");
+
+    std::unique_ptr<SuffixArrayBase> suffixArray = Create(oldInfo.length);
+    PATCH_CHECK(suffixArray != nullptr, return nullptr, "Failed to create SuffixArray");
+    int32_t ret = suffixArray->LoadIndex(stream, oldInfo.length, header.indexSize);
+    PATCH_CHECK(ret == 0, return nullptr, "Failed to load suffix array");
+    PATCH_LOGI("SuffixArray::Load %s %zu", fileName.c_str(), oldInfo.length);
+    return suffixArray;
+}
 
-    PATCH_DEBUG("SuffixArray::Init %d finish", static_cast<int>(oldInfo.length));
+template<class DataType>
+void SuffixArray<DataType>::Init(const BlockBuffer &oldInfo)
+{
+    suffixArray_.resize(oldInfo.length + 1, 0);
+    BuildSuffixArray(oldInfo.buffer, suffixArray_.data(),
+        static_cast<DataType>(oldInfo.length), static_cast<DataType>(BUCKET_SIZE));
+    PATCH_DEBUG("SuffixArray::Init %zu finish", oldInfo.length);
 }
 
 template<class DataType>
-void SuffixArray<DataType>::SplitForLess(std::vector<DataType> &suffixArrayTemp,
-    DataType start, DataType len, DataType h)
+int32_t SuffixArray<DataType>::Save(const std::string &fileName, const BlockBuffer &oldInfo) const
 {
-    DataType j = 0;
-    for (DataType k = start; k < start + len; k += j) {
-        j = 1;
-        DataType x = suffixArrayTemp[suffixArray_[k] + h];
-        for (DataType i = 1; k + i < start + len; i++) {
-            if (suffixArrayTemp[suffixArray_[k + i] + h] < x) {
-                x = suffixArrayTemp[suffixArray_[k + i] + h];
-                j = 0;
-            }
-            if (suffixArrayTemp[suffixArray_[k + i] + h] == x) {
-                SWAP(suffixArray_[k + j], suffixArray_[k + i]);
-                j++;
-            }
-        }
-        for (DataType i = 0; i < j; i++) {
-            suffixArrayTemp[suffixArray_[k + i]] = k + j - 1;
+    PATCH_CHECK(suffixArray_.size() == oldInfo.length + 1, return -1, "Suffix array is not built");
+    std::string oldHash = GeneraterBufferHash(oldInfo);
+    SuffixArrayHeader header {};
+    PATCH_CHECK(oldHash.size() == sizeof(header.oldHash), return -1, "Failed to get hash");
+    memcpy_s(header.magic, sizeof(header.magic), SUFFIX_ARRAY_MAGIC.c_str(), SUFFIX_ARRAY_MAGIC.size());
+    memcpy_s(header.oldHash, sizeof(header.oldHash), oldHash.c_str(), oldHash.size());
+    header.indexSize = sizeof(DataType);
+    header.oldLength = oldInfo.length;
+
+    // 先写临时文件再改名, 中途失败不会留下不完整的文件
+    std::string tmpName = fileName + ".tmp";
+    std::ofstream stream(tmpName, std::ios::out | std::ios::trunc | std::ios::binary);
+    PATCH_CHECK(stream.is_open(), return -1, "Failed to open %s", tmpName.c_str());
+    stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char *>(suffixArray_.data()), suffixArray_.size() * sizeof(DataType));
+    stream.close();
+    PATCH_CHECK(!stream.fail(), unlink(tmpName.c_str()); return -1, "Failed to write %s", tmpName.c_str());
+    PATCH_CHECK(rename(tmpName.c_str(), fileName.c_str()) == 0, unlink(tmpName.c_str()); return -1,
+        "Failed to rename %s", fileName.c_str());
+    PATCH_LOGI("SuffixArray::Save %s %zu", fileName.c_str(), oldInfo.length);
+    return 0;
+}
+
+template<class DataType>
+int32_t SuffixArray<DataType>::LoadIndex(std::istream &stream, size_t oldLength, uint32_t indexSize)
+{
+    PATCH_CHECK(indexSize == sizeof(DataType), return -1, "Invalid index size %u", indexSize);
+    suffixArray_.resize(oldLength + 1);
+    stream.read(reinterpret_cast<char *>(suffixArray_.data()), suffixArray_.size() * sizeof(DataType));
+    PATCH_CHECK(!stream.fail(), suffixArray_.clear(); return -1, "Failed to read suffix array");
+    return 0;
+}
+
+// buckets[c] 为字符c在后缀数组中的起始/结束位置, 位置0留给末尾的空后缀
+template<class DataType>
+template<class CharType>
+void SuffixArray<DataType>::GetBuckets(const CharType *data, DataType length,
+    std::vector<DataType> &buckets, bool end)
+{
+    std::fill(buckets.begin(), buckets.end(), 0);
+    for (DataType i = 0; i < length; i++) {
+        buckets[data[i]]++;
+    }
+    DataType sum = 1;
+    for (size_t c = 0; c < buckets.size(); c++) {
+        sum += buckets[c];
+        buckets[c] = end ? sum : (sum - buckets[c]);
+    }
+}
+
+template<class DataType>
+template<class CharType>
+void SuffixArray<DataType>::InduceSort(const CharType *data, DataType *suffixArray, DataType length,
+    const std::vector<bool> &types, std::vector<DataType> &buckets)
+{
+    // L type suffixes, scan from left to right
+    GetBuckets(data, length, buckets, false);
+    for (DataType i = 0; i <= length; i++) {
+        DataType j = suffixArray[i] - 1;
+        if (suffixArray[i] > 0 && !types[j]) {
+            suffixArray[buckets[data[j]]++] = j;
         }
-        if (j == 1) {
-            suffixArray_[k] = -1;
+    }
+    // S type suffixes, scan from right to left
+    GetBuckets(data, length, buckets, true);
+    for (DataType i = length; i > 0; i--) {
+        DataType j = suffixArray[i] - 1;
+        if (suffixArray[i] > 0 && types[j]) {
+            suffixArray[--buckets[data[j]]] = j;
         }
     }
 }
 
+// SA-IS: data has an implicit sentinel at data[length], suffixArray holds length + 1 items
 template<class DataType>
-void SuffixArray<DataType>::Split(std::vector<DataType> &suffixArrayTemp, DataType start, DataType len, DataType h)
+template<class CharType>
+void SuffixArray<DataType>::BuildSuffixArray(const CharType *data, DataType *suffixArray,
+    DataType length, DataType alphabetSize)
 {
-    if (len < MIN_LENGTH) {
-        SplitForLess(suffixArrayTemp, start, len, h);
+    std::fill(suffixArray, suffixArray + length + 1, -1);
+    suffixArray[0] = length;
+    if (length == 0) {
         return;
     }
 
-    DataType x = suffixArrayTemp[suffixArray_[start + len / MULTIPLE_TWO] + h];
-    DataType jj = 0;
-    DataType kk = 0;
-    for (DataType i = start; i < (start + len); i++) {
-        jj = (suffixArrayTemp[suffixArray_[i] + h] < x) ? (jj + 1) : jj;
-        kk = (suffixArrayTemp[suffixArray_[i] + h] == x) ? (kk + 1) : kk;
-    }
-    jj += start;
-    kk += jj;
-    DataType i = start;
-    DataType j = 0;
-    DataType k = 0;
-    while (i < jj) {
-        if (suffixArrayTemp[suffixArray_[i] + h] < x) {
-            i++;
-        } else if (suffixArrayTemp[suffixArray_[i] + h] == x) {
-            SWAP(suffixArray_[i], suffixArray_[jj + j]);
-            j++;
-        } else {
-            SWAP(suffixArray_[i], suffixArray_[kk + k]);
-            k++;
+    // true for S type, the sentinel is S type and the last char is L type
+    std::vector<bool> types(length + 1, false);
+    types[length] = true;
+    for (DataType i = length - 2; i >= 0; i--) {
+        types[i] = (data[i] < data[i + 1]) || (data[i] == data[i + 1] && types[i + 1]);
+    }
+    auto isLms = [&types](DataType i) -> bool {
+        return (i > 0) && types[i] && !types[i - 1];
+    };
+
+    // step 1: 按LMS子串排序
+    std::vector<DataType> buckets(alphabetSize, 0);
+    GetBuckets(data, length, buckets, true);
+    for (DataType i = 1; i < length; i++) {
+        if (isLms(i)) {
+            suffixArray[--buckets[data[i]]] = i;
         }
     }
-    while (jj + j < kk) {
-        if (suffixArrayTemp[suffixArray_[jj + j] + h] == x) {
-            j++;
-        } else {
-            SWAP(suffixArray_[jj + j], suffixArray_[kk + k]);
-            k++;
+    InduceSort(data, suffixArray, length, types, buckets);
+
+    // step 2: name the sorted LMS substrings, the sentinel always gets 0
+    DataType lmsCount = 0;
+    for (DataType i = 0; i <= length; i++) {
+        if (isLms(suffixArray[i])) {
+            suffixArray[lmsCount++] = suffixArray[i];
+        }
+    }
+    std::fill(suffixArray + lmsCount, suffixArray + length + 1, -1);
+    DataType name = 0;
+    DataType prev = -1;
+    for (DataType i = 0; i < lmsCount; i++) {
+        DataType pos = suffixArray[i];
+        bool diff = false;
+        for (DataType d = 0; ; d++) {
+            if (prev == -1 || pos + d == length || prev + d == length ||
+                data[pos + d] != data[prev + d] || types[pos + d] != types[prev + d]) {
+                diff = true;
+                break;
+            }
+            if (d > 0 && (isLms(pos + d) || isLms(prev + d))) {
+                break;
+            }
+        }
+        if (diff) {
+            name++;
+            prev = pos;
+        }
+        suffixArray[lmsCount + pos / MULTIPLE_TWO] = name - 1;
+    }
+    DataType *reduced = suffixArray + length + 1 - lmsCount;
+    for (DataType i = length, j = length; i >= lmsCount; i--) {
+        if (suffixArray[i] >= 0) {
+            suffixArray[j--] = suffixArray[i];
         }
     }
-    if (jj > start) {
-        Split(suffixArrayTemp, start, jj - start, h);
+
+    // 递归排序去掉哨兵后的缩减串
+    DataType reducedLength = lmsCount - 1;
+    for (DataType i = 0; i < reducedLength; i++) {
+        reduced[i]--;
+    }
+    if (name < lmsCount) {
+        BuildSuffixArray(reduced, suffixArray, reducedLength, name - 1);
+    } else {
+        suffixArray[0] = reducedLength;
+        for (DataType i = 0; i < reducedLength; i++) {
+            suffixArray[reduced[i] + 1] = i;
+        }
     }
 
-    for (i = 0; i < kk - jj; i++) {
-        suffixArrayTemp[suffixArray_[jj + i]] = kk - 1;
+    // step 3: induce the final order from the sorted LMS suffixes
+    for (DataType i = 1, j = 0; i <= length; i++) {
+        if (isLms(i)) {
+            reduced[j++] = i;
+        }
     }
-    if (jj == kk - 1) {
-        suffixArray_[jj] = -1;
+    for (DataType i = 0; i < lmsCount; i++) {
+        suffixArray[i] = reduced[suffixArray[i]];
     }
-    if (start + len > kk) {
-        Split(suffixArrayTemp, kk, start + len - kk, h);
+    std::fill(suffixArray + lmsCount, suffixArray + length + 1, -1);
+    GetBuckets(data, length, buckets, true);
+    for (DataType i = lmsCount - 1; i > 0; i--) {
+        DataType j = suffixArray[i];
+        suffixArray[i] = -1;
+        suffixArray[--buckets[data[j]]] = j;
     }
+    suffixArray[0] = length;
+    InduceSort(data, suffixArray, length, types, buckets);
 }
 
 template<class DataType>
@@ -560,41 +799,6 @@ int64_t SuffixArray<DataType>::Search(const BlockBuffer &newInfo,
     }
 }
 
-template<class DataType>
-void SuffixArray<DataType>::InitBuckets(const BlockBuffer &oldInfo,
-    std::vector<DataType> &buckets, std::vector<DataType> &suffixArrayTemp)
-{
-    suffixArray_.resize(oldInfo.length + 1, 0);
-    suffixArrayTemp.resize(oldInfo.length + 1, 0);
-    buckets.resize(BUCKET_SIZE, 0);
-
-    for (size_t i = 0; i < oldInfo.length; i++) {
-        buckets[oldInfo.buffer[i]]++;
-    }
-    for (size_t i = 1; i < buckets.size(); i++) {
-        buckets[i] += buckets[i - 1];
-    }
-    for (size_t i = buckets.size() - 1; i > 0; i--) {
-        buckets[i] = buckets[i - 1];
-    }
-    buckets[0] = 0;
-
-    DataType i;
-    for (i = 0; i < static_cast<DataType>(oldInfo.length); i++) {
-        suffixArray_[++buckets[oldInfo.buffer[i]]] = i;
-    }
-    suffixArray_[0] = oldInfo.length;
-
-    for (i = 0; i < static_cast<DataType>(oldInfo.length); i++) {
-        suffixArrayTemp[i] = buckets[oldInfo.buffer[i]];
-    }
-    suffixArrayTemp[oldInfo.length] = 0;
-
-    for (i = 1; i < static_cast<DataType>(BUCKET_SIZE); i++) {
-        if (buckets[i] == buckets[i - 1] + 1) {
-            suffixArray_[buckets[i]] = -1;
-        }
-    }
-    suffixArray_[0] = -1;
-}
+template class SuffixArray<int32_t>;
+template class SuffixArray<int64_t>;
 } // namespace updatepatch
@@ -17,6 +17,7 @@
 #define BLOCKS_DIFF_H
 
 #include <iostream>
+#include <memory>
 #include <vector>
 #include "bzip2_adapter.h"
 #include "diffpatch.h"
@@ -25,61 +26,111 @@
 #include "update_diff.h"
 
 namespace updatepatch {
+class SuffixArrayBase {
+public:
+    SuffixArrayBase() = default;
+    virtual ~SuffixArrayBase() {}
+
+    virtual void Init(const BlockBuffer &oldInfo) = 0;
+    virtual int64_t Search(const BlockBuffer &newInfo,
+        const BlockBuffer &oldInfo, int64_t st, int64_t en, int64_t &pos) const = 0;
+    // 保存到文件, 同一旧镜像再次差分时直接加载, 不再重新构建
+    virtual int32_t Save(const std::string &fileName, const BlockBuffer &oldInfo) const = 0;
+
+    // int32_t index for inputs below 2G, int64_t index otherwise
+    static std::unique_ptr<SuffixArrayBase> Create(size_t oldLength);
+    // 文件不存在或与 oldInfo 不匹配时返回 nullptr
+    static std::unique_ptr<SuffixArrayBase> Load(const std::string &fileName, const BlockBuffer &oldInfo);
+protected:
+    virtual int32_t LoadIndex(std::istream &stream, size_t oldLength, uint32_t indexSize) = 0;
+};
+
+// Suffix array built with SA-IS (induced sorting), suffixArray_[0] is the empty suffix
 template<class DataType>
-class SuffixArray {
+class SuffixArray : public SuffixArrayBase {
 public:
     SuffixArray() = default;
-    ~SuffixArray() {}
+    ~SuffixArray() override {}
 
-    void Init(const BlockBuffer &oldInfo);
+    void Init(const BlockBuffer &oldInfo) override;
     int64_t Search(const BlockBuffer &newInfo,
-        const BlockBuffer &oldInfo, int64_t st, int64_t en, int64_t &pos) const;
+        const BlockBuffer &oldInfo, int64_t st, int64_t en, int64_t &pos) const override;
+    int32_t Save(const std::string &fileName, const BlockBuffer &oldInfo) const override;
+protected:
+    int32_t LoadIndex(std::istream &stream, size_t oldLength, uint32_t indexSize) override;
 private:
-    void InitBuckets(const BlockBuffer &oldInfo,
-        std::vector<DataType> &buckets, std::vector<DataType> &suffixArrayTemp);
-    void Split(std::vector<DataType> &suffixArrayTemp, DataType start, DataType len, DataType h);
-    void SplitForLess(std::vector<DataType> &suffixArrayTemp, DataType start, DataType len, DataType h);
+    template<class CharType>
+    static void BuildSuffixArray(const CharType *data, DataType *suffixArray, DataType length, DataType alphabetSize);
+    template<class CharType>
+    static void GetBuckets(const CharType *data, DataType length, std::vector<DataType> &buckets, bool end);
+    template<class CharType>
+    static void InduceSort(const CharType *data, DataType *suffixArray, DataType length,
+        const std::vector<bool> &types, std::vector<DataType> &buckets);
     int64_t MatchLength(const BlockBuffer &oldBuffer, const BlockBuffer &newBuffer) const;
 
     std::vector<DataType> suffixArray_;
 };
 
+// scan state of one segment of the new image
+struct DiffSegment {
+    std::vector<ControlData> controlDatas {};
+    int64_t matchPos { 0 };
+    int64_t currentOffset { 0 };
+    int64_t lastOffset { 0 };
+    int64_t lastScan { 0 };
+    int64_t lastPos { 0 };
+    int64_t startPos { 0 }; // old position used by the first control data
+};
+
 class BlocksDiff {
 public:
     BlocksDiff() = default;
     virtual ~BlocksDiff() {}
 
+    static int32_t MakePatch(const std::string &oldFileName, const std::string &newFileName,
+        const std::string &patchFileName, int32_t compressMethod = BSDIFF_COMPRESS_BZIP2);
+    static int32_t MakePatch(const BlockBuffer &newInfo, const BlockBuffer &oldInfo, std::vector<uint8_t> &patchData,
+        size_t offset, size_t &patchSize, int32_t compressMethod = BSDIFF_COMPRESS_BZIP2);
+    static int32_t MakePatch(const BlockBuffer &newInfo, const BlockBuffer &oldInfo, std::fstream &patchFile,
+        size_t &patchSize, int32_t compressMethod = BSDIFF_COMPRESS_BZIP2);
+    // 同一旧镜像对多个新镜像差分, 后缀数组只构建一次; suffixArrayFile 非空时优先从该文件加载,
+    // 加载失败则构建后保存到该文件. targets 为 (新镜像, 补丁文件)
     static int32_t MakePatch(const std::string &oldFileName,
-        const std::string &newFileName, const std::string &patchFileName);
-    static int32_t MakePatch(const BlockBuffer &newInfo,
-        const BlockBuffer &oldInfo, std::vector<uint8_t> &patchData, size_t offset, size_t &patchSize);
-    static int32_t MakePatch(const BlockBuffer &newInfo,
-        const BlockBuffer &oldInfo, std::fstream &patchFile, size_t &patchSize);
+        const std::vector<std::pair<std::string, std::string>> &targets,
+        int32_t compressMethod = BSDIFF_COMPRESS_BZIP2, const std::string &suffixArrayFile = "");
+    static std::shared_ptr<SuffixArrayBase> GetSuffixArray(const BlockBuffer &oldInfo,
+        const std::string &suffixArrayFile);
 
     int32_t MakePatch(const BlockBuffer &newInfo, const BlockBuffer &oldInfo, size_t &patchSize);
+    void SetCompressMethod(int32_t compressMethod)
+    {
+        compressMethod_ = compressMethod;
+    }
+    // 使用已构建的后缀数组, 必须由同一个 oldInfo 构建
+    void SetSuffixArray(std::shared_ptr<SuffixArrayBase> suffixArray)
+    {
+        suffixArray_ = suffixArray;
+    }
+protected:
+    int32_t compressMethod_ { BSDIFF_COMPRESS_BZIP2 };
 private:
-    virtual std::unique_ptr<DeflateAdapter> CreateBZip2Adapter(size_t patchOffset) = 0;
+    virtual std::unique_ptr<DeflateAdapter> CreateDeflateAdapter(size_t patchOffset) = 0;
     virtual int32_t WritePatchHeader(int64_t controlSize,
         int64_t diffDataSize, int64_t newSize, size_t &patchOffset) = 0;
 
     int32_t GetCtrlDatas(const BlockBuffer &newInfo,
         const BlockBuffer &oldInfo, std::vector<ControlData> &controlDatas);
+    void GetSegmentCtrlDatas(const BlockBuffer &newInfo, const BlockBuffer &oldInfo, DiffSegment &segment) const;
     int32_t WriteControlData(const std::vector<ControlData> controlDatas, size_t &patchSize);
     int32_t WriteDiffData(const std::vector<ControlData> controlDatas, size_t &patchSize);
     int32_t WriteExtraData(const std::vector<ControlData> controlDatas, size_t &patchSize);
 
-    void ComputeOldScore(const BlockBuffer &newInfo,
-        const BlockBuffer &oldInfo, int64_t &oldScore, int64_t &matchLen);
-    void ComputeLength(const BlockBuffer &newInfo,
-        const BlockBuffer &oldInfo, int64_t &lengthFront, int64_t &lengthBack);
-
-    std::unique_ptr<SuffixArray<int32_t>> suffixArray_ {nullptr};
-    std::vector<ControlData> controls_ {};
-    int64_t matchPos_ { 0 };
-    int64_t currentOffset_ { 0 };
-    int64_t lastOffset_ { 0 };
-    int64_t lastScan_ { 0 };
-    int64_t lastPos_ { 0 };
+    void ComputeOldScore(const BlockBuffer &newInfo, const BlockBuffer &oldInfo,
+        DiffSegment &segment, int64_t &oldScore, int64_t &matchLen) const;
+    void ComputeLength(const BlockBuffer &newInfo, const BlockBuffer &oldInfo,
+        const DiffSegment &segment, int64_t &lengthFront, int64_t &lengthBack) const;
+
+    std::shared_ptr<SuffixArrayBase> suffixArray_ {nullptr};
 };
 
 class BlocksStreamDiff : public BlocksDiff {
@@ -87,7 +138,7 @@ public:
     BlocksStreamDiff(std::fstream &stream, size_t offset) : BlocksDiff(), stream_(stream), offset_(offset) {}
     ~BlocksStreamDiff() override {}
 private:
-    std::unique_ptr<DeflateAdapter> CreateBZip2Adapter(size_t patchOffset) override;
+    std::unique_ptr<DeflateAdapter> CreateDeflateAdapter(size_t patchOffset) override;
     int32_t WritePatchHeader(int64_t controlSize,
         int64_t diffDataSize, int64_t newSize, size_t &patchOffset) override;
     std::fstream &stream_;
@@ -100,7 +151,7 @@ public:
         : BlocksDiff(), patchData_(patchData), offset_(offset) {}
     ~BlocksBufferDiff() override {}
 private:
-    std::unique_ptr<DeflateAdapter> CreateBZip2Adapter(size_t patchOffset) override;
+    std::unique_ptr<DeflateAdapter> CreateDeflateAdapter(size_t patchOffset) override;
     int32_t WritePatchHeader(int64_t controlSize,
         int64_t diffDataSize, int64_t newSize, size_t &patchOffset) override;
     std::vector<uint8_t> &patchData_;
@@ -14,7 +14,10 @@
  */
 
 #include "image_diff.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include <vector>
 #include "diffpatch.h"
 
@@ -24,7 +27,6 @@ namespace updatepatch {
 #define GET_REAL_DATA_LEN(info) (info) ->packedSize + (info)->dataOffset - (info)->headerOffset
 constexpr int32_t LZ4F_MAX_BLOCKID = 7;
 constexpr int32_t ZIP_MAX_LEVEL = 9;
-constexpr int32_t MAX_NEW_LENGTH = 1 << 20;
 
 template<class DataType>
 static void WriteToFile(std::ofstream &patchFile, DataType data, size_t dataSize)
@@ -101,17 +103,12 @@ int32_t ImageDiff::SplitImage(const PatchBuffer &oldInfo, const PatchBuffer &new
     return 0;
 }
 
-int32_t ImageDiff::WriteHeader(std::ofstream &patchFile,
-    std::fstream &blockPatchFile, size_t &dataOffset, ImageBlock &block) const
+int32_t ImageDiff::WriteHeader(std::ofstream &patchFile, size_t &dataOffset, ImageBlock &block) const
 {
     int32_t ret = 0;
     switch (block.type) {
         case BLOCK_NORMAL: {
-            size_t patchSize = 0;
-            BlockBuffer newInfo = { block.newInfo.buffer + block.newInfo.start, block.newInfo.length };
-            BlockBuffer oldInfo = { block.oldInfo.buffer + block.oldInfo.start, block.oldInfo.length };
-            ret = MakeBlockPatch(block, blockPatchFile, newInfo, oldInfo, patchSize);
-            PATCH_CHECK(ret == 0, return -1, "Failed to make block patch");
+            size_t patchSize = block.patchSize;
             PATCH_LOGI("WriteHeader BLOCK_NORMAL patchOffset %zu oldInfo %ld %ld newInfo:%zu %zu patch %zu %zu",
                 static_cast<size_t>(patchFile.tellp()),
                 block.oldInfo.start, block.oldInfo.length, block.newInfo.start, block.newInfo.length,
@@ -139,57 +136,70 @@ int32_t ImageDiff::WriteHeader(std::ofstream &patchFile,
     return ret;
 }
 
-int32_t ImageDiff::MakeBlockPatch(ImageBlock &block, std::fstream &blockPatchFile,
-    const BlockBuffer &newInfo, const BlockBuffer &oldInfo, size_t &patchSize) const
+int32_t ImageDiff::MakeBlockPatch(ImageBlock &block) const
 {
-    if (!usePatchFile_) {
-        std::vector<uint8_t> patchData;
-        int32_t ret = BlocksDiff::MakePatch(newInfo, oldInfo, patchData, 0, patchSize);
-        PATCH_CHECK(ret == 0, return -1, "Failed to make block patch");
-        BlockBuffer patchBuffer = {patchData.data(), patchSize};
-        PATCH_DEBUG("MakeBlockPatch hash %zu %s", patchSize, GeneraterBufferHash(patchBuffer).c_str());
-        block.patchData = std::move(patchData);
-    } else {
-        int32_t ret = BlocksDiff::MakePatch(newInfo, oldInfo, blockPatchFile, patchSize);
-        PATCH_CHECK(ret == 0, return -1, "Failed to make block patch");
-        PATCH_LOGI("MakeBlockPatch patch %zu patch %zu",
-            patchSize, static_cast<size_t>(blockPatchFile.tellp()));
+    BlockBuffer newInfo {};
+    BlockBuffer oldInfo {};
+    switch (block.type) {
+        case BLOCK_NORMAL:
+            newInfo = { block.newInfo.buffer + block.newInfo.start, block.newInfo.length };
+            oldInfo = { block.oldInfo.buffer + block.oldInfo.start, block.oldInfo.length };
+            break;
+        case BLOCK_DEFLATE:
+        case BLOCK_LZ4:
+            newInfo = { block.destOriginalData.data(), block.destOriginalLength };
+            oldInfo = { block.srcOriginalData.data(), block.srcOriginalLength };
+            break;
+        default:
+            return 0;
     }
+    size_t patchSize = 0;
+    std::vector<uint8_t> patchData;
+    int32_t ret = BlocksDiff::MakePatch(newInfo, oldInfo, patchData, 0, patchSize, compressMethod_);
+    PATCH_CHECK(ret == 0, return -1, "Failed to make block patch");
+    patchData.resize(patchSize);
+    BlockBuffer patchBuffer = {patchData.data(), patchSize};
+    PATCH_DEBUG("MakeBlockPatch hash %zu %s", patchSize, GeneraterBufferHash(patchBuffer).c_str());
+    block.patchData = std::move(patchData);
+    block.patchSize = patchSize;
     return 0;
 }
 
-int32_t ImageDiff::WritePatch(std::ofstream &patchFile, std::fstream &blockPatchFile)
+int32_t ImageDiff::MakeBlockPatches(std::ofstream &patchFile)
 {
-    if (usePatchFile_) { // copy to patch
-        size_t bsPatchSize = static_cast<size_t>(blockPatchFile.tellp());
-        PATCH_LOGI("WritePatch patch block patch %zu img patch offset %zu",
-            bsPatchSize, static_cast<size_t>(patchFile.tellp()));
-        blockPatchFile.seekg(0, std::ios::beg);
-        std::vector<char> buffer(IGMDIFF_LIMIT_UNIT);
-        while (bsPatchSize > 0) {
-            size_t readLen = (bsPatchSize > IGMDIFF_LIMIT_UNIT) ? IGMDIFF_LIMIT_UNIT : bsPatchSize;
-            blockPatchFile.read(buffer.data(), readLen);
-            patchFile.write(buffer.data(), readLen);
-            bsPatchSize -= readLen;
-        }
-        PATCH_LOGI("WritePatch patch %zu", static_cast<size_t>(patchFile.tellp()));
-    } else {
-        for (size_t index = 0; index < updateBlocks_.size(); index++) {
-            if (updateBlocks_[index].type == BLOCK_RAW) {
-                continue;
-            }
-            PATCH_LOGI("WritePatch [%zu] write patch patchOffset %zu length %zu",
-                index, static_cast<size_t>(patchFile.tellp()), updateBlocks_[index].patchData.size());
-            patchFile.write(reinterpret_cast<const char*>(updateBlocks_[index].patchData.data()),
-                updateBlocks_[index].patchData.size());
+    // 各块的差分互不依赖, 在线程池中并行生成; 前面的块都写入后立即按顺序写入并释放
+    constexpr int32_t pending = 1;
+    std::vector<int32_t> results(updateBlocks_.size(), pending);
+    std::mutex writeMutex;
+    size_t nextWrite = 0;
+    std::atomic<int32_t> ret { 0 };
+    RunParallelTasks(updateBlocks_.size(), [&](size_t index) {
+        // 已经失败时不再生成剩余的块
+        int32_t result = (ret == 0) ? MakeBlockPatch(updateBlocks_[index]) : -1;
+        std::lock_guard<std::mutex> lock(writeMutex);
+        results[index] = result;
+        for (; nextWrite < results.size() && results[nextWrite] != pending && ret == 0; nextWrite++) {
+            ret = (results[nextWrite] == 0) ? WritePatch(patchFile, updateBlocks_[nextWrite]) : -1;
+            PATCH_CHECK(ret == 0, break, "Failed to make block patch %zu", nextWrite);
         }
+    });
+    return ret;
+}
+
+int32_t ImageDiff::WritePatch(std::ofstream &patchFile, ImageBlock &block) const
+{
+    if (block.type == BLOCK_RAW) {
+        return 0;
     }
+    PATCH_LOGI("WritePatch patchOffset %zu length %zu", static_cast<size_t>(patchFile.tellp()), block.patchSize);
+    patchFile.write(reinterpret_cast<const char*>(block.patchData.data()), block.patchSize);
+    PATCH_CHECK(!patchFile.fail(), return -1, "Failed to write patch");
+    std::vector<uint8_t>().swap(block.patchData);
     return 0;
 }
 
 int32_t ImageDiff::DiffImage(const std::string &patchName)
 {
-    std::fstream blockPatchFile;
     std::ofstream patchFile(patchName, std::ios::out | std::ios::trunc | std::ios::binary);
     PATCH_CHECK(!patchFile.fail(), return -1, "Failed to open %s", patchName.c_str());
 
@@ -199,30 +209,29 @@ int32_t ImageDiff::DiffImage(const std::string &patchName)
     patchFile.write(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
     dataOffset += sizeof(uint32_t);
 
+    std::streampos headerPos = patchFile.tellp();
     for (size_t index = 0; index < updateBlocks_.size(); index++) {
         dataOffset += GetHeaderSize(updateBlocks_[index]);
-        if (updateBlocks_[index].destOriginalLength >= MAX_NEW_LENGTH ||
-            updateBlocks_[index].newInfo.length >= MAX_NEW_LENGTH) {
-            usePatchFile_ = true;
-        }
     }
 
-    if (usePatchFile_) {
-        blockPatchFile.open(patchName + ".bspatch", std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
-        PATCH_CHECK(!blockPatchFile.fail(), return -1, "Failed to open bspatch %s", patchName.c_str());
-    }
+    // 头部大小固定, 先跳过头部写入补丁数据, 全部完成后再回填头部中的偏移
+    size_t patchOffset = dataOffset;
+    patchFile.seekp(static_cast<std::streamoff>(patchOffset));
+    int32_t ret = MakeBlockPatches(patchFile);
+    PATCH_CHECK(ret == 0, return -1, "Failed to make block patches");
+    std::streampos endPos = patchFile.tellp();
 
+    patchFile.seekp(headerPos);
     for (size_t index = 0; index < updateBlocks_.size(); index++) {
         PATCH_LOGI("DiffImage [%zu] write header patchOffset %zu dataOffset %zu",
             index, static_cast<size_t>(patchFile.tellp()), dataOffset);
         patchFile.write(reinterpret_cast<const char*>(&updateBlocks_[index].type), sizeof(uint32_t));
-        int32_t ret = WriteHeader(patchFile, blockPatchFile, dataOffset, updateBlocks_[index]);
+        ret = WriteHeader(patchFile, dataOffset, updateBlocks_[index]);
         PATCH_CHECK(ret == 0, return -1, "Failed to write header");
     }
-
-    int32_t ret = WritePatch(patchFile, blockPatchFile);
-    PATCH_CHECK(ret == 0, return -1, "Failed to write patch");
-    PATCH_LOGI("DiffImage success patchOffset %zu %s", static_cast<size_t>(patchFile.tellp()), patchName.c_str());
+    PATCH_CHECK(!patchFile.fail() && static_cast<size_t>(patchFile.tellp()) == patchOffset,
+        return -1, "Failed to write header");
+    PATCH_LOGI("DiffImage success patchOffset %zu %s", static_cast<size_t>(endPos), patchName.c_str());
     patchFile.close();
     return 0;
 }
@@ -283,7 +292,16 @@ int32_t CompressedImageDiff::DiffFile(const std::string &fileName, size_t &oldOf
     ret = newParser_->Extract(fileName, newBuffer);
     const FileInfo *newFileInfo = newParser_->GetFileInfo(fileName);
     PATCH_CHECK(ret == 0 && newFileInfo != nullptr, return -1, "Failed to get new data");
-    newOffset += GET_REAL_DATA_LEN(newFileInfo);
+    // 文件之间的数据 (如 zip 的 data descriptor) 不属于任何文件, 原样写入
+    if (newFileInfo->headerOffset > newOffset) {
+        ImageBlock block = {
+            BLOCK_RAW,
+            { orgNewBuffer.buffer, newOffset, newFileInfo->headerOffset - newOffset },
+            { orgOldBuffer.buffer, 0, orgOldBuffer.length },
+        };
+        updateBlocks_.push_back(std::move(block));
+    }
+    newOffset = std::max(newOffset, newFileInfo->headerOffset + GET_REAL_DATA_LEN(newFileInfo));
     PATCH_CHECK(limit_ == 0 || newFileInfo->unpackedSize < limit_, return PATCH_EXCEED_LIMIT,
         "Exceed limit, so make patch by original file");
 
@@ -299,7 +317,7 @@ int32_t CompressedImageDiff::DiffFile(const std::string &fileName, size_t &oldOf
     }
     const FileInfo *oldFileInfo = oldParser_->GetFileInfo(fileName);
     PATCH_CHECK(oldFileInfo != nullptr, return -1, "Failed to get file info");
-    oldOffset += GET_REAL_DATA_LEN(oldFileInfo);
+    oldOffset = std::max(oldOffset, oldFileInfo->headerOffset + GET_REAL_DATA_LEN(oldFileInfo));
 
     BlockBuffer newData = {newBuffer.data(), newFileInfo->unpackedSize};
     ret = TestAndSetConfig(newData, fileName);
@@ -327,17 +345,11 @@ int32_t CompressedImageDiff::DiffFile(const std::string &fileName, size_t &oldOf
     return 0;
 }
 
-int32_t ZipImageDiff::WriteHeader(std::ofstream &patchFile,
-    std::fstream &blockPatchFile, size_t &dataOffset, ImageBlock &block) const
+int32_t ZipImageDiff::WriteHeader(std::ofstream &patchFile, size_t &dataOffset, ImageBlock &block) const
 {
     int32_t ret = 0;
     if (block.type == BLOCK_DEFLATE) {
-        size_t patchSize = 0;
-        BlockBuffer oldInfo = { block.srcOriginalData.data(), block.srcOriginalLength };
-        BlockBuffer newInfo = { block.destOriginalData.data(), block.destOriginalLength };
-        ret = MakeBlockPatch(block, blockPatchFile, newInfo, oldInfo, patchSize);
-        PATCH_CHECK(ret == 0, return -1, "Failed to make block patch");
-
+        size_t patchSize = block.patchSize;
         PATCH_LOGI("WriteHeader BLOCK_DEFLATE patchoffset %zu dataOffset:%zu patchData:%zu",
             static_cast<size_t>(patchFile.tellp()), dataOffset, patchSize);
         PATCH_LOGI("WriteHeader oldInfo start:%zu length:%zu", block.oldInfo.start, block.oldInfo.length);
@@ -358,7 +370,7 @@ int32_t ZipImageDiff::WriteHeader(std::ofstream &patchFile,
         WriteToFile<int32_t>(patchFile, strategy_, sizeof(int32_t));
         dataOffset += patchSize;
     } else {
-        ret = ImageDiff::WriteHeader(patchFile, blockPatchFile, dataOffset, block);
+        ret = ImageDiff::WriteHeader(patchFile, dataOffset, block);
     }
     return ret;
 }
@@ -392,15 +404,14 @@ int32_t ZipImageDiff::TestAndSetConfig(const BlockBuffer &buffer, const std::str
     BlockBuffer orgData = {orgNewBuffer.buffer + fileInfo->dataOffset, fileInfo->packedSize};
     PATCH_DEBUG("DiffFile new orignial hash %zu %s", fileInfo->packedSize, GeneraterBufferHash(orgData).c_str());
 
-    std::vector<uint8_t> data;
     for (int32_t i = ZIP_MAX_LEVEL; i >= 0; i--) {
         zipInfo.level = i;
         size_t bufferSize = 0;
-        ret = CompressData(&zipInfo.fileInfo, buffer, data, bufferSize);
+        ret = CompressData(&zipInfo.fileInfo, buffer, compressBuffer_, bufferSize);
         PATCH_CHECK(ret == 0, return -1, "Can not Compress buff ");
 
         if ((bufferSize == fileInfo->packedSize) &&
-            memcmp(data.data(), orgNewBuffer.buffer + fileInfo->dataOffset, bufferSize) == 0) {
+            memcmp(compressBuffer_.data(), orgNewBuffer.buffer + fileInfo->dataOffset, bufferSize) == 0) {
             level_ = i;
             return 0;
         }
@@ -408,23 +419,18 @@ int32_t ZipImageDiff::TestAndSetConfig(const BlockBuffer &buffer, const std::str
     return -1;
 }
 
-int32_t Lz4ImageDiff::WriteHeader(std::ofstream &patchFile,
-    std::fstream &blockPatchFile, size_t &dataOffset, ImageBlock &block) const
+int32_t Lz4ImageDiff::WriteHeader(std::ofstream &patchFile, size_t &dataOffset, ImageBlock &block) const
 {
     int32_t ret = 0;
     if (block.type == BLOCK_LZ4) {
-        size_t patchSize = 0;
-        BlockBuffer oldInfo = { block.srcOriginalData.data(), block.srcOriginalLength };
-        BlockBuffer newInfo = { block.destOriginalData.data(), block.destOriginalLength };
-        ret = MakeBlockPatch(block, blockPatchFile, newInfo, oldInfo, patchSize);
-        PATCH_CHECK(ret == 0, return -1, "Failed to make block patch");
-
+        size_t patchSize = block.patchSize;
         PATCH_LOGI("WriteHeader BLOCK_LZ4 patchoffset %zu dataOffset:%zu %zu",
             static_cast<size_t>(patchFile.tellp()), dataOffset, patchSize);
         PATCH_LOGI("WriteHeader oldInfo start:%zu length:%zu", block.oldInfo.start, block.oldInfo.length);
         PATCH_LOGI("WriteHeader uncompressedLength:%zu %zu", block.srcOriginalLength, block.destOriginalLength);
         PATCH_LOGI("WriteHeader level_:%d method_:%d blockIndependence_:%d contentChecksumFlag_:%d blockSizeID_:%d %d",
             compressionLevel_, method_, blockIndependence_, contentChecksumFlag_, blockSizeID_, autoFlush_);
+        BlockBuffer newInfo = { block.destOriginalData.data(), block.destOriginalLength };
         PATCH_LOGI("WriteHeader BLOCK_LZ4 decompressed hash %zu %s",
             newInfo.length, GeneraterBufferHash(newInfo).c_str());
         WriteToFile<int64_t>(patchFile, static_cast<int64_t>(block.oldInfo.start), sizeof(int64_t));
@@ -442,7 +448,7 @@ int32_t Lz4ImageDiff::WriteHeader(std::ofstream &patchFile,
         WriteToFile<int32_t>(patchFile, autoFlush_, sizeof(int32_t));
         dataOffset += patchSize;
     } else {
-        ret = ImageDiff::WriteHeader(patchFile, blockPatchFile, dataOffset, block);
+        ret = ImageDiff::WriteHeader(patchFile, dataOffset, block);
     }
     return ret;
 }
@@ -478,15 +484,14 @@ int32_t Lz4ImageDiff::TestAndSetConfig(const BlockBuffer &buffer, const std::str
     PATCH_DEBUG("DiffFile new orignial hash %zu %s",
         fileInfo->packedSize + sizeof(uint32_t), GeneraterBufferHash(orgData).c_str());
 
-    std::vector<uint8_t> data;
     for (int32_t i = 0; i <= LZ4F_MAX_BLOCKID; i++) {
         lz4Info.blockSizeID = i;
         size_t bufferSize = 0;
-        ret = CompressData(&lz4Info.fileInfo, buffer, data, bufferSize);
+        ret = CompressData(&lz4Info.fileInfo, buffer, compressBuffer_, bufferSize);
         PATCH_CHECK(ret == 0, return -1, "Can not Compress buff ");
 
         if ((bufferSize == fileInfo->packedSize + sizeof(uint32_t)) &&
-            memcmp(data.data(), orgNewBuffer.buffer + fileInfo->headerOffset, bufferSize) == 0) {
+            memcmp(compressBuffer_.data(), orgNewBuffer.buffer + fileInfo->headerOffset, bufferSize) == 0) {
             blockSizeID_ = i;
             return 0;
         }
@@ -507,10 +512,7 @@ int32_t CompressedImageDiff::CompressData(hpackage::PkgManager::FileInfoPtr info
                 return 0;
             }
             bufferSize += size;
-            if ((start + bufferSize) > outData.size()) {
-                outData.resize(IGMDIFF_LIMIT_UNIT * ((start + bufferSize) / IGMDIFF_LIMIT_UNIT + 1));
-            }
-            return memcpy_s(outData.data() + start, outData.size(), data.buffer, size);
+            return WriteDataToBuffer(outData, start, data.buffer, size);
         }, nullptr);
     int32_t ret = pkgManager->CompressBuffer(info, {buffer.buffer, buffer.length}, stream1);
     PATCH_CHECK(ret == 0, return -1, "Can not Compress buff ");
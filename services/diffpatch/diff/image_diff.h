@@ -29,6 +29,8 @@ struct ImageBlock {
     size_t srcOriginalLength;
     size_t destOriginalLength;
     std::vector<uint8_t> patchData;
+    // patchData 写入文件后释放, 头部中使用这里记录的大小
+    size_t patchSize;
     std::vector<uint8_t> srcOriginalData;
     std::vector<uint8_t> destOriginalData;
 };
@@ -44,20 +46,23 @@ public:
     }
 
     virtual int32_t MakePatch(const std::string &patchName);
-    virtual int32_t WriteHeader(std::ofstream &patchFile,
-        std::fstream &blockPatchFile, size_t &offset, ImageBlock &block) const;
+    void SetCompressMethod(int32_t compressMethod)
+    {
+        compressMethod_ = compressMethod;
+    }
+    virtual int32_t WriteHeader(std::ofstream &patchFile, size_t &offset, ImageBlock &block) const;
 protected:
     int32_t SplitImage(const PatchBuffer &oldInfo, const PatchBuffer &newInfo);
     int32_t DiffImage(const std::string &patchName);
-    int32_t MakeBlockPatch(ImageBlock &block, std::fstream &blockPatchFile,
-        const BlockBuffer &newInfo, const BlockBuffer &oldInfo, size_t &patchSize) const;
-    int32_t WritePatch(std::ofstream &patchFile, std::fstream &blockPatchFile);
+    int32_t MakeBlockPatches(std::ofstream &patchFile);
+    int32_t MakeBlockPatch(ImageBlock &block) const;
+    int32_t WritePatch(std::ofstream &patchFile, ImageBlock &block) const;
 
     size_t limit_;
     std::vector<ImageBlock> updateBlocks_ {};
     UpdateDiff::ImageParserPtr newParser_ {nullptr};
     UpdateDiff::ImageParserPtr oldParser_ {nullptr};
-    bool usePatchFile_ { false };
+    int32_t compressMethod_ { BSDIFF_COMPRESS_BZIP2 };
 };
 
 class CompressedImageDiff : public ImageDiff {
@@ -73,7 +78,10 @@ protected:
     int32_t DiffFile(const std::string &fileName, size_t &oldOffset, size_t &newOffset);
     int32_t CompressData(hpackage::PkgManager::FileInfoPtr info,
         const BlockBuffer &buffer, std::vector<uint8_t> &outData, size_t &outSize) const;
+
     int32_t type_;
+    // 探测压缩参数时重压缩的临时数据
+    std::vector<uint8_t> compressBuffer_ {};
 };
 
 class ZipImageDiff : public CompressedImageDiff {
@@ -82,8 +90,7 @@ public:
         : CompressedImageDiff(limit, newParser, oldParser, BLOCK_DEFLATE) {}
     ~ZipImageDiff() override {}
 
-    int32_t WriteHeader(std::ofstream &patchFile,
-        std::fstream &blockPatchFile, size_t &offset, ImageBlock &block) const override;
+    int32_t WriteHeader(std::ofstream &patchFile, size_t &offset, ImageBlock &block) const override;
 protected:
     int32_t TestAndSetConfig(const BlockBuffer &buffer, const std::string &fileName) override;
 
@@ -100,8 +107,7 @@ public:
         : CompressedImageDiff(limit, newParser, oldParser, BLOCK_LZ4) {}
     ~Lz4ImageDiff() override {}
 
-    int32_t WriteHeader(std::ofstream &patchFile,
-        std::fstream &blockPatchFile, size_t &offset, ImageBlock &block) const override;
+    int32_t WriteHeader(std::ofstream &patchFile, size_t &offset, ImageBlock &block) const override;
 protected:
     int32_t TestAndSetConfig(const BlockBuffer &buffer, const std::string &fileName) override;
 private:
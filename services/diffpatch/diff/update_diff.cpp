@@ -83,6 +83,10 @@ int32_t ImageParser::Extract(const std::string &fileName, std::vector<uint8_t> &
 {
     PATCH_DEBUG("ImageParser::Extract %s", fileName.c_str());
     PATCH_CHECK(pkgManager_ != nullptr, return PATCH_INVALID_PARAM, "Failed to get pkg manager");
+    const FileInfo *fileInfo = pkgManager_->GetFileInfo(fileName);
+    PATCH_CHECK(fileInfo != nullptr, return -1, "Failed to get file info");
+    // 按解压后大小一次分配, lz4 解压前只有估计值, 不足时由 WriteDataToBuffer 成倍扩容
+    buffer.resize(fileInfo->unpackedSize);
     size_t bufferSize = 0;
     hpackage::PkgManager::StreamPtr outStream = nullptr;
     int32_t ret = pkgManager_->CreatePkgStream(outStream, fileName,
@@ -92,18 +96,12 @@ int32_t ImageParser::Extract(const std::string &fileName, std::vector<uint8_t> &
                 return 0;
             }
             bufferSize += size;
-            if ((start + bufferSize) > buffer.size()) {
-                buffer.resize(IGMDIFF_LIMIT_UNIT * ((start + bufferSize) / IGMDIFF_LIMIT_UNIT + 1));
-            }
-            return memcpy_s(buffer.data() + start, buffer.size(), data.buffer, size);
+            return WriteDataToBuffer(buffer, start, data.buffer, size);
         }, nullptr);
     PATCH_CHECK(ret == 0, return -1, "Failed to extract data");
 
     ret = pkgManager_->ExtractFile(fileName, outStream);
     pkgManager_->ClosePkgStream(outStream);
-
-    const FileInfo *fileInfo = pkgManager_->GetFileInfo(fileName);
-    PATCH_CHECK(fileInfo != nullptr, return -1, "Failed to get file info");
     PATCH_CHECK(fileInfo->unpackedSize == bufferSize, return -1,
         "Failed to check uncompress data size %zu %zu", fileInfo->unpackedSize, bufferSize);
     return ret;
@@ -113,7 +111,7 @@ int32_t UpdateDiff::MakePatch(const std::string &oldFileName,
     const std::string &newFileName, const std::string &patchFileName)
 {
     if (blockDiff_) {
-        return BlocksDiff::MakePatch(oldFileName, newFileName, patchFileName);
+        return BlocksDiff::MakePatch(oldFileName, newFileName, patchFileName, compressMethod_);
     }
 
     newParser_.reset(new ImageParser());
@@ -129,6 +127,7 @@ int32_t UpdateDiff::MakePatch(const std::string &oldFileName,
     if (newParser_->GetType() != oldParser_->GetType()) {
         imageDiff.reset(new ImageDiff(limit_, newParser_.get(), oldParser_.get()));
         PATCH_CHECK(imageDiff != nullptr, return -1, "Failed to diff file");
+        imageDiff->SetCompressMethod(compressMethod_);
         return imageDiff->MakePatch(patchFileName);
     }
 
@@ -147,22 +146,30 @@ int32_t UpdateDiff::MakePatch(const std::string &oldFileName,
             break;
     }
     PATCH_CHECK(imageDiff != nullptr, return -1, "Failed to diff file");
+    imageDiff->SetCompressMethod(compressMethod_);
     return imageDiff->MakePatch(patchFileName);
 }
 
 int32_t UpdateDiff::DiffImage(size_t limit, const std::string &oldFileName,
-    const std::string &newFileName, const std::string &patchFileName)
+    const std::string &newFileName, const std::string &patchFileName, int32_t compressMethod)
 {
-    std::unique_ptr<UpdateDiff> updateDiff(new UpdateDiff(limit, false));
+    std::unique_ptr<UpdateDiff> updateDiff(new UpdateDiff(limit, false, compressMethod));
     PATCH_CHECK(updateDiff != nullptr, return -1, "Failed to create update diff");
     return updateDiff->MakePatch(oldFileName, newFileName, patchFileName);
 }
 
 int32_t UpdateDiff::DiffBlock(const std::string &oldFileName,
-    const std::string &newFileName, const std::string &patchFileName)
+    const std::string &newFileName, const std::string &patchFileName, int32_t compressMethod)
 {
-    std::unique_ptr<UpdateDiff> updateDiff(new UpdateDiff(0, true));
+    std::unique_ptr<UpdateDiff> updateDiff(new UpdateDiff(0, true, compressMethod));
     PATCH_CHECK(updateDiff != nullptr, return -1, "Failed to create update diff");
     return updateDiff->MakePatch(oldFileName, newFileName, patchFileName);
 }
+
+int32_t UpdateDiff::DiffBlocks(const std::string &oldFileName,
+    const std::vector<std::pair<std::string, std::string>> &targets,
+    int32_t compressMethod, const std::string &suffixArrayFile)
+{
+    return BlocksDiff::MakePatch(oldFileName, targets, compressMethod, suffixArrayFile);
+}
 } // namespace updatepatch
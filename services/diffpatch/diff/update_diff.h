@@ -53,20 +53,27 @@ private:
 class UpdateDiff {
 public:
     using ImageParserPtr = ImageParser *;
-    UpdateDiff(size_t limit, bool blockDiff) : limit_(limit * IGMDIFF_LIMIT_UNIT), blockDiff_(blockDiff) {}
+    UpdateDiff(size_t limit, bool blockDiff, int32_t compressMethod = BSDIFF_COMPRESS_BZIP2)
+        : limit_(limit * IGMDIFF_LIMIT_UNIT), blockDiff_(blockDiff), compressMethod_(compressMethod) {}
     ~UpdateDiff() {}
 
     int32_t MakePatch(const std::string &oldFileName, const std::string &newFileName, const std::string &patchFileName);
 
-    static int32_t DiffImage(size_t limit, const std::string &oldFileName,
-        const std::string &newFileName, const std::string &patchFileName);
+    static int32_t DiffImage(size_t limit, const std::string &oldFileName, const std::string &newFileName,
+        const std::string &patchFileName, int32_t compressMethod = BSDIFF_COMPRESS_BZIP2);
 
-    static int32_t DiffBlock(const std::string &oldFileName,
-        const std::string &newFileName, const std::string &patchFileName);
+    static int32_t DiffBlock(const std::string &oldFileName, const std::string &newFileName,
+        const std::string &patchFileName, int32_t compressMethod = BSDIFF_COMPRESS_BZIP2);
+
+    // 同一旧镜像生成多个块补丁, targets 为 (新镜像, 补丁文件); suffixArrayFile 用于保存/复用后缀数组
+    static int32_t DiffBlocks(const std::string &oldFileName,
+        const std::vector<std::pair<std::string, std::string>> &targets,
+        int32_t compressMethod = BSDIFF_COMPRESS_BZIP2, const std::string &suffixArrayFile = "");
 
 private:
     size_t limit_ { 0 };
     bool blockDiff_ { true };
+    int32_t compressMethod_ { BSDIFF_COMPRESS_BZIP2 };
     std::unique_ptr<ImageParser> newParser_ { nullptr };
     std::unique_ptr<ImageParser> oldParser_ { nullptr };
 };
@@ -14,13 +14,26 @@
  */
 
 #include "diffpatch.h"
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <fcntl.h>
+#include <mutex>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 #include "openssl/sha.h"
+#include "securec.h"
+#include "thread_pool.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 namespace updatepatch {
 int32_t WriteDataToFile(const std::string &fileName, const std::vector<uint8_t> &data, size_t dataSize)
@@ -32,6 +45,17 @@ int32_t WriteDataToFile(const std::string &fileName, const std::vector<uint8_t>
     return PATCH_SUCCESS;
 }
 
+int32_t WriteDataToBuffer(std::vector<uint8_t> &buffer, size_t start, const uint8_t *data, size_t size)
+{
+    if (size == 0) {
+        return 0;
+    }
+    if (start + size > buffer.size()) {
+        buffer.resize(std::max(start + size, buffer.size() * 2)); // 2: 成倍扩容
+    }
+    return memcpy_s(buffer.data() + start, buffer.size() - start, data, size);
+}
+
 int32_t PatchMapFile(const std::string &fileName, MemMapInfo &info)
 {
     int32_t file = open(fileName.c_str(), O_RDONLY);
@@ -72,4 +96,85 @@ std::string ConvertSha256Hex(const BlockBuffer &buffer)
     }
     return haxSha256;
 }
+
+void AddDiffData(uint8_t *dst, const uint8_t *src, size_t length)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    constexpr size_t avxStep = 32;
+    for (; i + avxStep <= length; i += avxStep) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_add_epi8(a, b));
+    }
+#endif
+#if defined(__SSE2__)
+    constexpr size_t sseStep = 16;
+    for (; i + sseStep <= length; i += sseStep) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_add_epi8(a, b));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    constexpr size_t neonStep = 16;
+    for (; i + neonStep <= length; i += neonStep) {
+        vst1q_u8(dst + i, vaddq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+    }
+#endif
+    for (; i < length; i++) {
+        dst[i] += src[i];
+    }
+}
+
+uscript::ThreadPool *GetThreadPool()
+{
+    // 线程池是进程内的单例, 大小由第一个创建者决定, 这里按 CPU 核数申请的大小可能不生效
+    int32_t threadNumber = static_cast<int32_t>(std::thread::hardware_concurrency());
+    if (threadNumber <= 1) {
+        return nullptr;
+    }
+    uscript::ThreadPool *threadPool = uscript::ThreadPool::CreateThreadPool(threadNumber);
+    static std::once_flag logFlag;
+    if (threadPool != nullptr && threadPool->GetThreadNumber() < threadNumber) {
+        std::call_once(logFlag, [threadPool, threadNumber]() {
+            PATCH_LOGI("Reuse thread pool with %d threads, %d requested", threadPool->GetThreadNumber(), threadNumber);
+        });
+    }
+    return threadPool;
+}
+
+void RunParallelTasks(size_t taskCount, const std::function<void(size_t)> &task)
+{
+    // 嵌套调用时仍在同一个线程池中执行, 不会额外创建线程
+    uscript::ThreadPool *threadPool = GetThreadPool();
+    if (threadPool == nullptr) {
+        for (size_t i = 0; i < taskCount; i++) {
+            task(i);
+        }
+        return;
+    }
+    threadPool->ParallelFor(static_cast<int32_t>(taskCount), [&task](int32_t index) {
+        task(static_cast<size_t>(index));
+    });
+}
+
+std::string GetBsdiffMagic(int32_t compressMethod)
+{
+    std::string magic = BSDIFF_MAGIC;
+    magic.back() = static_cast<char>('0' + compressMethod);
+    return magic;
+}
+
+int32_t GetBsdiffCompressMethod(const uint8_t *header, size_t length)
+{
+    if (header == nullptr || length < BSDIFF_MAGIC.size() ||
+        memcmp(header, BSDIFF_MAGIC.c_str(), BSDIFF_MAGIC.size() - 1) != 0) {
+        return -1;
+    }
+    int32_t compressMethod = header[BSDIFF_MAGIC.size() - 1] - '0';
+    if (compressMethod < BSDIFF_COMPRESS_BZIP2 || compressMethod >= BSDIFF_COMPRESS_BUTT) {
+        return -1;
+    }
+    return compressMethod;
+}
 } // namespace updatepatch
\ No newline at end of file
@@ -17,6 +17,7 @@
 #define DIFF_PATCH_H
 #include <cstdlib>
 #include <fcntl.h>
+#include <functional>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -24,6 +25,10 @@
 #include "log/log.h"
 #include "patch/update_patch.h"
 
+namespace uscript {
+class ThreadPool;
+}
+
 namespace updatepatch {
 #define PATCH_LOGE(format, ...) Logger(updater::ERROR, (__FILE_NAME__), (__LINE__), format, ##__VA_ARGS__)
 #define PATCH_DEBUG(format, ...) Logger(updater::DEBUG, (__FILE_NAME__), (__LINE__), format, ##__VA_ARGS__)
@@ -95,7 +100,7 @@ enum {
  */
 
 /* Header is
-    0	8	 "BSDIFF40"
+    0	8	 "BSDIFF40"  [last byte: compress method of the three blocks, '0' bzip2 '1' zstd '2' lz4]
     8	8	length of bzip2ed ctrl block
     16	8	length of bzip2ed diff block
     24	8	length of new file
@@ -137,6 +142,14 @@ static constexpr int PATCH_DEFLATE_MIN_HEADER_LEN = 60;
 static constexpr int PATCH_LZ4_MIN_HEADER_LEN = 64;
 
 static const std::string BSDIFF_MAGIC = "BSDIFF40";
+
+// compress method of the bsdiff ctrl/diff/extra blocks, bzip2 is the default
+enum {
+    BSDIFF_COMPRESS_BZIP2 = 0,
+    BSDIFF_COMPRESS_ZSTD,
+    BSDIFF_COMPRESS_LZ4,
+    BSDIFF_COMPRESS_BUTT
+};
 static const std::string PKGDIFF_MAGIC = "PKGDIFF0";
 
 struct PatchHeader {
@@ -169,8 +182,19 @@ struct MemMapInfo {
 };
 
 int32_t WriteDataToFile(const std::string &fileName, const std::vector<uint8_t> &data, size_t dataSize);
+// copy data to buffer[start], the buffer grows geometrically so that appending is linear
+int32_t WriteDataToBuffer(std::vector<uint8_t> &buffer, size_t start, const uint8_t *data, size_t size);
 int32_t PatchMapFile(const std::string &fileName, MemMapInfo &info);
 std::string GeneraterBufferHash(const BlockBuffer &buffer);
 std::string ConvertSha256Hex(const BlockBuffer &buffer);
+// dst[i] += src[i], vectorized with NEON/SSE2/AVX2 when available
+void AddDiffData(uint8_t *dst, const uint8_t *src, size_t length);
+std::string GetBsdiffMagic(int32_t compressMethod);
+// the thread pool shared with the script manager, nullptr on single core hosts
+uscript::ThreadPool *GetThreadPool();
+// run task(0) ... task(taskCount - 1) on the shared thread pool, the caller thread included
+void RunParallelTasks(size_t taskCount, const std::function<void(size_t)> &task);
+// return the compress method, -1 if it is not a bsdiff patch
+int32_t GetBsdiffCompressMethod(const uint8_t *header, size_t length);
 } // namespace updatepatch
 #endif // DIFF_PATCH_H
\ No newline at end of file
@@ -14,10 +14,13 @@
  */
 
 #include "blocks_patch.h"
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 #include <vector>
 #include "diffpatch.h"
+#include "lz4_adapter.h"
+#include "zstd_adapter.h"
 
 using namespace hpackage;
 using namespace std;
@@ -26,6 +29,7 @@ namespace updatepatch {
 #define PATCH_MIN BSDIFF_MAGIC.size() + sizeof(int64_t) * 3
 #define GET_BYTE_FROM_BUFFER(v, index, buffer)  (y) = (y) * 256; (y) += buffer[index]
 constexpr uint8_t BUFFER_MASK = 0x80;
+constexpr int64_t PATCH_WINDOW_SIZE = 1024 * 1024;
 
 static int64_t ReadLE64(const uint8_t *buffer)
 {
@@ -57,6 +61,20 @@ static int64_t ReadLE64(const uint8_t *buffer)
     return y;
 }
 
+static std::unique_ptr<BZip2ReadAdapter> CreateReadAdapter(int32_t compressMethod,
+    size_t offset, size_t length, const BlockBuffer &buffer)
+{
+    switch (compressMethod) {
+        case BSDIFF_COMPRESS_ZSTD:
+            return std::make_unique<ZstdBufferReadAdapter>(offset, length, buffer);
+        case BSDIFF_COMPRESS_LZ4:
+            return std::make_unique<Lz4BufferReadAdapter>(offset, length, buffer);
+        default:
+            break;
+    }
+    return std::make_unique<BZip2BufferReadAdapter>(offset, length, buffer);
+}
+
 int32_t BlocksPatch::ApplyPatch()
 {
     PATCH_LOGI("BlocksPatch::ApplyPatch");
@@ -85,6 +103,8 @@ int32_t BlocksPatch::ApplyPatch()
         newOffset_ += ctrlData.extraLength;
         oldOffset_ += ctrlData.offsetIncrement;
     }
+    ret = FlushNewData();
+    PATCH_CHECK(ret == 0, return ret, "Failed to flush new data");
     controlDataReader_->Close();
     diffDataReader_->Close();
     extraDataReader_->Close();
@@ -100,9 +120,9 @@ int32_t BlocksPatch::ReadHeader(int64_t &controlDataSize, int64_t &diffDataSize,
     PATCH_LOGI("Restore patch hash %zu %s",
         patchInfo_.length - patchInfo_.start, GeneraterBufferHash(patchData).c_str());
     uint8_t *header = patchInfo_.buffer + patchInfo_.start;
-    // Compare header
-    PATCH_CHECK(memcmp(header, BSDIFF_MAGIC.c_str(), BSDIFF_MAGIC.size()) == 0,
-        return -1, "Corrupt patch, patch head != BSDIFF40");
+    // Compare header, the last byte of magic is the compress method
+    int32_t compressMethod = GetBsdiffCompressMethod(header, patchInfo_.length - patchInfo_.start);
+    PATCH_CHECK(compressMethod >= 0, return -1, "Corrupt patch, patch head != BSDIFF40");
 
     /* Read lengths from header */
     size_t offset = BSDIFF_MAGIC.size();
@@ -119,20 +139,30 @@ int32_t BlocksPatch::ReadHeader(int64_t &controlDataSize, int64_t &diffDataSize,
         return -1, "Invalid patch data size");
 
     BlockBuffer patchBuffer = {header, patchInfo_.length - patchInfo_.start};
-    controlDataReader_.reset(new BZip2BufferReadAdapter(offset, static_cast<size_t>(controlDataSize), patchBuffer));
+    controlDataReader_ = CreateReadAdapter(compressMethod, offset,
+        static_cast<size_t>(controlDataSize), patchBuffer);
     offset += controlDataSize;
-    diffDataReader_.reset(new BZip2BufferReadAdapter(offset, static_cast<size_t>(diffDataSize), patchBuffer));
+    diffDataReader_ = CreateReadAdapter(compressMethod, offset, static_cast<size_t>(diffDataSize), patchBuffer);
     offset += diffDataSize;
-    extraDataReader_.reset(new BZip2BufferReadAdapter(offset,
-        patchInfo_.length - patchInfo_.start - offset, patchBuffer));
+    extraDataReader_ = CreateReadAdapter(compressMethod, offset,
+        patchInfo_.length - patchInfo_.start - offset, patchBuffer);
     PATCH_CHECK(controlDataReader_ != nullptr && diffDataReader_ != nullptr && extraDataReader_ != nullptr,
         return -1, "Failed to create reader");
-    controlDataReader_->Open();
-    diffDataReader_->Open();
-    extraDataReader_->Open();
+    int32_t ret = controlDataReader_->Open();
+    ret |= diffDataReader_->Open();
+    ret |= extraDataReader_->Open();
+    PATCH_CHECK(ret == 0, return -1, "Failed to open reader");
     return 0;
 }
 
+void BlocksPatch::GetOldDataRange(int64_t oldOffset, int64_t length, size_t oldLength,
+    int64_t &start, int64_t &end) const
+{
+    // [start, end) of the diff data that has old data at oldOffset + i
+    start = std::max(static_cast<int64_t>(0), -oldOffset);
+    end = std::min(length, static_cast<int64_t>(oldLength) - oldOffset);
+}
+
 int32_t BlocksPatch::ReadControlData(ControlData &ctrlData)
 {
     std::vector<uint8_t> data(sizeof(int64_t), 0);
@@ -167,10 +197,11 @@ int32_t BlocksBufferPatch::RestoreDiffData(const ControlData &ctrlData)
     int32_t ret = diffDataReader_->ReadData(diffData);
     PATCH_CHECK(ret == 0, return ret, "Failed to read diff data");
 
-    for (int64_t i = 0; i < ctrlData.diffLength; i++) {
-        if (((oldOffset_ + i) >= 0) && (static_cast<size_t>(oldOffset_ + i) < oldInfo_.length)) {
-            newData_[newOffset_ + i] += oldInfo_.buffer[oldOffset_ + i];
-        }
+    int64_t start = 0;
+    int64_t end = 0;
+    GetOldDataRange(oldOffset_, ctrlData.diffLength, oldInfo_.length, start, end);
+    if (start < end) {
+        AddDiffData(diffData.buffer + start, oldInfo_.buffer + oldOffset_ + start, static_cast<size_t>(end - start));
     }
     return 0;
 }
@@ -186,50 +217,97 @@ int32_t BlocksBufferPatch::RestoreExtraData(const ControlData &ctrlData)
     return 0;
 }
 
-int32_t BlocksStreamPatch::RestoreDiffData(const ControlData &ctrlData)
+int32_t BlocksStreamPatch::ReadHeader(int64_t &controlDataSize, int64_t &diffDataSize, int64_t &newSize)
 {
-    if (ctrlData.diffLength <= 0) {
-        return 0;
-    }
-    std::vector<uint8_t> diffData(ctrlData.diffLength);
-    BlockBuffer diffBuffer = {diffData.data(), diffData.size()};
-    int32_t ret = diffDataReader_->ReadData(diffBuffer);
-    PATCH_CHECK(ret == 0, return ret, "Failed to read diff data");
+    int32_t ret = BlocksPatch::ReadHeader(controlDataSize, diffDataSize, newSize);
+    PATCH_CHECK(ret == 0, return -1, "Failed to read header");
+    PATCH_CHECK(stream_ != nullptr && writer_ != nullptr, return -1, "Invalid stream or writer");
 
-    size_t oldOffset = oldOffset_;
-    size_t oldLength = stream_->GetFileLength();
-    PkgBuffer buffer {};
+    // 窗口大小固定, 内存占用与镜像大小无关
+    window_.resize(static_cast<size_t>(std::min(newSize, PATCH_WINDOW_SIZE)));
+    windowLength_ = 0;
+    windowOffset_ = 0;
+    oldLength_ = stream_->GetFileLength();
     if (stream_->GetStreamType() == PkgStream::PkgStreamType_MemoryMap ||
         stream_->GetStreamType() == PkgStream::PkgStreamType_Buffer) {
-        ret = stream_->GetBuffer(buffer);
+        ret = stream_->GetBuffer(oldBuffer_);
         PATCH_CHECK(ret == 0, return ret, "Failed to get old buffer");
     } else {
-        std::vector<uint8_t> oldData(ctrlData.diffLength);
-        size_t readLen = 0;
-        ret = stream_->Read(buffer, oldOffset_, ctrlData.diffLength, readLen);
-        PATCH_CHECK(ret == 0 && readLen == static_cast<size_t>(ctrlData.diffLength),
-            return ret, "Failed to get old buffer");
-        oldOffset = 0;
+        oldWindow_.resize(window_.size());
+    }
+    return 0;
+}
+
+int32_t BlocksStreamPatch::AddOldData(const BlockBuffer &data, int64_t oldOffset)
+{
+    int64_t start = 0;
+    int64_t end = 0;
+    GetOldDataRange(oldOffset, static_cast<int64_t>(data.length), oldLength_, start, end);
+    if (start >= end) {
+        return 0;
     }
-    for (int64_t i = 0; i < ctrlData.diffLength; i++) {
-        if ((oldOffset_ + i >= 0) && (static_cast<size_t>(oldOffset_ + i) < oldLength)) {
-            diffData[i] += buffer.buffer[oldOffset + i];
+    size_t length = static_cast<size_t>(end - start);
+    if (oldBuffer_.buffer != nullptr) {
+        AddDiffData(data.buffer + start, oldBuffer_.buffer + oldOffset + start, length);
+        return 0;
+    }
+    // data 不超过窗口大小, 一次读完
+    PkgBuffer buffer = {oldWindow_.data(), oldWindow_.size()};
+    size_t readLen = 0;
+    int32_t ret = stream_->Read(buffer, static_cast<size_t>(oldOffset + start), length, readLen);
+    PATCH_CHECK(ret == 0 && readLen == length, return -1, "Failed to read old data %zu", readLen);
+    AddDiffData(data.buffer + start, oldWindow_.data(), length);
+    return 0;
+}
+
+int32_t BlocksStreamPatch::FlushNewData()
+{
+    if (windowLength_ == 0) {
+        return 0;
+    }
+    BlockBuffer data = {window_.data(), windowLength_};
+    int32_t ret = writer_->Write(static_cast<size_t>(windowOffset_), data, windowLength_);
+    PATCH_CHECK(ret == 0, return ret, "Failed to write new data");
+    windowOffset_ += static_cast<int64_t>(windowLength_);
+    windowLength_ = 0;
+    return 0;
+}
+
+int32_t BlocksStreamPatch::RestoreDiffData(const ControlData &ctrlData)
+{
+    int64_t offset = 0;
+    while (offset < ctrlData.diffLength) {
+        if (windowLength_ == window_.size()) {
+            int32_t ret = FlushNewData();
+            PATCH_CHECK(ret == 0, return ret, "Failed to flush new data");
         }
+        size_t length = std::min(window_.size() - windowLength_, static_cast<size_t>(ctrlData.diffLength - offset));
+        BlockBuffer diffBuffer = {window_.data() + windowLength_, length};
+        int32_t ret = diffDataReader_->ReadData(diffBuffer);
+        PATCH_CHECK(ret == 0, return ret, "Failed to read diff data");
+        ret = AddOldData(diffBuffer, oldOffset_ + offset);
+        PATCH_CHECK(ret == 0, return ret, "Failed to add old data");
+        windowLength_ += length;
+        offset += static_cast<int64_t>(length);
     }
-    // write
-    return writer_->Write(newOffset_, diffBuffer, static_cast<size_t>(ctrlData.diffLength));
+    return 0;
 }
 
 int32_t BlocksStreamPatch::RestoreExtraData(const ControlData &ctrlData)
 {
-    if (ctrlData.extraLength <= 0) {
-        return 0;
+    int64_t offset = 0;
+    while (offset < ctrlData.extraLength) {
+        if (windowLength_ == window_.size()) {
+            int32_t ret = FlushNewData();
+            PATCH_CHECK(ret == 0, return ret, "Failed to flush new data");
+        }
+        size_t length = std::min(window_.size() - windowLength_, static_cast<size_t>(ctrlData.extraLength - offset));
+        BlockBuffer extraBuffer = {window_.data() + windowLength_, length};
+        int32_t ret = extraDataReader_->ReadData(extraBuffer);
+        PATCH_CHECK(ret == 0, return ret, "Failed to read extra data");
+        windowLength_ += length;
+        offset += static_cast<int64_t>(length);
     }
-    std::vector<uint8_t> extraData(ctrlData.extraLength);
-    BlockBuffer extraBuffer = {extraData.data(), static_cast<size_t>(ctrlData.extraLength)};
-    int32_t ret = extraDataReader_->ReadData(extraBuffer);
-    PATCH_CHECK(ret == 0, return ret, "Failed to read extra data");
-    // write
-    return writer_->Write(newOffset_, extraBuffer, static_cast<size_t>(ctrlData.extraLength));
+    return 0;
 }
 } // namespace updatepatch
@@ -33,10 +33,15 @@ public:
     int32_t ApplyPatch();
 protected:
     int32_t ReadControlData(ControlData &ctrlData);
+    void GetOldDataRange(int64_t oldOffset, int64_t length, size_t oldLength, int64_t &start, int64_t &end) const;
 
     virtual int32_t ReadHeader(int64_t &controlDataSize, int64_t &diffDataSize, int64_t &newSize);
     virtual int32_t RestoreDiffData(const ControlData &ctrlData) = 0;
     virtual int32_t RestoreExtraData(const ControlData &ctrlData) = 0;
+    virtual int32_t FlushNewData()
+    {
+        return 0;
+    }
 
     PatchBuffer patchInfo_ { nullptr };
     int64_t newSize_ = { 0 };
@@ -70,11 +75,22 @@ public:
         : BlocksPatch(patchInfo), stream_(stream), writer_(writer) {}
     ~BlocksStreamPatch() override {}
 private:
+    int32_t ReadHeader(int64_t &controlDataSize, int64_t &diffDataSize, int64_t &newSize) override;
     int32_t RestoreDiffData(const ControlData &ctrlData) override;
     int32_t RestoreExtraData(const ControlData &ctrlData) override;
+    int32_t FlushNewData() override;
+    int32_t AddOldData(const BlockBuffer &data, int64_t oldOffset);
 
     hpackage::PkgManager::StreamPtr stream_ { nullptr };
     UpdatePatchWriterPtr writer_ { nullptr };
+    // 新数据输出窗口, 所有控制项复用, 写满后交给 writer_
+    std::vector<uint8_t> window_ {};
+    size_t windowLength_ { 0 };
+    int64_t windowOffset_ { 0 };
+    // 旧数据不能直接映射时, 分块读入 oldWindow_
+    BlockBuffer oldBuffer_ { nullptr, 0 };
+    size_t oldLength_ { 0 };
+    std::vector<uint8_t> oldWindow_ {};
 };
 } // namespace updatepatch
 #endif // BLOCKS_DIFF_H
\ No newline at end of file
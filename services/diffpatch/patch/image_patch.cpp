@@ -14,6 +14,7 @@
  */
 
 #include "image_patch.h"
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -21,12 +22,15 @@
 #include "lz4_adapter.h"
 #include "openssl/sha.h"
 #include "securec.h"
+#include "thread_pool.h"
 #include "zip_adapter.h"
 
 using namespace hpackage;
 
 namespace updatepatch {
-uint32_t g_tmpFileId = 0;
+std::atomic<uint32_t> g_tmpFileId {0};
+// 未写出的压缩块最多缓存的字节数
+constexpr size_t MAX_PENDING_BUFFER_SIZE = 64 * 1024 * 1024; // 64M
 
 int32_t NormalImagePatch::ApplyImagePatch(const PatchParam &param, size_t &startOffset)
 {
@@ -68,34 +72,48 @@ int32_t RowImagePatch::ApplyImagePatch(const PatchParam &param, size_t &startOff
 }
 
 int32_t CompressedImagePatch::ApplyImagePatch(const PatchParam &param, size_t &startOffset)
+{
+    int32_t ret = PrepareImagePatch(param, startOffset);
+    PATCH_CHECK(ret == 0, return -1, "Failed to prepare image patch");
+    return RestoreImageData(param);
+}
+
+int32_t CompressedImagePatch::PrepareImagePatch(const PatchParam &param, size_t &startOffset)
 {
     size_t offset = startOffset;
     // read header
-    PatchHeader header {};
-    int32_t ret = ReadHeader(param, header, offset);
+    int32_t ret = ReadHeader(param, header_, offset);
     PATCH_CHECK(ret == 0, return -1, "failed to read header");
     PATCH_LOGI("ApplyImagePatch srcStart %zu srcLen %zu patchOffset: %zu expandedLen:%zu %zu",
-        header.srcStart, header.srcLength, header.patchOffset, header.expandedLen, header.targetSize);
-    PATCH_CHECK(header.srcStart + header.srcLength <= param.oldSize, return -1, "Failed to check patch");
+        header_.srcStart, header_.srcLength, header_.patchOffset, header_.expandedLen, header_.targetSize);
+    PATCH_CHECK(header_.srcStart + header_.srcLength <= param.oldSize, return -1, "Failed to check patch");
+    startOffset = offset;
+    return 0;
+}
 
+int32_t CompressedImagePatch::RestoreImageData(const PatchParam &param)
+{
     // decompress old data
     hpackage::PkgManager::StreamPtr stream = nullptr;
-    BlockBuffer oldData = { param.oldBuff + header.srcStart, header.srcLength };
-    ret = DecompressData(oldData, stream, true, header.expandedLen);
+    BlockBuffer oldData = { param.oldBuff + header_.srcStart, header_.srcLength };
+    int32_t ret = DecompressData(oldData, stream, true, header_.expandedLen);
     PATCH_CHECK(ret == 0, return -1, "Failed to decompress data");
+    PkgManager* pkgManager = hpackage::PkgManager::GetPackageInstance();
+    PATCH_CHECK(pkgManager != nullptr, return -1, "Failed to get pkg manager");
 
     // prepare new data
     std::unique_ptr<hpackage::FileInfo> info = GetFileInfo();
-    PATCH_CHECK(info != nullptr, return -1, "Failed to get file info");
-    info->packedSize = header.targetSize;
-    info->unpackedSize = header.expandedLen;
+    PATCH_CHECK(info != nullptr, pkgManager->ClosePkgStream(stream); return -1, "Failed to get file info");
+    info->packedSize = header_.targetSize;
+    info->unpackedSize = header_.expandedLen;
     std::unique_ptr<CompressedFileRestore> zipWriter = std::make_unique<CompressedFileRestore>(info.get(), writer_);
-    PATCH_CHECK(zipWriter != nullptr, return -1, "Failed to create zip writer");
-    PATCH_CHECK(zipWriter->Init() == 0, return -1, "Failed to create zip writer");
+    PATCH_CHECK(zipWriter != nullptr, pkgManager->ClosePkgStream(stream); return -1, "Failed to create zip writer");
+    PATCH_CHECK(zipWriter->Init() == 0, pkgManager->ClosePkgStream(stream); return -1, "Failed to create zip writer");
 
     // apply patch
-    PatchBuffer patchInfo = {param.patch, header.patchOffset, param.patchSize};
+    PatchBuffer patchInfo = {param.patch, header_.patchOffset, param.patchSize};
     ret = UpdatePatch::ApplyBlockPatch(patchInfo, stream, zipWriter.get());
+    pkgManager->ClosePkgStream(stream);
     PATCH_CHECK(ret == 0, return -1, "Failed to apply bsdiff patch");
 
     // compress new data
@@ -103,8 +121,7 @@ int32_t CompressedImagePatch::ApplyImagePatch(const PatchParam &param, size_t &s
     size_t compressSize = 0;
     zipWriter->CompressData(originalSize, compressSize);
     PATCH_LOGI("ApplyImagePatch unpackedSize %zu %zu", originalSize, compressSize);
-    PATCH_CHECK(originalSize == header.targetSize, return -1, "Failed to apply bsdiff patch");
-    startOffset = offset;
+    PATCH_CHECK(originalSize == header_.targetSize, return -1, "Failed to apply bsdiff patch");
     return 0;
 }
 
@@ -278,4 +295,70 @@ int32_t CompressedFileRestore::CompressData(size_t &originalSize, size_t &compre
     PATCH_LOGI("CompressedFileRestore hash %zu %s ", dataSize_, hexDigest.c_str());
     return 0;
 }
+
+CompressedImagePatchPipeline::~CompressedImagePatchPipeline()
+{
+    // 出错返回时任务可能还在执行, 等待结束后再释放
+    for (auto &task : tasks_) {
+        threadPool_->Wait(task->result);
+    }
+}
+
+int32_t CompressedImagePatchPipeline::Submit(std::unique_ptr<CompressedImagePatch> patch,
+    std::unique_ptr<BufferPatchWriter> output)
+{
+    if (!initialized_) {
+        threadPool_ = GetThreadPool();
+        initialized_ = true;
+    }
+    if (threadPool_ == nullptr) {
+        int32_t ret = patch->RestoreImageData(param_);
+        PATCH_CHECK(ret == 0, return -1, "Failed to restore image data");
+        return WriteOutput(*output);
+    }
+
+    // 按缓存的字节数限制未写出的块, 内存占用不随块数和块大小增长; 至少保留一个块在执行
+    size_t bufferSize = patch->GetBufferSize();
+    while (!tasks_.empty() && pendingSize_ + bufferSize > MAX_PENDING_BUFFER_SIZE) {
+        int32_t ret = WriteFront();
+        PATCH_CHECK(ret == 0, return ret, "Failed to write image data");
+    }
+    std::unique_ptr<Task> task = std::make_unique<Task>();
+    CompressedImagePatch *imagePatch = patch.get();
+    task->patch = std::move(patch);
+    task->output = std::move(output);
+    task->bufferSize = bufferSize;
+    task->result = threadPool_->Submit([this, imagePatch]() {
+        return imagePatch->RestoreImageData(param_);
+    });
+    pendingSize_ += bufferSize;
+    tasks_.push_back(std::move(task));
+    return 0;
+}
+
+int32_t CompressedImagePatchPipeline::Flush()
+{
+    while (!tasks_.empty()) {
+        int32_t ret = WriteFront();
+        PATCH_CHECK(ret == 0, return ret, "Failed to write image data");
+    }
+    return 0;
+}
+
+int32_t CompressedImagePatchPipeline::WriteFront()
+{
+    std::unique_ptr<Task> task = std::move(tasks_.front());
+    tasks_.pop_front();
+    pendingSize_ -= task->bufferSize;
+    int32_t ret = threadPool_->Wait(task->result);
+    PATCH_CHECK(ret == 0, return -1, "Failed to restore image data");
+    return WriteOutput(*task->output);
+}
+
+int32_t CompressedImagePatchPipeline::WriteOutput(const BufferPatchWriter &output)
+{
+    const std::vector<uint8_t> &data = output.GetData();
+    BlockBuffer buffer = { const_cast<uint8_t *>(data.data()), data.size() };
+    return writer_->Write(0, buffer, data.size());
+}
 } // namespace updater
@@ -16,6 +16,8 @@
 #ifndef IMAGE_PATCH_H
 #define IMAGE_PATCH_H
 
+#include <deque>
+#include <future>
 #include <sys/types.h>
 #include "deflate_adapter.h"
 #include "diffpatch.h"
@@ -65,6 +67,14 @@ public:
     ~CompressedImagePatch() override {}
 
     int32_t ApplyImagePatch(const PatchParam &param, size_t &startOffset) override;
+    // ApplyImagePatch in two steps, so that RestoreImageData can run on a worker thread
+    int32_t PrepareImagePatch(const PatchParam &param, size_t &startOffset);
+    int32_t RestoreImageData(const PatchParam &param);
+    // RestoreImageData 中缓存的数据大小, PrepareImagePatch 之后有效
+    size_t GetBufferSize() const
+    {
+        return header_.expandedLen + header_.targetSize;
+    }
 protected:
     virtual int32_t ReadHeader(const PatchParam &param, PatchHeader &header, size_t &offset) = 0;
     virtual std::unique_ptr<hpackage::FileInfo> GetFileInfo() const = 0;
@@ -72,6 +82,7 @@ protected:
         hpackage::PkgManager::StreamPtr &stream, bool memory, size_t expandedLen) const;
 
     std::vector<uint8_t> bonusData_ {};
+    PatchHeader header_ {};
 };
 
 class ZipImagePatch : public CompressedImagePatch {
@@ -133,5 +144,61 @@ private:
     std::unique_ptr<DeflateAdapter> deflateAdapter_ { nullptr };
     SHA256_CTX sha256Ctx_ {};
 };
+class BufferPatchWriter : public UpdatePatchWriter {
+public:
+    BufferPatchWriter() : UpdatePatchWriter() {}
+    ~BufferPatchWriter() override {}
+
+    int32_t Init() override
+    {
+        return 0;
+    }
+    int32_t Write(size_t start, const BlockBuffer &buffer, size_t len) override
+    {
+        data_.insert(data_.end(), buffer.buffer, buffer.buffer + len);
+        return 0;
+    }
+    int32_t Finish() override
+    {
+        return 0;
+    }
+    const std::vector<uint8_t> &GetData() const
+    {
+        return data_;
+    }
+private:
+    std::vector<uint8_t> data_ {};
+};
+
+// 压缩块在共享线程池中解压、还原、重新压缩, 结果按提交顺序写入 writer
+class CompressedImagePatchPipeline {
+public:
+    CompressedImagePatchPipeline(const PatchParam &param, UpdatePatchWriterPtr writer)
+        : param_(param), writer_(writer) {}
+    ~CompressedImagePatchPipeline();
+
+    // patch 的 writer 必须是 output, 且已经调用过 PrepareImagePatch
+    int32_t Submit(std::unique_ptr<CompressedImagePatch> patch, std::unique_ptr<BufferPatchWriter> output);
+    // 等待已提交的块完成并全部写出
+    int32_t Flush();
+private:
+    struct Task {
+        std::unique_ptr<CompressedImagePatch> patch;
+        std::unique_ptr<BufferPatchWriter> output;
+        size_t bufferSize;
+        std::future<int32_t> result;
+    };
+
+    int32_t WriteFront();
+    int32_t WriteOutput(const BufferPatchWriter &output);
+
+    const PatchParam &param_;
+    UpdatePatchWriterPtr writer_ { nullptr };
+    // 第一个压缩块提交时才获取线程池, 没有压缩块的补丁不使用线程池
+    bool initialized_ { false };
+    uscript::ThreadPool *threadPool_ { nullptr };
+    size_t pendingSize_ { 0 };
+    std::deque<std::unique_ptr<Task>> tasks_ {};
+};
 } // namespace updater
 #endif  // IMAGE_PATCH_H
@@ -50,6 +50,8 @@ int32_t UpdatePatch::ApplyImagePatch(const PatchParam &param,
     offset += sizeof(int32_t);
 
     std::vector<uint8_t> empty;
+    // 压缩块在线程池中还原, normal 和 raw 块写出前先写出前面所有的压缩块
+    CompressedImagePatchPipeline pipeline(param, writer);
     for (int i = 0; i < numChunks; ++i) {
         // each chunk's header record starts with 4 bytes.
         PATCH_CHECK((offset + sizeof(int32_t)) <= param.patchSize, return -1, "Failed to read chunk record ");
@@ -57,6 +59,8 @@ int32_t UpdatePatch::ApplyImagePatch(const PatchParam &param,
         PATCH_LOGI("ApplyImagePatch numChunks[%d] type %d offset %d", i, type, offset);
         offset += sizeof(int32_t);
         std::unique_ptr<ImagePatch> imagePatch = nullptr;
+        std::unique_ptr<CompressedImagePatch> compressedPatch = nullptr;
+        std::unique_ptr<BufferPatchWriter> output = nullptr;
         switch (type) {
             case BLOCK_NORMAL:
                 imagePatch = std::make_unique<NormalImagePatch>(writer);
@@ -65,18 +69,31 @@ int32_t UpdatePatch::ApplyImagePatch(const PatchParam &param,
                 imagePatch = std::make_unique<RowImagePatch>(writer);
                 break;
             case BLOCK_DEFLATE:
-                imagePatch = std::make_unique<ZipImagePatch>(writer, ((i == 1) ? bonusData : empty));
+                output = std::make_unique<BufferPatchWriter>();
+                compressedPatch = std::make_unique<ZipImagePatch>(output.get(), ((i == 1) ? bonusData : empty));
                 break;
             case BLOCK_LZ4:
-                imagePatch = std::make_unique<Lz4ImagePatch>(writer, ((i == 1) ? bonusData : empty));
+                output = std::make_unique<BufferPatchWriter>();
+                compressedPatch = std::make_unique<Lz4ImagePatch>(output.get(), ((i == 1) ? bonusData : empty));
                 break;
             default:
                 break;
         }
+        if (compressedPatch != nullptr) {
+            int32_t ret = compressedPatch->PrepareImagePatch(param, offset);
+            PATCH_CHECK(ret == 0, return -1, "Apply image patch fail ");
+            ret = pipeline.Submit(std::move(compressedPatch), std::move(output));
+            PATCH_CHECK(ret == 0, return -1, "Apply image patch fail ");
+            continue;
+        }
         PATCH_CHECK(imagePatch != nullptr, return -1, "Failed to  creareimg patch ");
-        int32_t ret = imagePatch->ApplyImagePatch(param, offset);
+        int32_t ret = pipeline.Flush();
+        PATCH_CHECK(ret == 0, return -1, "Apply image patch fail ");
+        ret = imagePatch->ApplyImagePatch(param, offset);
         PATCH_CHECK(ret == 0, return -1, "Apply image patch fail ");
     }
+    int32_t ret = pipeline.Flush();
+    PATCH_CHECK(ret == 0, return -1, "Apply image patch fail ");
     return 0;
 }
 
@@ -162,7 +179,7 @@ int32_t UpdatePatch::ApplyPatch(const std::string &patchName, const std::string
         param.oldSize = oldData.length;
         ret = updatepatch::UpdatePatch::ApplyImagePatch(param, writer.get(), empty);
         PATCH_CHECK(ret == 0, return -1, "Failed to apply image patch file");
-    } else if (memcmp(patchData.memory, BSDIFF_MAGIC.c_str(), BSDIFF_MAGIC.size()) == 0) { // bsdiff
+    } else if (GetBsdiffCompressMethod(patchData.memory, patchData.length) >= 0) { // bsdiff
         PatchBuffer patchInfo = {patchData.memory, 0, patchData.length};
         BlockBuffer oldInfo = {oldData.memory, oldData.length};
         ret = ApplyBlockPatch(patchInfo, oldInfo, writer.get());
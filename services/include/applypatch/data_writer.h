@@ -35,6 +35,11 @@ public:
     using DataWriterPtr = DataWriter *;
     virtual bool Write(const uint8_t *addr, size_t len, WriteMode mode, const std::string &partitionName) = 0;
     virtual int OpenPartition(const std::string &partitionName);
+    // 所有数据传入后调用，写入缓存的数据并检查是否完整
+    virtual bool Finish()
+    {
+        return true;
+    }
     virtual ~DataWriter() {}
     static std::unique_ptr<DataWriter> CreateDataWriter(WriteMode mode, const std::string &partitionName,
         UpdaterEnv *env);
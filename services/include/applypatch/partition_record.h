@@ -16,6 +16,7 @@
 #define UPDATER_PARTITION_UPDATE_RECORD_H
 
 #include <cstdio>
+#include <mutex>
 #include <unistd.h>
 #include <cassert>
 #include "fs_manager/mount.h"
@@ -68,6 +69,8 @@ private:
 private:
     std::string GetMiscPartitionPath(const std::string &mountPoint = "/misc");
 
+    // 分区可能并发更新，记录时需要互斥
+    std::mutex mutex_;
     PartitionRecordInfo info_;
     // offset of partition record in misc.
     // offset is not start from zero, but
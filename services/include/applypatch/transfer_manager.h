@@ -26,8 +26,6 @@
 
 
 namespace updater {
-static std::unordered_map<std::string, BlockSet> blocksetMap;
-
 struct WriterThreadInfo {
     pthread_mutex_t mutex;
     pthread_cond_t cond;
@@ -53,6 +51,7 @@ struct TransferParams {
     std::string retryFile;
     uint8_t *patchDataBuffer;
     size_t patchDataSize;
+    std::unordered_map<std::string, BlockSet> blocksetMap;
 };
 using GlobalParams = TransferParams;
 class TransferManager;
@@ -60,8 +59,12 @@ using TransferManagerPtr = TransferManager *;
 class TransferManager {
 public:
     TransferManager() {}
+    // 每个线程一个实例，不同分区可以在不同线程中同时更新
     static TransferManagerPtr GetTransferManagerInstance();
     static void ReleaseTransferManagerInstance(TransferManagerPtr transferManager);
+    // 取出当前线程的实例并清空，之后可以用 Attach 放回，线程池中的线程执行多个分区时使用
+    static TransferManagerPtr DetachTransferManagerInstance();
+    static void AttachTransferManagerInstance(TransferManagerPtr transferManager);
     virtual ~TransferManager();
 
     void Init();
@@ -16,6 +16,7 @@
 #define UPDATE_ENV_H
 
 #include <cstdio>
+#include <mutex>
 #include <string>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -30,21 +31,39 @@ using uscript::UScriptInstructionFactoryPtr;
 namespace updater {
 class UpdaterEnv : public UScriptEnv {
 public:
-    UpdaterEnv(hpackage::PkgManager::PkgManagerPtr pkgManager, FILE* pipeWrite, bool retry) :
-        UScriptEnv(pkgManager), pipeWrite_(pipeWrite), isRetry_(retry) {}
+    // messageVersion 为 0 时使用文本消息，否则使用该版本的二进制帧
+    UpdaterEnv(hpackage::PkgManager::PkgManagerPtr pkgManager, FILE* pipeWrite, bool retry,
+        uint8_t messageVersion = 0) :
+        UScriptEnv(pkgManager), pipeWrite_(pipeWrite), isRetry_(retry), messageVersion_(messageVersion) {}
     virtual ~UpdaterEnv();
 
     virtual void PostMessage(const std::string &cmd, std::string content);
+    // 进度变化小于 MESSAGE_PROGRESS_STEP 时先合并，发送其他消息或者进度完成时再发出
+    virtual void PostProgress(float progress);
     virtual UScriptInstructionFactoryPtr GetInstructionFactory();
     virtual const std::vector<std::string> GetInstructionNames() const;
     virtual bool IsRetry() const
     {
         return isRetry_;
     }
+    // 是否与其他分区同时更新，同时更新的分区不能共用临时目录
+    virtual bool IsConcurrent() const
+    {
+        return false;
+    }
 private:
+    void WriteMessage(const std::string &cmd, const std::string &content);
+    void FlushProgress();
+
     UScriptInstructionFactoryPtr factory_ = nullptr;
     FILE* pipeWrite_ = nullptr;
     bool isRetry_ = false;
+    uint8_t messageVersion_ = 0;
+    std::mutex messageMutex_;
+    bool progressPending_ = false;
+    float pendingProgress_ = 0.0f;
+    float sentProgress_ = 0.0f;
+    uint32_t pendingCount_ = 0;
 };
 }
 #endif /* UPDATE_ENV_H */
@@ -334,6 +334,14 @@ public:
         std::vector<std::string> &fileIds) = 0;
 
     virtual int32_t ParsePackage(StreamPtr stream, std::vector<std::string> &fileIds, int32_t type) = 0;
+
+    /**
+     * Set whether packages loaded afterwards create their entries on first lookup.
+     * Only zip and upgrade packages support lazy loading, other types ignore it.
+     *
+     * @param lazyLoad      true to keep an index at load time and create entries on demand
+     */
+    virtual void SetLazyLoad(bool lazyLoad) {}
 };
 } // namespace hpackage
 #endif // PKG_MANAGER_H
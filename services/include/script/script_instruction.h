@@ -43,6 +43,10 @@ public:
     }
 
     virtual void PostMessage(const std::string &cmd, std::string content) = 0;
+    virtual void PostProgress(float progress)
+    {
+        PostMessage("set_progress", std::to_string(progress));
+    }
     virtual UScriptInstructionFactoryPtr GetInstructionFactory() = 0;
     virtual const std::vector<std::string> GetInstructionNames() const = 0;
     virtual bool IsRetry() const = 0;
@@ -90,6 +94,11 @@ public:
     virtual int32_t GetParam(int32_t index, int32_t& value) = 0;
     virtual int32_t GetParam(int32_t index, float& value) = 0;
     virtual int32_t GetParam(int32_t index, std::string& value) = 0;
+
+    /**
+     * 上报指令处理的数据量（字节），用于性能统计，可以多次调用累加
+     */
+    virtual void AddProcessedBytes(uint64_t bytes) {}
 };
 
 /**
@@ -107,6 +116,15 @@ public:
      * 返回值：函数处理结果
      */
     virtual int32_t Execute(UScriptEnv &env, UScriptContext &context) = 0;
+
+    /**
+     * 脚本通过 async 调用时，是否可以在线程池中与其他指令并发执行
+     * 返回 false 的指令在 async 调用处同步执行
+     */
+    virtual bool IsAsyncSafe() const
+    {
+        return false;
+    }
 };
 
 /**
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SCRIPT_PROFILER_H
+#define SCRIPT_PROFILER_H
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace uscript {
+/**
+ * 脚本指令性能统计，按指令名、脚本和行号记录调用次数、耗时以及指令上报的处理数据量
+ * 默认关闭，关闭时执行指令只多一次标志判断
+ */
+class ScriptProfiler {
+public:
+    struct ProfileRecord {
+        std::string name;
+        std::string script;
+        int32_t line = 0;
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+        uint64_t bytes = 0;
+    };
+
+    static ScriptProfiler &GetInstance();
+
+    void Enable(bool enable)
+    {
+        enabled_ = enable;
+    }
+    bool IsEnabled() const
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void AddRecord(const std::string &name, const std::string &script, int32_t line,
+        uint64_t durationNs, uint64_t bytes);
+    // 按总耗时从大到小排序
+    std::vector<ProfileRecord> GetRecords() const;
+    std::string DumpTable() const;
+    std::string DumpJson() const;
+    int32_t DumpJson(const std::string &path) const;
+    void Reset();
+
+private:
+    ScriptProfiler() = default;
+    ~ScriptProfiler() = default;
+
+    using RecordKey = std::tuple<std::string, std::string, int32_t>;
+    std::atomic<bool> enabled_ { false };
+    mutable std::mutex mutex_;
+    std::map<RecordKey, ProfileRecord> records_ {};
+};
+} // namespace uscript
+#endif // SCRIPT_PROFILER_H
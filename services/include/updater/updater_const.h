@@ -22,14 +22,18 @@ const std::string COMMAND_FILE = "/data/updater/command";
 const std::string TMP_LOG = "/tmp/updater.log";
 const std::string TMP_STAGE_LOG = "/tmp/updater_stage.log";
 const std::string TMP_ERROR_CODE_PATH = "/tmp/error_code.log";
+const std::string TMP_SCRIPT_PROFILE = "/tmp/updater_script_profile.json";
 const std::string ERROR_CODE_PATH = "/data/updater/log/error_code.log";
 const std::string UPDATER_LOG_DIR = "/data/updater/log";
 const std::string UPDATER_LOG = "/data/updater/log/updater_log";
 const std::string UPDATER_STAGE_LOG = "/data/updater/log/updater_stage_log";
+const std::string UPDATER_SCRIPT_PROFILE = "/data/updater/log/updater_script_profile.json";
 const std::string UPDATER_PATH = "/data/updater";
 const std::string MISC_FILE = "/dev/block/platform/soc/10100000.himci.eMMC/by-name/misc";
 const std::string UPDATER_BINARY = "updater_binary";
 const std::string SDCARD_PATH = "/sdcard";
+// 设置该环境变量时统计脚本中各指令的耗时, updater_binary 从 updater 继承
+constexpr const char *SCRIPT_PROFILE_ENV = "UPDATER_SCRIPT_PROFILE";
 #ifndef UPDATER_UT
 const std::string SDCARD_CARD_PATH = "/sdcard/updater";
 const std::string SDCARD_CARD_PKG_PATH = "/sdcard/updater/updater.zip";
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef UPDATER_MESSAGE_H
+#define UPDATER_MESSAGE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+/**
+ * updater 与 updater_binary 之间通过管道传递的消息。
+ * updater 在环境变量中告诉子进程支持的协议版本，子进程据此选择二进制帧或者文本 "cmd:content\n"。
+ * 旧版本的 updater_binary 只会输出文本，所以接收端两种格式都要支持：
+ * 二进制帧以 MESSAGE_MAGIC 开头，该字节不会出现在文本行的开头。
+ */
+namespace updater {
+constexpr const char *MESSAGE_VERSION_ENV = "UPDATER_MESSAGE_VERSION";
+constexpr uint8_t MESSAGE_VERSION = 1;
+constexpr uint8_t MESSAGE_MAGIC = 0xA5;
+constexpr uint32_t MAX_MESSAGE_SIZE = 4096;
+// 发送端合并进度，变化达到该值时才发送
+constexpr float MESSAGE_PROGRESS_STEP = 0.01;
+
+enum MessageType : uint8_t {
+    MESSAGE_TYPE_TEXT = 1, // 负载为 "cmd:content"，不带换行
+    MESSAGE_TYPE_PROGRESS, // 负载为 MessageProgress
+};
+
+struct MessageHeader {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint8_t reserved;
+    uint32_t length; // 负载长度
+};
+
+// 固定长度的进度记录，count 为发送端合并的进度消息个数
+struct MessageProgress {
+    float progress;
+    uint32_t count;
+};
+
+static_assert(sizeof(MessageHeader) == 8, "Invalid message header size");
+static_assert(sizeof(MessageProgress) == 8, "Invalid message progress size");
+
+// 读取 updater 设置的协议版本，没有设置时返回 0，表示使用文本
+uint8_t GetMessageVersion();
+
+// 按协商的版本写入一帧并立即 flush
+bool WriteMessageFrame(FILE *pipe, uint8_t version, MessageType type, const void *payload, uint32_t length);
+
+/**
+ * 接收端按字节流解析消息，数据可以分多次传入，不完整的帧留到下次解析。
+ * 文本行和文本帧都通过 textHandler 返回 "cmd:content"，进度帧通过 progressHandler 返回。
+ */
+class MessageParser {
+public:
+    using TextHandler = std::function<void(const std::string &)>;
+    using ProgressHandler = std::function<void(float)>;
+
+    MessageParser(TextHandler textHandler, ProgressHandler progressHandler)
+        : textHandler_(std::move(textHandler)), progressHandler_(std::move(progressHandler)) {}
+    ~MessageParser() {}
+
+    void Parse(const char *data, size_t size);
+    // 管道关闭时处理最后一行没有换行的文本
+    void Finish();
+
+private:
+    // 返回 0 表示数据不完整
+    size_t ParseFrame(size_t pos);
+    size_t ParseLine(size_t pos);
+
+    TextHandler textHandler_;
+    ProgressHandler progressHandler_;
+    std::string buffer_ {};
+};
+} // namespace updater
+#endif // UPDATER_MESSAGE_H
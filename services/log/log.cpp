@@ -74,7 +74,9 @@ std::ostream& UpdaterLogger::OutputUpdaterLog(const std::string &path, int line)
     char realTime[MAX_TIME_SIZE] = {0};
     auto sysTime = std::chrono::system_clock::now();
     auto currentTime = std::chrono::system_clock::to_time_t(sysTime);
-    struct tm *localTime = std::localtime(&currentTime);
+    // 多个线程会同时输出日志，使用可重入的 localtime_r
+    struct tm timeInfo {};
+    struct tm *localTime = localtime_r(&currentTime, &timeInfo);
     if (localTime != nullptr) {
         std::strftime(realTime, sizeof(realTime), "%Y-%m-%d %H:%M:%S", localTime);
     }
@@ -96,7 +98,8 @@ std::ostream& StageLogger::OutputUpdaterStage()
     char realTime[MAX_TIME_SIZE] = {0};
     auto sysTime = std::chrono::system_clock::now();
     auto currentTime = std::chrono::system_clock::to_time_t(sysTime);
-    struct tm *localTime = std::localtime(&currentTime);
+    struct tm timeInfo {};
+    struct tm *localTime = localtime_r(&currentTime, &timeInfo);
     if (localTime != nullptr) {
         std::strftime(realTime, sizeof(realTime), "%Y-%m-%d %H:%M:%S", localTime);
     }
@@ -113,7 +116,7 @@ std::ostream& StageLogger::OutputUpdaterStage()
 
 void Logger(int level, const char* fileName, int32_t line, const char* format, ...)
 {
-    static std::vector<char> buff(1024);
+    static thread_local std::vector<char> buff(1024);
     va_list list;
     va_start(list, format);
     int size = vsnprintf_s(reinterpret_cast<char*>(buff.data()), buff.capacity(), buff.capacity(), format, list);
@@ -127,7 +130,8 @@ std::ostream& ErrorCode::OutputErrorCode(const std::string &path, int line, Upda
     char realTime[MAX_TIME_SIZE] = {0};
     auto sysTime = std::chrono::system_clock::now();
     auto currentTime = std::chrono::system_clock::to_time_t(sysTime);
-    struct tm *localTime = std::localtime(&currentTime);
+    struct tm timeInfo {};
+    struct tm *localTime = localtime_r(&currentTime, &timeInfo);
     if (localTime != nullptr) {
         std::strftime(realTime, sizeof(realTime), "%Y-%m-%d %H:%M:%S", localTime);
     }
@@ -219,6 +219,9 @@ PkgFilePtr PkgManagerImpl::CreatePackage(PkgStreamPtr stream, PkgFile::PkgType t
         default:
             return nullptr;
     }
+    if (pkgFile != nullptr) {
+        pkgFile->SetLazyLoad(lazyLoad_);
+    }
     return pkgFile;
 }
 
@@ -243,6 +246,7 @@ int32_t PkgManagerImpl::ParsePackage(StreamPtr stream, std::vector<std::string>
         });
     PKG_CHECK(ret == PKG_SUCCESS, pkgFile->SetPkgStream(); delete pkgFile;
         return ret, "Load package fail %s", stream->GetFileName().c_str());
+    std::lock_guard<std::mutex> lock(pkgFilesLock_);
     pkgFiles_.push_back(pkgFile);
     return PKG_SUCCESS;
 }
@@ -257,9 +261,9 @@ int32_t PkgManagerImpl::LoadPackage(const std::string &packagePath, const std::s
     PKG_CHECK(ret == PKG_SUCCESS, return ret, "Invalid keyname");
 
     // Check if package already loaded
-    for (auto iter : pkgFiles_) {
-        PkgFilePtr pkgFile = iter;
-        if (pkgFile != nullptr && pkgFile->GetPkgStream()->GetFileName().compare(packagePath) == 0) {
+    {
+        std::lock_guard<std::mutex> lock(pkgFilesLock_);
+        if (FindPkgFile(packagePath) != nullptr) {
             return PKG_SUCCESS;
         }
     }
@@ -334,10 +338,33 @@ int32_t PkgManagerImpl::LoadPackageWithStream(const std::string &packagePath,
         });
 
     PKG_CHECK(ret == PKG_SUCCESS, delete pkgFile; return ret, "Load package fail %s", packagePath.c_str());
-    pkgFiles_.push_back(pkgFile);
+    // 查找和插入在同一个锁内, 多个线程同时加载同一个包时只保留先完成的一份
+    PkgFilePtr loadedFile = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(pkgFilesLock_);
+        loadedFile = FindPkgFile(stream->GetFileName());
+        if (loadedFile == nullptr) {
+            pkgFiles_.push_back(pkgFile);
+        }
+    }
+    if (loadedFile != nullptr) {
+        PKG_LOGI("Package %s already loaded", packagePath.c_str());
+        delete pkgFile;
+    }
     return PKG_SUCCESS;
 }
 
+PkgFilePtr PkgManagerImpl::FindPkgFile(const std::string &fileName) const
+{
+    for (auto iter : pkgFiles_) {
+        PkgFilePtr pkgFile = iter;
+        if (pkgFile != nullptr && pkgFile->GetPkgStream()->GetFileName().compare(fileName) == 0) {
+            return pkgFile;
+        }
+    }
+    return nullptr;
+}
+
 int32_t PkgManagerImpl::ExtractFile(const std::string &name, PkgManager::StreamPtr output)
 {
     PKG_CHECK(output != nullptr, return PKG_INVALID_STREAM, "Invalid stream");
@@ -353,6 +380,7 @@ int32_t PkgManagerImpl::ExtractFile(const std::string &name, PkgManager::StreamP
 
 const PkgInfo *PkgManagerImpl::GetPackageInfo(const std::string &packagePath)
 {
+    std::lock_guard<std::mutex> lock(pkgFilesLock_);
     for (auto iter : pkgFiles_) {
         PkgFilePtr pkgFile = iter;
         if (pkgFile != nullptr && pkgFile->GetPkgType() == PkgFile::PKG_TYPE_UPGRADE) {
@@ -373,7 +401,8 @@ const FileInfo *PkgManagerImpl::GetFileInfo(const std::string &path)
 
 PkgEntryPtr PkgManagerImpl::GetPkgEntry(const std::string &fileId)
 {
-    // Find out pkgEntry by fileId.
+    // Find out pkgEntry by fileId. 延迟创建 entry 时会修改索引，需要加锁
+    std::lock_guard<std::mutex> lock(pkgFilesLock_);
     for (auto iter : pkgFiles_) {
         PkgFilePtr pkgFile = iter;
         PkgEntryPtr pkgEntry = pkgFile->FindPkgEntry(fileId);
@@ -428,6 +457,7 @@ int32_t PkgManagerImpl::CreatePkgStream(PkgStreamPtr &stream, const std::string
         int32_t ret = CheckFile(fileName);
         PKG_CHECK(ret == PKG_SUCCESS, return ret, "Fail to check file %s ", fileName.c_str());
 
+        std::lock_guard<std::mutex> lock(pkgStreamsLock_);
         if (pkgStreams_.find(fileName) != pkgStreams_.end()) {
             PkgStreamPtr mapStream = pkgStreams_[fileName];
             mapStream->AddRef();
@@ -439,6 +469,8 @@ int32_t PkgManagerImpl::CreatePkgStream(PkgStreamPtr &stream, const std::string
         file = fopen(fileName.c_str(), modeFlags[type]);
         PKG_CHECK(file != nullptr, return PKG_INVALID_FILE, "Fail to open file %s ", fileName.c_str());
         stream = new FileStream(fileName, file, type);
+        pkgStreams_[fileName] = stream;
+        return PKG_SUCCESS;
     } else if (type == PkgStream::PkgStreamType_MemoryMap) {
         size_t fileSize = size;
         if (fileSize == 0) {
@@ -455,6 +487,7 @@ int32_t PkgManagerImpl::CreatePkgStream(PkgStreamPtr &stream, const std::string
     } else {
         return -1;
     }
+    std::lock_guard<std::mutex> lock(pkgStreamsLock_);
     pkgStreams_[fileName] = stream;
     return PKG_SUCCESS;
 }
@@ -474,13 +507,16 @@ void PkgManagerImpl::ClosePkgStream(PkgStreamPtr &stream)
         return;
     }
 
-    auto iter = pkgStreams_.find(mapStream->GetFileName());
-    if (iter != pkgStreams_.end()) {
-        mapStream->DelRef();
-        if (mapStream->IsRef()) {
-            return;
+    {
+        std::lock_guard<std::mutex> lock(pkgStreamsLock_);
+        auto iter = pkgStreams_.find(mapStream->GetFileName());
+        if (iter != pkgStreams_.end()) {
+            mapStream->DelRef();
+            if (mapStream->IsRef()) {
+                return;
+            }
+            pkgStreams_.erase(iter);
         }
-        pkgStreams_.erase(iter);
     }
     delete mapStream;
     stream = nullptr;
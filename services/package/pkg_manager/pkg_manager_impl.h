@@ -18,6 +18,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include "pkg_lz4file.h"
 #include "pkg_manager.h"
 #include "pkg_pkgfile.h"
@@ -73,6 +74,11 @@ public:
     int32_t ParsePackage(StreamPtr stream, std::vector<std::string> &fileIds, int32_t type) override;
 
     int32_t CreatePkgStream(StreamPtr &stream, const std::string &fileName, const PkgBuffer &buffer) override;
+
+    void SetLazyLoad(bool lazyLoad) override
+    {
+        lazyLoad_ = lazyLoad;
+    }
 private:
     PkgFilePtr CreatePackage(PkgStreamPtr stream, PkgFile::PkgType type, PkgInfoPtr header = nullptr);
 
@@ -87,6 +93,9 @@ private:
     int32_t LoadPackageWithStream(const std::string &path, std::vector<std::string> &fileNames,
         PkgFile::PkgType type, PkgStreamPtr stream);
 
+    // 调用者需持有 pkgFilesLock_
+    PkgFilePtr FindPkgFile(const std::string &fileName) const;
+
     PkgFile::PkgType GetPkgTypeByName(const std::string &path);
 
     int32_t Sign(PkgStreamPtr stream, size_t offset, const PkgInfoPtr &info);
@@ -108,8 +117,13 @@ private:
     void ClosePkgStream(PkgStreamPtr &stream);
 private:
     bool unzipToFile_ {true};
+    bool lazyLoad_ {false};
     std::vector<PkgFilePtr> pkgFiles_ {};
     std::map<std::string, PkgStreamPtr> pkgStreams_ {};
+    // image patch creates and closes streams from worker threads
+    std::mutex pkgStreamsLock_ {};
+    // 多个分区并发更新时会同时查找 entry 和加载差分包
+    std::mutex pkgFilesLock_ {};
     std::string signVerifyKeyName_ {};
 };
 } // namespace hpackage
@@ -62,9 +62,12 @@ int32_t FileStream::Read(const PkgBuffer &data, size_t offset, size_t needRead,
     PKG_CHECK(data.length >= needRead, return PKG_INVALID_STREAM, "Invalid stream");
     readLen = 0;
     size_t len = GetFileLength();
-    fseek(stream_, offset, SEEK_SET);
     PKG_CHECK(offset <= len, return PKG_INVALID_STREAM, "Invalid offset");
+    // 多个脚本可能同时解压同一个包，seek 和 read 需要一起完成
+    flockfile(stream_);
+    fseek(stream_, offset, SEEK_SET);
     len = fread(data.buffer, 1, needRead, stream_);
+    funlockfile(stream_);
     readLen = len;
     return PKG_SUCCESS;
 }
@@ -73,8 +76,10 @@ int32_t FileStream::Write(const PkgBuffer &data, size_t size, size_t offset)
 {
     PKG_CHECK(streamType_ == PkgStreamType_Write, return PKG_INVALID_STREAM, "Invalid stream type");
     PKG_CHECK(stream_ != nullptr, return PKG_INVALID_STREAM, "Invalid stream");
+    flockfile(stream_);
     fseek(stream_, offset, SEEK_SET);
     size_t len = fwrite(data.buffer, size, 1, stream_);
+    funlockfile(stream_);
     PKG_CHECK(len == 1, return PKG_INVALID_STREAM, "Write buffer fail");
     return PKG_SUCCESS;
 }
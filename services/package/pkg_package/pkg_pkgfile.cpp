@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 #include "pkg_pkgfile.h"
+#include <algorithm>
 #include <ctime>
 #include <limits>
 #include <memory>
@@ -83,6 +84,62 @@ PkgEntryPtr PkgFile::FindPkgEntry(const std::string &fileName)
     if (iter != pkgEntryMapFileName_.end()) {
         return (*iter).second;
     }
+    return FindLazyEntry(fileName);
+}
+
+PkgEntryPtr PkgFile::FindPkgEntry(uint32_t nodeId)
+{
+    PKG_CHECK(CheckState({PKG_FILE_STATE_WORKING}, PKG_FILE_STATE_WORKING), return nullptr,
+        "error state curr %d ", state_);
+    auto iter = pkgEntryMapId_.find(nodeId);
+    if (iter != pkgEntryMapId_.end()) {
+        return iter->second;
+    }
+    // 索引按名字hash排序，按节点号只能逐个查找
+    for (auto &index : entryIndex_) {
+        if (index.nodeId == nodeId && !index.loaded) {
+            index.loaded = true;
+            return LoadPkgEntry(index);
+        }
+    }
+    return nullptr;
+}
+
+void PkgFile::AddEntryIndex(const std::string &fileName, size_t headerOffset, size_t dataOffset)
+{
+    entryIndex_.push_back({std::hash<std::string> {}(fileName), nodeId_++, headerOffset, dataOffset, false});
+}
+
+void PkgFile::SortEntryIndex()
+{
+    std::stable_sort(entryIndex_.begin(), entryIndex_.end(),
+        [](const PkgEntryIndex &left, const PkgEntryIndex &right) {
+            return left.nameHash < right.nameHash;
+        });
+}
+
+PkgEntryPtr PkgFile::FindLazyEntry(const std::string &fileName)
+{
+    if (entryIndex_.empty()) {
+        return nullptr;
+    }
+    size_t nameHash = std::hash<std::string> {}(fileName);
+    auto iter = std::lower_bound(entryIndex_.begin(), entryIndex_.end(), nameHash,
+        [](const PkgEntryIndex &index, size_t hash) {
+            return index.nameHash < hash;
+        });
+    // hash可能冲突，逐个解析直到名字匹配，已解析的entry都保存在map中
+    for (; iter != entryIndex_.end() && iter->nameHash == nameHash; ++iter) {
+        if (iter->loaded) {
+            continue;
+        }
+        iter->loaded = true;
+        PkgEntryPtr entry = LoadPkgEntry(*iter);
+        PKG_CHECK(entry != nullptr, continue, "Failed to load entry at %zu", iter->headerOffset);
+        if (entry->GetFileName() == fileName) {
+            return entry;
+        }
+    }
     return nullptr;
 }
 
@@ -16,6 +16,7 @@
 #define PKG_FILE_H
 
 #include <map>
+#include <vector>
 #include "pkg_algorithm.h"
 #include "pkg_manager.h"
 #include "pkg_utils.h"
@@ -99,6 +100,9 @@ public:
 
     PkgEntryPtr FindPkgEntry(const std::string &fileName);
 
+    // 按节点号查找，延迟加载时节点号在建立索引时分配，与直接加载一致
+    PkgEntryPtr FindPkgEntry(uint32_t nodeId);
+
     PkgStreamPtr GetPkgStream() const
     {
         return pkgStream_;
@@ -124,9 +128,33 @@ public:
     static int32_t ConvertStringToBuffer(const std::string &fileName, const PkgBuffer &buffer, size_t &realLen);
 
     void AddSignData(uint8_t digestMethod, size_t currOffset, size_t &signOffset);
+
+    // 延迟创建entry，LoadPackage只建立索引，FindPkgEntry时再解析entry
+    void SetLazyLoad(bool lazyLoad)
+    {
+        lazyLoad_ = lazyLoad;
+    }
 protected:
+    struct PkgEntryIndex {
+        size_t nameHash;
+        uint32_t nodeId;
+        size_t headerOffset;
+        size_t dataOffset;
+        bool loaded;
+    };
+
     PkgEntryPtr AddPkgEntry(const std::string& fileName);
     bool CheckState(std::vector<uint32_t> states, uint32_t state);
+    void AddEntryIndex(const std::string &fileName, size_t headerOffset, size_t dataOffset);
+    void SortEntryIndex();
+    PkgEntryPtr FindLazyEntry(const std::string &fileName);
+
+    // 由具体的包类型根据索引解析出entry并保存，失败返回nullptr
+    virtual PkgEntryPtr LoadPkgEntry(const PkgEntryIndex &index)
+    {
+        UNUSED(index);
+        return nullptr;
+    }
 protected:
     enum {
         PKG_FILE_STATE_IDLE = 0,
@@ -140,6 +168,8 @@ protected:
     std::map<uint32_t, PkgEntryPtr> pkgEntryMapId_ {};
     std::multimap<std::string, PkgEntryPtr, std::greater<std::string>> pkgEntryMapFileName_ {};
     uint32_t state_ = PKG_FILE_STATE_IDLE;
+    bool lazyLoad_ = false;
+    std::vector<PkgEntryIndex> entryIndex_ {};
 };
 } // namespace hpackage
 #endif
@@ -266,6 +266,18 @@ int32_t UpgradePkgFile::ReadComponents(const PkgBuffer &buffer, size_t &parsedLe
             PKG_CHECK(ret == PKG_SUCCESS, return ret, "Fail to read data");
             currLen = 0;
         }
+        if (lazyLoad_) {
+            size_t decodeLen = 0;
+            ret = IndexComponent({buffer.buffer + currLen, readLen - currLen}, parsedLen + srcOffset, dataOffset,
+                decodeLen, fileNames);
+            PKG_CHECK(ret == PKG_SUCCESS, return ret, "Fail to index component");
+            PkgBuffer signBuffer(buffer.buffer + currLen, decodeLen);
+            algorithm->Update(signBuffer, decodeLen); // Generate digest for components
+            currLen += decodeLen;
+            srcOffset += decodeLen;
+            pkgInfo_.pkgInfo.entryCount++;
+            continue;
+        }
 
         UpgradeFileEntry *entry = new UpgradeFileEntry(this, nodeId_++);
         PKG_CHECK(entry != nullptr, return PKG_NONE_MEMORY, "Fail create upgrade node for %s",
@@ -294,9 +306,44 @@ int32_t UpgradePkgFile::ReadComponents(const PkgBuffer &buffer, size_t &parsedLe
             entry->GetFileInfo()->unpackedSize, entry->GetFileInfo()->identity.c_str());
     }
     parsedLen += srcOffset;
+    SortEntryIndex();
     return PKG_SUCCESS;
 }
 
+int32_t UpgradePkgFile::IndexComponent(const PkgBuffer &buffer, size_t headerOffset, size_t &dataOffset,
+    size_t &decodeLen, std::vector<std::string> &fileNames)
+{
+    PKG_CHECK(buffer.length >= sizeof(UpgradeCompInfo),
+        return PKG_INVALID_PKG_FORMAT, "Fail to check buffer %zu", buffer.length);
+    UpgradeCompInfo *info = reinterpret_cast<UpgradeCompInfo *>(buffer.buffer);
+    std::string fileName;
+    PkgFile::ConvertBufferToString(fileName, {info->address, sizeof(info->address)});
+    AddEntryIndex(fileName, headerOffset, dataOffset);
+    fileNames.push_back(std::move(fileName));
+    dataOffset += ReadLE32(buffer.buffer + offsetof(UpgradeCompInfo, size));
+    decodeLen = sizeof(UpgradeCompInfo);
+    return PKG_SUCCESS;
+}
+
+PkgEntryPtr UpgradePkgFile::LoadPkgEntry(const PkgEntryIndex &index)
+{
+    PkgBuffer buffer(sizeof(UpgradeCompInfo));
+    size_t readLen = 0;
+    int32_t ret = pkgStream_->Read(buffer, index.headerOffset, buffer.length, readLen);
+    PKG_CHECK(ret == PKG_SUCCESS, return nullptr, "Fail to read component");
+    UpgradeFileEntry *entry = new UpgradeFileEntry(this, index.nodeId);
+    PKG_CHECK(entry != nullptr, return nullptr, "Fail create upgrade node for %s",
+        pkgStream_->GetFileName().c_str());
+    size_t decodeLen = 0;
+    PkgBuffer headerBuff(buffer.buffer, readLen);
+    ret = entry->DecodeHeader(headerBuff, index.headerOffset, index.dataOffset, decodeLen);
+    PKG_CHECK(ret == PKG_SUCCESS, delete entry; return nullptr, "Fail to decode header");
+
+    pkgEntryMapId_.insert(pair<uint32_t, PkgEntryPtr>(entry->GetNodeId(), entry));
+    pkgEntryMapFileName_.insert(std::pair<std::string, PkgEntryPtr>(entry->GetFileName(), entry));
+    return entry;
+}
+
 int32_t UpgradePkgFile::ReadUpgradePkgHeader(const PkgBuffer &buffer, size_t &realLen,
     DigestAlgorithm::DigestAlgorithmPtr &algorithm)
 {
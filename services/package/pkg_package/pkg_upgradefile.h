@@ -109,6 +109,11 @@ private:
     int32_t ReadComponents(const PkgBuffer &buffer, size_t &parsedLen,
         DigestAlgorithm::DigestAlgorithmPtr algorithm, std::vector<std::string> &fileNames);
 
+    int32_t IndexComponent(const PkgBuffer &buffer, size_t headerOffset, size_t &dataOffset,
+        size_t &decodeLen, std::vector<std::string> &fileNames);
+
+    PkgEntryPtr LoadPkgEntry(const PkgEntryIndex &index) override;
+
     int32_t ReadUpgradePkgHeader(const PkgBuffer &buffer, size_t &realLen,
         DigestAlgorithm::DigestAlgorithmPtr &algorithm);
 
@@ -37,6 +37,26 @@ constexpr uint32_t GPBDD_FLAG_MASK = 0x0008;
 constexpr uint32_t ZIP_PKG_ALIGNMENT_DEF = 1;
 constexpr int32_t DEF_MEM_LEVEL = 8;
 
+ZipPkgFile::~ZipPkgFile()
+{
+    if (entryBlock_.empty()) {
+        return;
+    }
+    // entries in entryBlock_ are released with the block, not by PkgFile
+    const ZipFileEntry *blockStart = entryBlock_.data();
+    const ZipFileEntry *blockEnd = blockStart + entryBlock_.size();
+    auto inBlock = [blockStart, blockEnd](PkgEntryPtr entry) {
+        const ZipFileEntry *zipEntry = static_cast<const ZipFileEntry *>(entry);
+        return zipEntry >= blockStart && zipEntry < blockEnd;
+    };
+    for (auto iter = pkgEntryMapId_.begin(); iter != pkgEntryMapId_.end();) {
+        iter = inBlock(iter->second) ? pkgEntryMapId_.erase(iter) : ++iter;
+    }
+    for (auto iter = pkgEntryMapFileName_.begin(); iter != pkgEntryMapFileName_.end();) {
+        iter = inBlock(iter->second) ? pkgEntryMapFileName_.erase(iter) : ++iter;
+    }
+}
+
 int32_t ZipPkgFile::AddEntry(const PkgManager::FileInfoPtr file, const PkgStreamPtr inStream)
 {
     PKG_CHECK(CheckState({PKG_FILE_STATE_IDLE, PKG_FILE_STATE_WORKING}, PKG_FILE_STATE_WORKING),
@@ -121,7 +141,7 @@ int32_t ZipPkgFile::LoadPackage(std::vector<std::string> &fileNames, const PkgBu
             sizeof(Zip64EndCentralDirLocator), readLen);
         uint32_t signature = ReadLE32(buffer.buffer + offsetof(Zip64EndCentralDirLocator, signature));
         if (ret != PKG_SUCCESS || signature != 0x07064b50) {
-            return ParseFileEntries(fileNames, endDir, currentPos, fileLen);
+            return ParseFileEntries(fileNames, endDir, currentPos, endDirPos);
         }
         currentPos = ReadLE64(buffer.buffer + offsetof(Zip64EndCentralDirLocator, endOfCentralDirectoryRecord));
         ret = pkgStream_->Read(buffer, currentPos, sizeof(Zip64EndCentralDirRecord), readLen);
@@ -130,7 +150,7 @@ int32_t ZipPkgFile::LoadPackage(std::vector<std::string> &fileNames, const PkgBu
             currentPos = ReadLE64(buffer.buffer + offsetof(Zip64EndCentralDirRecord, offset));
         }
     }
-    return ParseFileEntries(fileNames, endDir, currentPos, fileLen);
+    return ParseFileEntries(fileNames, endDir, currentPos, endDirPos);
 }
 
 int32_t ZipPkgFile::LoadPackage(std::vector<std::string>& fileNames, VerifyFunction verifier)
@@ -171,36 +191,117 @@ int32_t ZipPkgFile::LoadPackage(std::vector<std::string>& fileNames, VerifyFunct
     return LoadPackage(fileNames, buffer, endDirLen, endDirPos, readLen);
 }
 
+int32_t ZipPkgFile::ReadCentralDir(PkgBuffer &centralDir, size_t currentPos, size_t dirLen)
+{
+    // 内存映射的包直接引用映射区，避免再拷贝一次
+    PkgBuffer mapBuffer {};
+    if (pkgStream_->GetBuffer(mapBuffer) == PKG_SUCCESS && mapBuffer.buffer != nullptr &&
+        mapBuffer.length >= currentPos + dirLen) {
+        centralDir.buffer = mapBuffer.buffer + currentPos;
+        centralDir.length = dirLen;
+        return PKG_SUCCESS;
+    }
+
+    // 整个central directory一次读入
+    centralDir.data.resize(dirLen);
+    centralDir.buffer = centralDir.data.data();
+    centralDir.length = dirLen;
+    size_t readLen = 0;
+    int32_t ret = pkgStream_->Read(centralDir, currentPos, dirLen, readLen);
+    PKG_CHECK(ret == PKG_SUCCESS, return ret, "read central dir failed %s", pkgStream_->GetFileName().c_str());
+    PKG_CHECK(readLen == dirLen, return PKG_INVALID_PKG_FORMAT, "central dir not enough %zu %zu", readLen, dirLen);
+    return PKG_SUCCESS;
+}
+
 int32_t ZipPkgFile::ParseFileEntries(std::vector<std::string> &fileNames,
-    const EndCentralDir &endDir, size_t currentPos, size_t fileLen)
+    const EndCentralDir &endDir, size_t currentPos, size_t endDirPos)
 {
-    int32_t ret = PKG_SUCCESS;
-    int32_t buffLen = MAX_FILE_NAME + sizeof(LocalFileHeader) + sizeof(DataDescriptor)
-        + sizeof(CentralDirEntry) + BIG_SIZE_HEADER;
-    PkgBuffer buffer(buffLen);
+    if (endDir.totalEntries == 0) {
+        return PKG_SUCCESS;
+    }
+    // central directory 位于 EndCentralDir (以及zip64的记录) 之前
+    PKG_CHECK(endDirPos > currentPos, return PKG_INVALID_FILE, "too small to be zip");
+    size_t dirLen = endDirPos - currentPos;
+    PkgBuffer centralDir {};
+    int32_t ret = ReadCentralDir(centralDir, currentPos, dirLen);
+    PKG_CHECK(ret == PKG_SUCCESS, return ret, "Failed to read central dir");
+    if (lazyLoad_) {
+        return IndexFileEntries(fileNames, endDir, centralDir, currentPos);
+    }
 
+    int32_t buffLen = MAX_FILE_NAME + sizeof(LocalFileHeader) + sizeof(DataDescriptor) + BIG_SIZE_HEADER;
+    PkgBuffer localBuff(buffLen);
+    // reserve 之后 entry 地址不再变化，可以直接保存指针
+    entryBlock_.reserve(endDir.totalEntries);
+    fileNames.reserve(fileNames.size() + endDir.totalEntries);
+    size_t offset = 0;
     for (int32_t i = 0; i < endDir.totalEntries; i++) {
-        PKG_CHECK(fileLen > currentPos, return PKG_INVALID_FILE, "too small to be zip");
+        PKG_CHECK(dirLen > offset, return PKG_INVALID_FILE, "too small to be zip");
 
-        ZipFileEntry* entry = new ZipFileEntry(this, nodeId_++);
-        PKG_CHECK(entry != nullptr, return PKG_NONE_MEMORY, "Failed to create zip node for %s",
-            pkgStream_->GetFileName().c_str());
+        entryBlock_.emplace_back(this, nodeId_++);
+        ZipFileEntry *entry = &entryBlock_.back();
 
-        // 从文件中解析出文件头信息，保存在entry中
+        // 从内存中的central directory解析出文件头信息，保存在entry中
         size_t decodeLen = 0;
-        ret = entry->DecodeHeader(buffer, currentPos, 0, decodeLen);
-        PKG_CHECK(ret == PKG_SUCCESS, delete entry; return ret, "DecodeHeader failed");
+        PkgBuffer centralBuff(centralDir.buffer + offset, dirLen - offset);
+        ret = entry->DecodeHeaderFromCentralDir(centralBuff, localBuff, currentPos + offset, decodeLen);
+        PKG_CHECK(ret == PKG_SUCCESS, entryBlock_.pop_back(); return ret, "DecodeHeader failed");
 
         // 保存entry文件
-        pkgEntryMapId_.insert(std::pair<uint32_t, PkgEntryPtr>(entry->GetNodeId(), (PkgEntryPtr)entry));
-        pkgEntryMapFileName_.insert(std::pair<std::string, PkgEntryPtr>(entry->GetFileName(), (PkgEntryPtr)entry));
+        pkgEntryMapId_.emplace_hint(pkgEntryMapId_.end(), entry->GetNodeId(), entry);
+        pkgEntryMapFileName_.insert(std::pair<std::string, PkgEntryPtr>(entry->GetFileName(), entry));
         fileNames.push_back(entry->GetFileName());
 
-        currentPos += decodeLen;
+        offset += decodeLen;
     }
     return ret;
 }
 
+int32_t ZipPkgFile::IndexFileEntries(std::vector<std::string> &fileNames, const EndCentralDir &endDir,
+    const PkgBuffer &centralDir, size_t currentPos)
+{
+    entryIndex_.reserve(endDir.totalEntries);
+    fileNames.reserve(fileNames.size() + endDir.totalEntries);
+    size_t offset = 0;
+    for (int32_t i = 0; i < endDir.totalEntries; i++) {
+        PKG_CHECK(centralDir.length >= offset + sizeof(CentralDirEntry), return PKG_INVALID_FILE,
+            "too small to be zip");
+        uint8_t *entryData = centralDir.buffer + offset;
+        uint32_t signature = ReadLE32(entryData + offsetof(CentralDirEntry, signature));
+        PKG_CHECK(signature == CENTRAL_SIGNATURE, return PKG_INVALID_PKG_FORMAT,
+            "Check centralDir signature failed 0x%x", signature);
+        uint16_t nameSize = ReadLE16(entryData + offsetof(CentralDirEntry, nameSize));
+        uint16_t extraSize = ReadLE16(entryData + offsetof(CentralDirEntry, extraSize));
+        uint16_t commentSize = ReadLE16(entryData + offsetof(CentralDirEntry, commentSize));
+        size_t fileNameLength = (nameSize < MAX_FILE_NAME) ? nameSize : (MAX_FILE_NAME - 1);
+        PKG_CHECK(centralDir.length >= offset + sizeof(CentralDirEntry) + fileNameLength,
+            return PKG_INVALID_PKG_FORMAT, "data not not enough %zu", centralDir.length);
+
+        // 只记录名字hash和central dir位置，entry在第一次查找时才创建
+        fileNames.emplace_back(reinterpret_cast<char*>(entryData + sizeof(CentralDirEntry)), fileNameLength);
+        AddEntryIndex(fileNames.back(), currentPos + offset, 0);
+        offset += sizeof(CentralDirEntry) + nameSize + extraSize + commentSize;
+    }
+    SortEntryIndex();
+    return PKG_SUCCESS;
+}
+
+PkgEntryPtr ZipPkgFile::LoadPkgEntry(const PkgEntryIndex &index)
+{
+    ZipFileEntry *entry = new ZipFileEntry(this, index.nodeId);
+    PKG_CHECK(entry != nullptr, return nullptr, "Failed to create zip node for %s",
+        pkgStream_->GetFileName().c_str());
+    PkgBuffer buffer(MAX_FILE_NAME + sizeof(LocalFileHeader) + sizeof(DataDescriptor) +
+        sizeof(CentralDirEntry) + BIG_SIZE_HEADER);
+    size_t decodeLen = 0;
+    int32_t ret = entry->DecodeHeader(buffer, index.headerOffset, 0, decodeLen);
+    PKG_CHECK(ret == PKG_SUCCESS, delete entry; return nullptr, "DecodeHeader failed");
+
+    pkgEntryMapId_.insert(std::pair<uint32_t, PkgEntryPtr>(entry->GetNodeId(), entry));
+    pkgEntryMapFileName_.insert(std::pair<std::string, PkgEntryPtr>(entry->GetFileName(), entry));
+    return entry;
+}
+
 int32_t ZipFileEntry::EncodeHeader(PkgStreamPtr inStream, size_t startOffset, size_t &encodeLen)
 {
     // 对zip包，数据和数据头信息在连续位置，使用一个打包
@@ -404,6 +505,8 @@ int32_t ZipFileEntry::DecodeCentralDirEntry(PkgStreamPtr inStream, PkgBuffer &bu
     if (extraSize <= 0) {
         return PKG_SUCCESS;
     }
+    PKG_CHECK(readLen >= sizeof(CentralDirEntry) + nameSize + extraSize, return PKG_INVALID_PKG_FORMAT,
+        "extra data not enough %zu", readLen);
     uint8_t* extraData = buffer.buffer + nameSize + sizeof(CentralDirEntry);
     int16_t headerId = ReadLE16(extraData);
     if (headerId != 1) { // zip64 扩展
@@ -545,11 +648,20 @@ int32_t ZipFileEntry::DecodeHeader(const PkgBuffer &buff, size_t startOffset, si
     int32_t ret = inStream->Read(buff, startOffset, buff.length, readLen);
     PKG_CHECK(ret == PKG_SUCCESS, return ret, "parse entry read centralDir failed");
     PkgBuffer centralBuff(buff.buffer, readLen);
-    ret = DecodeCentralDirEntry(inStream, centralBuff, startOffset, decodeLen);
+    return DecodeHeaderFromCentralDir(centralBuff, buff, startOffset, decodeLen);
+}
+
+int32_t ZipFileEntry::DecodeHeaderFromCentralDir(PkgBuffer &centralBuff, const PkgBuffer &localBuff,
+    size_t currentPos, size_t &decodeLen)
+{
+    PkgStreamPtr inStream = pkgFile_->GetPkgStream();
+    PKG_CHECK(inStream != nullptr, return PKG_INVALID_PARAM,
+        "outStream or inStream null for %s", fileInfo_.fileInfo.identity.c_str());
+    int32_t ret = DecodeCentralDirEntry(inStream, centralBuff, currentPos, decodeLen);
     PKG_CHECK(ret == PKG_SUCCESS, return ret, "decode CentralDir failed");
 
     size_t headerLen = 0;
-    ret = DecodeLocalFileHeader(inStream, buff, fileInfo_.fileInfo.headerOffset, headerLen);
+    ret = DecodeLocalFileHeader(inStream, localBuff, fileInfo_.fileInfo.headerOffset, headerLen);
     PKG_CHECK(ret == PKG_SUCCESS, return ret, "decode LocalFileHeader failed");
     fileInfo_.fileInfo.packMethod = PKG_DIGEST_TYPE_CRC;
     fileInfo_.fileInfo.digestMethod = PKG_COMPRESS_METHOD_ZIP;
@@ -17,6 +17,7 @@
 #define ZIP_PKG_FILE_H
 
 #include <map>
+#include <vector>
 #include "pkg_pkgfile.h"
 #include "pkg_utils.h"
 
@@ -150,6 +151,11 @@ public:
 
     int32_t DecodeCentralDirEntry(PkgStreamPtr inStream, PkgBuffer &buffer, size_t currentPos,
         size_t &decodeLen);
+
+    // centralBuff holds the entry already read from the central directory,
+    // localBuff is only used as scratch space for reading the local file header
+    int32_t DecodeHeaderFromCentralDir(PkgBuffer &centralBuff, const PkgBuffer &localBuff, size_t currentPos,
+        size_t &decodeLen);
 protected:
     ZipFileInfo fileInfo_ {};
     uint32_t crc32_ {0};
@@ -173,7 +179,7 @@ public:
         pkgInfo_.signMethod = PKG_SIGN_METHOD_RSA;
         pkgInfo_.digestMethod = PKG_DIGEST_TYPE_SHA256;
     }
-    ~ZipPkgFile() override {}
+    ~ZipPkgFile() override;
 
     int32_t AddEntry(const PkgManager::FileInfoPtr file, const PkgStreamPtr inStream) override;
 
@@ -184,10 +190,16 @@ private:
     int32_t LoadPackage(std::vector<std::string> &fileNames, const PkgBuffer &buff,
         uint32_t endDirLen, size_t endDirPos, size_t &readLen);
     int32_t ParseFileEntries(std::vector<std::string> &fileNames, const EndCentralDir &endDir,
-        size_t currentPos, size_t fileLen);
+        size_t currentPos, size_t endDirPos);
+    int32_t ReadCentralDir(PkgBuffer &centralDir, size_t currentPos, size_t dirLen);
+    int32_t IndexFileEntries(std::vector<std::string> &fileNames, const EndCentralDir &endDir,
+        const PkgBuffer &centralDir, size_t currentPos);
+    PkgEntryPtr LoadPkgEntry(const PkgEntryIndex &index) override;
 private:
     PkgInfo pkgInfo_ {};
     size_t currentOffset_ = 0;
+    // entries decoded from the central directory, allocated in one block
+    std::vector<ZipFileEntry> entryBlock_ {};
 };
 } // namespace hpackage
 #endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "script_async.h"
+#include "script_context.h"
+#include "script_interpreter.h"
+#include "script_utils.h"
+
+using namespace uscript;
+
+namespace BasicInstruction {
+static int32_t PushOutput(UScriptContext &context, const ScriptValue &value)
+{
+    switch (value.GetValueType()) {
+        case UScriptValue::VALUE_TYPE_INTEGER:
+            return context.PushParam(value.GetInteger());
+        case UScriptValue::VALUE_TYPE_FLOAT:
+            return context.PushParam(value.GetFloat());
+        case UScriptValue::VALUE_TYPE_STRING:
+            return context.PushParam(value.GetString());
+        default:
+            break;
+    }
+    return USCRIPT_INVALID_PARAM;
+}
+
+// handle 保存在执行当前脚本的解释器中，不同脚本之间互不可见
+static ScriptInterpreter *GetInterpreter(UScriptContext &context)
+{
+    UScriptInstructionContext *instrContext = dynamic_cast<UScriptInstructionContext *>(&context);
+    return (instrContext != nullptr) ? instrContext->GetInterpreter() : nullptr;
+}
+
+int32_t ScriptAsync::Execute(UScriptEnv &env, UScriptContext &context)
+{
+    ScriptInterpreter *inter = GetInterpreter(context);
+    USCRIPT_CHECK(inter != nullptr, return USCRIPT_INVALID_PARAM, "Failed to get interpreter");
+
+    std::string instrName;
+    USCRIPT_CHECK(context.GetParamType(0) == UScriptContext::PARAM_TYPE_STRING,
+        return USCRIPT_INVALID_PARAM, "Invalid instruction name");
+    int32_t ret = context.GetParam(0, instrName);
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to get param");
+
+    // 参数在这里复制，调用者的上下文在指令执行完之前可能已经释放
+    std::shared_ptr<UScriptInstructionContext> instrContext = std::make_shared<UScriptInstructionContext>();
+    for (int32_t i = 1; i < context.GetParamCount(); i++) {
+        ret = instrContext->CopyInputParam(context, i);
+        USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to get param %d for %s", i, instrName.c_str());
+    }
+    int32_t handle = 0;
+    ret = inter->AsyncExecute(instrName, instrContext, handle);
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to execute %s", instrName.c_str());
+    return context.PushParam(handle);
+}
+
+int32_t ScriptWait::Execute(UScriptEnv &env, UScriptContext &context)
+{
+    ScriptInterpreter *inter = GetInterpreter(context);
+    USCRIPT_CHECK(inter != nullptr, return USCRIPT_INVALID_PARAM, "Failed to get interpreter");
+
+    int32_t handle = 0;
+    USCRIPT_CHECK(context.GetParamType(0) == UScriptContext::PARAM_TYPE_INTEGER,
+        return USCRIPT_INVALID_PARAM, "Invalid handle");
+    int32_t ret = context.GetParam(0, handle);
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to get param");
+
+    std::shared_ptr<UScriptInstructionContext> instrContext = nullptr;
+    ret = inter->WaitAsync(handle, instrContext);
+    USCRIPT_CHECK(instrContext != nullptr, return ret, "Invalid handle %d", handle);
+    context.AddProcessedBytes(instrContext->GetProcessedBytes());
+    for (auto &value : instrContext->GetOutVar()) {
+        PushOutput(context, value);
+    }
+    return ret;
+}
+} // namespace BasicInstruction
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef USCRIPT_ASYNC_H
+#define USCRIPT_ASYNC_H
+
+#include "script_instruction.h"
+
+namespace BasicInstruction {
+/**
+ * async(name, ...) 在线程池中执行指令 name，返回句柄
+ * wait(handle) 等待指令完成，返回值与直接调用该指令相同
+ */
+class ScriptAsync : public uscript::UScriptInstruction {
+public:
+    ScriptAsync() {}
+    virtual ~ScriptAsync() {}
+    int32_t Execute(uscript::UScriptEnv &env, uscript::UScriptContext &context) override;
+};
+
+class ScriptWait : public uscript::UScriptInstruction {
+public:
+    ScriptWait() {}
+    virtual ~ScriptWait() {}
+    int32_t Execute(uscript::UScriptEnv &env, uscript::UScriptContext &context) override;
+};
+} // namespace BasicInstruction
+#endif // USCRIPT_ASYNC_H
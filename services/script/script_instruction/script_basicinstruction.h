@@ -39,6 +39,10 @@ public:
     UScriptInstructionSleep() {}
     virtual ~UScriptInstructionSleep() {}
     int32_t Execute(uscript::UScriptEnv &env, uscript::UScriptContext &context) override;
+    bool IsAsyncSafe() const override
+    {
+        return true;
+    }
 };
 class UScriptInstructionStdout : public uscript::UScriptInstruction {
 public:
@@ -15,6 +15,7 @@
 #include "script_instructionhelper.h"
 #include <dlfcn.h>
 #include <set>
+#include "script_async.h"
 #include "script_basicinstruction.h"
 #include "script_loadscript.h"
 #include "script_manager_impl.h"
@@ -28,7 +29,7 @@ namespace uscript {
 static std::set<std::string> g_reservedInstructions = {
     "LoadScript", "RegisterCmd", "abort", "assert", "concat",
     "is_substring", "stdout", "sleep", "set_progress", "ui_print",
-    "show_progress"
+    "show_progress", "async", "wait"
     };
 
 static ScriptInstructionHelper* g_instructionHelper = nullptr;
@@ -73,6 +74,8 @@ int32_t ScriptInstructionHelper::RegisterInstructions() const
     scriptManager_->AddInstruction("set_progress", new UScriptInstructionSetProcess());
     scriptManager_->AddInstruction("show_progress", new UScriptInstructionShowProcess());
     scriptManager_->AddInstruction("ui_print", new UScriptInstructionUiPrint());
+    scriptManager_->AddInstruction("async", new ScriptAsync());
+    scriptManager_->AddInstruction("wait", new ScriptWait());
     return USCRIPT_SUCCESS;
 }
 
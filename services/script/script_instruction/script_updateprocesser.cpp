@@ -26,11 +26,7 @@ int32_t UScriptInstructionSetProcess::Execute(uscript::UScriptEnv &env, uscript:
     float setProcess = 0.0f;
     int32_t ret = context.GetParam(0, setProcess);
     USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to get param");
-    std::string content;
-    std::stringstream sstream;
-    sstream << setProcess;
-    sstream >> content;
-    env.PostMessage("set_progress", content);
+    env.PostProgress(setProcess);
     return USCRIPT_SUCCESS;
 }
 
@@ -50,13 +50,17 @@ public:
 
     virtual int LexerInput(char* buf, int maxSize);
 
-    void SetPkgStream(hpackage::PkgManager::StreamPtr pkgStream)
+    // 直接从内存中的脚本内容读取，buffer 需要在解析结束前保持有效
+    void SetBuffer(const uint8_t *buffer, size_t size)
     {
-        pkgStream_ = pkgStream;
+        buffer_ = buffer;
+        bufferSize_ = size;
+        currPos = 0;
     }
 
 private:
-    hpackage::PkgManager::StreamPtr pkgStream_ = nullptr;
+    const uint8_t *buffer_ = nullptr;
+    size_t bufferSize_ = 0;
     size_t currPos = 0;
     location loc {};
 };
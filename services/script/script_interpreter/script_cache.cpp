@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "script_cache.h"
+#include <openssl/sha.h>
+#include "script_function.h"
+#include "script_statement.h"
+#include "script_utils.h"
+
+using namespace std;
+
+namespace uscript {
+static std::mutex g_cacheMutex;
+static std::map<std::string, ParsedScriptPtr> g_scriptCache;
+// 按加入顺序保存摘要，用于淘汰
+static std::deque<std::string> g_cacheOrder;
+
+ParsedScript::~ParsedScript()
+{
+    delete statements_;
+    auto iter = functions_.begin();
+    while (iter != functions_.end()) {
+        auto entry = iter->second;
+        if (entry) {
+            delete entry;
+        }
+        iter = functions_.erase(iter);
+    }
+    functions_.clear();
+}
+
+void ParsedScript::AddStatement(UScriptStatement *statement)
+{
+    if (statements_ == nullptr) {
+        statements_ = UScriptStatementList::CreateInstance(statement);
+    } else {
+        statements_->AddScriptStatement(statement);
+    }
+}
+
+int32_t ParsedScript::AddFunction(ScriptFunction *function)
+{
+    if (functions_.find(function->GetFunctionName()) != functions_.end()) {
+        USCRIPT_LOGI("Fail to add function %s, function exist", function->GetFunctionName().c_str());
+        return USCRIPT_SUCCESS;
+    }
+    functions_[function->GetFunctionName()] = function;
+    return USCRIPT_SUCCESS;
+}
+
+ScriptFunction* ParsedScript::FindFunction(const std::string &name) const
+{
+    auto iter = functions_.find(name);
+    if (iter != functions_.end()) {
+        return iter->second;
+    }
+    return nullptr;
+}
+
+const ScriptProgram *ParsedScript::GetProgram()
+{
+    // 多个线程同时执行同一脚本时只编译一次
+    std::call_once(compileFlag_, [this] {
+        std::unique_ptr<ScriptProgram> program = std::make_unique<ScriptProgram>();
+        if (ScriptCompiler::Compile(statements_, functions_, *program) == USCRIPT_SUCCESS) {
+            program_ = std::move(program);
+        }
+    });
+    return program_.get();
+}
+
+std::string ScriptCache::GetDigest(const uint8_t *data, size_t size)
+{
+    uint8_t digest[SHA256_DIGEST_LENGTH] = {0};
+    SHA256(data, size, digest);
+    return std::string(reinterpret_cast<char*>(digest), sizeof(digest));
+}
+
+ParsedScriptPtr ScriptCache::Find(const std::string &digest)
+{
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+    auto iter = g_scriptCache.find(digest);
+    if (iter != g_scriptCache.end()) {
+        return iter->second;
+    }
+    return nullptr;
+}
+
+void ScriptCache::Add(const std::string &digest, ParsedScriptPtr script)
+{
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+    if (!g_scriptCache.emplace(digest, script).second) {
+        return;
+    }
+    g_cacheOrder.push_back(digest);
+    if (g_cacheOrder.size() > MAX_SCRIPTS) {
+        g_scriptCache.erase(g_cacheOrder.front());
+        g_cacheOrder.pop_front();
+    }
+}
+
+void ScriptCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+    g_scriptCache.clear();
+    g_cacheOrder.clear();
+}
+
+size_t ScriptCache::GetSize()
+{
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+    return g_scriptCache.size();
+}
+} // namespace uscript
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef USCRIPT_CACHE_H
+#define USCRIPT_CACHE_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "script_compiler.h"
+
+namespace uscript {
+class ScriptFunction;
+class UScriptStatement;
+class UScriptStatementList;
+
+/**
+ * 解析后的脚本。语法树和字节码在执行时只读，可以在多个解释器之间共享。
+ */
+class ParsedScript {
+public:
+    ParsedScript() {}
+    ~ParsedScript();
+
+    void AddStatement(UScriptStatement *statement);
+    int32_t AddFunction(ScriptFunction *function);
+    ScriptFunction* FindFunction(const std::string &name) const;
+
+    UScriptStatementList *GetStatements() const
+    {
+        return statements_;
+    }
+
+    // 第一次调用时编译成字节码，编译失败返回 nullptr
+    const ScriptProgram *GetProgram();
+
+private:
+    UScriptStatementList *statements_ = nullptr;
+    std::map<std::string, ScriptFunction*> functions_ {};
+    std::once_flag compileFlag_ {};
+    std::unique_ptr<ScriptProgram> program_ {};
+};
+
+using ParsedScriptPtr = std::shared_ptr<ParsedScript>;
+
+/**
+ * 按脚本内容的摘要缓存解析结果，进程内重复执行同一脚本时不再重新解析
+ * 最多缓存 MAX_SCRIPTS 个脚本，超出时淘汰最早加入的，ScriptManager 释放时清空
+ */
+class ScriptCache {
+public:
+    static constexpr size_t MAX_SCRIPTS = 32;
+
+    static std::string GetDigest(const uint8_t *data, size_t size);
+    static ParsedScriptPtr Find(const std::string &digest);
+    static void Add(const std::string &digest, ParsedScriptPtr script);
+    static void Clear();
+    static size_t GetSize();
+};
+} // namespace uscript
+#endif // USCRIPT_CACHE_H
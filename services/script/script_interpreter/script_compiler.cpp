@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "script_compiler.h"
+#include "script_function.h"
+#include "script_statement.h"
+#include "script_utils.h"
+
+using namespace std;
+
+namespace uscript {
+int32_t ScriptCompiler::Compile(UScriptStatementList *statements,
+    const std::map<std::string, ScriptFunction*> &functions, ScriptProgram &program)
+{
+    ScriptCompiler compiler(program, functions);
+    int32_t index = 0;
+    for (auto &function : functions) {
+        compiler.functionIndex_[function.first] = index++;
+    }
+
+    compiler.BeginMain();
+    int32_t ret = compiler.CompileStatements(statements);
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile statements");
+    compiler.Emit(OPCODE_RETURN_LAST);
+
+    for (auto &function : functions) {
+        USCRIPT_CHECK(function.second != nullptr, return USCRIPT_INVALID_SCRIPT, "Invalid function %s",
+            function.first.c_str());
+        ret = function.second->Compile(compiler);
+        USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile function %s", function.first.c_str());
+        compiler.Emit(OPCODE_RETURN_LAST);
+    }
+    compiler.ResolveVariables();
+    USCRIPT_LOGI("Compile script finish code: %zu constants: %zu variables: %zu functions: %zu",
+        program.code.size(), program.constants.size(), program.variables.size(), program.functions.size());
+    return USCRIPT_SUCCESS;
+}
+
+size_t ScriptCompiler::Emit(ScriptOpCode op, int32_t operand)
+{
+    program_.code.push_back({op, operand});
+    return program_.code.size() - 1;
+}
+
+void ScriptCompiler::EmitConstant(ScriptValue value)
+{
+    program_.constants.push_back(std::move(value));
+    Emit(OPCODE_CONST, static_cast<int32_t>(program_.constants.size() - 1));
+}
+
+void ScriptCompiler::PatchJump(size_t pc)
+{
+    program_.code[pc].operand = static_cast<int32_t>(program_.code.size());
+}
+
+ScriptCompiler::Mark ScriptCompiler::GetMark() const
+{
+    return { program_.code.size(), program_.constants.size() };
+}
+
+bool ScriptCompiler::GetConstant(const Mark &mark, ScriptValue &value) const
+{
+    if (program_.code.size() != mark.code + 1 || program_.code[mark.code].op != OPCODE_CONST) {
+        return false;
+    }
+    value = program_.constants[program_.code[mark.code].operand];
+    return true;
+}
+
+void ScriptCompiler::Rewind(const Mark &mark)
+{
+    program_.code.resize(mark.code);
+    program_.constants.resize(mark.constants);
+}
+
+int32_t ScriptCompiler::AddScope(int32_t parent)
+{
+    program_.scopes.push_back(ScriptScope());
+    scopeParents_.push_back(parent);
+    scopeSlots_.push_back(std::map<std::string, int32_t>());
+    return static_cast<int32_t>(program_.scopes.size() - 1);
+}
+
+int32_t ScriptCompiler::DeclareVariable(const std::string &name)
+{
+    std::map<std::string, int32_t> &slots = scopeSlots_[currentScope_];
+    auto iter = slots.find(name);
+    if (iter != slots.end()) {
+        return iter->second;
+    }
+    std::vector<std::string> &names = program_.scopes[currentScope_].names;
+    names.push_back(name);
+    int32_t slot = static_cast<int32_t>(names.size() - 1);
+    slots[name] = slot;
+    return slot;
+}
+
+int32_t ScriptCompiler::AddVariable(const std::string &name)
+{
+    auto key = std::make_pair(currentScope_, name);
+    auto iter = variableIndex_.find(key);
+    if (iter != variableIndex_.end()) {
+        return iter->second;
+    }
+    ScriptVariable variable;
+    variable.name = name;
+    program_.variables.push_back(variable);
+    variableScopes_.push_back(currentScope_);
+    int32_t index = static_cast<int32_t>(program_.variables.size() - 1);
+    variableIndex_[key] = index;
+    return index;
+}
+
+void ScriptCompiler::ResolveVariables()
+{
+    // 作用域内的变量可能在访问之后才定义（例如循环中），所以在全部编译完成后再计算槽位
+    for (size_t i = 0; i < program_.variables.size(); i++) {
+        ScriptVariable &variable = program_.variables[i];
+        int32_t depth = 0;
+        int32_t scope = variableScopes_[i];
+        int32_t frame = scope;
+        for (; scope >= 0; scope = scopeParents_[scope], depth++) {
+            auto iter = scopeSlots_[scope].find(variable.name);
+            if (iter != scopeSlots_[scope].end()) {
+                variable.slots.push_back({ depth, iter->second });
+            }
+            frame = scope;
+        }
+        // 函数内可以访问调用者的变量，main 的上下文是最外层
+        variable.callerDepth = (frame == 0) ? -1 : depth;
+    }
+}
+
+int32_t ScriptCompiler::AddAssignTarget(const std::vector<std::string> &identifiers)
+{
+    ScriptAssignTarget target;
+    target.variable = AddVariable(identifiers[0]);
+    for (auto &identifier : identifiers) {
+        target.slots.push_back(DeclareVariable(identifier));
+    }
+    program_.assignTargets.push_back(target);
+    return static_cast<int32_t>(program_.assignTargets.size() - 1);
+}
+
+int32_t ScriptCompiler::AddCallSite(const std::string &name, bool hasParams, int32_t line)
+{
+    ScriptCallSite site;
+    site.name = name;
+    site.hasParams = hasParams;
+    site.line = line;
+    auto iter = functionIndex_.find(name);
+    if (iter != functionIndex_.end()) {
+        site.function = iter->second;
+    }
+    program_.callSites.push_back(site);
+    return static_cast<int32_t>(program_.callSites.size() - 1);
+}
+
+void ScriptCompiler::EndCallSite(int32_t site)
+{
+    program_.callSites[site].end = program_.code.size();
+}
+
+void ScriptCompiler::BeginFunction(const std::string &name, const std::vector<std::string> &params, bool hasParams)
+{
+    ScriptFunctionCode function;
+    function.name = name;
+    function.hasParams = hasParams;
+    function.entry = program_.code.size();
+    loops_.clear();
+    scopeDepth_ = 0;
+    currentScope_ = AddScope(-1);
+    function.scope = currentScope_;
+    for (auto &param : params) {
+        function.paramSlots.push_back(DeclareVariable(param));
+    }
+    program_.functions.push_back(function);
+}
+
+void ScriptCompiler::BeginMain()
+{
+    // main 使用第一个作用域
+    currentScope_ = AddScope(-1);
+}
+
+int32_t ScriptCompiler::CompileStatements(UScriptStatementList *statements)
+{
+    if (statements == nullptr) {
+        return USCRIPT_SUCCESS;
+    }
+    return statements->Compile(*this);
+}
+
+void ScriptCompiler::PushScope()
+{
+    currentScope_ = AddScope(currentScope_);
+    Emit(OPCODE_PUSH_SCOPE, currentScope_);
+    scopeDepth_++;
+}
+
+void ScriptCompiler::PopScope()
+{
+    Emit(OPCODE_POP_SCOPE, 1);
+    currentScope_ = scopeParents_[currentScope_];
+    scopeDepth_--;
+}
+
+void ScriptCompiler::BeginLoop()
+{
+    LoopInfo loop;
+    loop.scopeDepth = scopeDepth_;
+    loops_.push_back(loop);
+}
+
+void ScriptCompiler::SetContinueTarget()
+{
+    LoopInfo &loop = loops_.back();
+    loop.continueTarget = static_cast<int32_t>(program_.code.size());
+    for (auto pc : loop.continues) {
+        PatchJump(pc);
+    }
+    loop.continues.clear();
+}
+
+void ScriptCompiler::EndLoop()
+{
+    for (auto pc : loops_.back().breaks) {
+        PatchJump(pc);
+    }
+    loops_.pop_back();
+}
+
+void ScriptCompiler::EmitLeaveScopes(int32_t scopeDepth)
+{
+    if (scopeDepth_ > scopeDepth) {
+        Emit(OPCODE_POP_SCOPE, scopeDepth_ - scopeDepth);
+    }
+}
+
+int32_t ScriptCompiler::EmitBreak()
+{
+    // 循环外的 break 在语法树执行时会结束整个语句列表，这里不支持
+    USCRIPT_CHECK(!loops_.empty(), return USCRIPT_INVALID_STATEMENT, "Break outside loop");
+    EmitLeaveScopes(loops_.back().scopeDepth);
+    loops_.back().breaks.push_back(Emit(OPCODE_JUMP));
+    return USCRIPT_SUCCESS;
+}
+
+int32_t ScriptCompiler::EmitContinue()
+{
+    USCRIPT_CHECK(!loops_.empty(), return USCRIPT_INVALID_STATEMENT, "Continue outside loop");
+    LoopInfo &loop = loops_.back();
+    EmitLeaveScopes(loop.scopeDepth);
+    size_t pc = Emit(OPCODE_JUMP, loop.continueTarget);
+    if (loop.continueTarget < 0) {
+        loop.continues.push_back(pc);
+    }
+    return USCRIPT_SUCCESS;
+}
+} // namespace uscript
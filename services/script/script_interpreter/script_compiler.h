@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef USCRIPT_COMPILER_H
+#define USCRIPT_COMPILER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "script_context.h"
+
+namespace uscript {
+class ScriptFunction;
+class UScriptStatementList;
+
+/**
+ * 字节码指令，基于操作数栈执行
+ */
+enum ScriptOpCode : uint8_t {
+    OPCODE_CONST,        // 压入常量池中的值，operand 为常量下标
+    OPCODE_LOAD,         // 查找变量并压栈，operand 为变量下标
+    OPCODE_ASSIGN,       // 弹出值并赋给变量，结果重新压栈，operand 为赋值目标下标
+    OPCODE_BINARY,       // 弹出左右操作数计算，operand 为 ExpressionAction
+    OPCODE_OR_JUMP,      // 栈顶为真时替换为 1 并跳转，实现 || 短路
+    OPCODE_JUMP,         // 无条件跳转
+    OPCODE_JUMP_FALSE,   // 弹出条件，为假时跳转
+    OPCODE_POP,          // 丢弃栈顶
+    OPCODE_STMT,         // 表达式语句结束，弹出结果并检查错误
+    OPCODE_CLEAR,        // 清空最近一条语句的结果
+    OPCODE_PUSH_SCOPE,   // 新建局部上下文，operand 为作用域下标
+    OPCODE_POP_SCOPE,    // 退出 operand 层局部上下文
+    OPCODE_CALL,         // 开始调用，operand 为调用点下标
+    OPCODE_ARG,          // 弹出一个实参绑定到当前调用
+    OPCODE_INVOKE,       // 执行当前调用，结果压栈
+    OPCODE_MAKE_LIST,    // 弹出 operand 个值组成返回值列表
+    OPCODE_RETURN,       // 函数返回，operand 非 0 时弹出返回值
+    OPCODE_RETURN_LAST,  // 函数结束，返回最近一条语句的结果
+};
+
+struct ScriptByteCode {
+    ScriptOpCode op;
+    int32_t operand;
+};
+
+struct ScriptCallSite {
+    std::string name;
+    int32_t function = -1; // 脚本函数下标，-1 表示不是脚本函数
+    bool hasParams = false;
+    size_t end = 0; // 调用结束后的下一条指令
+    int32_t line = 0;
+};
+
+struct ScriptFunctionCode {
+    std::string name;
+    std::vector<int32_t> paramSlots;
+    bool hasParams = false;
+    int32_t scope = 0;
+    size_t entry = 0;
+};
+
+// 作用域对应执行时的一层上下文，names 按槽位保存在该层定义的变量名
+struct ScriptScope {
+    std::vector<std::string> names;
+};
+
+// 变量在上下文栈中的位置，depth 为距离当前上下文的层数
+struct ScriptSlot {
+    int32_t depth;
+    int32_t slot;
+};
+
+struct ScriptVariable {
+    std::string name;
+    std::vector<ScriptSlot> slots {}; // 由内到外可能定义该变量的槽位
+    // 函数内的变量在本函数中找不到时，从该层开始按名字查找调用者的上下文，-1 表示不查找
+    int32_t callerDepth = -1;
+};
+
+struct ScriptAssignTarget {
+    int32_t variable; // 第一个变量，用来判断是更新还是定义
+    std::vector<int32_t> slots; // 定义时每个变量在当前上下文中的槽位
+};
+
+struct ScriptProgram {
+    std::vector<ScriptByteCode> code;
+    std::vector<ScriptValue> constants;
+    std::vector<ScriptScope> scopes;
+    std::vector<ScriptVariable> variables;
+    std::vector<ScriptAssignTarget> assignTargets;
+    std::vector<ScriptCallSite> callSites;
+    std::vector<ScriptFunctionCode> functions;
+};
+
+/**
+ * 将语法树编译成字节码，语法树节点通过 Compile 接口调用这里的方法生成指令。
+ * 遇到不支持的语法时编译失败，由解释器回退到语法树执行。
+ * 变量在编译时分配槽位，全部编译完成后再确定每次访问可能用到的 (depth, slot)。
+ */
+class ScriptCompiler {
+public:
+    struct Mark {
+        size_t code;
+        size_t constants;
+    };
+
+    static int32_t Compile(UScriptStatementList *statements,
+        const std::map<std::string, ScriptFunction*> &functions, ScriptProgram &program);
+
+    size_t Emit(ScriptOpCode op, int32_t operand = 0);
+    void EmitConstant(ScriptValue value);
+    // 将 pc 处跳转指令的目标设置为当前位置
+    void PatchJump(size_t pc);
+
+    size_t GetCodeSize() const
+    {
+        return program_.code.size();
+    }
+    Mark GetMark() const;
+    // mark 之后只生成了一条常量指令时返回 true 并复制该常量
+    bool GetConstant(const Mark &mark, ScriptValue &value) const;
+    void Rewind(const Mark &mark);
+
+    int32_t AddVariable(const std::string &name);
+    int32_t AddAssignTarget(const std::vector<std::string> &identifiers);
+    int32_t AddCallSite(const std::string &name, bool hasParams, int32_t line);
+    void EndCallSite(int32_t site);
+    void BeginFunction(const std::string &name, const std::vector<std::string> &params, bool hasParams);
+    void BeginMain();
+
+    int32_t CompileStatements(UScriptStatementList *statements);
+
+    void PushScope();
+    void PopScope();
+
+    void BeginLoop();
+    void SetContinueTarget();
+    void EndLoop();
+    int32_t EmitBreak();
+    int32_t EmitContinue();
+
+private:
+    struct LoopInfo {
+        int32_t scopeDepth = 0;
+        int32_t continueTarget = -1;
+        std::vector<size_t> breaks {};
+        std::vector<size_t> continues {};
+    };
+
+    ScriptCompiler(ScriptProgram &program, const std::map<std::string, ScriptFunction*> &functions)
+        : program_(program), functions_(functions) {}
+    void EmitLeaveScopes(int32_t scopeDepth);
+    int32_t AddScope(int32_t parent);
+    // 在当前作用域中定义变量，返回槽位
+    int32_t DeclareVariable(const std::string &name);
+    void ResolveVariables();
+
+    ScriptProgram &program_;
+    const std::map<std::string, ScriptFunction*> &functions_;
+    std::map<std::string, int32_t> functionIndex_ {};
+    std::vector<LoopInfo> loops_ {};
+    int32_t scopeDepth_ = 0;
+    int32_t currentScope_ = -1;
+    std::vector<int32_t> scopeParents_ {};
+    std::vector<std::map<std::string, int32_t>> scopeSlots_ {};
+    // 每个变量访问所在的作用域，ResolveVariables 时使用
+    std::vector<int32_t> variableScopes_ {};
+    std::map<std::pair<int32_t, std::string>, int32_t> variableIndex_ {};
+};
+} // namespace uscript
+#endif // USCRIPT_COMPILER_H
@@ -13,12 +13,12 @@
  * limitations under the License.
  */
 #include "script_context.h"
-#include <iostream>
-#include <typeinfo>
+#include <algorithm>
 #include <cmath>
 #include "script_expression.h"
 #include "script_interpreter.h"
 #include "script_utils.h"
+#include "securec.h"
 
 using namespace std;
 
@@ -27,25 +27,19 @@ static uint32_t g_contextId = 0;
 
 int32_t UScriptInstructionContext::PushParam(int32_t value)
 {
-    UScriptValuePtr valuePtr = std::make_shared<IntegerValue>(value);
-    USCRIPT_CHECK(valuePtr != nullptr, return USCRIPT_ERROR_CREATE_OBJ, "Failed to create value");
-    outParam_.push_back(valuePtr);
+    outParam_.emplace_back(value);
     return USCRIPT_SUCCESS;
 }
 
 int32_t UScriptInstructionContext::PushParam(float value)
 {
-    UScriptValuePtr valuePtr = std::make_shared<FloatValue>(value);
-    USCRIPT_CHECK(valuePtr != nullptr, return USCRIPT_ERROR_CREATE_OBJ, "Failed to create value");
-    outParam_.push_back(valuePtr);
+    outParam_.emplace_back(value);
     return USCRIPT_SUCCESS;
 }
 
 int32_t UScriptInstructionContext::PushParam(const std::string& value)
 {
-    UScriptValuePtr valuePtr = std::make_shared<StringValue>(value);
-    USCRIPT_CHECK(valuePtr != nullptr, return USCRIPT_ERROR_CREATE_OBJ, "Failed to create value");
-    outParam_.push_back(valuePtr);
+    outParam_.emplace_back(value);
     return USCRIPT_SUCCESS;
 }
 
@@ -56,27 +50,37 @@ int32_t UScriptInstructionContext::GetParamCount()
 
 int32_t UScriptInstructionContext::GetParam(int32_t index, int &value)
 {
-    return GetParam<int32_t, IntegerValue>(index, value);
+    int32_t ret = CheckParam(index, UScriptValue::VALUE_TYPE_INTEGER);
+    if (ret == USCRIPT_SUCCESS) {
+        value = innerParam_[index].GetInteger();
+    }
+    return ret;
 }
 
 int32_t UScriptInstructionContext::GetParam(int32_t index, float &value)
 {
-    return GetParam<float, FloatValue>(index, value);
+    int32_t ret = CheckParam(index, UScriptValue::VALUE_TYPE_FLOAT);
+    if (ret == USCRIPT_SUCCESS) {
+        value = innerParam_[index].GetFloat();
+    }
+    return ret;
 }
 
 int32_t UScriptInstructionContext::GetParam(int32_t index, std::string &value)
 {
-    return GetParam<std::string, StringValue>(index, value);
+    int32_t ret = CheckParam(index, UScriptValue::VALUE_TYPE_STRING);
+    if (ret == USCRIPT_SUCCESS) {
+        value = innerParam_[index].GetString();
+    }
+    return ret;
 }
 
-template<class T, class TWapper>
-int32_t UScriptInstructionContext::GetParam(int32_t index, T &value)
+int32_t UScriptInstructionContext::CheckParam(int32_t index, UScriptValue::UScriptValueType type) const
 {
     USCRIPT_CHECK(static_cast<size_t>(index) < this->innerParam_.size(),
         return UScriptContext::PARAM_TYPE_INVALID, "Invalid index %d", index);
-    TWapper* inter = (TWapper*)(innerParam_[index].get());
-    USCRIPT_CHECK(inter != nullptr, return USCRIPT_INVALID_PARAM, "Invalid index %d", index);
-    value = inter->GetValue();
+    USCRIPT_CHECK(innerParam_[index].GetValueType() == type, return USCRIPT_INVALID_PARAM,
+        "Invalid type %d for index %d", innerParam_[index].GetValueType(), index);
     return USCRIPT_SUCCESS;
 }
 
@@ -84,23 +88,70 @@ UScriptContext::ParamType UScriptInstructionContext::GetParamType(int32_t index)
 {
     USCRIPT_CHECK(static_cast<size_t>(index) < this->innerParam_.size(),
         return UScriptContext::PARAM_TYPE_INVALID, "Invalid index %d", index);
-    UScriptValue::UScriptValueType type = innerParam_[index]->GetValueType();
+    UScriptValue::UScriptValueType type = innerParam_[index].GetValueType();
     return (UScriptContext::ParamType)type;
 }
 
 int32_t UScriptInstructionContext::AddInputParam(UScriptValuePtr value)
 {
-    innerParam_.push_back(value);
+    innerParam_.push_back(ScriptValue::FromPtr(value));
+    return USCRIPT_SUCCESS;
+}
+
+int32_t UScriptInstructionContext::AddInputParam(ScriptValue value)
+{
+    innerParam_.push_back(std::move(value));
     return USCRIPT_SUCCESS;
 }
 
+int32_t UScriptInstructionContext::CopyInputParam(UScriptContext &context, int32_t index)
+{
+    int32_t ret = USCRIPT_INVALID_PARAM;
+    switch (context.GetParamType(index)) {
+        case UScriptContext::PARAM_TYPE_INTEGER: {
+            int32_t value = 0;
+            ret = context.GetParam(index, value);
+            innerParam_.push_back(ScriptValue(value));
+            break;
+        }
+        case UScriptContext::PARAM_TYPE_FLOAT: {
+            float value = 0;
+            ret = context.GetParam(index, value);
+            innerParam_.push_back(ScriptValue(value));
+            break;
+        }
+        case UScriptContext::PARAM_TYPE_STRING: {
+            std::string value;
+            ret = context.GetParam(index, value);
+            innerParam_.push_back(ScriptValue(std::move(value)));
+            break;
+        }
+        default:
+            break;
+    }
+    return ret;
+}
+
 UScriptValuePtr UScriptInterpretContext::FindVariable(const ScriptInterpreter &inter, std::string id)
 {
     INTERPRETER_LOGI(inter, this, "FindVariable varName:%s ", id.c_str());
-    if (localVariables_.find(id) != localVariables_.end()) {
-        return localVariables_[id];
+    int32_t slot = FindSlot(id);
+    if (slot < 0 || variables_[slot].IsNull()) {
+        return nullptr;
     }
-    return nullptr;
+    if (ptrCache_[slot] == nullptr) {
+        ptrCache_[slot] = variables_[slot].ToPtr();
+    }
+    return ptrCache_[slot];
+}
+
+const ScriptValue *UScriptInterpretContext::GetVariable(const std::string &id) const
+{
+    int32_t slot = FindSlot(id);
+    if (slot < 0 || variables_[slot].IsNull()) {
+        return nullptr;
+    }
+    return &variables_[slot];
 }
 
 UScriptInterpretContext::UScriptInterpretContext(bool top) : top_(top)
@@ -108,12 +159,48 @@ UScriptInterpretContext::UScriptInterpretContext(bool top) : top_(top)
     contextId_ = ++g_contextId;
 }
 
+UScriptInterpretContext::UScriptInterpretContext(bool top, const std::vector<std::string> &names)
+    : top_(top), slotNames_(&names), variables_(names.size()), ptrCache_(names.size())
+{
+    contextId_ = ++g_contextId;
+}
+
+int32_t UScriptInterpretContext::FindSlot(const std::string &id) const
+{
+    // 每层上下文的变量很少，顺序查找即可
+    const std::vector<std::string> &names = (slotNames_ != nullptr) ? *slotNames_ : names_;
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == id) {
+            return static_cast<int32_t>(i);
+        }
+    }
+    return -1;
+}
+
 void UScriptInterpretContext::UpdateVariable(const ScriptInterpreter &inter, std::string id,
     UScriptValuePtr value)
 {
-    INTERPRETER_LOGI(inter, this, " Update varName:%s value: %s", id.c_str(),
-        UScriptValue::ScriptToString(value).c_str());
-    localVariables_[id] = value;
+    UpdateVariable(inter, id, ScriptValue::FromPtr(value));
+    // 语法树中的值不会被修改，直接作为缓存，下次读取时不再转换
+    int32_t slot = FindSlot(id);
+    if (slot >= 0) {
+        ptrCache_[slot] = value;
+    }
+}
+
+void UScriptInterpretContext::UpdateVariable(const ScriptInterpreter &inter, const std::string &id,
+    ScriptValue value)
+{
+    INTERPRETER_LOGI(inter, this, " Update varName:%s value: %s", id.c_str(), value.ScriptToString().c_str());
+    int32_t slot = FindSlot(id);
+    if (slot >= 0) {
+        SetSlot(static_cast<size_t>(slot), std::move(value));
+        return;
+    }
+    INTERPRETER_CHECK(inter, this, slotNames_ == nullptr, return, "No slot for variable %s", id.c_str());
+    names_.push_back(id);
+    variables_.push_back(std::move(value));
+    ptrCache_.push_back(nullptr);
 }
 
 void UScriptInterpretContext::UpdateVariables(const ScriptInterpreter &inter,
@@ -136,291 +223,313 @@ void UScriptInterpretContext::UpdateVariables(const ScriptInterpreter &inter,
     }
 }
 
-UScriptValuePtr UScriptValue::Computer(int32_t action, UScriptValuePtr rightValue)
+ScriptValue::ScriptValue(std::string value) : type_(UScriptValue::VALUE_TYPE_STRING), shortString_()
 {
-    return std::make_shared<ErrorValue>(USCRIPT_ERROR_INTERPRET);
+    if (value.size() <= SHORT_STRING_SIZE) {
+        if (!value.empty()) {
+            (void)memcpy_s(shortString_.data, sizeof(shortString_.data), value.data(), value.size());
+        }
+        shortString_.size = static_cast<uint8_t>(value.size());
+    } else {
+        heap_ = std::make_shared<const std::string>(std::move(value));
+    }
 }
 
-#define INTEGER_MATH_COMPUTER(op, rightValue)                                     \
-    do {                                                                          \
-        if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_INTEGER) {      \
-            IntegerValue* value = (IntegerValue*)(rightValue.get());  \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");   \
-            return make_shared<IntegerValue>(GetValue() op value->GetValue());    \
-        } else if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_FLOAT) { \
-            FloatValue* value = (FloatValue*)(rightValue.get());      \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");   \
-            return make_shared<FloatValue>(GetValue() op value->GetValue());      \
-        }                                                                         \
-    } while (0)
-
-#define INTEGER_LOGIC_COMPUTER(op, rightValue)                                    \
-    do {                                                                          \
-        if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_INTEGER) {      \
-            IntegerValue* value = (IntegerValue*)(rightValue.get());  \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");   \
-            return make_shared<IntegerValue>(GetValue() op value->GetValue());    \
-        } else if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_FLOAT) { \
-            FloatValue* value = (FloatValue*)(rightValue.get());      \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");   \
-            return make_shared<IntegerValue>(GetValue() op value->GetValue());    \
-        }                                                                         \
-    } while (0)
-
-#define INTEGER_MATH_COMPUTER_DIV(rightValue)                                       \
-    do {                                                                            \
-        if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_INTEGER) {       \
-            IntegerValue* value = (IntegerValue*)(rightValue.get());                \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");     \
-            if (value->GetValue() == 0) {                                           \
-                return defReturn;                                                   \
-            }                                                                       \
-            return make_shared<IntegerValue>(this->GetValue() / value->GetValue()); \
-        } else if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_FLOAT) {  \
-            FloatValue* value = (FloatValue*)(rightValue.get());                    \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");     \
-            if (value->GetValue() == 0) {                                           \
-                return defReturn;                                                   \
-            }                                                                       \
-            return make_shared<FloatValue>(this->GetValue() / value->GetValue());   \
-        }                                                                           \
-    } while (0)
+ScriptValue::ScriptValue(std::vector<ScriptValue> values) : type_(UScriptValue::VALUE_TYPE_LIST), intValue_(0),
+    heap_(std::make_shared<const std::vector<ScriptValue>>(std::move(values)))
+{
+}
 
-UScriptValuePtr IntegerValue::Computer(int32_t action, UScriptValuePtr value)
+bool ScriptValue::IsTrue() const
 {
-    UScriptValuePtr rightValue = UScriptValue::GetRightCompluteValue(value);
-    UScriptValuePtr defReturn = std::make_shared<ErrorValue>(USCRIPT_ERROR_INTERPRET);
-    USCRIPT_CHECK(rightValue != nullptr, return defReturn, "Check param error");
-    switch (action) {
-        case UScriptExpression::ADD_OPERATOR: {
-            INTEGER_MATH_COMPUTER(+, rightValue);
-            break;
-        }
-        case UScriptExpression::SUB_OPERATOR: {
-            INTEGER_MATH_COMPUTER(-, rightValue);
-            break;
-        }
-        case UScriptExpression::MUL_OPERATOR: {
-            INTEGER_MATH_COMPUTER(*, rightValue);
-            break;
-        }
-        case UScriptExpression::DIV_OPERATOR: {
-            INTEGER_MATH_COMPUTER_DIV(rightValue);
+    switch (type_) {
+        case UScriptValue::VALUE_TYPE_INTEGER:
+            return intValue_ != 0;
+        case UScriptValue::VALUE_TYPE_FLOAT:
+            return floatValue_ != 0;
+        case UScriptValue::VALUE_TYPE_STRING:
+            return StringSize() != 0;
+        case UScriptValue::VALUE_TYPE_ERROR:
+            // 对于返回值，true表示返回ok
+            return intValue_ == USCRIPT_SUCCESS;
+        default:
             break;
-        }
+    }
+    return false;
+}
+
+const std::vector<ScriptValue> &ScriptValue::GetValues() const
+{
+    static const std::vector<ScriptValue> emptyValues {};
+    if (type_ != UScriptValue::VALUE_TYPE_LIST || heap_ == nullptr) {
+        return emptyValues;
+    }
+    return *static_cast<const std::vector<ScriptValue> *>(heap_.get());
+}
+
+// 算术运算结果为 Result 类型，比较和逻辑运算结果为 Logic 类型
+template<typename Result, typename Logic, typename Left, typename Right>
+static ScriptValue NumberComputer(int32_t action, Left left, Right right)
+{
+    switch (action) {
+        case UScriptExpression::ADD_OPERATOR:
+            return ScriptValue(static_cast<Result>(left + right));
+        case UScriptExpression::SUB_OPERATOR:
+            return ScriptValue(static_cast<Result>(left - right));
+        case UScriptExpression::MUL_OPERATOR:
+            return ScriptValue(static_cast<Result>(left * right));
+        case UScriptExpression::DIV_OPERATOR:
+            if (right == 0) {
+                break;
+            }
+            return ScriptValue(static_cast<Result>(left / right));
         case UScriptExpression::GT_OPERATOR:
-            INTEGER_LOGIC_COMPUTER(>, rightValue);
-            break;
+            return ScriptValue(static_cast<Logic>(left > right));
         case UScriptExpression::GE_OPERATOR:
-            INTEGER_LOGIC_COMPUTER(>=, rightValue);
-            break;
+            return ScriptValue(static_cast<Logic>(left >= right));
         case UScriptExpression::LT_OPERATOR:
-            INTEGER_LOGIC_COMPUTER(<, rightValue);
-            break;
+            return ScriptValue(static_cast<Logic>(left < right));
         case UScriptExpression::LE_OPERATOR:
-            INTEGER_LOGIC_COMPUTER(<=, rightValue);
-            break;
+            return ScriptValue(static_cast<Logic>(left <= right));
         case UScriptExpression::EQ_OPERATOR:
-            INTEGER_LOGIC_COMPUTER(==, rightValue);
-            break;
+            return ScriptValue(static_cast<Logic>(left == right));
         case UScriptExpression::NE_OPERATOR:
-            INTEGER_LOGIC_COMPUTER(!=, rightValue);
-            break;
+            return ScriptValue(static_cast<Logic>(left != right));
         case UScriptExpression::AND_OPERATOR:
-            INTEGER_LOGIC_COMPUTER(&&, rightValue);
-            break;
+            return ScriptValue(static_cast<Logic>(left && right));
         case UScriptExpression::OR_OPERATOR:
-            INTEGER_LOGIC_COMPUTER(||, rightValue);
-            break;
+            return ScriptValue(static_cast<Logic>(left || right));
         default:
             break;
     }
-    return defReturn;
-}
-
-#define FLOAT_MATH_COMPUTER(op, rightValue)                                       \
-    do {                                                                          \
-        if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_INTEGER) {      \
-            IntegerValue* value = (IntegerValue*)(rightValue.get());  \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");   \
-            return make_shared<FloatValue>(GetValue() op value->GetValue());      \
-        } else if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_FLOAT) { \
-            FloatValue* value = (FloatValue*)(rightValue.get());      \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");   \
-            return make_shared<FloatValue>(GetValue() op value->GetValue());      \
-        }                                                                         \
-    } while (0)
-
-#define FLOAT_LOGIC_COMPUTER(op, rightValue)                                      \
-    do {                                                                          \
-        if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_INTEGER) {      \
-            IntegerValue* value = (IntegerValue*)(rightValue.get());  \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");   \
-            return make_shared<FloatValue>(GetValue() op value->GetValue());      \
-        } else if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_FLOAT) { \
-            FloatValue* value = (FloatValue*)(rightValue.get());      \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");   \
-            return make_shared<IntegerValue>(GetValue() op value->GetValue());    \
-        }                                                                         \
-    } while (0)
-
-#define FLOAT_MATH_COMPUTER_DIV(rightValue)                                       \
-    do {                                                                          \
-        if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_INTEGER) {     \
-            IntegerValue* value = (IntegerValue*)(rightValue.get());              \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");   \
-            UPDATER_CHECK_ONLY_RETURN (value->GetValue() != 0, break);            \
-            return make_shared<FloatValue>(this->GetValue() / value->GetValue()); \
-        } else if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_FLOAT) { \
-            FloatValue* value = (FloatValue*)(rightValue.get());                  \
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");   \
-            UPDATER_CHECK_ONLY_RETURN (value->GetValue() != 0, break);            \
-            return make_shared<FloatValue>(this->GetValue() / value->GetValue());  \
-        }                                                                          \
-    } while (0)
+    return ScriptValue::Error(USCRIPT_ERROR_INTERPRET);
+}
 
-UScriptValuePtr FloatValue::Computer(int32_t action, UScriptValuePtr value)
+ScriptValue ScriptValue::Computer(int32_t action, const ScriptValue &rightValue) const
 {
-    UScriptValuePtr rightValue = UScriptValue::GetRightCompluteValue(value);
-    UScriptValuePtr defReturn = std::make_shared<ErrorValue>(USCRIPT_ERROR_INTERPRET);
-    USCRIPT_CHECK(rightValue != nullptr, return defReturn, "Check param error");
-    switch (action) {
-        case UScriptExpression::ADD_OPERATOR: {
-            FLOAT_MATH_COMPUTER(+, rightValue);
-            break;
+    if (rightValue.IsNull()) {
+        return Error(USCRIPT_ERROR_INTERPRET);
+    }
+    // 只有一个值的返回值列表可以参与计算
+    if (type_ == UScriptValue::VALUE_TYPE_LIST) {
+        if (GetValues().size() != 1) {
+            return Error(USCRIPT_ERROR_INTERPRET);
         }
-        case UScriptExpression::SUB_OPERATOR: {
-            FLOAT_MATH_COMPUTER(-, rightValue);
-            break;
+        return GetValues()[0].Computer(action, rightValue);
+    }
+    if (rightValue.type_ == UScriptValue::VALUE_TYPE_LIST) {
+        if (rightValue.GetValues().size() != 1) {
+            return Error(USCRIPT_ERROR_INTERPRET);
         }
-        case UScriptExpression::MUL_OPERATOR: {
-            FLOAT_MATH_COMPUTER(*, rightValue);
+        return Computer(action, rightValue.GetValues()[0]);
+    }
+
+    switch (type_) {
+        case UScriptValue::VALUE_TYPE_INTEGER:
+            return ComputerInteger(action, rightValue);
+        case UScriptValue::VALUE_TYPE_FLOAT:
+            return ComputerFloat(action, rightValue);
+        case UScriptValue::VALUE_TYPE_STRING:
+            return ComputerString(action, rightValue);
+        default:
             break;
+    }
+    return Error(USCRIPT_ERROR_INTERPRET);
+}
+
+ScriptValue ScriptValue::ComputerInteger(int32_t action, const ScriptValue &rightValue) const
+{
+    if (rightValue.type_ == UScriptValue::VALUE_TYPE_INTEGER) {
+        return NumberComputer<int32_t, int32_t>(action, intValue_, rightValue.intValue_);
+    } else if (rightValue.type_ == UScriptValue::VALUE_TYPE_FLOAT) {
+        return NumberComputer<float, int32_t>(action, intValue_, rightValue.floatValue_);
+    }
+    return Error(USCRIPT_ERROR_INTERPRET);
+}
+
+ScriptValue ScriptValue::ComputerFloat(int32_t action, const ScriptValue &rightValue) const
+{
+    // 浮点数按误差判断相等，右值不是数值时认为不相等
+    if (action == UScriptExpression::EQ_OPERATOR || action == UScriptExpression::NE_OPERATOR) {
+        bool equal = false;
+        if (rightValue.type_ == UScriptValue::VALUE_TYPE_INTEGER) {
+            equal = abs(floatValue_ - static_cast<float>(rightValue.intValue_)) < 0.0001f;
+        } else if (rightValue.type_ == UScriptValue::VALUE_TYPE_FLOAT) {
+            equal = abs(floatValue_ - rightValue.floatValue_) < 0.0001f;
         }
-        case UScriptExpression::DIV_OPERATOR: {
-            FLOAT_MATH_COMPUTER_DIV(rightValue);
-            break;
+        return ScriptValue(static_cast<int32_t>((action == UScriptExpression::EQ_OPERATOR) ? equal : !equal));
+    }
+    // 与整数比较的结果保持为浮点数
+    if (rightValue.type_ == UScriptValue::VALUE_TYPE_INTEGER) {
+        return NumberComputer<float, float>(action, floatValue_, rightValue.intValue_);
+    } else if (rightValue.type_ == UScriptValue::VALUE_TYPE_FLOAT) {
+        return NumberComputer<float, int32_t>(action, floatValue_, rightValue.floatValue_);
+    }
+    return Error(USCRIPT_ERROR_INTERPRET);
+}
+
+ScriptValue ScriptValue::ComputerString(int32_t action, const ScriptValue &rightValue) const
+{
+    if (action == UScriptExpression::ADD_OPERATOR) {
+        std::string str = GetString();
+        switch (rightValue.type_) {
+            case UScriptValue::VALUE_TYPE_INTEGER:
+                return ScriptValue(str + to_string(rightValue.intValue_));
+            case UScriptValue::VALUE_TYPE_FLOAT:
+                return ScriptValue(str + to_string(rightValue.floatValue_));
+            case UScriptValue::VALUE_TYPE_STRING:
+                return ScriptValue(str.append(rightValue.StringData(), rightValue.StringSize()));
+            default:
+                break;
         }
+        return Error(USCRIPT_ERROR_INTERPRET);
+    }
+    if (rightValue.type_ != UScriptValue::VALUE_TYPE_STRING) {
+        return Error(USCRIPT_ERROR_INTERPRET);
+    }
+
+    int32_t result = CompareString(rightValue);
+    switch (action) {
         case UScriptExpression::GT_OPERATOR:
-            FLOAT_LOGIC_COMPUTER(>, rightValue);
-            break;
+            return ScriptValue(static_cast<int32_t>(result > 0));
         case UScriptExpression::GE_OPERATOR:
-            FLOAT_LOGIC_COMPUTER(>=, rightValue);
-            break;
+            return ScriptValue(static_cast<int32_t>(result >= 0));
         case UScriptExpression::LT_OPERATOR:
-            FLOAT_LOGIC_COMPUTER(<, rightValue);
-            break;
+            return ScriptValue(static_cast<int32_t>(result < 0));
         case UScriptExpression::LE_OPERATOR:
-            FLOAT_LOGIC_COMPUTER(<=, rightValue);
-            break;
+            return ScriptValue(static_cast<int32_t>(result <= 0));
         case UScriptExpression::EQ_OPERATOR:
-            return make_shared<IntegerValue>(ComputerEqual(rightValue));
+            return ScriptValue(static_cast<int32_t>(result == 0));
         case UScriptExpression::NE_OPERATOR:
-            return make_shared<IntegerValue>(!ComputerEqual(rightValue));
-        case UScriptExpression::AND_OPERATOR:
-            FLOAT_LOGIC_COMPUTER(&&, rightValue);
-            break;
-        case UScriptExpression::OR_OPERATOR:
-            FLOAT_LOGIC_COMPUTER(||, rightValue);
+            return ScriptValue(static_cast<int32_t>(result != 0));
+        default:
             break;
+    }
+    return Error(USCRIPT_ERROR_INTERPRET);
+}
+
+int32_t ScriptValue::CompareString(const ScriptValue &rightValue) const
+{
+    size_t leftSize = StringSize();
+    size_t rightSize = rightValue.StringSize();
+    int32_t ret = char_traits<char>::compare(StringData(), rightValue.StringData(), min(leftSize, rightSize));
+    if (ret != 0 || leftSize == rightSize) {
+        return ret;
+    }
+    return (leftSize < rightSize) ? -1 : 1;
+}
+
+std::string ScriptValue::ToString() const
+{
+    switch (type_) {
+        case UScriptValue::VALUE_TYPE_INTEGER:
+            return to_string(intValue_);
+        case UScriptValue::VALUE_TYPE_FLOAT:
+            return to_string(floatValue_);
+        case UScriptValue::VALUE_TYPE_STRING:
+            return GetString();
+        case UScriptValue::VALUE_TYPE_ERROR:
+            return to_string(intValue_);
+        case UScriptValue::VALUE_TYPE_LIST: {
+            std::string str;
+            const std::vector<ScriptValue> &values = GetValues();
+            for (size_t index = 0; index < values.size(); index++) {
+                str += " [" + to_string(index) + "] = " + values[index].ToString();
+            }
+            return str;
+        }
         default:
             break;
     }
-    return defReturn;
+    return std::string("null");
 }
 
-bool FloatValue::ComputerEqual(UScriptValuePtr rightValue)
+std::string ScriptValue::ScriptToString() const
 {
-    if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_INTEGER) {
-        IntegerValue* value = (IntegerValue*)(rightValue.get());
-        USCRIPT_CHECK(value != nullptr, return 0, "Failed to cast ");
-        float v2 = value->GetValue();
-        USCRIPT_LOGI("ComputerEqual %f   v2: %f", GetValue(), v2);
-        float diff = GetValue() - v2;
-        diff = abs(diff);
-        return diff < 0.0001f;
-    } else if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_FLOAT) {
-        FloatValue* value = (FloatValue*)(rightValue.get());
-        USCRIPT_CHECK(value != nullptr, return 0, "Failed to cast ");
-        float diff = GetValue() - value->GetValue();
-        diff = abs(diff);
-        USCRIPT_LOGI("ComputerEqual %f %f diff: %f", GetValue(), value->GetValue(), diff);
-        return diff < 0.0001f;
+    static const std::map<int8_t, std::string> typsMaps = {
+        {UScriptValue::VALUE_TYPE_INTEGER, "type: Integer "},
+        {UScriptValue::VALUE_TYPE_FLOAT, "type: Float "},
+        {UScriptValue::VALUE_TYPE_STRING, "type: String "},
+        {UScriptValue::VALUE_TYPE_ERROR, "type: Error "},
+        {UScriptValue::VALUE_TYPE_LIST, "type: List "}
+    };
+    auto iter = typsMaps.find(type_);
+    if (iter == typsMaps.end()) {
+        return ToString();
     }
-    return 0;
+    return iter->second + ToString();
 }
 
-UScriptValuePtr StringValue::ComputerReturn(int32_t action, UScriptValuePtr rightValue,
-    UScriptValuePtr defReturn) const
+ScriptValue ScriptValue::FromPtr(const UScriptValuePtr &value)
 {
-    switch (action) {
-        case UScriptExpression::GT_OPERATOR: {
-            return make_shared<IntegerValue>(ComputerLogic(rightValue) > 0);
-        }
-        case UScriptExpression::GE_OPERATOR: {
-            return make_shared<IntegerValue>(ComputerLogic(rightValue) >= 0);
-        }
-        case UScriptExpression::LT_OPERATOR: {
-            return make_shared<IntegerValue>(ComputerLogic(rightValue) < 0);
-        }
-        case UScriptExpression::LE_OPERATOR: {
-            return make_shared<IntegerValue>(ComputerLogic(rightValue) <= 0);
-        }
-        case UScriptExpression::EQ_OPERATOR: {
-            return make_shared<IntegerValue>(ComputerLogic(rightValue) == 0);
+    if (value == nullptr) {
+        return ScriptValue();
+    }
+    switch (value->GetValueType()) {
+        case UScriptValue::VALUE_TYPE_INTEGER:
+            return ScriptValue(static_cast<IntegerValue*>(value.get())->GetValue());
+        case UScriptValue::VALUE_TYPE_FLOAT:
+            return ScriptValue(static_cast<FloatValue*>(value.get())->GetValue());
+        case UScriptValue::VALUE_TYPE_STRING:
+            return ScriptValue(static_cast<StringValue*>(value.get())->GetValue());
+        case UScriptValue::VALUE_TYPE_ERROR:
+            return Error(static_cast<ErrorValue*>(value.get())->GetValue());
+        case UScriptValue::VALUE_TYPE_LIST: {
+            std::vector<ScriptValue> values;
+            for (auto &out : static_cast<ReturnValue*>(value.get())->GetValues()) {
+                values.push_back(FromPtr(out));
+            }
+            return ScriptValue(std::move(values));
         }
-        case UScriptExpression::NE_OPERATOR: {
-            return make_shared<IntegerValue>(ComputerLogic(rightValue) != 0);
+        default:
+            break;
+    }
+    return Error(USCRIPT_ERROR_INTERPRET);
+}
+
+UScriptValuePtr ScriptValue::ToPtr() const
+{
+    switch (type_) {
+        case UScriptValue::VALUE_TYPE_INTEGER:
+            return std::make_shared<IntegerValue>(intValue_);
+        case UScriptValue::VALUE_TYPE_FLOAT:
+            return std::make_shared<FloatValue>(floatValue_);
+        case UScriptValue::VALUE_TYPE_STRING:
+            return std::make_shared<StringValue>(GetString());
+        case UScriptValue::VALUE_TYPE_ERROR:
+            return std::make_shared<ErrorValue>(intValue_);
+        case UScriptValue::VALUE_TYPE_LIST: {
+            std::shared_ptr<ReturnValue> retValue = std::make_shared<ReturnValue>();
+            for (auto &out : GetValues()) {
+                retValue->AddValue(out.ToPtr());
+            }
+            return retValue;
         }
-        case UScriptExpression::AND_OPERATOR:
-            return defReturn;
-        case UScriptExpression::OR_OPERATOR:
-            return defReturn;
         default:
             break;
     }
-    return std::make_shared<ErrorValue>(USCRIPT_ERROR_INTERPRET);
+    return nullptr;
 }
 
-UScriptValuePtr StringValue::Computer(int32_t action, UScriptValuePtr value)
+UScriptValuePtr UScriptValue::Computer(int32_t action, UScriptValuePtr rightValue)
 {
-    UScriptValuePtr rightValue = UScriptValue::GetRightCompluteValue(value);
-    UScriptValuePtr defReturn = std::make_shared<ErrorValue>(USCRIPT_ERROR_INTERPRET);
-    USCRIPT_CHECK(rightValue != nullptr, return defReturn, "Check param error");
+    return std::make_shared<ErrorValue>(USCRIPT_ERROR_INTERPRET);
+}
 
-    std::string str;
-    if (action == UScriptExpression::ADD_OPERATOR) {
-        if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_INTEGER) {
-            IntegerValue* value = (IntegerValue*)(rightValue.get());
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");
-            str.assign(this->GetValue());
-            return make_shared<StringValue>(str + to_string(value->GetValue()));
-        } else if (rightValue->GetValueType() == UScriptValue::VALUE_TYPE_FLOAT) {
-            FloatValue* value = (FloatValue*)(rightValue.get());
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");
-            str.assign(this->GetValue());
-            return make_shared<StringValue>(str + to_string(value->GetValue()));
-        } else {
-            StringValue* value = (StringValue*)(rightValue.get());
-            USCRIPT_CHECK(value != nullptr, return defReturn, "Failed to cast ");
-            str.assign(this->GetValue());
-            return make_shared<StringValue>(str + value->GetValue());
-        }
-    }
-    if (rightValue->GetValueType() != UScriptValue::VALUE_TYPE_STRING) {
-        return defReturn;
-    }
+// 计算规则统一由 ScriptValue 实现，字节码执行和语法树执行的结果保持一致
+UScriptValuePtr IntegerValue::Computer(int32_t action, UScriptValuePtr value)
+{
+    return ScriptValue(value_).Computer(action, ScriptValue::FromPtr(value)).ToPtr();
+}
 
-    return ComputerReturn(action, rightValue, defReturn);
+UScriptValuePtr FloatValue::Computer(int32_t action, UScriptValuePtr value)
+{
+    return ScriptValue(value_).Computer(action, ScriptValue::FromPtr(value)).ToPtr();
 }
 
-int32_t StringValue::ComputerLogic(UScriptValuePtr rightValue) const
+UScriptValuePtr StringValue::Computer(int32_t action, UScriptValuePtr value)
 {
-    StringValue* value = (StringValue*)(rightValue.get());
-    USCRIPT_CHECK(value != nullptr, return -1, "Failed to cast ");
-    std::string str;
-    str.assign(this->GetValue());
-    return str.compare(value->GetValue());
+    return ScriptValue(value_).Computer(action, ScriptValue::FromPtr(value)).ToPtr();
 }
 
 std::string UScriptValue::ToString()
@@ -445,11 +554,9 @@ void ReturnValue::AddValue(const UScriptValuePtr value)
     }
 }
 
-void ReturnValue::AddValues(const std::vector<UScriptValuePtr> values)
+void ReturnValue::AddValues(const std::vector<UScriptValuePtr> &values)
 {
-    for (auto out : values) {
-        values_.push_back(out);
-    }
+    values_.insert(values_.end(), values.begin(), values.end());
 }
 
 std::vector<UScriptValuePtr> ReturnValue::GetValues() const
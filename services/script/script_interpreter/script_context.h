@@ -39,6 +39,7 @@ public:
         VALUE_TYPE_ERROR,
         VALUE_TYPE_LIST,
         VALUE_TYPE_RETURN,
+        VALUE_TYPE_NULL,
     };
 
     explicit UScriptValue(UScriptValueType type) : type_(type) {}
@@ -106,7 +107,6 @@ public:
     std::string ToString() override;
 
 private:
-    bool ComputerEqual(UScriptValuePtr rightValue);
     float value_;
 };
 
@@ -127,12 +127,8 @@ public:
     }
 
     UScriptValuePtr Computer(int32_t action, UScriptValuePtr rightValue) override;
-
-    UScriptValuePtr ComputerReturn(int32_t action, UScriptValuePtr rightValue, UScriptValuePtr defReturn) const;
-
     std::string ToString() override;
 private:
-    int32_t ComputerLogic(UScriptValuePtr rightValue) const;
     std::string value_;
 };
 
@@ -153,7 +149,7 @@ public:
     std::string ToString() override;
 
     void AddValue(const UScriptValuePtr value);
-    void AddValues(const std::vector<UScriptValuePtr> values);
+    void AddValues(const std::vector<UScriptValuePtr> &values);
     std::vector<UScriptValuePtr> GetValues() const;
 
 private:
@@ -191,9 +187,111 @@ private:
     int32_t retCode_ = 0;
 };
 
+/**
+ * 按值传递的脚本值。整数、浮点数、错误码和短字符串直接保存在对象内，
+ * 只有长字符串和返回值列表使用共享的堆对象，复制时不重新分配。
+ * 字节码执行、变量槽位和指令参数都使用该类型，语法树执行仍使用 UScriptValuePtr，两者通过 FromPtr/ToPtr 转换。
+ */
+class ScriptValue {
+public:
+    static constexpr size_t SHORT_STRING_SIZE = 22;
+
+    ScriptValue() : type_(UScriptValue::VALUE_TYPE_NULL), intValue_(0) {}
+    explicit ScriptValue(int32_t value) : type_(UScriptValue::VALUE_TYPE_INTEGER), intValue_(value) {}
+    explicit ScriptValue(float value) : type_(UScriptValue::VALUE_TYPE_FLOAT), floatValue_(value) {}
+    explicit ScriptValue(std::string value);
+    explicit ScriptValue(std::vector<ScriptValue> values);
+
+    static ScriptValue Error(int32_t retCode)
+    {
+        ScriptValue value;
+        value.type_ = UScriptValue::VALUE_TYPE_ERROR;
+        value.intValue_ = retCode;
+        return value;
+    }
+
+    UScriptValue::UScriptValueType GetValueType() const
+    {
+        return type_;
+    }
+
+    bool IsNull() const
+    {
+        return type_ == UScriptValue::VALUE_TYPE_NULL;
+    }
+
+    // 与 UScriptValue 各子类的 IsTrue 一致
+    bool IsTrue() const;
+
+    int32_t GetInteger() const
+    {
+        return intValue_;
+    }
+
+    float GetFloat() const
+    {
+        return floatValue_;
+    }
+
+    int32_t GetError() const
+    {
+        return intValue_;
+    }
+
+    std::string GetString() const
+    {
+        return std::string(StringData(), StringSize());
+    }
+
+    const std::vector<ScriptValue> &GetValues() const;
+
+    ScriptValue Computer(int32_t action, const ScriptValue &rightValue) const;
+    std::string ToString() const;
+    std::string ScriptToString() const;
+
+    static ScriptValue FromPtr(const UScriptValuePtr &value);
+    UScriptValuePtr ToPtr() const;
+
+private:
+    const std::string *LongString() const
+    {
+        return (type_ == UScriptValue::VALUE_TYPE_STRING) ? static_cast<const std::string *>(heap_.get()) : nullptr;
+    }
+
+    const char *StringData() const
+    {
+        const std::string *longString = LongString();
+        return (longString != nullptr) ? longString->data() : shortString_.data;
+    }
+
+    size_t StringSize() const
+    {
+        const std::string *longString = LongString();
+        return (longString != nullptr) ? longString->size() : shortString_.size;
+    }
+
+    ScriptValue ComputerInteger(int32_t action, const ScriptValue &rightValue) const;
+    ScriptValue ComputerFloat(int32_t action, const ScriptValue &rightValue) const;
+    ScriptValue ComputerString(int32_t action, const ScriptValue &rightValue) const;
+    int32_t CompareString(const ScriptValue &rightValue) const;
+
+    UScriptValue::UScriptValueType type_;
+    union {
+        int32_t intValue_;
+        float floatValue_;
+        struct {
+            char data[SHORT_STRING_SIZE + 1];
+            uint8_t size;
+        } shortString_;
+    };
+    // 长字符串为 std::string, 列表为 std::vector<ScriptValue>, 按 type_ 区分
+    std::shared_ptr<const void> heap_ {};
+};
+
 /**
  * 脚本指令上下文，用来在执行脚本指令时，传递输入、输出参数
  */
+class ScriptInterpreter;
 class UScriptInstructionContext : public UScriptContext {
 public:
     UScriptInstructionContext() {}
@@ -208,20 +306,52 @@ public:
     virtual int32_t GetParam(int32_t index, int32_t &value) override;
     virtual int32_t GetParam(int32_t index, float &value) override;
     virtual int32_t GetParam(int32_t index, std::string &value) override;
+    virtual void AddProcessedBytes(uint64_t bytes) override
+    {
+        processedBytes_ += bytes;
+    }
 
     int32_t AddInputParam(UScriptValuePtr value);
+    int32_t AddInputParam(ScriptValue value);
+    // 复制 context 中的第 index 个参数，用于在另一个上下文中执行指令
+    int32_t CopyInputParam(UScriptContext &context, int32_t index);
+
+    uint64_t GetProcessedBytes() const
+    {
+        return processedBytes_;
+    }
 
-    std::vector<UScriptValuePtr> GetOutVar() const
+    const std::vector<ScriptValue> &GetOutVar() const
     {
         return outParam_;
     }
 
+    // 执行指令的解释器，async/wait 通过它管理本脚本的异步调用
+    void SetInterpreter(ScriptInterpreter *interpreter)
+    {
+        interpreter_ = interpreter;
+    }
+
+    ScriptInterpreter *GetInterpreter() const
+    {
+        return interpreter_;
+    }
+
+    // 清空参数后重复使用，保留已分配的空间
+    void Reset()
+    {
+        innerParam_.clear();
+        outParam_.clear();
+        processedBytes_ = 0;
+    }
+
 private:
-    template<class T, class TWapper> int32_t GetOutputValue(int32_t index, T &value);
-    template<class T, class TWapper> int32_t GetParam(int32_t index, T &value);
+    int32_t CheckParam(int32_t index, UScriptValue::UScriptValueType type) const;
 
-    std::vector<UScriptValuePtr> innerParam_ {};
-    std::vector<UScriptValuePtr> outParam_ {};
+    std::vector<ScriptValue> innerParam_ {};
+    std::vector<ScriptValue> outParam_ {};
+    uint64_t processedBytes_ = 0;
+    ScriptInterpreter *interpreter_ = nullptr;
 };
 
 /**
@@ -230,14 +360,19 @@ private:
 class UScriptInterpretContext {
 public:
     explicit UScriptInterpretContext(bool top = false);
+    // 变量使用编译时分配的槽位保存，names 为每个槽位对应的变量名
+    UScriptInterpretContext(bool top, const std::vector<std::string> &names);
 
     virtual ~UScriptInterpretContext()
     {
-        localVariables_.clear();
+        variables_.clear();
     }
 
     UScriptValuePtr FindVariable(const ScriptInterpreter &inter, std::string id);
+    // 不存在时返回 nullptr，不复制变量的值
+    const ScriptValue *GetVariable(const std::string &id) const;
     void UpdateVariable(const ScriptInterpreter &inter, std::string id, UScriptValuePtr value);
+    void UpdateVariable(const ScriptInterpreter &inter, const std::string &id, ScriptValue value);
     void UpdateVariables(const ScriptInterpreter &inter,
         UScriptValuePtr value,
         std::vector<std::string> ids,
@@ -253,10 +388,28 @@ public:
         return top_;
     }
 
+    const ScriptValue &GetSlot(size_t slot) const
+    {
+        return variables_[slot];
+    }
+
+    void SetSlot(size_t slot, ScriptValue value)
+    {
+        variables_[slot] = std::move(value);
+        ptrCache_[slot] = nullptr;
+    }
+
 private:
+    int32_t FindSlot(const std::string &id) const;
+
     uint32_t contextId_ = 0;
     bool top_ = false;
-    std::map<std::string, UScriptValuePtr> localVariables_ {};
+    // 编译后执行时指向编译结果中的变量名，否则使用 names_
+    const std::vector<std::string> *slotNames_ = nullptr;
+    std::vector<std::string> names_ {};
+    std::vector<ScriptValue> variables_ {};
+    // 语法树执行读取变量时使用的 UScriptValuePtr，按槽位缓存，变量更新后失效
+    std::vector<UScriptValuePtr> ptrCache_ {};
 };
 } // namespace uscript
 #endif // USCRIPT_CONTEXT_H
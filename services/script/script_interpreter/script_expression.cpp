@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 #include "script_expression.h"
+#include "script_compiler.h"
 #include "script_function.h"
 #include "script_interpreter.h"
 #include "script_utils.h"
@@ -48,13 +49,14 @@ UScriptExpression* BinaryExpression::CreateExpression(ExpressionAction action,
 {
     return new BinaryExpression(action, left, right);
 }
-UScriptExpression* FunctionCallExpression::CreateExpression(std::string identifier, ScriptParams *params)
+UScriptExpression* FunctionCallExpression::CreateExpression(std::string identifier, ScriptParams *params,
+    int32_t line)
 {
-    return new FunctionCallExpression(identifier, params);
+    return new FunctionCallExpression(identifier, params, line);
 }
 UScriptValuePtr UScriptExpression::Execute(ScriptInterpreter &inter, UScriptContextPtr local)
 {
-    return std::make_shared<UScriptValue>(UScriptValue::VALUE_TYPE_ERROR);
+    return std::make_shared<ErrorValue>(USCRIPT_ERROR_INTERPRET);
 }
 UScriptValuePtr IntegerExpression::Execute(ScriptInterpreter &inter, UScriptContextPtr local)
 {
@@ -77,7 +79,7 @@ UScriptValuePtr IdentifierExpression::Execute(ScriptInterpreter &inter, UScriptC
     if (variable != nullptr) {
         return variable;
     }
-    return std::make_shared<UScriptValue>(UScriptValue::VALUE_TYPE_ERROR);
+    return std::make_shared<ErrorValue>(USCRIPT_ERROR_INTERPRET);
 }
 
 int32_t IdentifierExpression::GetIdentifierName(UScriptExpression *expression, std::string &name)
@@ -151,8 +153,10 @@ UScriptValuePtr FunctionCallExpression::Execute(ScriptInterpreter &inter, UScrip
     UScriptValuePtr v;
     INTERPRETER_LOGI(inter, local, "FunctionCallExpression::Execute %s ", functionName_.c_str());
 
-    if (inter.IsNativeFunction(functionName_)) {
-        return inter.ExecuteNativeFunc(local, functionName_, params_);
+    UScriptEnv *env = nullptr;
+    UScriptInstruction *instruction = inter.FindInstruction(functionName_, env);
+    if (instruction != nullptr) {
+        return inter.ExecuteNativeFunc(local, *instruction, *env, functionName_, params_, line_);
     }
 
     ScriptFunction* function = function_;
@@ -166,6 +170,103 @@ UScriptValuePtr FunctionCallExpression::Execute(ScriptInterpreter &inter, UScrip
     return function->Execute(inter, local, params_);
 }
 
+int32_t UScriptExpression::Compile(ScriptCompiler &compiler)
+{
+    USCRIPT_LOGE("Expression type %d can not be compiled", expressType_);
+    return USCRIPT_INVALID_SCRIPT;
+}
+
+int32_t IntegerExpression::Compile(ScriptCompiler &compiler)
+{
+    compiler.EmitConstant(ScriptValue(value_));
+    return USCRIPT_SUCCESS;
+}
+
+int32_t FloatExpression::Compile(ScriptCompiler &compiler)
+{
+    compiler.EmitConstant(ScriptValue(value_));
+    return USCRIPT_SUCCESS;
+}
+
+int32_t StringExpression::Compile(ScriptCompiler &compiler)
+{
+    compiler.EmitConstant(ScriptValue(value_));
+    return USCRIPT_SUCCESS;
+}
+
+int32_t IdentifierExpression::Compile(ScriptCompiler &compiler)
+{
+    compiler.Emit(OPCODE_LOAD, compiler.AddVariable(identifier_));
+    return USCRIPT_SUCCESS;
+}
+
+int32_t AssignExpression::Compile(ScriptCompiler &compiler)
+{
+    USCRIPT_CHECK(expression_ != nullptr, return USCRIPT_INVALID_SCRIPT, "Invalid assign %s", identifier_.c_str());
+    int32_t ret = expression_->Compile(compiler);
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile assign %s", identifier_.c_str());
+
+    std::vector<std::string> identifiers;
+    identifiers.push_back(identifier_);
+    identifiers.insert(identifiers.end(), multipleIdentifiers_.begin(), multipleIdentifiers_.end());
+    compiler.Emit(OPCODE_ASSIGN, compiler.AddAssignTarget(identifiers));
+    return USCRIPT_SUCCESS;
+}
+
+int32_t BinaryExpression::Compile(ScriptCompiler &compiler)
+{
+    USCRIPT_CHECK(left_ != nullptr && right_ != nullptr, return USCRIPT_INVALID_SCRIPT, "Invalid binary expression");
+    ScriptCompiler::Mark mark = compiler.GetMark();
+    int32_t ret = left_->Compile(compiler);
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile left expression");
+    ScriptValue left;
+    bool leftConstant = compiler.GetConstant(mark, left);
+    if (action_ == OR_OPERATOR && leftConstant && left.IsTrue()) {
+        compiler.Rewind(mark);
+        compiler.EmitConstant(ScriptValue(1));
+        return USCRIPT_SUCCESS;
+    }
+
+    // 左值为常量时已经确定不会短路
+    bool shortCircuit = action_ == OR_OPERATOR && !leftConstant;
+    size_t orJump = shortCircuit ? compiler.Emit(OPCODE_OR_JUMP) : 0;
+    ScriptCompiler::Mark rightMark = compiler.GetMark();
+    ret = right_->Compile(compiler);
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile right expression");
+    ScriptValue right;
+    if (leftConstant && compiler.GetConstant(rightMark, right)) {
+        // 两边都是常量时在编译期完成计算，计算失败的留到执行时报错
+        ScriptValue value = left.Computer(action_, right);
+        if (value.GetValueType() != UScriptValue::VALUE_TYPE_ERROR) {
+            compiler.Rewind(mark);
+            compiler.EmitConstant(std::move(value));
+            return USCRIPT_SUCCESS;
+        }
+    }
+    compiler.Emit(OPCODE_BINARY, action_);
+    if (shortCircuit) {
+        compiler.PatchJump(orJump);
+    }
+    return USCRIPT_SUCCESS;
+}
+
+int32_t FunctionCallExpression::Compile(ScriptCompiler &compiler)
+{
+    int32_t site = compiler.AddCallSite(functionName_, params_ != nullptr, line_);
+    compiler.Emit(OPCODE_CALL, site);
+    if (params_ != nullptr) {
+        for (auto expression : params_->GetParams()) {
+            int32_t ret = expression->Compile(compiler);
+            USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile param for %s",
+                functionName_.c_str());
+            compiler.Emit(OPCODE_ARG, site);
+        }
+    }
+    compiler.Emit(OPCODE_INVOKE, site);
+    compiler.EndCallSite(site);
+    return USCRIPT_SUCCESS;
+}
+
 BinaryExpression::~BinaryExpression()
 {
     delete left_;
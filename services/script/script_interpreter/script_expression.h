@@ -24,6 +24,7 @@ using UScriptExpressionPtr = std::shared_ptr<UScriptExpression>;
 
 class ScriptParams;
 class ScriptFunction;
+class ScriptCompiler;
 
 class UScriptExpression {
 public:
@@ -58,6 +59,8 @@ public:
     virtual ~UScriptExpression();
 
     virtual UScriptValuePtr Execute(ScriptInterpreter &inter, UScriptContextPtr local);
+    // 生成字节码，不支持的表达式返回错误
+    virtual int32_t Compile(ScriptCompiler &compiler);
     static UScriptExpression* CreateExpression(ExpressionType expressType)
     {
         return new UScriptExpression(expressType);
@@ -81,6 +84,7 @@ public:
     ~IntegerExpression() override {}
 
     UScriptValuePtr Execute(ScriptInterpreter &inter, UScriptContextPtr local) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 
     static UScriptExpression* CreateExpression(int value)
     {
@@ -100,6 +104,7 @@ public:
     ~FloatExpression() override {}
 
     UScriptValuePtr Execute(ScriptInterpreter &inter, UScriptContextPtr local) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 
     static UScriptExpression* CreateExpression(float value)
     {
@@ -118,6 +123,7 @@ public:
     ~StringExpression() override {}
 
     UScriptValuePtr Execute(ScriptInterpreter &inter, UScriptContextPtr local) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 
     static UScriptExpression* CreateExpression(std::string value)
     {
@@ -135,6 +141,7 @@ public:
     ~IdentifierExpression() override {}
 
     UScriptValuePtr Execute(ScriptInterpreter &inter, UScriptContextPtr local) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 
     static UScriptExpression* CreateExpression(std::string value)
     {
@@ -159,6 +166,7 @@ public:
     ~BinaryExpression() override;
 
     UScriptValuePtr Execute(ScriptInterpreter &inter, UScriptContextPtr local) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 
     static UScriptExpression* CreateExpression(ExpressionAction action, UScriptExpression *left,
         UScriptExpression *right);
@@ -177,6 +185,7 @@ public:
     ~AssignExpression() override;
 
     UScriptValuePtr Execute(ScriptInterpreter &inter, UScriptContextPtr local) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 
     void AddIdentifier(const std::string &identifiers);
 
@@ -190,18 +199,22 @@ private:
 
 class FunctionCallExpression : public UScriptExpression {
 public:
-    FunctionCallExpression(std::string identifier, ScriptParams *params)
-        : UScriptExpression(UScriptExpression::EXPRESSION_TYPE_FUNC), functionName_(identifier), params_(params) {}
+    FunctionCallExpression(std::string identifier, ScriptParams *params, int32_t line = 0)
+        : UScriptExpression(UScriptExpression::EXPRESSION_TYPE_FUNC), functionName_(identifier), params_(params),
+        line_(line) {}
 
     ~FunctionCallExpression() override;
 
     UScriptValuePtr Execute(ScriptInterpreter &inter, UScriptContextPtr local) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 
-    static UScriptExpression* CreateExpression(std::string identifier, ScriptParams *params);
+    // line 为调用所在的脚本行号，用于性能统计
+    static UScriptExpression* CreateExpression(std::string identifier, ScriptParams *params, int32_t line = 0);
 private:
     std::string functionName_;
     ScriptFunction* function_ = nullptr;
     ScriptParams* params_ = nullptr;
+    int32_t line_ = 0;
 };
 } // namespace uscript
 #endif // _HS_EXPRESSION_H
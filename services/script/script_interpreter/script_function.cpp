@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 #include "script_function.h"
+#include "script_compiler.h"
 #include "script_context.h"
 #include "script_interpreter.h"
 #include "script_manager.h"
@@ -64,6 +65,10 @@ UScriptValuePtr ScriptFunction::Execute(ScriptInterpreter &inter,
     UScriptStatementResult result = statements_->Execute(inter, funcContext);
     INTERPRETER_LOGI(inter, context, "ScriptFunction execute %s result %s", functionName_.c_str(),
         UScriptStatementResult::ScriptToString(&result).c_str());
+    // 函数内出错时没有返回值, 把错误码传给调用者
+    if (result.GetResultType() == UScriptStatementResult::STATEMENT_RESULT_TYPE_ERROR) {
+        return std::make_shared<ErrorValue>(result.GetError());
+    }
     return result.GetResultValue();
 }
 
@@ -81,4 +86,19 @@ std::vector<std::string> ScriptFunction::GetParamNames(ScriptInterpreter &inter,
     }
     return names;
 }
+
+int32_t ScriptFunction::Compile(ScriptCompiler &compiler)
+{
+    std::vector<std::string> names;
+    if (params_ != nullptr) {
+        for (auto expression : params_->GetParams()) {
+            std::string varName;
+            int32_t ret = IdentifierExpression::GetIdentifierName(expression, varName);
+            USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Fail to get param name %s", functionName_.c_str());
+            names.push_back(varName);
+        }
+    }
+    compiler.BeginFunction(functionName_, names, params_ != nullptr);
+    return compiler.CompileStatements(statements_);
+}
 } // namespace uscript
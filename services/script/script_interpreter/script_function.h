@@ -22,6 +22,7 @@
 namespace uscript {
 class UScriptStatementList;
 class ScriptParams;
+class ScriptCompiler;
 
 class ScriptFunction {
 public:
@@ -42,6 +43,7 @@ public:
         return functionName_;
     }
     UScriptValuePtr Execute(ScriptInterpreter &inter, UScriptContextPtr local, ScriptParams *params);
+    int32_t Compile(ScriptCompiler &compiler);
 
 private:
     std::vector<std::string> GetParamNames(ScriptInterpreter &inter, UScriptContextPtr context) const;
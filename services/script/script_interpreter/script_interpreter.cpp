@@ -14,16 +14,28 @@
  */
 #include "script_interpreter.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include "script_cache.h"
+#include "script_compiler.h"
 #include "script_context.h"
 #include "script_manager_impl.h"
+#include "script_profiler.h"
 #include "scanner.h"
 #include "script_utils.h"
+#include "script_vm.h"
 
 using namespace std;
 
 namespace uscript {
 static int32_t g_instanceId = 0;
+static std::atomic<bool> g_bytecodeEnabled { true };
+
+void ScriptInterpreter::EnableBytecode(bool enable)
+{
+    g_bytecodeEnabled = enable;
+}
 
 int32_t ScriptInterpreter::ExecuteScript(ScriptManagerImpl *manager, hpackage::PkgManager::StreamPtr pkgStream)
 {
@@ -35,7 +47,9 @@ int32_t ScriptInterpreter::ExecuteScript(ScriptManagerImpl *manager, hpackage::P
     int32_t ret = inter->LoadScript(pkgStream);
     USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Fail to loadScript script %s", pkgStream->GetFileName().c_str());
     ret = inter->Execute();
+    int32_t asyncRet = inter->WaitAllAsync();
     delete inter;
+    ret = (ret == USCRIPT_SUCCESS) ? asyncRet : ret;
     USCRIPT_LOGI("ExecuteScript finish ret: %d  script: %s ",
         ret, pkgStream->GetFileName().c_str());
     return ret;
@@ -48,16 +62,6 @@ ScriptInterpreter::ScriptInterpreter(ScriptManagerImpl *manager) : scriptManager
 
 ScriptInterpreter::~ScriptInterpreter()
 {
-    delete statements_;
-    auto iter = functions_.begin();
-    while (iter != functions_.end()) {
-        auto entry = iter->second;
-        if (entry) {
-            delete entry;
-        }
-        iter = functions_.erase(iter);
-    }
-    functions_.clear();
     contextStack_.clear();
     delete scanner_;
     delete parser_;
@@ -65,6 +69,29 @@ ScriptInterpreter::~ScriptInterpreter()
 
 int32_t ScriptInterpreter::LoadScript(hpackage::PkgManager::StreamPtr pkgStream)
 {
+    scriptName_ = pkgStream->GetFileName();
+    // 内存中的脚本直接解析，文件流只读取一次
+    hpackage::PkgBuffer buffer;
+    std::vector<uint8_t> content;
+    int32_t ret = pkgStream->GetBuffer(buffer);
+    if (ret != hpackage::PKG_SUCCESS || buffer.buffer == nullptr) {
+        content.resize(pkgStream->GetFileLength());
+        size_t readLen = 0;
+        buffer = {content.data(), content.size()};
+        ret = pkgStream->Read(buffer, 0, content.size(), readLen);
+        USCRIPT_CHECK(ret == hpackage::PKG_SUCCESS && readLen == content.size(), return USCRIPT_INVALID_SCRIPT,
+            "Fail to read script %s", pkgStream->GetFileName().c_str());
+    }
+
+    // 相同内容的脚本直接使用缓存的语法树
+    std::string digest = ScriptCache::GetDigest(buffer.buffer, buffer.length);
+    script_ = ScriptCache::Find(digest);
+    if (script_ != nullptr) {
+        USCRIPT_LOGI("Use cached script %s", pkgStream->GetFileName().c_str());
+        return USCRIPT_SUCCESS;
+    }
+
+    script_ = std::make_shared<ParsedScript>();
     scanner_ = new Scanner(this);
     parser_ = new Parser(scanner_, this);
     if (scanner_ == nullptr || parser_ == nullptr) {
@@ -74,15 +101,26 @@ int32_t ScriptInterpreter::LoadScript(hpackage::PkgManager::StreamPtr pkgStream)
         return USCRIPT_ERROR_CREATE_OBJ;
     }
     scanner_->set_debug(0);
-    scanner_->SetPkgStream(pkgStream);
-    int32_t ret = parser_->parse();
+    scanner_->SetBuffer(buffer.buffer, buffer.length);
+    ret = parser_->parse();
+    if (ret == USCRIPT_SUCCESS) {
+        ScriptCache::Add(digest, script_);
+    }
     return ret;
 }
 
 int32_t ScriptInterpreter::Execute()
 {
+    if (g_bytecodeEnabled) {
+        const ScriptProgram *program = script_->GetProgram();
+        if (program != nullptr) {
+            return ScriptVm(*this, *program).Execute();
+        }
+        // 编译失败时回退到语法树执行
+        USCRIPT_LOGI("Fail to compile script, execute by statements");
+    }
     UScriptContextPtr context = std::make_shared<UScriptInterpretContext>(true);
-    UScriptStatementResult result = statements_->Execute(*this, context);
+    UScriptStatementResult result = script_->GetStatements()->Execute(*this, context);
     INTERPRETER_LOGI(*this, context, "statements_ execute result %s ",
         UScriptStatementResult::ScriptToString(&result).c_str());
     if (result.GetResultType() == UScriptStatementResult::STATEMENT_RESULT_TYPE_ERROR) {
@@ -93,20 +131,12 @@ int32_t ScriptInterpreter::Execute()
 
 int32_t ScriptInterpreter::AddFunction(ScriptFunction *function)
 {
-    if (functions_.find(function->GetFunctionName()) != functions_.end()) {
-        USCRIPT_LOGI("Fail to add function %s, function exist", function->GetFunctionName().c_str());
-        return USCRIPT_SUCCESS;
-    }
-    functions_[function->GetFunctionName()] = function;
-    return USCRIPT_SUCCESS;
+    return script_->AddFunction(function);
 }
 
 ScriptFunction* ScriptInterpreter::FindFunction(const std::string &name)
 {
-    if (functions_.find(name) != functions_.end()) {
-        return functions_[name];
-    }
-    return nullptr;
+    return script_->FindFunction(name);
 }
 
 UScriptValuePtr ScriptInterpreter::FindVariable(UScriptContextPtr local, std::string id)
@@ -125,10 +155,10 @@ UScriptValuePtr ScriptInterpreter::FindVariable(UScriptContextPtr local, std::st
 
 UScriptValuePtr ScriptInterpreter::UpdateVariable(UScriptContextPtr local, std::string id, UScriptValuePtr var)
 {
+    ScriptValue value = ScriptValue::FromPtr(var);
     for (auto context = contextStack_.rbegin(); context != contextStack_.rend(); context++) {
-        UScriptValuePtr variable = (*context)->FindVariable(*this, id);
-        if (variable != nullptr) {
-            (*context)->UpdateVariable(*this, id, var);
+        if ((*context)->GetVariable(id) != nullptr) {
+            (*context)->UpdateVariable(*this, id, value);
         }
         if ((*context)->IsTop()) {
             break;
@@ -139,11 +169,19 @@ UScriptValuePtr ScriptInterpreter::UpdateVariable(UScriptContextPtr local, std::
 
 void ScriptInterpreter::AddStatement(UScriptStatement *statement)
 {
-    if (statements_ == nullptr) {
-        statements_ = UScriptStatementList::CreateInstance(statement);
-    } else {
-        statements_->AddScriptStatement(statement);
-    }
+    script_->AddStatement(statement);
+}
+
+UScriptInstruction* ScriptInterpreter::FindInstruction(const std::string &name, UScriptEnv *&env)
+{
+    UScriptInstruction* instruction = scriptManager_->FindInstruction(name);
+    env = scriptManager_->GetScriptEnv(name);
+    return instruction;
+}
+
+uint32_t ScriptInterpreter::GetInstructionVersion() const
+{
+    return scriptManager_->GetInstructionVersion();
 }
 
 bool ScriptInterpreter::IsNativeFunction(std::string name)
@@ -151,48 +189,115 @@ bool ScriptInterpreter::IsNativeFunction(std::string name)
     return scriptManager_->FindInstruction(name) != nullptr;
 }
 
-UScriptValuePtr ScriptInterpreter::ExecuteNativeFunc(UScriptContextPtr context,
-    const std::string &name, ScriptParams *params)
+int32_t ScriptInterpreter::ExecuteInstruction(UScriptInstruction *instruction, UScriptEnv &env,
+    UScriptInstructionContext &context, const std::string &name, int32_t line)
+{
+    ScriptProfiler &profiler = ScriptProfiler::GetInstance();
+    context.SetInterpreter(this);
+    if (!profiler.IsEnabled()) {
+        return instruction->Execute(env, context);
+    }
+    auto start = std::chrono::steady_clock::now();
+    int32_t ret = instruction->Execute(env, context);
+    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    profiler.AddRecord(name, scriptName_, line, static_cast<uint64_t>(duration.count()), context.GetProcessedBytes());
+    return ret;
+}
+
+int32_t ScriptInterpreter::AsyncExecute(const std::string &instrName,
+    std::shared_ptr<UScriptInstructionContext> context, int32_t &handle)
+{
+    UScriptInstruction *instruction = scriptManager_->FindInstruction(instrName);
+    USCRIPT_CHECK(instruction != nullptr, return USCRIPT_NOTEXIST_INSTRUCTION,
+        "Failed to find instruction %s", instrName.c_str());
+    UScriptEnv *env = scriptManager_->GetScriptEnv(instrName);
+    ThreadPool *threadPool = scriptManager_->threadPool_;
+    AsyncCall call;
+    call.context = context;
+    if (instruction->IsAsyncSafe() && threadPool != nullptr) {
+        call.result = threadPool->Submit([instruction, env, context]() {
+            return instruction->Execute(*env, *context);
+        });
+    } else {
+        // 不能并发执行的指令在这里同步执行，仍然通过 wait 获取结果
+        std::promise<int32_t> result;
+        result.set_value(instruction->Execute(*env, *context));
+        call.result = result.get_future();
+    }
+    handle = nextHandle_++;
+    asyncCalls_[handle] = std::move(call);
+    return USCRIPT_SUCCESS;
+}
+
+int32_t ScriptInterpreter::WaitAsync(int32_t handle, std::shared_ptr<UScriptInstructionContext> &context)
+{
+    auto iter = asyncCalls_.find(handle);
+    USCRIPT_CHECK(iter != asyncCalls_.end(), return USCRIPT_INVALID_PARAM, "Invalid handle %d", handle);
+    AsyncCall call = std::move(iter->second);
+    asyncCalls_.erase(iter);
+    context = call.context;
+    ThreadPool *threadPool = scriptManager_->threadPool_;
+    return (threadPool != nullptr) ? threadPool->Wait(call.result) : call.result.get();
+}
+
+int32_t ScriptInterpreter::WaitAllAsync()
+{
+    int32_t retCode = USCRIPT_SUCCESS;
+    while (!asyncCalls_.empty()) {
+        int32_t handle = asyncCalls_.begin()->first;
+        std::shared_ptr<UScriptInstructionContext> context = nullptr;
+        int32_t ret = WaitAsync(handle, context);
+        if (ret != USCRIPT_SUCCESS) {
+            USCRIPT_LOGE("Async instruction %d failed %d", handle, ret);
+            retCode = ret;
+        }
+    }
+    return retCode;
+}
+
+static UScriptValuePtr MakeReturnValue(const std::vector<ScriptValue> &values)
 {
-    std::shared_ptr<ErrorValue> error = std::make_shared<ErrorValue>(USCRIPT_ERROR_INTERPRET);
     std::shared_ptr<ReturnValue> retValue = std::make_shared<ReturnValue>();
-    INTERPRETER_LOGI(*this, context, "ExecuteNativeFunc::Execute %s ", name.c_str());
-    UScriptInstruction* instruction = scriptManager_->FindInstruction(name);
-    USCRIPT_CHECK(instruction != nullptr, return error, "Fail to find instruction %s", name.c_str());
+    for (auto &value : values) {
+        retValue->AddValue(value.ToPtr());
+    }
+    return retValue;
+}
 
-    std::shared_ptr<UScriptInstructionContext> funcContext = std::make_shared<UScriptInstructionContext>();
-    USCRIPT_CHECK(funcContext != nullptr, return error, "Fail to create context %s", name.c_str());
+UScriptValuePtr ScriptInterpreter::ExecuteNativeFunc(UScriptContextPtr context, UScriptInstruction &instruction,
+    UScriptEnv &env, const std::string &name, ScriptParams *params, int32_t line)
+{
+    INTERPRETER_LOGI(*this, context, "ExecuteNativeFunc::Execute %s ", name.c_str());
+    // 指令上下文只在本次调用中使用，不需要在堆上分配
+    UScriptInstructionContext funcContext;
     if (params == nullptr) {
-        int32_t ret = instruction->Execute(*scriptManager_->GetScriptEnv(name), *funcContext.get());
-        retValue->AddValues(funcContext->GetOutVar());
+        int32_t ret = ExecuteInstruction(&instruction, env, funcContext, name, line);
         INTERPRETER_LOGI(*this, context, "ExecuteNativeFunc::Execute %s result: %d", name.c_str(), ret);
-        return retValue;
+        return MakeReturnValue(funcContext.GetOutVar());
     }
 
     for (auto id : params->GetParams()) {
         UScriptValuePtr result = id->Execute(*this, context);
         if (result == nullptr || result->GetValueType() == UScriptValue::VALUE_TYPE_ERROR) {
             INTERPRETER_LOGI(*this, context, "ExecuteNativeFunc::Execute %s ", name.c_str());
-            return error;
+            return std::make_shared<ErrorValue>(USCRIPT_ERROR_INTERPRET);
         }
 
         if (result->GetValueType() != UScriptValue::VALUE_TYPE_LIST) {
-            funcContext->AddInputParam(result);
+            funcContext.AddInputParam(result);
         } else {
             ReturnValue* values = (ReturnValue*)(result.get());
             for (auto out : values->GetValues()) {
-                funcContext->AddInputParam(out);
+                funcContext.AddInputParam(out);
             }
         }
     }
 
-    int32_t ret = instruction->Execute(*scriptManager_->GetScriptEnv(name), *funcContext.get());
+    int32_t ret = ExecuteInstruction(&instruction, env, funcContext, name, line);
     INTERPRETER_LOGI(*this, context, "ExecuteNativeFunc::Execute %s result: %d", name.c_str(), ret);
     if (ret != USCRIPT_SUCCESS) {
-        error->SetValue(ret);
-        return error;
+        return std::make_shared<ErrorValue>(ret);
     }
-    retValue->AddValues(funcContext->GetOutVar());
-    return retValue;
+    return MakeReturnValue(funcContext.GetOutVar());
 }
 } // namespace uscript
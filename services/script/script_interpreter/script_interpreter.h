@@ -15,6 +15,9 @@
 #ifndef USCRIPT_INTERPRETER_H
 #define USCRIPT_INTERPRETER_H
 
+#include <future>
+#include <map>
+#include "script_cache.h"
 #include "script_context.h"
 #include "script_expression.h"
 #include "script_function.h"
@@ -51,10 +54,21 @@ public:
     int32_t AddFunction(ScriptFunction *function);
     ScriptFunction* FindFunction(const std::string &name);
     bool IsNativeFunction(std::string name);
-    UScriptValuePtr ExecuteNativeFunc(UScriptContextPtr upContext, const std::string &name,
-        ScriptParams *params);
+    UScriptValuePtr ExecuteNativeFunc(UScriptContextPtr upContext, UScriptInstruction &instruction,
+        UScriptEnv &env, const std::string &name, ScriptParams *params, int32_t line = 0);
+    // 执行原生指令，打开性能统计时按指令名和行号记录耗时及处理的数据量
+    int32_t ExecuteInstruction(UScriptInstruction *instruction, UScriptEnv &env,
+        UScriptInstructionContext &context, const std::string &name, int32_t line);
     UScriptValuePtr FindVariable(UScriptContextPtr local, std::string id);
     UScriptValuePtr UpdateVariable(UScriptContextPtr local, std::string id, UScriptValuePtr var);
+    UScriptInstruction* FindInstruction(const std::string &name, UScriptEnv *&env);
+    uint32_t GetInstructionVersion() const;
+    // 在线程池中执行指令，通过 handle 等待结果，每个 handle 只能等待一次，handle 只在本脚本中有效
+    int32_t AsyncExecute(const std::string &instrName, std::shared_ptr<UScriptInstructionContext> context,
+        int32_t &handle);
+    int32_t WaitAsync(int32_t handle, std::shared_ptr<UScriptInstructionContext> &context);
+    // 关闭后脚本只使用语法树执行，默认先编译成字节码执行
+    static void EnableBytecode(bool enable);
     int32_t GetInstanceId() const
     {
         return instanceId_;
@@ -68,19 +82,41 @@ public:
     {
         contextStack_.pop_back();
     }
+    UScriptContextPtr GetCurrentContext() const
+    {
+        return contextStack_.back();
+    }
+    // depth 为距离栈顶的层数
+    UScriptInterpretContext *GetContext(size_t depth) const
+    {
+        return contextStack_[contextStack_.size() - 1 - depth].get();
+    }
+    size_t GetContextDepth() const
+    {
+        return contextStack_.size();
+    }
 
 private:
     int32_t LoadScript(hpackage::PkgManager::StreamPtr pkgStream);
     int32_t Execute();
+    // 脚本结束时等待没有 wait 的异步指令
+    int32_t WaitAllAsync();
 
 private:
-    UScriptStatementList* statements_ = nullptr;
-    std::map<std::string, ScriptFunction*> functions_;
+    struct AsyncCall {
+        std::future<int32_t> result;
+        std::shared_ptr<UScriptInstructionContext> context;
+    };
+
+    ParsedScriptPtr script_ = nullptr;
+    std::string scriptName_ {};
     std::vector<UScriptContextPtr> contextStack_;
     ScriptManagerImpl* scriptManager_ = nullptr;
     Parser* parser_ = nullptr;
     Scanner* scanner_ = nullptr;
     int32_t instanceId_ = 0;
+    std::map<int32_t, AsyncCall> asyncCalls_ {};
+    int32_t nextHandle_ = 0;
 };
 } // namespace uscript
 #endif
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "script_profiler.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include "script_manager.h"
+#include "script_utils.h"
+
+using namespace std;
+
+namespace uscript {
+static constexpr uint64_t NS_PER_US = 1000;
+
+static std::string EscapeJson(const std::string &str)
+{
+    std::string result;
+    for (auto c : str) {
+        if (c == '"' || c == '\\') {
+            result.push_back('\\');
+            result.push_back(c);
+        } else if (static_cast<unsigned char>(c) < ' ') {
+            char buffer[8] = {0}; // \u00xx
+            (void)snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            result += buffer;
+        } else {
+            result.push_back(c);
+        }
+    }
+    return result;
+}
+
+ScriptProfiler &ScriptProfiler::GetInstance()
+{
+    static ScriptProfiler profiler;
+    return profiler;
+}
+
+void ScriptProfiler::AddRecord(const std::string &name, const std::string &script, int32_t line,
+    uint64_t durationNs, uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ProfileRecord &record = records_[RecordKey(name, script, line)];
+    if (record.count == 0) {
+        record.name = name;
+        record.script = script;
+        record.line = line;
+    }
+    record.count++;
+    record.totalNs += durationNs;
+    record.maxNs = std::max(record.maxNs, durationNs);
+    record.bytes += bytes;
+}
+
+std::vector<ScriptProfiler::ProfileRecord> ScriptProfiler::GetRecords() const
+{
+    std::vector<ProfileRecord> records;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &record : records_) {
+            records.push_back(record.second);
+        }
+    }
+    std::stable_sort(records.begin(), records.end(), [](const ProfileRecord &a, const ProfileRecord &b) {
+        return a.totalNs > b.totalNs;
+    });
+    return records;
+}
+
+std::string ScriptProfiler::DumpTable() const
+{
+    std::string table;
+    char line[512] = {0};
+    (void)snprintf(line, sizeof(line), "%-24s %-24s %6s %8s %14s %12s %14s\n",
+        "instruction", "script", "line", "count", "total(us)", "max(us)", "bytes");
+    table += line;
+    for (auto &record : GetRecords()) {
+        (void)snprintf(line, sizeof(line), "%-24s %-24s %6d %8" PRIu64 " %14" PRIu64 " %12" PRIu64 " %14" PRIu64 "\n",
+            record.name.c_str(), record.script.c_str(), record.line, record.count,
+            record.totalNs / NS_PER_US, record.maxNs / NS_PER_US, record.bytes);
+        table += line;
+    }
+    return table;
+}
+
+std::string ScriptProfiler::DumpJson() const
+{
+    std::string json = "[";
+    bool first = true;
+    for (auto &record : GetRecords()) {
+        json += first ? "\n" : ",\n";
+        first = false;
+        json += "  {\"instruction\": \"" + EscapeJson(record.name) + "\", ";
+        json += "\"script\": \"" + EscapeJson(record.script) + "\", ";
+        json += "\"line\": " + std::to_string(record.line) + ", ";
+        json += "\"count\": " + std::to_string(record.count) + ", ";
+        json += "\"total_us\": " + std::to_string(record.totalNs / NS_PER_US) + ", ";
+        json += "\"max_us\": " + std::to_string(record.maxNs / NS_PER_US) + ", ";
+        json += "\"bytes\": " + std::to_string(record.bytes) + "}";
+    }
+    json += first ? "]\n" : "\n]\n";
+    return json;
+}
+
+int32_t ScriptProfiler::DumpJson(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    USCRIPT_CHECK(file.is_open(), return USCRIPT_INVALID_PARAM, "Fail to open %s", path.c_str());
+    file << DumpJson();
+    USCRIPT_CHECK(file.good(), return USCRIPT_ERROR_EXECUTE, "Fail to write %s", path.c_str());
+    return USCRIPT_SUCCESS;
+}
+
+void ScriptProfiler::Reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    records_.clear();
+}
+} // namespace uscript
@@ -13,17 +13,21 @@
  * limitations under the License.
  */
 #include "scanner.h"
+#include <algorithm>
 #include "pkg_manager.h"
+#include "securec.h"
 
 using namespace hpackage;
 
 namespace uscript {
 int Scanner::LexerInput(char *buf, int maxSize)
 {
-    size_t readLen = 0;
-    PkgBuffer data = {reinterpret_cast<uint8_t*>(buf), static_cast<size_t>(maxSize)};
-    (void)pkgStream_->Read(data, currPos, maxSize, readLen);
+    if (buffer_ == nullptr || currPos >= bufferSize_ || maxSize <= 0) {
+        return 0;
+    }
+    size_t readLen = std::min(bufferSize_ - currPos, static_cast<size_t>(maxSize));
+    (void)memcpy_s(buf, maxSize, buffer_ + currPos, readLen);
     currPos += readLen;
-    return readLen;
+    return static_cast<int>(readLen);
 }
 } // namespace uscript
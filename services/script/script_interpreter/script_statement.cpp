@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 #include "script_statement.h"
+#include "script_compiler.h"
 #include "script_context.h"
 #include "script_expression.h"
 #include "script_interpreter.h"
@@ -23,8 +24,8 @@ using namespace std;
 namespace uscript {
 void UScriptStatementResult::UpdateStatementResult(UScriptValuePtr value)
 {
-    USCRIPT_CHECK(value != nullptr, SetResultType(UScriptStatementResult::STATEMENT_RESULT_TYPE_ERROR),
-        "Invalid value");
+    USCRIPT_CHECK(value != nullptr, SetResultType(UScriptStatementResult::STATEMENT_RESULT_TYPE_ERROR);
+        SetError(USCRIPT_ERROR_INTERPRET); return, "Invalid value");
     switch (value->GetValueType()) {
         case UScriptValue::VALUE_TYPE_INTEGER:
             /* fallthrough */
@@ -346,4 +347,143 @@ UScriptStatementResult UScriptReturnStatement::Execute(ScriptInterpreter &interp
     result.SetResultValue(retValue);
     return result;
 }
+
+int32_t UScriptStatementCtrl::Compile(ScriptCompiler &compiler)
+{
+    switch (GetType()) {
+        case STATEMENT_TYPE_BREAK:
+            return compiler.EmitBreak();
+        case STATEMENT_TYPE_CONTINUE:
+            return compiler.EmitContinue();
+        case STATEMENT_TYPE_RTN:
+            compiler.Emit(OPCODE_RETURN, 0);
+            return USCRIPT_SUCCESS;
+        default:
+            break;
+    }
+    return USCRIPT_INVALID_STATEMENT;
+}
+
+int32_t UScriptExpressionStatement::Compile(ScriptCompiler &compiler)
+{
+    USCRIPT_CHECK(expression_ != nullptr, return USCRIPT_INVALID_STATEMENT, "Invalid expression statement");
+    int32_t ret = expression_->Compile(compiler);
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile expression statement");
+    compiler.Emit(OPCODE_STMT);
+    return USCRIPT_SUCCESS;
+}
+
+int32_t UScriptForStatement::Compile(ScriptCompiler &compiler)
+{
+    int32_t ret = USCRIPT_SUCCESS;
+    if (before_ != nullptr) {
+        ret = before_->Compile(compiler);
+        USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile for before");
+        compiler.Emit(OPCODE_POP);
+    }
+
+    compiler.BeginLoop();
+    size_t start = compiler.GetCodeSize();
+    size_t exitJump = 0;
+    if (condition_ != nullptr) {
+        ret = condition_->Compile(compiler);
+        USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile for condition");
+        exitJump = compiler.Emit(OPCODE_JUMP_FALSE);
+    }
+    ret = compiler.CompileStatements(statements_);
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile for statements");
+
+    compiler.SetContinueTarget();
+    if (after_ != nullptr) {
+        ret = after_->Compile(compiler);
+        USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile for after");
+        compiler.Emit(OPCODE_POP);
+    }
+    compiler.Emit(OPCODE_JUMP, static_cast<int32_t>(start));
+    if (condition_ != nullptr) {
+        compiler.PatchJump(exitJump);
+    }
+    compiler.EndLoop();
+    compiler.Emit(OPCODE_CLEAR);
+    return USCRIPT_SUCCESS;
+}
+
+int32_t UScriptWhileStatement::Compile(ScriptCompiler &compiler)
+{
+    int32_t ret = USCRIPT_SUCCESS;
+    compiler.BeginLoop();
+    compiler.SetContinueTarget();
+    size_t start = compiler.GetCodeSize();
+    size_t exitJump = 0;
+    if (condition_ != nullptr) {
+        ret = condition_->Compile(compiler);
+        USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile while condition");
+        exitJump = compiler.Emit(OPCODE_JUMP_FALSE);
+    }
+    ret = compiler.CompileStatements(statements_);
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile while statements");
+
+    compiler.Emit(OPCODE_JUMP, static_cast<int32_t>(start));
+    if (condition_ != nullptr) {
+        compiler.PatchJump(exitJump);
+    }
+    compiler.EndLoop();
+    compiler.Emit(OPCODE_CLEAR);
+    return USCRIPT_SUCCESS;
+}
+
+int32_t UScriptIfStatement::Compile(ScriptCompiler &compiler)
+{
+    USCRIPT_CHECK(expression_ != nullptr, return USCRIPT_INVALID_STATEMENT, "Invalid if statement");
+    compiler.Emit(OPCODE_CLEAR);
+    int32_t ret = expression_->Compile(compiler);
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile if condition");
+    size_t elseJump = compiler.Emit(OPCODE_JUMP_FALSE);
+
+    // 分支在新的局部上下文中执行，与 Execute 保持一致
+    if (trueStatements_ != nullptr) {
+        compiler.PushScope();
+        ret = compiler.CompileStatements(trueStatements_);
+        USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile if statements");
+        compiler.PopScope();
+    }
+    size_t endJump = compiler.Emit(OPCODE_JUMP);
+    compiler.PatchJump(elseJump);
+    if (falseStatements_ != nullptr) {
+        compiler.PushScope();
+        ret = compiler.CompileStatements(falseStatements_);
+        USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile else statements");
+        compiler.PopScope();
+    } else if (nextStatement_ != nullptr) {
+        ret = nextStatement_->Compile(compiler);
+        USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile else if statement");
+    }
+    compiler.PatchJump(endJump);
+    return USCRIPT_SUCCESS;
+}
+
+int32_t UScriptReturnStatement::Compile(ScriptCompiler &compiler)
+{
+    if (params_ == nullptr) {
+        compiler.Emit(OPCODE_RETURN, 0);
+        return USCRIPT_SUCCESS;
+    }
+    std::vector<UScriptExpression*> params = params_->GetParams();
+    for (auto id : params) {
+        int32_t ret = id->Compile(compiler);
+        USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile return value");
+    }
+    compiler.Emit(OPCODE_MAKE_LIST, static_cast<int32_t>(params.size()));
+    compiler.Emit(OPCODE_RETURN, 1);
+    return USCRIPT_SUCCESS;
+}
+
+int32_t UScriptStatementList::Compile(ScriptCompiler &compiler)
+{
+    for (auto statement : statements_) {
+        int32_t ret = statement->Compile(compiler);
+        USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to compile statement %d", statement->GetType());
+    }
+    return USCRIPT_SUCCESS;
+}
 } // namespace uscript
@@ -22,6 +22,7 @@
 namespace uscript {
 class UScriptStatementList;
 class UScriptExpression;
+class ScriptCompiler;
 
 class UScriptStatementResult {
 public:
@@ -111,6 +112,7 @@ public:
     static UScriptStatement* CreateWhileStatement(UScriptExpression *condition, UScriptStatementList *list);
 
     virtual UScriptStatementResult Execute(ScriptInterpreter &interpreter, UScriptContextPtr context) = 0;
+    virtual int32_t Compile(ScriptCompiler &compiler) = 0;
 
     StatementType GetType() const
     {
@@ -126,6 +128,7 @@ public:
     explicit UScriptStatementCtrl(UScriptStatement::StatementType type) : UScriptStatement(type) {}
     ~UScriptStatementCtrl() override {}
     UScriptStatementResult Execute(ScriptInterpreter &interpreter, UScriptContextPtr context) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 };
 
 class UScriptExpressionStatement : public UScriptStatement {
@@ -134,6 +137,7 @@ public:
         UScriptStatement(STATEMENT_TYPE_EXPRESSION), expression_(expression) {}
     ~UScriptExpressionStatement() override;
     UScriptStatementResult Execute(ScriptInterpreter &interpreter, UScriptContextPtr context) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 private:
     UScriptExpression* expression_;
 };
@@ -144,6 +148,7 @@ public:
         : UScriptStatement(STATEMENT_TYPE_IF), expression_(expression), trueStatements_(statements)  {}
     ~UScriptIfStatement() override;
     UScriptStatementResult Execute(ScriptInterpreter &interpreter, UScriptContextPtr context) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 
     void AddFalseStatementList(UScriptStatementList *statements)
     {
@@ -169,6 +174,7 @@ public:
 
     ~UScriptForStatement() override;
     UScriptStatementResult Execute(ScriptInterpreter &interpreter, UScriptContextPtr context) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 
 private:
     UScriptExpression* before_ = nullptr;
@@ -184,6 +190,7 @@ public:
 
     ~UScriptWhileStatement() override;
     UScriptStatementResult Execute(ScriptInterpreter &interpreter, UScriptContextPtr context) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 
 private:
     UScriptExpression *condition_ = nullptr;
@@ -196,6 +203,7 @@ public:
 
     ~UScriptReturnStatement() override;
     UScriptStatementResult Execute(ScriptInterpreter &interpreter, UScriptContextPtr context) override;
+    int32_t Compile(ScriptCompiler &compiler) override;
 
     void AddParams(ScriptParams* params)
     {
@@ -218,6 +226,7 @@ public:
     void AddScriptStatement(UScriptStatement *statement);
 
     UScriptStatementResult Execute(ScriptInterpreter &interpreter, UScriptContextPtr context);
+    int32_t Compile(ScriptCompiler &compiler);
 
     static UScriptStatementResult DoExecute(ScriptInterpreter &inter, UScriptContextPtr context,
         UScriptStatementList *statements);
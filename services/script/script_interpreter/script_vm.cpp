@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "script_vm.h"
+#include "script_interpreter.h"
+#include "script_utils.h"
+
+using namespace std;
+
+namespace uscript {
+ScriptVm::ScriptVm(ScriptInterpreter &inter, const ScriptProgram &program) : inter_(inter), program_(program)
+{
+    targets_.resize(program_.callSites.size());
+}
+
+int32_t ScriptVm::Execute()
+{
+    UScriptContextPtr context = std::make_shared<UScriptInterpretContext>(true, program_.scopes[0].names);
+    size_t contextDepth = inter_.GetContextDepth();
+    inter_.ContextPush(context);
+    size_t pc = 0;
+    bool running = true;
+    while (running) {
+        const ScriptByteCode &code = program_.code[pc++];
+        switch (code.op) {
+            case OPCODE_CONST:
+                Push(program_.constants[code.operand]);
+                break;
+            case OPCODE_LOAD: {
+                const ScriptVariable &name = program_.variables[code.operand];
+                const ScriptValue *variable = FindVariable(name);
+                if (variable == nullptr) {
+                    INTERPRETER_LOGI(inter_, context, "Can not find variable %s", name.name.c_str());
+                    Push(ScriptValue::Error(USCRIPT_ERROR_INTERPRET));
+                } else {
+                    Push(*variable);
+                }
+                break;
+            }
+            case OPCODE_ASSIGN:
+                Assign(code.operand, Pop());
+                break;
+            case OPCODE_BINARY:
+                Binary(code.operand);
+                break;
+            case OPCODE_OR_JUMP:
+                if (stack_.back().IsTrue()) {
+                    stack_.back() = ScriptValue(1);
+                    pc = static_cast<size_t>(code.operand);
+                }
+                break;
+            case OPCODE_JUMP:
+                pc = static_cast<size_t>(code.operand);
+                break;
+            case OPCODE_JUMP_FALSE: {
+                ScriptValue value = Pop();
+                if (value.IsNull() || value.GetValueType() == UScriptValue::VALUE_TYPE_ERROR) {
+                    INTERPRETER_LOGE(inter_, context, "Execute condition failed: %s", value.ScriptToString().c_str());
+                    // 与语法树执行一致，条件计算失败时结束执行，但不带错误码
+                    running = Raise(std::move(value), USCRIPT_SUCCESS, pc);
+                } else if (!value.IsTrue()) {
+                    pc = static_cast<size_t>(code.operand);
+                }
+                break;
+            }
+            case OPCODE_POP:
+                Pop();
+                break;
+            case OPCODE_STMT:
+                lastValue_ = Pop();
+                if (lastValue_.IsNull()) {
+                    INTERPRETER_LOGE(inter_, context, "Invalid value");
+                    running = Raise(ScriptValue(), USCRIPT_ERROR_INTERPRET, pc);
+                } else if (lastValue_.GetValueType() == UScriptValue::VALUE_TYPE_ERROR) {
+                    running = Raise(lastValue_, lastValue_.GetError(), pc);
+                }
+                break;
+            case OPCODE_CLEAR:
+                lastValue_ = ScriptValue();
+                break;
+            case OPCODE_PUSH_SCOPE: {
+                const ScriptScope &scope = program_.scopes[code.operand];
+                inter_.ContextPush(std::make_shared<UScriptInterpretContext>(false, scope.names));
+                break;
+            }
+            case OPCODE_POP_SCOPE:
+                for (int32_t i = 0; i < code.operand; i++) {
+                    inter_.ContextPop();
+                }
+                break;
+            case OPCODE_CALL:
+                Call(code.operand, pc);
+                break;
+            case OPCODE_ARG:
+                BindArg(code.operand, pc);
+                break;
+            case OPCODE_INVOKE:
+                Invoke(code.operand, pc);
+                break;
+            case OPCODE_MAKE_LIST:
+                MakeList(code.operand);
+                break;
+            case OPCODE_RETURN:
+                running = Return((code.operand != 0) ? Pop() : ScriptValue(), pc);
+                break;
+            case OPCODE_RETURN_LAST:
+                running = Return(lastValue_, pc);
+                break;
+            default:
+                INTERPRETER_LOGE(inter_, context, "Invalid opcode %d", code.op);
+                result_ = USCRIPT_INVALID_SCRIPT;
+                running = false;
+                break;
+        }
+    }
+    while (inter_.GetContextDepth() > contextDepth) {
+        inter_.ContextPop();
+    }
+    INTERPRETER_LOGI(inter_, context, "ScriptVm execute finish ret: %d", result_);
+    return result_;
+}
+
+ScriptValue ScriptVm::Pop()
+{
+    ScriptValue value = std::move(stack_.back());
+    stack_.pop_back();
+    return value;
+}
+
+const ScriptValue *ScriptVm::FindVariable(const ScriptVariable &variable) const
+{
+    for (auto &slot : variable.slots) {
+        const ScriptValue &value = inter_.GetContext(slot.depth)->GetSlot(slot.slot);
+        if (!value.IsNull()) {
+            return &value;
+        }
+    }
+    if (variable.callerDepth < 0) {
+        return nullptr;
+    }
+    for (size_t depth = variable.callerDepth; depth < inter_.GetContextDepth(); depth++) {
+        UScriptInterpretContext *context = inter_.GetContext(depth);
+        const ScriptValue *value = context->GetVariable(variable.name);
+        if (value != nullptr || context->IsTop()) {
+            return value;
+        }
+    }
+    return nullptr;
+}
+
+void ScriptVm::UpdateVariable(const ScriptVariable &variable, const ScriptValue &value)
+{
+    // 与 ScriptInterpreter::UpdateVariable 一致，更新所有可见的同名变量
+    for (auto &slot : variable.slots) {
+        UScriptInterpretContext *context = inter_.GetContext(slot.depth);
+        if (!context->GetSlot(slot.slot).IsNull()) {
+            context->SetSlot(slot.slot, value);
+        }
+    }
+    if (variable.callerDepth < 0) {
+        return;
+    }
+    for (size_t depth = variable.callerDepth; depth < inter_.GetContextDepth(); depth++) {
+        UScriptInterpretContext *context = inter_.GetContext(depth);
+        if (context->GetVariable(variable.name) != nullptr) {
+            context->UpdateVariable(inter_, variable.name, value);
+        }
+        if (context->IsTop()) {
+            break;
+        }
+    }
+}
+
+void ScriptVm::DefineVariables(UScriptInterpretContext &context, const std::vector<int32_t> &slots,
+    const ScriptValue &value, size_t &index)
+{
+    if (value.GetValueType() != UScriptValue::VALUE_TYPE_LIST) {
+        USCRIPT_CHECK(index < slots.size(), return, "Invalid startIndex %zu", index);
+        context.SetSlot(slots[index++], value);
+        return;
+    }
+    for (auto &out : value.GetValues()) {
+        USCRIPT_CHECK(index < slots.size(), return, "Invalid startIndex %zu", index);
+        context.SetSlot(slots[index++], out);
+    }
+}
+
+void ScriptVm::Assign(int32_t target, ScriptValue value)
+{
+    if (value.IsNull()) {
+        Push(ScriptValue::Error(USCRIPT_ERROR_INTERPRET));
+        return;
+    }
+    if (value.GetValueType() == UScriptValue::VALUE_TYPE_ERROR) {
+        Push(std::move(value));
+        return;
+    }
+
+    // 变量已经存在时更新所有可见的同名变量，否则在当前上下文中定义
+    const ScriptAssignTarget &assign = program_.assignTargets[target];
+    const ScriptVariable &variable = program_.variables[assign.variable];
+    if (FindVariable(variable) != nullptr) {
+        UpdateVariable(variable, value);
+    } else {
+        size_t index = 0;
+        DefineVariables(*inter_.GetContext(0), assign.slots, value, index);
+    }
+    Push(std::move(value));
+}
+
+void ScriptVm::Binary(int32_t action)
+{
+    // 结果直接写回左操作数的位置
+    ScriptValue right = Pop();
+    ScriptValue &left = stack_.back();
+    left = left.Computer(action, right);
+}
+
+void ScriptVm::MakeList(int32_t count)
+{
+    std::vector<ScriptValue> values;
+    size_t start = stack_.size() - static_cast<size_t>(count);
+    for (size_t i = start; i < stack_.size(); i++) {
+        ScriptValue &value = stack_[i];
+        if (value.IsNull()) {
+            continue;
+        }
+        if (value.GetValueType() == UScriptValue::VALUE_TYPE_LIST) {
+            values.insert(values.end(), value.GetValues().begin(), value.GetValues().end());
+        } else {
+            values.push_back(std::move(value));
+        }
+    }
+    stack_.erase(stack_.begin() + start, stack_.end());
+    Push(ScriptValue(std::move(values)));
+}
+
+void ScriptVm::Call(int32_t site, size_t &pc)
+{
+    const ScriptCallSite &callSite = program_.callSites[site];
+    CallTarget &target = targets_[site];
+    uint32_t version = inter_.GetInstructionVersion();
+    if (!target.bound || target.version != version) {
+        target.instruction = inter_.FindInstruction(callSite.name, target.env);
+        target.version = version;
+        target.bound = true;
+    }
+
+    PendingCall call { site, target.instruction, target.env, nullptr, nullptr, 0 };
+    if (call.instruction != nullptr) {
+        // 指令上下文执行完后回收，循环中的调用不再重复分配
+        if (freeContexts_.empty()) {
+            call.instrContext = std::make_shared<UScriptInstructionContext>();
+        } else {
+            call.instrContext = std::move(freeContexts_.back());
+            freeContexts_.pop_back();
+        }
+        calls_.push_back(std::move(call));
+        return;
+    }
+    if (callSite.function < 0) {
+        INTERPRETER_LOGI(inter_, inter_.GetCurrentContext(), "Can not find function %s", callSite.name.c_str());
+        Push(ScriptValue::Error(USCRIPT_NOTEXIST_INSTRUCTION));
+        pc = callSite.end;
+        return;
+    }
+    if (callSite.hasParams != program_.functions[callSite.function].hasParams) {
+        INTERPRETER_LOGE(inter_, inter_.GetCurrentContext(), "Function param not match %s", callSite.name.c_str());
+        Push(ScriptValue::Error(USCRIPT_ERROR_INTERPRET));
+        pc = callSite.end;
+        return;
+    }
+    call.funcContext = std::make_shared<UScriptInterpretContext>(false,
+        program_.scopes[program_.functions[callSite.function].scope].names);
+    calls_.push_back(call);
+}
+
+void ScriptVm::BindArg(int32_t site, size_t &pc)
+{
+    ScriptValue value = Pop();
+    PendingCall &call = calls_.back();
+    const ScriptCallSite &callSite = program_.callSites[site];
+    bool invalid = (value.IsNull() || value.GetValueType() == UScriptValue::VALUE_TYPE_ERROR);
+    if (call.instruction != nullptr) {
+        if (invalid) {
+            INTERPRETER_LOGI(inter_, inter_.GetCurrentContext(), "Invalid param for %s", callSite.name.c_str());
+            calls_.pop_back();
+            Push(ScriptValue::Error(USCRIPT_ERROR_INTERPRET));
+            pc = callSite.end;
+            return;
+        }
+        if (value.GetValueType() != UScriptValue::VALUE_TYPE_LIST) {
+            call.instrContext->AddInputParam(std::move(value));
+            return;
+        }
+        for (auto &out : value.GetValues()) {
+            call.instrContext->AddInputParam(out);
+        }
+        return;
+    }
+
+    const std::vector<int32_t> &params = program_.functions[callSite.function].paramSlots;
+    if (invalid || call.index >= params.size()) {
+        INTERPRETER_LOGE(inter_, inter_.GetCurrentContext(), "Fail to computer param %zu for %s",
+            call.index, callSite.name.c_str());
+        calls_.pop_back();
+        Push(ScriptValue::Error(USCRIPT_NOTEXIST_INSTRUCTION));
+        pc = callSite.end;
+        return;
+    }
+    DefineVariables(*call.funcContext, params, value, call.index);
+}
+
+void ScriptVm::Invoke(int32_t site, size_t &pc)
+{
+    PendingCall call = std::move(calls_.back());
+    calls_.pop_back();
+    const ScriptCallSite &callSite = program_.callSites[site];
+    if (call.instruction != nullptr) {
+        int32_t ret = inter_.ExecuteInstruction(call.instruction, *call.env, *call.instrContext, callSite.name,
+            callSite.line);
+        INTERPRETER_LOGI(inter_, inter_.GetCurrentContext(), "ExecuteNativeFunc::Execute %s result: %d",
+            callSite.name.c_str(), ret);
+        // 无参调用不检查返回值，与 ExecuteNativeFunc 一致
+        if (callSite.hasParams && ret != USCRIPT_SUCCESS) {
+            Push(ScriptValue::Error(ret));
+        } else {
+            Push(ScriptValue(call.instrContext->GetOutVar()));
+        }
+        call.instrContext->Reset();
+        freeContexts_.push_back(std::move(call.instrContext));
+        return;
+    }
+
+    frames_.push_back({ pc, inter_.GetContextDepth(), stack_.size(), calls_.size(), lastValue_ });
+    inter_.ContextPush(call.funcContext);
+    lastValue_ = ScriptValue();
+    pc = program_.functions[callSite.function].entry;
+}
+
+bool ScriptVm::Return(ScriptValue value, size_t &pc)
+{
+    if (frames_.empty()) {
+        result_ = USCRIPT_SUCCESS;
+        return false;
+    }
+    CallFrame &frame = frames_.back();
+    pc = frame.returnPc;
+    while (inter_.GetContextDepth() > frame.contextDepth) {
+        inter_.ContextPop();
+    }
+    stack_.erase(stack_.begin() + frame.stackDepth, stack_.end());
+    calls_.erase(calls_.begin() + frame.callDepth, calls_.end());
+    lastValue_ = std::move(frame.lastValue);
+    frames_.pop_back();
+    Push(std::move(value));
+    return true;
+}
+
+bool ScriptVm::Raise(ScriptValue value, int32_t error, size_t &pc)
+{
+    // 函数内的错误作为函数返回值交给调用者处理
+    if (frames_.empty()) {
+        result_ = error;
+        return false;
+    }
+    return Return(std::move(value), pc);
+}
+} // namespace uscript
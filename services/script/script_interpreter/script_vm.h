@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef USCRIPT_VM_H
+#define USCRIPT_VM_H
+
+#include <vector>
+#include "script_compiler.h"
+#include "script_context.h"
+
+namespace uscript {
+class ScriptInterpreter;
+
+/**
+ * 执行 ScriptCompiler 生成的字节码。
+ * 变量保存在解释器上下文栈中各层上下文的槽位里，作用域规则与语法树执行一致。
+ */
+class ScriptVm {
+public:
+    ScriptVm(ScriptInterpreter &inter, const ScriptProgram &program);
+    ~ScriptVm() {}
+
+    int32_t Execute();
+
+private:
+    // 脚本函数调用帧
+    struct CallFrame {
+        size_t returnPc;
+        size_t contextDepth;
+        size_t stackDepth;
+        size_t callDepth;
+        ScriptValue lastValue;
+    };
+
+    // 正在计算实参的调用
+    struct PendingCall {
+        int32_t site;
+        UScriptInstruction *instruction;
+        UScriptEnv *env;
+        std::shared_ptr<UScriptInstructionContext> instrContext;
+        UScriptContextPtr funcContext;
+        size_t index;
+    };
+
+    // 调用点绑定的原生指令，指令表变化后重新查找
+    struct CallTarget {
+        UScriptInstruction *instruction = nullptr;
+        UScriptEnv *env = nullptr;
+        uint32_t version = 0;
+        bool bound = false;
+    };
+
+    ScriptValue Pop();
+    void Push(ScriptValue value)
+    {
+        stack_.push_back(std::move(value));
+    }
+
+    // 找不到时返回 nullptr
+    const ScriptValue *FindVariable(const ScriptVariable &variable) const;
+    void UpdateVariable(const ScriptVariable &variable, const ScriptValue &value);
+    // 按 UScriptInterpretContext::UpdateVariables 的规则把值依次保存到槽位
+    void DefineVariables(UScriptInterpretContext &context, const std::vector<int32_t> &slots,
+        const ScriptValue &value, size_t &index);
+    void Assign(int32_t target, ScriptValue value);
+    void Binary(int32_t action);
+    void MakeList(int32_t count);
+    void Call(int32_t site, size_t &pc);
+    void BindArg(int32_t site, size_t &pc);
+    void Invoke(int32_t site, size_t &pc);
+    // 返回 false 表示脚本执行结束
+    bool Return(ScriptValue value, size_t &pc);
+    bool Raise(ScriptValue value, int32_t error, size_t &pc);
+
+    ScriptInterpreter &inter_;
+    const ScriptProgram &program_;
+    // 操作数栈按值保存，整数、浮点数和短字符串不需要分配内存
+    std::vector<ScriptValue> stack_ {};
+    std::vector<CallFrame> frames_ {};
+    std::vector<PendingCall> calls_ {};
+    std::vector<CallTarget> targets_ {};
+    std::vector<std::shared_ptr<UScriptInstructionContext>> freeContexts_ {};
+    ScriptValue lastValue_ {};
+    int32_t result_ = USCRIPT_SUCCESS;
+};
+} // namespace uscript
+#endif // USCRIPT_VM_H
@@ -152,7 +152,7 @@ expression_statement:expression SEMICOLON
 expression: value_expression
         |IDENTIFIER ASSIGN expression
         {
-                $$ = AssignExpression::CreateExpression($1, $3);
+                $$ = AssignExpression::CreateExpression($1, $3, @1.begin.line);
         }
         |IDENTIFIER COMMA IDENTIFIER ASSIGN expression
         {
@@ -255,7 +255,7 @@ primary_expression:SUB primary_expression
         }
         |IDENTIFIER LP RP
         {
-                $$ = FunctionCallExpression::CreateExpression($1, nullptr);
+                $$ = FunctionCallExpression::CreateExpression($1, nullptr, @1.begin.line);
         }
         |IDENTIFIER LP arglist RP
         {
@@ -16,6 +16,7 @@
 #include <cstring>
 #include <dlfcn.h>
 #include "pkg_manager.h"
+#include "script_cache.h"
 #include "script_instructionhelper.h"
 #include "script_interpreter.h"
 #include "script_utils.h"
@@ -45,6 +46,8 @@ void ScriptManager::ReleaseScriptManager()
         delete g_scriptManager;
     }
     g_scriptManager = nullptr;
+    // 执行完成后不再需要缓存的脚本
+    ScriptCache::Clear();
 }
 
 ScriptManagerImpl::~ScriptManagerImpl()
@@ -115,11 +118,16 @@ int32_t ScriptManagerImpl::RegisterInstruction(ScriptInstructionHelper &helper)
 int32_t ScriptManagerImpl::ExtractAndExecuteScript(PkgManager::PkgManagerPtr manager,
     const std::string &scriptName)
 {
+    // 脚本解压到内存中直接解析，不再写临时文件
+    const FileInfo *info = manager->GetFileInfo(scriptName);
+    USCRIPT_CHECK(info != nullptr, return USCRIPT_INVALID_PARAM, "Failed to get file info %s", scriptName.c_str());
+    std::vector<uint8_t> content(info->unpackedSize);
     PkgManager::StreamPtr outStream = nullptr;
-    int32_t ret = manager->CreatePkgStream(outStream, scriptName, 0, PkgStream::PkgStreamType_Write);
+    int32_t ret = manager->CreatePkgStream(outStream, scriptName, PkgBuffer(content.data(), content.size()));
     USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to create script stream %s", scriptName.c_str());
     ret = manager->ExtractFile(scriptName, outStream);
-    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, return ret, "Failed to extract script stream %s", scriptName.c_str());
+    USCRIPT_CHECK(ret == USCRIPT_SUCCESS, manager->ClosePkgStream(outStream); return ret,
+        "Failed to extract script stream %s", scriptName.c_str());
 
     ret = ScriptInterpreter::ExecuteScript(this, outStream);
     manager->ClosePkgStream(outStream);
@@ -137,36 +145,33 @@ int32_t ScriptManagerImpl::ExecuteScript(int32_t priority)
         return USCRIPT_SUCCESS;
     }
 
-    // Execute scripts
-    int32_t threadNumber = threadPool_->GetThreadNumber();
-    Task task;
-    int32_t ret = USCRIPT_SUCCESS;
-    int32_t retCode = USCRIPT_SUCCESS;
-    task.workSize = threadNumber;
-    task.processor = [&](int iter) {
-        for (size_t i = iter; i < scriptFiles_[priority].size(); i += threadNumber) {
-            ret = ExtractAndExecuteScript(manager, scriptFiles_[priority][i]);
-            if (ret != USCRIPT_SUCCESS) {
-                USCRIPT_LOGE("Failed to execute script %s", scriptFiles_[priority][i].c_str());
-                retCode = ret;
-            }
+    // Execute scripts, 每个脚本一个下标，空闲线程自动领取剩余的脚本
+    std::atomic<int32_t> retCode { USCRIPT_SUCCESS };
+    threadPool_->ParallelFor(static_cast<int32_t>(scriptFiles_[priority].size()), [&](int32_t index) {
+        int32_t ret = ExtractAndExecuteScript(manager, scriptFiles_[priority][index]);
+        if (ret != USCRIPT_SUCCESS) {
+            USCRIPT_LOGE("Failed to execute script %s", scriptFiles_[priority][index].c_str());
+            retCode = ret;
         }
-    };
-    ThreadPool::AddTask(std::move(task));
+    });
     return retCode;
 }
 
 int32_t ScriptManagerImpl::AddInstruction(const std::string &instrName, const UScriptInstructionPtr instruction)
 {
     USCRIPT_LOGI("AddInstruction instrName: %s ", instrName.c_str());
-    if (scriptInstructions_.find(instrName) != scriptInstructions_.end()) {
+    auto iter = scriptInstructions_.find(instrName);
+    if (iter != scriptInstructions_.end()) {
         USCRIPT_LOGW("Instruction: %s exist", instrName.c_str());
         // New instruction has the same name
         // with already registered instruction,
         // just override it.
-        delete scriptInstructions_[instrName];
+        delete iter->second;
+        iter->second = instruction;
+    } else {
+        scriptInstructions_.emplace(instrName, instruction);
     }
-    scriptInstructions_[instrName] = instruction;
+    instructionVersion_++;
     return USCRIPT_SUCCESS;
 }
 
@@ -187,10 +192,8 @@ int32_t ScriptManagerImpl::AddScript(const std::string &scriptName, int32_t prio
 
 UScriptInstruction* ScriptManagerImpl::FindInstruction(const std::string &instrName)
 {
-    if (scriptInstructions_.find(instrName) == scriptInstructions_.end()) {
-        return nullptr;
-    }
-    return scriptInstructions_[instrName];
+    auto iter = scriptInstructions_.find(instrName);
+    return (iter == scriptInstructions_.end()) ? nullptr : iter->second;
 }
 
 UScriptEnv* ScriptManagerImpl::GetScriptEnv(const std::string &instrName) const
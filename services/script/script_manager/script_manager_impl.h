@@ -15,8 +15,10 @@
 #ifndef USCRIPT_MANAGER_IMPL_H
 #define USCRIPT_MANAGER_IMPL_H
 
+#include <atomic>
 #include <map>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 #include "pkg_manager.h"
 #include "script_instruction.h"
@@ -42,13 +44,19 @@ private:
     int32_t AddInstruction(const std::string &instrName, const UScriptInstructionPtr instruction);
     UScriptInstruction* FindInstruction(const std::string &instrName);
     UScriptEnv* GetScriptEnv(const std::string &instrName) const;
+    // 每次注册指令后递增，用于让缓存的指令失效
+    uint32_t GetInstructionVersion() const
+    {
+        return instructionVersion_;
+    }
     int32_t RegisterInstruction(ScriptInstructionHelper &helper);
 private:
     static const int32_t MAX_THREAD_POOL = 4;
-    std::map<std::string, UScriptInstructionPtr> scriptInstructions_;
+    std::unordered_map<std::string, UScriptInstructionPtr> scriptInstructions_;
     std::vector<std::string> scriptFiles_[MAX_PRIORITY] {};
     ThreadPool *threadPool_ = nullptr;
     UScriptEnv *scriptEnv_ = nullptr;
+    std::atomic<uint32_t> instructionVersion_ { 0 };
 };
 } // namespace uscript
 #endif
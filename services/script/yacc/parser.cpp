@@ -1315,12 +1315,13 @@ yyreduce:
                         }
                         case 43: { // primary_expression: IDENTIFIER LP RP
                             yylhs.value.as<UScriptExpression*>() = FunctionCallExpression::CreateExpression(
-                                yystack_[2].value.as<string>(), nullptr);
+                                yystack_[2].value.as<string>(), nullptr, yystack_[2].location.begin.line);
                             break;
                         }
                         case 44: { // primary_expression: IDENTIFIER LP arglist RP
                             yylhs.value.as<UScriptExpression*>() = FunctionCallExpression::CreateExpression(
-                                yystack_[3].value.as<string>(), yystack_[1].value.as<ScriptParams*>());
+                                yystack_[3].value.as<string>(), yystack_[1].value.as<ScriptParams*>(),
+                                yystack_[3].location.begin.line);
                             break;
                         }
                         case 45: { // statement_list: statement_list statement
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef USCRIPT_THREADPOOL_H
+#define USCRIPT_THREADPOOL_H
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uscript {
+struct Task {
+    std::function<void(int)> processor;
+    int32_t workSize;
+};
+
+/**
+ * 每个工作线程有自己的任务队列，空闲时从其他队列窃取任务，没有任务时阻塞等待。
+ * Submit 提交单个任务，ParallelFor 把一组工作分给调用线程和工作线程一起执行。
+ */
+class ThreadPool {
+public:
+    static ThreadPool* CreateThreadPool(int32_t number);
+    static void AddTask(Task &&task);
+    static void Destroy();
+
+    void Init(int32_t number);
+
+    void AddNewTask(Task &&task);
+
+    // 提交任务到工作线程执行，在任务中需要使用 Wait 等待同一线程池中其他任务的结果
+    template<typename Function>
+    std::future<decltype(std::declval<Function>()())> Submit(Function &&function)
+    {
+        using Result = decltype(std::declval<Function>()());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+        std::future<Result> result = task->get_future();
+        PushTask([task]() {
+            (*task)();
+        });
+        return result;
+    }
+
+    // 等待 Submit 返回的结果，等待期间帮忙执行排队中的任务，可以在任务中调用
+    template<typename Result>
+    Result Wait(std::future<Result> &future)
+    {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            // 队列为空说明等待的任务已经在其他线程执行，直接阻塞
+            if (!RunPendingTask()) {
+                future.wait();
+            }
+        }
+        return future.get();
+    }
+
+    // 对 [0, count) 中的每个下标调用一次 processor，全部完成后返回
+    void ParallelFor(int32_t count, const std::function<void(int32_t)> &processor);
+
+    int32_t GetThreadNumber() const
+    {
+        return threadNumber_;
+    }
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void ThreadRun(int32_t threadIndex);
+    void PushTask(std::function<void()> &&task);
+    bool PopTask(size_t queueIndex, std::function<void()> &task);
+    bool RunPendingTask();
+
+    static void ThreadExecute(void* context, int32_t threadIndex)
+    {
+        ((ThreadPool*)context)->ThreadRun(threadIndex);
+    }
+
+    ThreadPool()
+    {
+    }
+    ~ThreadPool();
+
+private:
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::atomic<uint32_t> nextQueue_ = { 0 };
+    std::atomic<int32_t> pendingTasks_ = { 0 };
+    std::atomic<int32_t> parkedWorkers_ = { 0 };
+    std::atomic<bool> stop_ = { false };
+
+    std::mutex parkMutex_;
+    std::condition_variable parkCondition_;
+    int32_t threadNumber_ = 0;
+};
+} // namespace uscript
+#endif
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "thread_pool.h"
+#include <cstring>
+#include "log/log.h"
+
+using namespace updater;
+
+namespace uscript {
+static ThreadPool* g_threadPool = nullptr;
+static std::mutex g_initMutex;
+// 当前工作线程使用的队列，非工作线程为 -1
+static thread_local int32_t g_queueIndex = -1;
+
+ThreadPool* ThreadPool::CreateThreadPool(int number)
+{
+    UPDATER_ERROR_CHECK(number > 1, "Invalid number " << number, return nullptr);
+    std::lock_guard<std::mutex> lock(g_initMutex);
+    if (g_threadPool != nullptr) {
+        return g_threadPool;
+    }
+    if (g_threadPool == nullptr) {
+        g_threadPool = new ThreadPool();
+        g_threadPool->Init(number);
+    }
+    return g_threadPool;
+}
+
+void ThreadPool::Destroy()
+{
+    if (g_threadPool == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_initMutex);
+    delete g_threadPool;
+    g_threadPool = nullptr;
+}
+
+void ThreadPool::Init(int32_t numberThread)
+{
+    threadNumber_ = numberThread;
+    // 调用线程作为第 0 个线程参与 ParallelFor，只为其他线程创建队列
+    for (int32_t threadIndex = 1; threadIndex < threadNumber_; ++threadIndex) {
+        queues_.emplace_back(new WorkQueue());
+    }
+    // Create workers
+    for (int32_t threadIndex = 1; threadIndex < threadNumber_; ++threadIndex) {
+        workers_.emplace_back(std::thread(ThreadPool::ThreadExecute, this, threadIndex));
+    }
+}
+
+void ThreadPool::ThreadRun(int32_t threadIndex)
+{
+    g_queueIndex = threadIndex - 1;
+    std::function<void()> task;
+    while (true) {
+        if (PopTask(static_cast<size_t>(g_queueIndex), task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        // 没有任务时阻塞，PushTask 先增加 pendingTasks_ 再检查 parkedWorkers_，不会丢失唤醒
+        std::unique_lock<std::mutex> lock(parkMutex_);
+        parkedWorkers_++;
+        parkCondition_.wait(lock, [this] {
+            return stop_ || pendingTasks_ > 0;
+        });
+        parkedWorkers_--;
+        if (stop_ && pendingTasks_ <= 0) {
+            break;
+        }
+    }
+    printf("ThreadPool::ThreadRun %d exit \n", threadIndex);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(parkMutex_);
+        stop_ = true;
+    }
+    parkCondition_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::PushTask(std::function<void()> &&task)
+{
+    // 工作线程提交的任务放到自己的队列，其他线程轮流放到各个队列
+    size_t index = (g_queueIndex >= 0 && static_cast<size_t>(g_queueIndex) < queues_.size()) ?
+        static_cast<size_t>(g_queueIndex) : (nextQueue_++ % queues_.size());
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    pendingTasks_++;
+    if (parkedWorkers_ > 0) {
+        std::lock_guard<std::mutex> lock(parkMutex_);
+        parkCondition_.notify_one();
+    }
+}
+
+bool ThreadPool::PopTask(size_t queueIndex, std::function<void()> &task)
+{
+    // 先从自己队列的尾部取，再从其他队列的头部窃取
+    for (size_t i = 0; i < queues_.size(); ++i) {
+        WorkQueue &queue = *queues_[(queueIndex + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        pendingTasks_--;
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::RunPendingTask()
+{
+    if (queues_.empty()) {
+        return false;
+    }
+    std::function<void()> task;
+    size_t index = (g_queueIndex >= 0) ? static_cast<size_t>(g_queueIndex) : 0;
+    if (!PopTask(index, task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::AddTask(Task &&task)
+{
+    if (g_threadPool != nullptr) {
+        g_threadPool->AddNewTask(std::move(task));
+    }
+}
+
+void ThreadPool::AddNewTask(Task &&task)
+{
+    LOG(INFO) << "ThreadPool::AddNewTask " << task.workSize;
+    ParallelFor(task.workSize, task.processor);
+}
+
+void ThreadPool::ParallelFor(int32_t count, const std::function<void(int32_t)> &processor)
+{
+    // If there are no multi-works
+    // Do not need to enqueue, execute it immediately
+    if (count <= 1 || queues_.empty()) {
+        for (int32_t i = 0; i < count; ++i) {
+            processor(i);
+        }
+        return;
+    }
+
+    // 各线程按顺序领取下标，领不到下标的辅助任务直接结束；state 由辅助任务共同持有，调用者返回后仍然有效
+    struct ParallelState {
+        std::atomic<int32_t> next { 0 };
+        std::atomic<int32_t> finished { 0 };
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+    auto state = std::make_shared<ParallelState>();
+    auto run = [state, count, &processor]() {
+        for (int32_t i = state->next++; i < count; i = state->next++) {
+            processor(i);
+            if (++state->finished == count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->condition.notify_all();
+            }
+        }
+    };
+    int32_t helpers = std::min(count, threadNumber_) - 1;
+    for (int32_t i = 0; i < helpers; ++i) {
+        PushTask(run);
+    }
+    run();
+
+    // 只等待已经领取的下标执行完成，不依赖排队中的辅助任务，嵌套调用不会死锁
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [&state, count] {
+        return state->finished == count;
+    });
+}
+} // namespace uscript
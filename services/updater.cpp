@@ -33,6 +33,7 @@
 #include "progress_bar.h"
 #include "text_label.h"
 #include "updater/updater_const.h"
+#include "updater/updater_message.h"
 #include "updater_main.h"
 #include "updater_ui.h"
 #include "utils.h"
@@ -66,6 +67,8 @@ int GetUpdatePackageInfo(PkgManager::PkgManagerPtr pkgManager, const std::string
         LOG(ERROR) << "Fail to GetPackageInstance";
         return UPDATE_CORRUPT;
     }
+    // 只按名字读取 updater_binary 等少数文件，entry 在第一次查找时再创建
+    pkgManager->SetLazyLoad(true);
     int32_t ret = pkgManager->LoadPackage(path, utils::GetCertName(), components);
     if (ret != PKG_SUCCESS) {
         LOG(INFO) << "LoadPackage fail ret :"<< ret;
@@ -217,6 +220,24 @@ UpdaterStatus DoInstallUpdaterPackage(PkgManager::PkgManagerPtr pkgManager, cons
     return updateRet;
 }
 
+static void HandleChildProgress(float frac)
+{
+    if (frac >= -EPSINON && frac <= EPSINON) {
+        return;
+    } else {
+        g_tmpProgressValue = static_cast<int>(frac * g_percentage);
+    }
+    if (frac >= FULL_EPSINON && g_tmpValue + g_percentage < FULL_PERCENT_PROGRESS) {
+        g_tmpValue += g_percentage;
+        return;
+    }
+    g_tmpProgressValue = g_tmpProgressValue + g_tmpValue;
+    if (g_tmpProgressValue == 0) {
+        return;
+    }
+    g_progressBar->SetProgressValue(g_tmpProgressValue);
+}
+
 static void HandleChildOutput(const std::string &buffer, int32_t bufferLen,
     bool &retryUpdate)
 {
@@ -249,23 +270,7 @@ static void HandleChildOutput(const std::string &buffer, int32_t bufferLen,
         }
     } else if (outputHeader == "set_progress") {
         UPDATER_ERROR_CHECK(output.size() >= DEFAULT_PROCESS_NUM, "check output fail", return);
-        auto outputInfo = Trim(output[1]);
-        float frac = 0.0;
-        frac = std::stof(output[1]);
-        if (frac >= -EPSINON && frac <= EPSINON) {
-            return;
-        } else {
-            g_tmpProgressValue = static_cast<int>(frac * g_percentage);
-        }
-        if (frac >= FULL_EPSINON && g_tmpValue + g_percentage < FULL_PERCENT_PROGRESS) {
-            g_tmpValue += g_percentage;
-            return;
-        }
-        g_tmpProgressValue = g_tmpProgressValue + g_tmpValue;
-        if (g_tmpProgressValue == 0) {
-            return;
-        }
-        g_progressBar->SetProgressValue(g_tmpProgressValue);
+        HandleChildProgress(std::stof(output[1]));
     } else {
         LOG(WARNING) << "Child process returns unexpected message.";
     }
@@ -315,6 +320,8 @@ UpdaterStatus StartUpdaterProc(PkgManager::PkgManagerPtr pkgManager, const std::
                 LOG(WARNING) << "Cannot set current process schedule with SCHED_OTHER";
             }
         }
+        // 告诉子进程支持的消息协议版本，旧版本的 updater_binary 会忽略并继续输出文本
+        setenv(MESSAGE_VERSION_ENV, std::to_string(MESSAGE_VERSION).c_str(), 1);
         if (retryCount > 0) {
             execl(fullPath.c_str(), packagePath.c_str(), std::to_string(pipeWrite).c_str(), "retry", nullptr);
         } else {
@@ -327,16 +334,21 @@ UpdaterStatus StartUpdaterProc(PkgManager::PkgManagerPtr pkgManager, const std::
     close(pipeWrite); // close write endpoint
     char buffer[MAX_BUFFER_SIZE];
     bool retryUpdate = false;
-    FILE* fromChild = fdopen(pipeRead, "r");
-    UPDATER_ERROR_CHECK(fromChild != nullptr, "fdopen pipeRead failed", return UPDATE_ERROR);
-    while (fgets(buffer, MAX_BUFFER_SIZE - 1, fromChild) != nullptr) {
-        size_t n = strlen(buffer);
-        if (buffer[n - 1] == '\n') {
-            buffer[n - 1] = '\0';
+    MessageParser parser([&retryUpdate](const std::string &message) {
+        HandleChildOutput(message, message.size(), retryUpdate);
+    }, HandleChildProgress);
+    while (true) {
+        ssize_t n = read(pipeRead, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
         }
-        HandleChildOutput(buffer, MAX_BUFFER_SIZE,  retryUpdate);
+        parser.Parse(buffer, static_cast<size_t>(n));
     }
-    fclose(fromChild);
+    parser.Finish();
+    close(pipeRead);
 
     int status;
     waitpid(pid, &status, 0);
@@ -24,6 +24,7 @@
 #include "applypatch/store.h"
 #include "applypatch/transfer_manager.h"
 #include "applypatch/partition_record.h"
+#include "applypatch/updater_env.h"
 #include "fs_manager/mount.h"
 #include "log/log.h"
 #include "utils.h"
@@ -75,7 +76,6 @@ void* UnpackNewData(void *arg)
 {
     WriterThreadInfo *info = static_cast<WriterThreadInfo *>(arg);
     hpackage::PkgManager::StreamPtr stream = nullptr;
-    TransferManagerPtr tm = TransferManager::GetTransferManagerInstance();
     if (info->newPatch.empty()) {
         LOG(ERROR) << "new patch file name is empty. thread quit.";
         pthread_mutex_lock(&info->mutex);
@@ -87,7 +87,8 @@ void* UnpackNewData(void *arg)
         return nullptr;
     }
     LOG(DEBUG) << "new patch file name: " << info->newPatch;
-    auto env = tm->GetGlobalParams()->env;
+    // TransferManager 按线程区分，这里使用启动线程时保存的 env
+    auto env = info->env;
     const FileInfo *file = env->GetPkgManager()->GetFileInfo(info->newPatch);
     if (file == nullptr) {
         LOG(ERROR) << "Cannot get file info of :" << info->newPatch;
@@ -173,7 +174,13 @@ static int32_t ExecuteTransferCommand(int fd, const std::vector<std::string> &li
     auto globalParams = tm->GetGlobalParams();
     auto writerThreadInfo = globalParams->writerThreadInfo.get();
 
+    // 并发更新时每个分区使用与 update_tmp 同级的单独目录，顺序更新清理 update_tmp 时不会删除
+    UpdaterEnv *updaterEnv = dynamic_cast<UpdaterEnv *>(&env);
     globalParams->storeBase = "/data/updater/update_tmp";
+    if (updaterEnv != nullptr && updaterEnv->IsConcurrent()) {
+        size_t start = partitionName.find_first_not_of('/');
+        globalParams->storeBase += "_" + ((start == std::string::npos) ? "" : partitionName.substr(start));
+    }
     globalParams->retryFile = std::string("/data/updater") + partitionName + "_retry";
     LOG(INFO) << "Store base path is " << globalParams->storeBase;
     int32_t ret = Store::CreateNewSpace(globalParams->storeBase, !globalParams->env->IsRetry());
@@ -212,6 +219,7 @@ static int InitThread(struct UpdateBlockInfo &infos, uscript::UScriptEnv &env, u
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
     writerThreadInfo->newPatch = infos.newDataName;
+    writerThreadInfo->env = &env;
     int error = pthread_create(&globalParams->thread, &attr, UnpackNewData, writerThreadInfo);
     return error;
 }
@@ -307,6 +315,7 @@ static int32_t ExecuteUpdateBlock(uscript::UScriptEnv &env, uscript::UScriptCont
         env.GetPkgManager()->ClosePkgStream(outStream); return USCRIPT_ERROR_EXECUTE);
     outStream->GetBuffer(globalParams->patchDataBuffer, globalParams->patchDataSize);
     LOG(DEBUG) << "Patch data size is: " << globalParams->patchDataSize;
+    context.AddProcessedBytes(globalParams->patchDataSize);
     ret = DoExecuteUpdateBlock(infos, env, outStream, lines, context);
     TransferManager::ReleaseTransferManagerInstance(tm);
     return ret;
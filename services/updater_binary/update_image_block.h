@@ -39,6 +39,11 @@ public:
     UScriptInstructionShaCheck() {}
     virtual ~UScriptInstructionShaCheck() {}
     int32_t Execute(uscript::UScriptEnv &env, uscript::UScriptContext &context) override;
+    // 只读取分区数据，不同分区可以并发校验
+    bool IsAsyncSafe() const override
+    {
+        return true;
+    }
 };
 }
 
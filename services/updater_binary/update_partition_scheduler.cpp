@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "update_partition_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <unordered_map>
+#include "applypatch/transfer_manager.h"
+#include "log/log.h"
+#include "script_manager.h"
+#include "updater/updater_const.h"
+
+using namespace uscript;
+
+namespace updater {
+// 任务中的指令通过这个 env 上报进度，其他消息直接转发
+class PartitionTaskEnv : public UpdaterEnv {
+public:
+    PartitionTaskEnv(UpdaterEnv &env, PartitionScheduler &scheduler, size_t index)
+        : UpdaterEnv(env.GetPkgManager(), nullptr, env.IsRetry()), env_(env), scheduler_(scheduler), index_(index) {}
+    ~PartitionTaskEnv() override {}
+
+    void PostMessage(const std::string &cmd, std::string content) override
+    {
+        if (cmd == "set_progress") {
+            PostProgress(strtof(content.c_str(), nullptr));
+            return;
+        }
+        env_.PostMessage(cmd, std::move(content));
+    }
+    void PostProgress(float progress) override
+    {
+        scheduler_.UpdateProgress(index_, progress);
+    }
+    bool IsConcurrent() const override
+    {
+        return true;
+    }
+private:
+    UpdaterEnv &env_;
+    PartitionScheduler &scheduler_;
+    size_t index_;
+};
+
+int32_t PartitionScheduler::AddTask(float weight, std::unique_ptr<UScriptInstruction> instruction,
+    std::unique_ptr<UScriptInstructionContext> context)
+{
+    UPDATER_ERROR_CHECK(weight > 0 && instruction != nullptr && context != nullptr, "Invalid partition task",
+        return USCRIPT_INVALID_PARAM);
+    std::string partitionName;
+    UPDATER_ERROR_CHECK(context->GetParam(0, partitionName) == USCRIPT_SUCCESS, "Invalid partition name",
+        return USCRIPT_INVALID_PARAM);
+    // 同一个分区的任务不能并发执行
+    for (auto &task : tasks_) {
+        UPDATER_ERROR_CHECK(task.partitionName != partitionName, "Duplicate partition " << partitionName,
+            return USCRIPT_INVALID_PARAM);
+    }
+    Task task {};
+    task.partitionName = partitionName;
+    task.weight = weight;
+    task.instruction = std::move(instruction);
+    task.context = std::move(context);
+    tasks_.push_back(std::move(task));
+    totalWeight_ += weight;
+    return USCRIPT_SUCCESS;
+}
+
+int32_t PartitionScheduler::Run(size_t threadNum)
+{
+    UPDATER_ERROR_CHECK(!tasks_.empty(), "No partition to update", return USCRIPT_INVALID_PARAM);
+    // 当前线程和另外启动的线程最多 threadNum 个 worker 同时取任务。
+    // 分区任务不放进脚本的共享线程池，其他线程在 Wait 中不会嵌套执行分区任务，分区之间不会被串行
+    std::atomic<size_t> next { 0 };
+    auto worker = [this, &next]() {
+        for (size_t index = next++; index < tasks_.size(); index = next++) {
+            RunTask(index);
+        }
+    };
+    size_t count = std::max<size_t>(std::min(threadNum, tasks_.size()), 1);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < count; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    int32_t ret = USCRIPT_SUCCESS;
+    for (auto &task : tasks_) {
+        if (task.result != USCRIPT_SUCCESS) {
+            LOG(ERROR) << "Failed to update " << task.partitionName << " ret " << task.result;
+            ret = (ret == USCRIPT_SUCCESS) ? task.result : ret;
+        }
+    }
+    if (ret == USCRIPT_SUCCESS) {
+        env_.PostProgress(FULL_EPSINON);
+    }
+    return ret;
+}
+
+void PartitionScheduler::RunTask(size_t index)
+{
+    Task &task = tasks_[index];
+    LOG(INFO) << "Start to update " << task.partitionName;
+    PartitionTaskEnv taskEnv(env_, *this, index);
+    // TransferManager 按线程保存，当前线程会依次执行多个任务，调用 Run 的线程可能已经有外层的实例，
+    // 因此每个任务使用新的实例，结束后恢复该线程原来的实例
+    TransferManagerPtr outerInstance = TransferManager::DetachTransferManagerInstance();
+    task.result = task.instruction->Execute(taskEnv, *task.context);
+    // 失败的任务可能没有释放实例，其写数据线程可能还在使用，不能删除
+    UPDATER_WARNING_CHECK_NOT_RETURN(TransferManager::DetachTransferManagerInstance() == nullptr,
+        "Transfer manager of " << task.partitionName << " is not released");
+    TransferManager::AttachTransferManagerInstance(outerInstance);
+    if (task.result == USCRIPT_SUCCESS) {
+        // 重试时跳过的分区不会上报进度
+        UpdateProgress(index, FULL_EPSINON);
+    }
+    LOG(INFO) << "Update " << task.partitionName << " finish, ret " << task.result;
+}
+
+void PartitionScheduler::UpdateProgress(size_t index, float progress)
+{
+    std::lock_guard<std::mutex> lock(progressMutex_);
+    tasks_[index].progress = std::min(std::max(progress, 0.0f), FULL_EPSINON);
+    float total = 0.0f;
+    for (auto &task : tasks_) {
+        total += task.weight * task.progress;
+    }
+    total /= totalWeight_;
+    // 进度为 1 时 updater 会进入下一阶段，只能由 Run 在全部成功后上报一次
+    if (total < FULL_EPSINON) {
+        env_.PostProgress(total);
+    }
+}
+
+uint64_t PartitionScheduler::GetProcessedBytes() const
+{
+    uint64_t bytes = 0;
+    for (auto &task : tasks_) {
+        bytes += task.context->GetProcessedBytes();
+    }
+    return bytes;
+}
+
+// 支持并发执行的指令及其参数个数
+static const std::unordered_map<std::string, int32_t> &GetPartitionInstructions()
+{
+    static const std::unordered_map<std::string, int32_t> instructions = {
+        { "block_update", 4 },
+        { "raw_image_write", 1 },
+        { "sparse_image_write", 1 },
+    };
+    return instructions;
+}
+
+static int32_t GetTaskWeight(UScriptContext &context, int32_t index, float &weight)
+{
+    if (context.GetParamType(index) == UScriptContext::PARAM_TYPE_INTEGER) {
+        int32_t value = 0;
+        int32_t ret = context.GetParam(index, value);
+        weight = static_cast<float>(value);
+        return ret;
+    }
+    return context.GetParam(index, weight);
+}
+
+int32_t UScriptInstructionPartitionUpdate::Execute(UScriptEnv &env, UScriptContext &context)
+{
+    UPDATER_ERROR_CHECK(env.GetPkgManager() != nullptr, "Error to get pkg manager", return USCRIPT_ERROR_EXECUTE);
+    UScriptInstructionFactoryPtr factory = env.GetInstructionFactory();
+    UPDATER_ERROR_CHECK(factory != nullptr, "Error to get instruction factory", return USCRIPT_ERROR_EXECUTE);
+    UpdaterEnv *updaterEnv = dynamic_cast<UpdaterEnv *>(&env);
+    UPDATER_ERROR_CHECK(updaterEnv != nullptr, "Partition update needs updater env", return USCRIPT_INVALID_PARAM);
+    PartitionScheduler scheduler(*updaterEnv);
+    int32_t index = 0;
+    while (index < context.GetParamCount()) {
+        float weight = 0;
+        std::string instrName;
+        int32_t ret = GetTaskWeight(context, index++, weight);
+        UPDATER_ERROR_CHECK(ret == USCRIPT_SUCCESS, "Error to get weight of task", return USCRIPT_INVALID_PARAM);
+        ret = context.GetParam(index++, instrName);
+        UPDATER_ERROR_CHECK(ret == USCRIPT_SUCCESS, "Error to get instruction of task", return USCRIPT_INVALID_PARAM);
+        auto iter = GetPartitionInstructions().find(instrName);
+        UPDATER_ERROR_CHECK(iter != GetPartitionInstructions().end(), "Unsupported partition task " << instrName,
+            return USCRIPT_INVALID_PARAM);
+        UPDATER_ERROR_CHECK(index + iter->second <= context.GetParamCount(), "Invalid param of " << instrName,
+            return USCRIPT_INVALID_PARAM);
+
+        std::unique_ptr<UScriptInstructionContext> taskContext = std::make_unique<UScriptInstructionContext>();
+        for (int32_t i = 0; i < iter->second; i++) {
+            ret = taskContext->CopyInputParam(context, index++);
+            UPDATER_ERROR_CHECK(ret == USCRIPT_SUCCESS, "Error to get param of " << instrName, return ret);
+        }
+        UScriptInstructionPtr instr = nullptr;
+        ret = factory->CreateInstructionInstance(instr, instrName);
+        UPDATER_ERROR_CHECK(ret == USCRIPT_SUCCESS && instr != nullptr, "Error to create " << instrName,
+            return USCRIPT_ERROR_EXECUTE);
+        ret = scheduler.AddTask(weight, std::unique_ptr<UScriptInstruction>(instr), std::move(taskContext));
+        UPDATER_CHECK_ONLY_RETURN(ret == USCRIPT_SUCCESS, return ret);
+    }
+    int32_t ret = scheduler.Run();
+    context.AddProcessedBytes(scheduler.GetProcessedBytes());
+    return ret;
+}
+} // namespace updater
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef UPDATER_UPDATE_PARTITION_SCHEDULER_H
+#define UPDATER_UPDATE_PARTITION_SCHEDULER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "applypatch/updater_env.h"
+#include "script_context.h"
+#include "script_instruction.h"
+
+namespace updater {
+/**
+ * 在单独的线程中同时更新不同的分区，最多 MAX_PARTITION_THREADS 个分区同时执行。
+ * 每个任务的进度按权重合并成一个进度上报，全部任务成功后才上报 1。
+ * 一个分区失败不会中断其他分区，成功的分区由各自的指令记录到 PartitionRecord，重试时跳过。
+ */
+class PartitionScheduler {
+public:
+    static constexpr size_t MAX_PARTITION_THREADS = 4;
+
+    explicit PartitionScheduler(UpdaterEnv &env) : env_(env) {}
+    ~PartitionScheduler() {}
+
+    // 第一个参数为分区名，同一个分区只能添加一次，指令的输出被忽略
+    int32_t AddTask(float weight, std::unique_ptr<uscript::UScriptInstruction> instruction,
+        std::unique_ptr<uscript::UScriptInstructionContext> context);
+    // 执行全部任务并等待结束，返回第一个失败任务的错误码
+    int32_t Run(size_t threadNum = MAX_PARTITION_THREADS);
+    void UpdateProgress(size_t index, float progress);
+    uint64_t GetProcessedBytes() const;
+private:
+    struct Task {
+        std::string partitionName;
+        float weight;
+        std::unique_ptr<uscript::UScriptInstruction> instruction;
+        std::unique_ptr<uscript::UScriptInstructionContext> context;
+        float progress = 0.0f;
+        int32_t result = 0;
+    };
+
+    void RunTask(size_t index);
+
+    UpdaterEnv &env_;
+    std::vector<Task> tasks_ {};
+    float totalWeight_ = 0.0f;
+    std::mutex progressMutex_;
+};
+
+/**
+ * partition_update(weight, "block_update", "/system", transfer, newData, patchData,
+ *     weight, "raw_image_write", "/boot", weight, "sparse_image_write", "/vendor", ...)
+ * 每个任务由权重、指令名和该指令的参数组成，通过 PartitionScheduler 并发执行
+ */
+class UScriptInstructionPartitionUpdate : public uscript::UScriptInstruction {
+public:
+    UScriptInstructionPartitionUpdate() {}
+    virtual ~UScriptInstructionPartitionUpdate() {}
+    int32_t Execute(uscript::UScriptEnv &env, uscript::UScriptContext &context) override;
+};
+} // namespace updater
+#endif // UPDATER_UPDATE_PARTITION_SCHEDULER_H
@@ -13,28 +13,37 @@
  * limitations under the License.
  */
 #include "update_processor.h"
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <memory>
 #include <string>
 #include <unistd.h>
+#include <unordered_map>
 #include "applypatch/data_writer.h"
 #include "applypatch/partition_record.h"
 #include "log.h"
 #include "pkg_manager.h"
 #include "script_instruction.h"
 #include "script_manager.h"
+#include "script_profiler.h"
 #include "update_image_block.h"
+#include "update_partition_scheduler.h"
 #include "update_partitions.h"
+#include "updater/updater_const.h"
+#include "updater/updater_message.h"
 
 using namespace uscript;
 using namespace hpackage;
 using namespace updater;
 
 namespace updater {
-size_t UScriptInstructionRawImageWrite::totalSize_ = 0;
-size_t UScriptInstructionRawImageWrite::readSize_ = 0;
 UpdaterEnv::~UpdaterEnv()
 {
+    {
+        std::lock_guard<std::mutex> lock(messageMutex_);
+        FlushProgress();
+    }
     if (factory_ != nullptr) {
         delete factory_;
         factory_ = nullptr;
@@ -43,9 +52,61 @@ UpdaterEnv::~UpdaterEnv()
 
 void UpdaterEnv::PostMessage(const std::string &cmd, std::string content)
 {
-    if (pipeWrite_ != nullptr) {
-        fprintf(pipeWrite_, "%s:%s\n", cmd.c_str(), content.c_str());
+    if (cmd == "set_progress") {
+        PostProgress(strtof(content.c_str(), nullptr));
+        return;
+    }
+    std::lock_guard<std::mutex> lock(messageMutex_);
+    // 先发出合并的进度，保证消息顺序
+    FlushProgress();
+    WriteMessage(cmd, content);
+}
+
+void UpdaterEnv::PostProgress(float progress)
+{
+    std::lock_guard<std::mutex> lock(messageMutex_);
+    progressPending_ = true;
+    pendingProgress_ = progress;
+    pendingCount_++;
+    // 进度完成时 updater 会累加阶段进度，需要立即发出
+    if (progress >= FULL_EPSINON || std::fabs(progress - sentProgress_) >= MESSAGE_PROGRESS_STEP) {
+        FlushProgress();
+    }
+}
+
+void UpdaterEnv::WriteMessage(const std::string &cmd, const std::string &content)
+{
+    if (pipeWrite_ == nullptr) {
+        return;
+    }
+    std::string message = cmd + ":" + content;
+    if (messageVersion_ > 0 && message.size() <= MAX_MESSAGE_SIZE &&
+        WriteMessageFrame(pipeWrite_, messageVersion_, MESSAGE_TYPE_TEXT, message.data(), message.size())) {
+        return;
+    }
+    // 对端不支持二进制帧或者消息过长时使用文本
+    fprintf(pipeWrite_, "%s\n", message.c_str());
+    fflush(pipeWrite_);
+}
+
+void UpdaterEnv::FlushProgress()
+{
+    if (!progressPending_) {
+        return;
+    }
+    progressPending_ = false;
+    sentProgress_ = pendingProgress_;
+    MessageProgress record { pendingProgress_, pendingCount_ };
+    pendingCount_ = 0;
+    if (pipeWrite_ == nullptr) {
+        return;
     }
+    if (messageVersion_ > 0 &&
+        WriteMessageFrame(pipeWrite_, messageVersion_, MESSAGE_TYPE_PROGRESS, &record, sizeof(record))) {
+        return;
+    }
+    fprintf(pipeWrite_, "set_progress:%f\n", record.progress);
+    fflush(pipeWrite_);
 }
 
 UScriptInstructionFactoryPtr UpdaterEnv::GetInstructionFactory()
@@ -56,39 +117,66 @@ UScriptInstructionFactoryPtr UpdaterEnv::GetInstructionFactory()
     return factory_;
 }
 
-const std::vector<std::string> UpdaterEnv::GetInstructionNames() const
+using InstructionCreator = UScriptInstructionPtr (*)();
+
+template<class Instruction>
+static UScriptInstructionPtr CreateInstruction()
+{
+    return new Instruction();
+}
+
+// 指令名到创建函数的映射，GetInstructionNames 和 CreateInstructionInstance 共用
+static const std::unordered_map<std::string, InstructionCreator> &GetInstructionRegistry()
 {
-    static std::vector<std::string> updaterCmds = {
-        "sparse_image_write", "sha_check", "first_block_check", "block_update",
-        "raw_image_write", "update_partitions"
+    static const std::unordered_map<std::string, InstructionCreator> registry = {
+        { "sparse_image_write", CreateInstruction<UScriptInstructionSparseImageWrite> },
+        { "sha_check", CreateInstruction<UScriptInstructionShaCheck> },
+        { "first_block_check", CreateInstruction<UScriptInstructionBlockCheck> },
+        { "block_update", CreateInstruction<UScriptInstructionBlockUpdate> },
+        { "raw_image_write", CreateInstruction<UScriptInstructionRawImageWrite> },
+        { "update_partitions", CreateInstruction<UpdatePartitions> },
+        { "partition_update", CreateInstruction<UScriptInstructionPartitionUpdate> },
     };
+    return registry;
+}
+
+const std::vector<std::string> UpdaterEnv::GetInstructionNames() const
+{
+    static const std::vector<std::string> updaterCmds = [] {
+        std::vector<std::string> names;
+        for (auto &entry : GetInstructionRegistry()) {
+            names.push_back(entry.first);
+        }
+        return names;
+    }();
     return updaterCmds;
 }
 
 int32_t UpdaterInstructionFactory::CreateInstructionInstance(UScriptInstructionPtr& instr,
     const std::string& name)
 {
-    if (name == "sparse_image_write") {
-        instr = new UScriptInstructionSparseImageWrite();
-    } else if (name == "sha_check") {
-        instr = new UScriptInstructionShaCheck();
-    } else if (name == "first_block_check") {
-        instr = new UScriptInstructionBlockCheck();
-    } else if (name == "block_update") {
-        instr = new UScriptInstructionBlockUpdate();
-    } else if (name == "raw_image_write") {
-        instr = new UScriptInstructionRawImageWrite();
-    } else if (name == "update_partitions") {
-        instr = new UpdatePartitions();
-    }
+    auto iter = GetInstructionRegistry().find(name);
+    UPDATER_ERROR_CHECK(iter != GetInstructionRegistry().end(), "Unknown instruction " << name,
+        return USCRIPT_NOTEXIST_INSTRUCTION);
+    instr = iter->second();
     return USCRIPT_SUCCESS;
 }
 
-int UScriptInstructionRawImageWrite::RawImageWriteProcessor(const PkgBuffer &buffer, size_t size, size_t start,
-                                                            bool isFinish, const void* context)
+struct ImageWriteContext {
+    DataWriter *writer;
+    UpdaterEnv *env; // 并发执行时每次调用的 env 可能不同
+    WriteMode mode;
+    size_t totalSize;
+    size_t readSize;
+};
+
+// 解压出的数据直接交给 writer，不需要把整个镜像保存在内存中
+static int ImageWriteProcessor(const PkgBuffer &buffer, size_t size, size_t start, bool isFinish,
+    const void* context)
 {
     void *p = const_cast<void *>(context);
-    DataWriter *writer = static_cast<DataWriter *>(p);
+    ImageWriteContext *writeContext = static_cast<ImageWriteContext *>(p);
+    DataWriter *writer = (writeContext != nullptr) ? writeContext->writer : nullptr;
     if (writer == nullptr) {
         LOG(ERROR) << "Data writer is null";
         return PKG_INVALID_STREAM;
@@ -99,15 +187,15 @@ int UScriptInstructionRawImageWrite::RawImageWriteProcessor(const PkgBuffer &buf
         return PKG_SUCCESS;
     }
 
-    bool ret = writer->Write(const_cast<uint8_t*>(buffer.buffer), size, WRITE_RAW, "");
+    bool ret = writer->Write(const_cast<uint8_t*>(buffer.buffer), size, writeContext->mode, "");
     if (!ret) {
         LOG(ERROR) << "Write " << size << " byte(s) failed";
         return PKG_INVALID_STREAM;
     }
 
-    if (totalSize_ != 0) {
-        readSize_ += size;
-        writer->GetUpdaterEnv()->PostMessage("set_progress", std::to_string((float)readSize_ / totalSize_));
+    if (writeContext->totalSize != 0) {
+        writeContext->readSize += size;
+        writeContext->env->PostProgress((float)writeContext->readSize / writeContext->totalSize);
     }
 
     return PKG_SUCCESS;
@@ -130,8 +218,7 @@ int32_t UScriptInstructionRawImageWrite::Execute(uscript::UScriptEnv &env, uscri
     LOG(INFO) << "UScriptInstructionRawImageWrite::Execute " << partitionName;
     UPDATER_ERROR_CHECK(env.GetPkgManager() != nullptr, "Error to get pkg manager", return USCRIPT_ERROR_EXECUTE);
 
-    std::unique_ptr<DataWriter> writer = DataWriter::CreateDataWriter(WRITE_RAW, partitionName,
-        static_cast<UpdaterEnv *>(&env));
+    std::unique_ptr<DataWriter> writer = DataWriter::CreateDataWriter(WRITE_RAW, partitionName);
     UPDATER_ERROR_CHECK(writer != nullptr, "Error to create writer", return USCRIPT_ERROR_EXECUTE);
 
     // Extract partition information
@@ -139,9 +226,9 @@ int32_t UScriptInstructionRawImageWrite::Execute(uscript::UScriptEnv &env, uscri
     const FileInfo *info = env.GetPkgManager()->GetFileInfo(partitionName);
     UPDATER_ERROR_CHECK(info != nullptr, "Error to get file info",
         DataWriter::ReleaseDataWriter(writer); return USCRIPT_ERROR_EXECUTE);
-    totalSize_ = info->unpackedSize;
+    ImageWriteContext writeContext { writer.get(), static_cast<UpdaterEnv *>(&env), WRITE_RAW, info->unpackedSize, 0 };
     ret = env.GetPkgManager()->CreatePkgStream(outStream,
-        partitionName, RawImageWriteProcessor, writer.get());
+        partitionName, ImageWriteProcessor, &writeContext);
     UPDATER_ERROR_CHECK(outStream != nullptr, "Error to create output stream",
         DataWriter::ReleaseDataWriter(writer); return USCRIPT_ERROR_EXECUTE);
 
@@ -151,11 +238,10 @@ int32_t UScriptInstructionRawImageWrite::Execute(uscript::UScriptEnv &env, uscri
         DataWriter::ReleaseDataWriter(writer); return USCRIPT_ERROR_EXECUTE);
 
     PartitionRecord::GetInstance().RecordPartitionUpdateStatus(partitionName, true);
+    context.AddProcessedBytes(info->unpackedSize);
     ret = USCRIPT_SUCCESS;
     env.GetPkgManager()->ClosePkgStream(outStream);
     DataWriter::ReleaseDataWriter(writer);
-    totalSize_ = 0;
-    readSize_ = 0;
     LOG(INFO)<<"UScriptInstructionRawImageWrite  finish";
     return ret;
 }
@@ -177,31 +263,26 @@ int32_t UScriptInstructionSparseImageWrite::Execute(uscript::UScriptEnv &env, us
     LOG(INFO) << "UScriptInstructionSparseImageWrite::Execute " << partitionName;
     UPDATER_ERROR_CHECK(env.GetPkgManager() != nullptr, "Error to get pkg manager", return USCRIPT_ERROR_EXECUTE);
 
-    hpackage::PkgManager::StreamPtr outStream = nullptr;
     const FileInfo *info = env.GetPkgManager()->GetFileInfo(partitionName);
     UPDATER_ERROR_CHECK(info != nullptr, "Error to get file info", return USCRIPT_ERROR_EXECUTE);
-
-    ret = env.GetPkgManager()->CreatePkgStream(outStream,
-        partitionName, info->unpackedSize, PkgStream::PkgStreamType_MemoryMap);
-    UPDATER_ERROR_CHECK(outStream != nullptr, "Error to create output stream", return USCRIPT_ERROR_EXECUTE);
-
-    ret = env.GetPkgManager()->ExtractFile(partitionName, outStream);
-    UPDATER_ERROR_CHECK(ret == USCRIPT_SUCCESS, "Error to extract file",
-        env.GetPkgManager()->ClosePkgStream(outStream); return USCRIPT_ERROR_EXECUTE);
     std::unique_ptr<DataWriter> writer = DataWriter::CreateDataWriter(WRITE_SPARSE, partitionName);
-    UPDATER_ERROR_CHECK(writer != nullptr, "Error to create writer",
-        env.GetPkgManager()->ClosePkgStream(outStream); return USCRIPT_ERROR_EXECUTE);
+    UPDATER_ERROR_CHECK(writer != nullptr, "Error to create writer", return USCRIPT_ERROR_EXECUTE);
 
-    size_t size = 0;
-    uint8_t* buffer = nullptr;
-    outStream->GetBuffer(buffer, size);
+    // 按块解析 sparse 镜像，内存占用与镜像大小无关
+    hpackage::PkgManager::StreamPtr outStream = nullptr;
+    ImageWriteContext writeContext { writer.get(), static_cast<UpdaterEnv *>(&env), WRITE_SPARSE,
+        info->unpackedSize, 0 };
+    ret = env.GetPkgManager()->CreatePkgStream(outStream, partitionName, ImageWriteProcessor, &writeContext);
+    UPDATER_ERROR_CHECK(outStream != nullptr, "Error to create output stream",
+        DataWriter::ReleaseDataWriter(writer); return USCRIPT_ERROR_EXECUTE);
 
-    ret = writer->Write(buffer, size, WRITE_SPARSE, partitionName);
-    if (ret != true) {
+    ret = env.GetPkgManager()->ExtractFile(partitionName, outStream);
+    if (ret != USCRIPT_SUCCESS || !writer->Finish()) {
         LOG(ERROR) << "writer " << partitionName.substr(1, partitionName.size()) << " failed ";
         ret = USCRIPT_ERROR_EXECUTE;
     } else {
         PartitionRecord::GetInstance().RecordPartitionUpdateStatus(partitionName, true);
+        context.AddProcessedBytes(info->unpackedSize);
         ret = USCRIPT_SUCCESS;
     }
 
@@ -221,6 +302,8 @@ int ProcessUpdater(bool retry, int pipeFd, const std::string &packagePath, const
     UPDATER_ERROR_CHECK(pkgManager != nullptr,
         "Fail to GetPackageInstance", fclose(pipeWrite); pipeWrite = nullptr; return EXIT_INVALID_ARGS);
 
+    // 脚本只按名字读取少数文件，entry 在第一次查找时再创建
+    pkgManager->SetLazyLoad(true);
     std::vector<std::string> components;
     int32_t ret = pkgManager->LoadPackage(packagePath, keyPath, components);
     UPDATER_ERROR_CHECK(ret == PKG_SUCCESS, "Fail to load package",
@@ -229,7 +312,7 @@ int ProcessUpdater(bool retry, int pipeFd, const std::string &packagePath, const
         PkgManager::ReleasePackageInstance(pkgManager);
         return EXIT_INVALID_ARGS);
 
-    UpdaterEnv* env = new UpdaterEnv(pkgManager, pipeWrite, retry);
+    UpdaterEnv* env = new UpdaterEnv(pkgManager, pipeWrite, retry, GetMessageVersion());
     UPDATER_ERROR_CHECK(env != nullptr, "Fail to create env",
         fclose(pipeWrite);
         pipeWrite = nullptr;
@@ -245,10 +328,21 @@ int ProcessUpdater(bool retry, int pipeFd, const std::string &packagePath, const
         PkgManager::ReleasePackageInstance(pkgManager);
         ScriptManager::ReleaseScriptManager();
         return EXIT_PARSE_SCRIPT_ERROR);
+    ScriptProfiler &profiler = ScriptProfiler::GetInstance();
+    bool profile = getenv(SCRIPT_PROFILE_ENV) != nullptr;
+    profiler.Reset();
+    profiler.Enable(profile);
     for (int32_t i = 0; i < ScriptManager::MAX_PRIORITY; i++) {
         ret = scriptManager->ExecuteScript(i);
         UPDATER_ERROR_CHECK(ret == USCRIPT_SUCCESS, "Fail to execute script", break);
     }
+    // 失败时同样输出，便于定位耗时的步骤
+    if (profile) {
+        profiler.Enable(false);
+        LOG(INFO) << "Script profile:\n" << profiler.DumpTable();
+        UPDATER_WARNING_CHECK_NOT_RETURN(profiler.DumpJson(TMP_SCRIPT_PROFILE) == USCRIPT_SUCCESS,
+            "Fail to dump script profile");
+    }
 
     delete env;
     env = nullptr;
@@ -42,6 +42,11 @@ public:
     UScriptInstructionSparseImageWrite() {}
     virtual ~UScriptInstructionSparseImageWrite() {}
     int32_t Execute(uscript::UScriptEnv &env, uscript::UScriptContext &context) override;
+    // 与 raw_image_write 相同，边解压边写入
+    bool IsAsyncSafe() const override
+    {
+        return true;
+    }
 };
 
 class UScriptInstructionRawImageWrite : public uscript::UScriptInstruction {
@@ -49,11 +54,11 @@ public:
     UScriptInstructionRawImageWrite() {}
     virtual ~UScriptInstructionRawImageWrite() {}
     int32_t Execute(uscript::UScriptEnv &env, uscript::UScriptContext &context) override;
-private:
-    static int RawImageWriteProcessor(const hpackage::PkgBuffer &buffer, size_t size, size_t start, bool isFinish,
-        const void* context);
-    static size_t totalSize_;
-    static size_t readSize_;
+    // 写入状态保存在每次调用中，不同分区可以并发写入
+    bool IsAsyncSafe() const override
+    {
+        return true;
+    }
 };
 } // updater
 
@@ -14,6 +14,7 @@
  */
 #include "updater_main.h"
 #include <chrono>
+#include <cstdlib>
 #include <dirent.h>
 #include <fcntl.h>
 #include <getopt.h>
@@ -339,6 +340,10 @@ void PostUpdater()
     UPDATER_ERROR_CHECK_NOT_RETURN(CopyUpdaterLogs(TMP_LOG, UPDATER_LOG) == true, "Copy updater log failed!");
     UPDATER_ERROR_CHECK_NOT_RETURN(CopyUpdaterLogs(TMP_ERROR_CODE_PATH, ERROR_CODE_PATH) == true,
         "Copy error code log failed!");
+    if (getenv(SCRIPT_PROFILE_ENV) != nullptr && access(TMP_SCRIPT_PROFILE.c_str(), 0) == 0) {
+        UPDATER_ERROR_CHECK_NOT_RETURN(CopyUpdaterLogs(TMP_SCRIPT_PROFILE, UPDATER_SCRIPT_PROFILE) == true,
+            "Copy script profile failed!");
+    }
     mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
     chmod(UPDATER_LOG.c_str(), mode);
     chmod(UPDATER_STAGE_LOG.c_str(), mode);
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "updater/updater_message.h"
+#include <cstdlib>
+#include "log/log.h"
+#include "securec.h"
+
+namespace updater {
+uint8_t GetMessageVersion()
+{
+    const char *version = getenv(MESSAGE_VERSION_ENV);
+    if (version == nullptr) {
+        return 0;
+    }
+    long value = strtol(version, nullptr, 10); // 10 : decimal
+    if (value <= 0) {
+        return 0;
+    }
+    // 只使用双方都支持的版本
+    return (value < MESSAGE_VERSION) ? static_cast<uint8_t>(value) : MESSAGE_VERSION;
+}
+
+bool WriteMessageFrame(FILE *pipe, uint8_t version, MessageType type, const void *payload, uint32_t length)
+{
+    UPDATER_CHECK_ONLY_RETURN(pipe != nullptr && length <= MAX_MESSAGE_SIZE, return false);
+    MessageHeader header {};
+    header.magic = MESSAGE_MAGIC;
+    header.version = version;
+    header.type = type;
+    header.length = length;
+    // 头部和负载一起写入，多个线程发送时帧不会交错
+    char frame[sizeof(MessageHeader) + MAX_MESSAGE_SIZE];
+    UPDATER_CHECK_ONLY_RETURN(memcpy_s(frame, sizeof(frame), &header, sizeof(header)) == 0, return false);
+    if (length > 0) {
+        UPDATER_CHECK_ONLY_RETURN(memcpy_s(frame + sizeof(header), sizeof(frame) - sizeof(header),
+            payload, length) == 0, return false);
+    }
+    size_t size = sizeof(header) + length;
+    UPDATER_CHECK_ONLY_RETURN(fwrite(frame, 1, size, pipe) == size, return false);
+    return fflush(pipe) == 0;
+}
+
+void MessageParser::Parse(const char *data, size_t size)
+{
+    buffer_.append(data, size);
+    size_t pos = 0;
+    while (pos < buffer_.size()) {
+        size_t used = (static_cast<uint8_t>(buffer_[pos]) == MESSAGE_MAGIC) ? ParseFrame(pos) : ParseLine(pos);
+        if (used == 0) {
+            break;
+        }
+        pos += used;
+    }
+    buffer_.erase(0, pos);
+}
+
+void MessageParser::Finish()
+{
+    if (!buffer_.empty() && static_cast<uint8_t>(buffer_[0]) != MESSAGE_MAGIC) {
+        textHandler_(buffer_);
+    }
+    buffer_.clear();
+}
+
+size_t MessageParser::ParseFrame(size_t pos)
+{
+    if (buffer_.size() - pos < sizeof(MessageHeader)) {
+        return 0;
+    }
+    MessageHeader header {};
+    UPDATER_CHECK_ONLY_RETURN(memcpy_s(&header, sizeof(header), buffer_.data() + pos, sizeof(header)) == 0,
+        return 1);
+    // 头部无效时跳过一个字节重新同步
+    UPDATER_ERROR_CHECK(header.version != 0 && header.length <= MAX_MESSAGE_SIZE,
+        "Invalid message header version " << static_cast<int>(header.version), return 1);
+    if (buffer_.size() - pos < sizeof(MessageHeader) + header.length) {
+        return 0;
+    }
+    const char *payload = buffer_.data() + pos + sizeof(MessageHeader);
+    switch (header.type) {
+        case MESSAGE_TYPE_TEXT:
+            textHandler_(std::string(payload, header.length));
+            break;
+        case MESSAGE_TYPE_PROGRESS: {
+            MessageProgress record {};
+            if (header.length == sizeof(record) &&
+                memcpy_s(&record, sizeof(record), payload, sizeof(record)) == 0) {
+                progressHandler_(record.progress);
+            }
+            break;
+        }
+        default:
+            // 新版本增加的消息类型，跳过
+            LOG(WARNING) << "Unknown message type " << static_cast<int>(header.type);
+            break;
+    }
+    return sizeof(MessageHeader) + header.length;
+}
+
+size_t MessageParser::ParseLine(size_t pos)
+{
+    size_t end = buffer_.find('\n', pos);
+    if (end == std::string::npos) {
+        // 与之前 fgets 的处理一致，过长的行分段处理
+        if (buffer_.size() - pos < MAX_MESSAGE_SIZE) {
+            return 0;
+        }
+        textHandler_(buffer_.substr(pos, MAX_MESSAGE_SIZE));
+        return MAX_MESSAGE_SIZE;
+    }
+    textHandler_(buffer_.substr(pos, end - pos));
+    return end - pos + 1;
+}
+} // namespace updater
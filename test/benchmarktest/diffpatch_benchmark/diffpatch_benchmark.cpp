@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "diffpatch.h"
+#include "pkg_manager.h"
+#include "update_diff.h"
+#include "update_patch.h"
+
+using namespace hpackage;
+using namespace updatepatch;
+
+/*
+ * 差分/还原性能基准:
+ *   diffpatch_benchmark [-d workDir] [-s sizeMB] [-c bzip2|zstd|lz4] [-l limitMB]
+ * 生成合成的新旧镜像 (随机修改, 插入, 删除, 以及 zip/gzip/lz4 包),
+ * 每个步骤在子进程中执行, 输出耗时, MB/s, 峰值内存和补丁大小.
+ */
+namespace {
+constexpr size_t MB = 1024 * 1024;
+constexpr size_t ZIP_FILE_COUNT = 16;
+constexpr uint32_t MUTATION_STEP = 4096;
+constexpr size_t INSERT_SIZE = 64 * 1024;
+
+struct BenchmarkConfig {
+    std::string workDir = "/data/updater/benchmark/";
+    size_t imageSize = 16 * MB;
+    int32_t compressMethod = BSDIFF_COMPRESS_BZIP2;
+    size_t limit = 0;
+};
+
+class Random {
+public:
+    explicit Random(uint32_t seed) : seed_(seed) {}
+    uint32_t Next()
+    {
+        seed_ = seed_ * 1103515245 + 12345; // 1103515245, 12345: LCG parameters
+        return seed_ >> 8; // 8: drop the low bits with short period
+    }
+private:
+    uint32_t seed_;
+};
+
+// 旧数据由若干重复的 "记录" 组成, 可压缩, 同时有大量可匹配的子串
+void GenerateOldData(std::vector<uint8_t> &data, size_t size, uint32_t seed)
+{
+    Random random(seed);
+    data.resize(size);
+    const size_t recordSize = 256;
+    std::vector<uint8_t> record(recordSize);
+    for (size_t i = 0; i < size; i++) {
+        if (i % recordSize == 0) {
+            for (auto &c : record) {
+                c = static_cast<uint8_t>('a' + random.Next() % 26); // 26: letters
+            }
+        }
+        data[i] = ((random.Next() % 4) == 0) ? record[i % recordSize] : record[(i * 7) % recordSize]; // 4, 7: mix
+    }
+}
+
+// 新数据: 零散字节修改, 插入新数据, 删除一段旧数据
+void GenerateNewData(const std::vector<uint8_t> &oldData, std::vector<uint8_t> &newData, uint32_t seed)
+{
+    Random random(seed);
+    newData = oldData;
+    for (size_t i = random.Next() % MUTATION_STEP; i < newData.size(); i += 1 + random.Next() % MUTATION_STEP) {
+        newData[i] ^= static_cast<uint8_t>(1 + random.Next() % 255); // 255: non zero change
+    }
+    std::vector<uint8_t> inserted(std::min(INSERT_SIZE, newData.size() / 8 + 1)); // 8: 1/8 of the data at most
+    for (auto &c : inserted) {
+        c = static_cast<uint8_t>(random.Next());
+    }
+    newData.insert(newData.begin() + newData.size() / 3, inserted.begin(), inserted.end()); // 3: first third
+    size_t eraseStart = newData.size() * 2 / 3; // 2 / 3: last third
+    size_t eraseLength = std::min(INSERT_SIZE / 2, newData.size() - eraseStart); // 2: half of inserted
+    newData.erase(newData.begin() + eraseStart, newData.begin() + eraseStart + eraseLength);
+}
+
+size_t GetFileSize(const std::string &fileName)
+{
+    struct stat st {};
+    if (stat(fileName.c_str(), &st) != 0) {
+        return 0;
+    }
+    return static_cast<size_t>(st.st_size);
+}
+
+std::string GetFileHash(const std::string &fileName)
+{
+    MemMapInfo data {};
+    int32_t ret = PatchMapFile(fileName, data);
+    PATCH_CHECK(ret == 0, return "", "Failed to map %s", fileName.c_str());
+    return GeneraterBufferHash({data.memory, data.length});
+}
+
+int32_t CreateContainer(const BenchmarkConfig &config, const std::string &name,
+    uint8_t pkgType, const std::vector<std::string> &files)
+{
+    PkgManager::PkgManagerPtr pkgManager = PkgManager::GetPackageInstance();
+    PATCH_CHECK(pkgManager != nullptr, return -1, "Failed to get pkg manager");
+    PkgInfo pkgInfo;
+    pkgInfo.signMethod = PKG_SIGN_METHOD_NONE;
+    pkgInfo.digestMethod = PKG_DIGEST_TYPE_SHA256;
+    pkgInfo.pkgType = pkgType;
+    // 不签名, keyName 只需要是一个存在的路径
+    if (pkgType == PKG_PACK_TYPE_LZ4) {
+        std::vector<std::pair<std::string, Lz4FileInfo>> lz4Files;
+        Lz4FileInfo file;
+        file.fileInfo.identity = files[0].substr(files[0].find_last_of('/') + 1);
+        file.fileInfo.packMethod = PKG_COMPRESS_METHOD_LZ4;
+        file.fileInfo.digestMethod = PKG_DIGEST_TYPE_CRC;
+        lz4Files.push_back(std::pair<std::string, Lz4FileInfo>(files[0], file));
+        return pkgManager->CreatePackage(config.workDir + name, config.workDir, &pkgInfo, lz4Files);
+    }
+    std::vector<std::pair<std::string, ZipFileInfo>> zipFiles;
+    for (auto &fileName : files) {
+        ZipFileInfo file;
+        file.fileInfo.identity = fileName.substr(fileName.find_last_of('/') + 1);
+        file.fileInfo.packMethod = (pkgType == PKG_PACK_TYPE_GZIP) ? PKG_COMPRESS_METHOD_GZIP :
+            PKG_COMPRESS_METHOD_ZIP;
+        file.fileInfo.digestMethod = PKG_DIGEST_TYPE_CRC;
+        zipFiles.push_back(std::pair<std::string, ZipFileInfo>(fileName, file));
+    }
+    return pkgManager->CreatePackage(config.workDir + name, config.workDir, &pkgInfo, zipFiles);
+}
+
+// 生成 name.old / name.new, 容器类型的镜像先生成原始文件再打包
+int32_t GenerateImages(const BenchmarkConfig &config, const std::string &name, uint8_t pkgType)
+{
+    size_t fileCount = (pkgType == PKG_PACK_TYPE_ZIP) ? ZIP_FILE_COUNT : 1;
+    std::vector<std::string> oldFiles;
+    std::vector<std::string> newFiles;
+    for (size_t i = 0; i < fileCount; i++) {
+        std::vector<uint8_t> oldData;
+        std::vector<uint8_t> newData;
+        GenerateOldData(oldData, config.imageSize / fileCount, static_cast<uint32_t>(i + 1));
+        GenerateNewData(oldData, newData, static_cast<uint32_t>(i + 1));
+        std::string suffix = (pkgType == PKG_PACK_TYPE_NONE) ? "" : ("_" + std::to_string(i) + ".bin");
+        oldFiles.push_back(config.workDir + "old/" + name + suffix);
+        newFiles.push_back(config.workDir + "new/" + name + suffix);
+        int32_t ret = WriteDataToFile(oldFiles.back(), oldData, oldData.size());
+        ret |= WriteDataToFile(newFiles.back(), newData, newData.size());
+        PATCH_CHECK(ret == 0, return -1, "Failed to write %s", name.c_str());
+    }
+    if (pkgType == PKG_PACK_TYPE_NONE) {
+        int32_t ret = rename(oldFiles[0].c_str(), (config.workDir + name + ".old").c_str());
+        ret |= rename(newFiles[0].c_str(), (config.workDir + name + ".new").c_str());
+        return ret;
+    }
+    int32_t ret = CreateContainer(config, name + ".old", pkgType, oldFiles);
+    PATCH_CHECK(ret == 0, return -1, "Failed to create old %s", name.c_str());
+    ret = CreateContainer(config, name + ".new", pkgType, newFiles);
+    PATCH_CHECK(ret == 0, return -1, "Failed to create new %s", name.c_str());
+    return 0;
+}
+
+int32_t ApplyPatchFile(const std::string &patchName, const std::string &oldName, const std::string &newName)
+{
+    MemMapInfo patchData {};
+    MemMapInfo oldData {};
+    int32_t ret = PatchMapFile(patchName, patchData);
+    PATCH_CHECK(ret == 0, return -1, "Failed to read patch file");
+    ret = PatchMapFile(oldName, oldData);
+    PATCH_CHECK(ret == 0, return -1, "Failed to read old file");
+    std::string expected = GetFileHash(newName);
+    // 还原的数据只做校验, 不落盘
+    UpdatePatch::ImageProcessor processor = [](size_t start, const BlockBuffer &data, size_t size) -> int {
+        return 0;
+    };
+    if (memcmp(patchData.memory, PKGDIFF_MAGIC.c_str(), PKGDIFF_MAGIC.size()) == 0) {
+        PatchParam param {};
+        param.patch = patchData.memory;
+        param.patchSize = patchData.length;
+        param.oldBuff = oldData.memory;
+        param.oldSize = oldData.length;
+        std::vector<uint8_t> empty;
+        return UpdatePatch::ApplyImagePatch(param, empty, processor, expected);
+    }
+    PatchBuffer patchInfo = {patchData.memory, 0, patchData.length};
+    BlockBuffer oldInfo = {oldData.memory, oldData.length};
+    return UpdatePatch::ApplyBlockPatch(patchInfo, oldInfo, processor, expected);
+}
+
+// 在子进程中执行, 峰值内存只统计本步骤
+int32_t RunStep(const std::string &name, const std::string &step, size_t dataSize,
+    const std::string &patchName, const std::function<int32_t()> &func)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    PATCH_CHECK(pid >= 0, return -1, "Failed to fork");
+    if (pid == 0) {
+        auto start = std::chrono::steady_clock::now();
+        int32_t ret = func();
+        std::chrono::duration<double> cost = std::chrono::steady_clock::now() - start;
+        struct rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+        double sizeMb = static_cast<double>(dataSize) / MB;
+        size_t patchSize = GetFileSize(patchName);
+        printf("%-12s %-12s %10.2f %10.3f %10.2f %12.2f %14zu %8.2f%% %s\n", name.c_str(), step.c_str(),
+            sizeMb, cost.count(), (cost.count() > 0) ? sizeMb / cost.count() : 0,
+            static_cast<double>(usage.ru_maxrss) / 1024, patchSize, // 1024: ru_maxrss is KB
+            (dataSize > 0) ? 100.0 * patchSize / dataSize : 0, (ret == 0) ? "ok" : "FAIL"); // 100.0: percent
+        fflush(stdout);
+        _exit((ret == 0) ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+int32_t RunBenchmark(const BenchmarkConfig &config, const std::string &name, uint8_t pkgType, bool block)
+{
+    int32_t ret = GenerateImages(config, name, pkgType);
+    PATCH_CHECK(ret == 0, return -1, "Failed to generate %s", name.c_str());
+    std::string oldName = config.workDir + name + ".old";
+    std::string newName = config.workDir + name + ".new";
+    std::string patchName = config.workDir + name + ".patch";
+    size_t newSize = GetFileSize(newName);
+
+    ret = RunStep(name, block ? "DiffBlock" : "DiffImage", newSize, patchName, [&]() {
+        if (block) {
+            return UpdateDiff::DiffBlock(oldName, newName, patchName, config.compressMethod);
+        }
+        return UpdateDiff::DiffImage(config.limit, oldName, newName, patchName, config.compressMethod);
+    });
+    PATCH_CHECK(ret == 0, return -1, "Failed to diff %s", name.c_str());
+    ret = RunStep(name, block ? "ApplyBlock" : "ApplyImage", newSize, patchName, [&]() {
+        return ApplyPatchFile(patchName, oldName, newName);
+    });
+    PATCH_CHECK(ret == 0, return -1, "Failed to patch %s", name.c_str());
+    return 0;
+}
+
+int32_t ParseArgs(int argc, char **argv, BenchmarkConfig &config)
+{
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "d:s:c:l:")) != -1) {
+        switch (opt) {
+            case 'd':
+                config.workDir = std::string(optarg) + "/";
+                break;
+            case 's':
+                config.imageSize = static_cast<size_t>(atol(optarg)) * MB;
+                break;
+            case 'c': {
+                std::string method = optarg;
+                config.compressMethod = (method == "zstd") ? BSDIFF_COMPRESS_ZSTD :
+                    ((method == "lz4") ? BSDIFF_COMPRESS_LZ4 : BSDIFF_COMPRESS_BZIP2);
+                break;
+            }
+            case 'l':
+                config.limit = static_cast<size_t>(atol(optarg));
+                break;
+            default:
+                printf("usage: %s [-d workDir] [-s sizeMB] [-c bzip2|zstd|lz4] [-l limitMB]\n", argv[0]);
+                return -1;
+        }
+    }
+    PATCH_CHECK(config.imageSize > 0, return -1, "Invalid image size");
+    return 0;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    BenchmarkConfig config {};
+    if (ParseArgs(argc, argv, config) != 0) {
+        return 1;
+    }
+    mkdir(config.workDir.c_str(), S_IRWXU);
+    mkdir((config.workDir + "old").c_str(), S_IRWXU);
+    mkdir((config.workDir + "new").c_str(), S_IRWXU);
+
+    printf("image size %zu MB, bsdiff compress method %d, limit %zu MB\n",
+        config.imageSize / MB, config.compressMethod, config.limit);
+    printf("%-12s %-12s %10s %10s %10s %12s %14s %9s\n", "image", "step", "size(MB)", "time(s)", "MB/s",
+        "peakRSS(MB)", "patch(bytes)", "ratio");
+    int32_t ret = RunBenchmark(config, "raw_block", PKG_PACK_TYPE_NONE, true);
+    ret |= RunBenchmark(config, "raw_image", PKG_PACK_TYPE_NONE, false);
+    ret |= RunBenchmark(config, "zip", PKG_PACK_TYPE_ZIP, false);
+    ret |= RunBenchmark(config, "gzip", PKG_PACK_TYPE_GZIP, false);
+    ret |= RunBenchmark(config, "lz4", PKG_PACK_TYPE_LZ4, false);
+    return (ret == 0) ? 0 : 1;
+}
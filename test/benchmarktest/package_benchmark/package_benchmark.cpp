@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "pkg_manager.h"
+#include "pkg_stream.h"
+#include "pkg_utils.h"
+#include "pkg_zipfile.h"
+
+using namespace hpackage;
+
+/*
+ * 升级包加载性能基准:
+ *   package_benchmark [-d workDir] [-n entries] [-r rounds]
+ * 生成包含大量小文件的 zip 包, 多次加载中心目录并查找首尾文件, 输出平均耗时.
+ */
+namespace {
+constexpr size_t ENTRY_SIZE = 64;
+
+struct BenchmarkConfig {
+    std::string workDir = "/data/updater/benchmark/";
+    uint32_t entryCount = 10000;
+    uint32_t rounds = 10;
+};
+
+int32_t CreateZip(PkgManager::PkgManagerPtr pkgManager, const std::string &packagePath, uint32_t entryCount)
+{
+    PkgManager::StreamPtr stream = nullptr;
+    int32_t ret = pkgManager->CreatePkgStream(stream, packagePath, 0, PkgStream::PkgStreamType_Write);
+    PKG_CHECK(ret == PKG_SUCCESS, return ret, "Failed to create %s", packagePath.c_str());
+    std::unique_ptr<ZipPkgFile> zipFile = std::make_unique<ZipPkgFile>(PkgStreamImpl::ConvertPkgStream(stream));
+    std::vector<uint8_t> content(ENTRY_SIZE, 'a');
+    for (uint32_t i = 0; i < entryCount && ret == PKG_SUCCESS; i++) {
+        ZipFileInfo info;
+        info.fileInfo.identity = "entry_" + std::to_string(i);
+        info.fileInfo.unpackedSize = content.size();
+        info.fileInfo.packMethod = PKG_COMPRESS_METHOD_ZIP;
+        info.fileInfo.digestMethod = PKG_DIGEST_TYPE_CRC;
+        PkgManager::StreamPtr inStream = nullptr;
+        pkgManager->CreatePkgStream(inStream, info.fileInfo.identity, PkgBuffer(content));
+        ret = zipFile->AddEntry(&info.fileInfo, PkgStreamImpl::ConvertPkgStream(inStream));
+        pkgManager->ClosePkgStream(inStream);
+    }
+    PKG_CHECK(ret == PKG_SUCCESS, return ret, "Failed to add entry");
+    size_t signOffset = 0;
+    return zipFile->SavePackage(signOffset);
+}
+
+int32_t LoadZip(PkgManager::PkgManagerPtr pkgManager, const std::string &packagePath, uint32_t entryCount)
+{
+    PkgManager::StreamPtr stream = nullptr;
+    int32_t ret = pkgManager->CreatePkgStream(stream, packagePath, 0, PkgStream::PkgStreamType_Read);
+    PKG_CHECK(ret == PKG_SUCCESS, return ret, "Failed to open %s", packagePath.c_str());
+    std::unique_ptr<ZipPkgFile> zipFile = std::make_unique<ZipPkgFile>(PkgStreamImpl::ConvertPkgStream(stream));
+    std::vector<std::string> components;
+    ret = zipFile->LoadPackage(components);
+    PKG_CHECK(ret == PKG_SUCCESS && components.size() == entryCount, return PKG_INVALID_FILE,
+        "Failed to load %s, %zu entries", packagePath.c_str(), components.size());
+    PKG_CHECK(zipFile->FindPkgEntry("entry_0") != nullptr &&
+        zipFile->FindPkgEntry("entry_" + std::to_string(entryCount - 1)) != nullptr,
+        return PKG_INVALID_FILE, "Failed to find entry");
+    return PKG_SUCCESS;
+}
+
+int32_t ParseArgs(int argc, char **argv, BenchmarkConfig &config)
+{
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "d:n:r:")) != -1) {
+        switch (opt) {
+            case 'd':
+                config.workDir = std::string(optarg) + "/";
+                break;
+            case 'n':
+                config.entryCount = static_cast<uint32_t>(atol(optarg));
+                break;
+            case 'r':
+                config.rounds = static_cast<uint32_t>(atol(optarg));
+                break;
+            default:
+                printf("usage: %s [-d workDir] [-n entries] [-r rounds]\n", argv[0]);
+                return -1;
+        }
+    }
+    PKG_CHECK(config.entryCount > 0 && config.rounds > 0, return -1, "Invalid entries or rounds");
+    return 0;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    BenchmarkConfig config {};
+    if (ParseArgs(argc, argv, config) != 0) {
+        return 1;
+    }
+    mkdir(config.workDir.c_str(), S_IRWXU);
+    PkgManager::PkgManagerPtr pkgManager = PkgManager::GetPackageInstance();
+    PKG_CHECK(pkgManager != nullptr, return 1, "Failed to get pkg manager");
+    std::string packagePath = config.workDir + "many_entries.zip";
+    int32_t ret = CreateZip(pkgManager, packagePath, config.entryCount);
+    PKG_CHECK(ret == PKG_SUCCESS, PkgManager::ReleasePackageInstance(pkgManager); return 1, "Failed to create zip");
+
+    printf("%-12s %10s %8s %12s %14s\n", "package", "entries", "rounds", "avg(ms)", "entries/ms");
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < config.rounds && ret == PKG_SUCCESS; i++) {
+        ret = LoadZip(pkgManager, packagePath, config.entryCount);
+    }
+    std::chrono::duration<double, std::milli> cost = std::chrono::steady_clock::now() - start;
+    double average = cost.count() / config.rounds;
+    printf("%-12s %10u %8u %12.3f %14.1f %s\n", "zip", config.entryCount, config.rounds, average,
+        (average > 0) ? config.entryCount / average : 0, (ret == PKG_SUCCESS) ? "ok" : "FAIL");
+    PkgManager::ReleasePackageInstance(pkgManager);
+    return (ret == PKG_SUCCESS) ? 0 : 1;
+}
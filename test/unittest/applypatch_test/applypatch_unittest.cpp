@@ -14,6 +14,7 @@
  */
 
 #include "applypatch_unittest.h"
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
 #include <fcntl.h>
@@ -28,6 +29,7 @@
 #include "fs_manager/mount.h"
 #include "log/log.h"
 #include "securec.h"
+#include "sparse_writer.h"
 #include "unittest_comm.h"
 #include "utils.h"
 
@@ -126,7 +128,7 @@ TEST_F(ApplyPatchUnitTest, updater_DataWriterOpenPartition)
 
 TEST_F(ApplyPatchUnitTest, updater_CreateDataWriter)
 {
-    std::vector<WriteMode> modes = { WRITE_RAW, WRITE_DECRYPT };
+    std::vector<WriteMode> modes = { WRITE_RAW, WRITE_SPARSE, WRITE_DECRYPT };
     std::unique_ptr<DataWriter> writer = nullptr;
     for (auto mode : modes) {
         if (mode == WRITE_DECRYPT) {
@@ -139,4 +141,93 @@ TEST_F(ApplyPatchUnitTest, updater_CreateDataWriter)
         writer = nullptr;
     }
 }
+
+static void AppendSparseData(std::vector<uint8_t> &image, const void *data, size_t size)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    image.insert(image.end(), p, p + size);
+}
+
+static void AppendSparseChunk(std::vector<uint8_t> &image, uint16_t type, uint32_t blocks, uint32_t dataSize)
+{
+    SparseChunkHeader chunk { type, 0, blocks, static_cast<uint32_t>(sizeof(SparseChunkHeader)) + dataSize };
+    AppendSparseData(image, &chunk, sizeof(chunk));
+}
+
+// RAW(2) + FILL(1) + DONT_CARE(1) + FILL 0(1) + CRC32 + RAW(1)
+static std::vector<uint8_t> CreateSparseImage(uint32_t blockSize, std::vector<uint8_t> &expected)
+{
+    constexpr uint32_t blocks = 6;
+    constexpr uint32_t chunks = 6;
+    constexpr uint32_t fillValue = 0x5a5a5a5a;
+    std::vector<uint8_t> image;
+    SparseHeader header { SPARSE_HEADER_MAGIC, SPARSE_MAJOR_VERSION, 0, sizeof(SparseHeader),
+        sizeof(SparseChunkHeader), blockSize, blocks, chunks, 0 };
+    AppendSparseData(image, &header, sizeof(header));
+    expected.assign(blocks * blockSize, 0);
+
+    AppendSparseChunk(image, CHUNK_TYPE_RAW, 2, 2 * blockSize); // 2 : blocks
+    for (uint32_t i = 0; i < 2 * blockSize; i++) {
+        expected[i] = static_cast<uint8_t>(i);
+    }
+    AppendSparseData(image, expected.data(), 2 * blockSize);
+    AppendSparseChunk(image, CHUNK_TYPE_FILL, 1, sizeof(fillValue));
+    AppendSparseData(image, &fillValue, sizeof(fillValue));
+    for (uint32_t i = 2 * blockSize; i < 3 * blockSize; i += sizeof(fillValue)) {
+        memcpy_s(expected.data() + i, sizeof(fillValue), &fillValue, sizeof(fillValue));
+    }
+    AppendSparseChunk(image, CHUNK_TYPE_DONT_CARE, 1, 0);
+    constexpr uint32_t zero = 0;
+    AppendSparseChunk(image, CHUNK_TYPE_FILL, 1, sizeof(zero));
+    AppendSparseData(image, &zero, sizeof(zero));
+    AppendSparseChunk(image, CHUNK_TYPE_CRC32, 0, sizeof(zero));
+    AppendSparseData(image, &zero, sizeof(zero));
+    AppendSparseChunk(image, CHUNK_TYPE_RAW, 1, blockSize);
+    std::fill(expected.begin() + 5 * blockSize, expected.end(), 0xA5); // 5 : last block
+    AppendSparseData(image, expected.data() + 5 * blockSize, blockSize); // 5 : last block
+    return image;
+}
+
+TEST_F(ApplyPatchUnitTest, updater_SparseWriter)
+{
+    constexpr uint32_t blockSize = 4096;
+    std::string partitionName = "/rawwriter";
+    auto devPath = GetBlockDeviceByMountPoint(partitionName);
+    const std::string devDir = "/data/updater/ut/datawriter";
+    updater::utils::MkdirRecursive(devDir, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+    close(open(devPath.c_str(), O_CREAT | O_WRONLY | O_EXCL, 0664));
+
+    std::vector<uint8_t> expected;
+    std::vector<uint8_t> image = CreateSparseImage(blockSize, expected);
+    std::unique_ptr<DataWriter> writer = DataWriter::CreateDataWriter(WRITE_SPARSE, partitionName);
+    ASSERT_NE(writer, nullptr);
+    // 分多次传入，头部和数据都会跨越两次写入
+    constexpr size_t step = 1000;
+    for (size_t pos = 0; pos < image.size(); pos += step) {
+        EXPECT_TRUE(writer->Write(image.data() + pos, std::min(step, image.size() - pos), WRITE_SPARSE, ""));
+    }
+    EXPECT_TRUE(writer->Finish());
+    EXPECT_FALSE(writer->Write(image.data(), image.size(), WRITE_SPARSE, ""));
+    DataWriter::ReleaseDataWriter(writer);
+
+    std::vector<uint8_t> buffer(expected.size());
+    int fd = open(devPath.c_str(), O_RDONLY);
+    ASSERT_GT(fd, 0);
+    EXPECT_EQ(static_cast<ssize_t>(buffer.size()), read(fd, buffer.data(), buffer.size()));
+    close(fd);
+    // DONT_CARE 的块内容不确定，不比较
+    EXPECT_EQ(0, memcmp(buffer.data(), expected.data(), 3 * blockSize)); // 3 : before don't care
+    EXPECT_EQ(0, memcmp(buffer.data() + 4 * blockSize, expected.data() + 4 * blockSize, // 4 : after don't care
+        2 * blockSize)); // 2 : last two blocks
+
+    // 数据不完整或者格式错误时失败
+    writer = DataWriter::CreateDataWriter(WRITE_SPARSE, partitionName);
+    EXPECT_TRUE(writer->Write(image.data(), image.size() - 1, WRITE_SPARSE, ""));
+    EXPECT_FALSE(writer->Finish());
+    DataWriter::ReleaseDataWriter(writer);
+    image[0] = 0;
+    writer = DataWriter::CreateDataWriter(WRITE_SPARSE, partitionName);
+    EXPECT_FALSE(writer->Write(image.data(), image.size(), WRITE_SPARSE, ""));
+    DataWriter::ReleaseDataWriter(writer);
+}
 } // namespace updater_ut
@@ -15,6 +15,7 @@
 
 #include <gtest/gtest.h>
 #include "applypatch/data_writer.h"
+#include "blocks_diff.h"
 #include "unittest_comm.h"
 #include "update_diff.h"
 #include "update_patch.h"
@@ -24,6 +25,50 @@ using namespace hpackage;
 using namespace updatepatch;
 
 namespace {
+// 固定种子的伪随机数, 用例数据可复现
+uint32_t NextPseudoRandom(uint32_t &seed)
+{
+    seed = seed * 1103515245 + 12345; // 1103515245, 12345: LCG parameters
+    return seed >> 8; // 8: 低位周期短, 不使用
+}
+
+void FillPseudoRandom(std::vector<uint8_t> &buffer, uint32_t &seed)
+{
+    for (auto &c : buffer) {
+        c = static_cast<uint8_t>(NextPseudoRandom(seed) >> 8); // 8: 取次低字节
+    }
+}
+
+class WindowPatchWriter : public UpdatePatchWriter {
+public:
+    explicit WindowPatchWriter(std::vector<uint8_t> &buffer) : UpdatePatchWriter(), buffer_(buffer) {}
+    ~WindowPatchWriter() override {}
+
+    int32_t Init() override
+    {
+        return 0;
+    }
+    int32_t Finish() override
+    {
+        return 0;
+    }
+    int32_t Write(size_t start, const BlockBuffer &data, size_t len) override
+    {
+        // 流式还原按顺序输出
+        PATCH_CHECK(start == buffer_.size(), return -1, "Invalid start %zu", start);
+        buffer_.insert(buffer_.end(), data.buffer, data.buffer + len);
+        maxWriteLength_ = std::max(maxWriteLength_, len);
+        return 0;
+    }
+    size_t GetMaxWriteLength() const
+    {
+        return maxWriteLength_;
+    }
+private:
+    std::vector<uint8_t> &buffer_;
+    size_t maxWriteLength_ {0};
+};
+
 class DiffPatchUnitTest : public testing::Test {
 public:
     DiffPatchUnitTest() {}
@@ -45,11 +90,11 @@ public:
         });
     }
 
-    int BlockDiffPatchTest(const std::string &oldFile,
-        const std::string &newFile, const std::string &patchFile, const std::string &restoreFile) const
+    int BlockDiffPatchTest(const std::string &oldFile, const std::string &newFile, const std::string &patchFile,
+        const std::string &restoreFile, int32_t compressMethod = BSDIFF_COMPRESS_BZIP2) const
     {
         int32_t ret = updatepatch::UpdateDiff::DiffBlock(TEST_PATH_FROM + oldFile,
-            TEST_PATH_FROM + newFile, TEST_PATH_FROM + patchFile);
+            TEST_PATH_FROM + newFile, TEST_PATH_FROM + patchFile, compressMethod);
         EXPECT_EQ(0, ret);
         ret = updatepatch::UpdatePatch::ApplyPatch(TEST_PATH_FROM + patchFile,
             TEST_PATH_FROM + oldFile, TEST_PATH_FROM + restoreFile);
@@ -177,6 +222,167 @@ public:
         EXPECT_EQ(0, memcmp(expected.c_str(), restoreHash.c_str(), restoreHash.size()));
         return 0;
     }
+
+    int BlockDiffPatchBufferTest(const std::vector<uint8_t> &oldData, const std::vector<uint8_t> &newData,
+        int32_t compressMethod = BSDIFF_COMPRESS_BZIP2) const
+    {
+        BlockBuffer newInfo = {const_cast<uint8_t *>(newData.data()), newData.size()};
+        BlockBuffer oldInfo = {const_cast<uint8_t *>(oldData.data()), oldData.size()};
+        std::vector<uint8_t> patchData;
+        size_t patchSize = 0;
+        int32_t ret = BlocksDiff::MakePatch(newInfo, oldInfo, patchData, 0, patchSize, compressMethod);
+        PATCH_CHECK(ret == 0, return -1, "Failed to make block patch");
+        PATCH_CHECK(GetBsdiffCompressMethod(patchData.data(), patchData.size()) == compressMethod,
+            return -1, "Invalid compress method");
+
+        PatchBuffer patchInfo = {patchData.data(), 0, patchData.size()};
+        std::vector<uint8_t> restoreData;
+        ret = updatepatch::UpdatePatch::ApplyBlockPatch(patchInfo, oldInfo, restoreData);
+        PATCH_CHECK(ret == 0, return -1, "Failed to apply block patch");
+        PATCH_CHECK(restoreData == newData, return -1, "Failed to check restore data");
+        return 0;
+    }
+
+    int BlockDiffPatchStreamTest(const std::vector<uint8_t> &oldData, const std::vector<uint8_t> &newData,
+        const std::string &oldName) const
+    {
+        BlockBuffer newInfo = {const_cast<uint8_t *>(newData.data()), newData.size()};
+        BlockBuffer oldInfo = {const_cast<uint8_t *>(oldData.data()), oldData.size()};
+        std::vector<uint8_t> patchData;
+        size_t patchSize = 0;
+        int32_t ret = BlocksDiff::MakePatch(newInfo, oldInfo, patchData, 0, patchSize);
+        PATCH_CHECK(ret == 0, return -1, "Failed to make block patch");
+        PatchBuffer patchInfo = {patchData.data(), 0, patchData.size()};
+
+        // 旧数据在内存中
+        std::vector<uint8_t> restoreData;
+        WindowPatchWriter writer(restoreData);
+        ret = UpdatePatch::ApplyBlockPatch(patchInfo, oldInfo, &writer);
+        PATCH_CHECK(ret == 0 && restoreData == newData, return -1, "Failed to apply patch with buffer");
+        PATCH_CHECK(writer.GetMaxWriteLength() < newData.size(), return -1, "Invalid write length");
+
+        // 旧数据在文件中, 按块读取
+        ret = WriteDataToFile(oldName, oldData, oldData.size());
+        PATCH_CHECK(ret == 0, return -1, "Failed to write old file");
+        PkgManager::PkgManagerPtr pkgManager = PkgManager::GetPackageInstance();
+        PkgManager::StreamPtr stream = nullptr;
+        ret = pkgManager->CreatePkgStream(stream, oldName, 0, PkgStream::PkgStreamType_Read);
+        PATCH_CHECK(ret == 0 && stream != nullptr, return -1, "Failed to create old stream");
+        std::vector<uint8_t> restoreFileData;
+        WindowPatchWriter fileWriter(restoreFileData);
+        ret = UpdatePatch::ApplyBlockPatch(patchInfo, stream, &fileWriter);
+        pkgManager->ClosePkgStream(stream);
+        PATCH_CHECK(ret == 0 && restoreFileData == newData, return -1, "Failed to apply patch with file");
+        return 0;
+    }
+
+    // 多个新镜像共用一个后缀数组, 第二次从文件加载, 补丁应与单独差分一致
+    int SuffixArrayReuseTest(const std::vector<uint8_t> &oldData,
+        const std::vector<std::vector<uint8_t>> &newDatas) const
+    {
+        std::string oldName = TEST_PATH_FROM + "SuffixArrayReuse.old";
+        std::string suffixArrayName = TEST_PATH_FROM + "SuffixArrayReuse.sa";
+        unlink(suffixArrayName.c_str());
+        int32_t ret = WriteDataToFile(oldName, oldData, oldData.size());
+        std::vector<std::pair<std::string, std::string>> targets;
+        for (size_t i = 0; i < newDatas.size(); i++) {
+            std::string newName = TEST_PATH_FROM + "SuffixArrayReuse.new" + std::to_string(i);
+            ret |= WriteDataToFile(newName, newDatas[i], newDatas[i].size());
+            targets.push_back({newName, newName + ".patch"});
+        }
+        PATCH_CHECK(ret == 0, return -1, "Failed to write test data");
+        for (int round = 0; round < 2; round++) { // 2: 第一次构建并保存, 第二次加载
+            ret = UpdateDiff::DiffBlocks(oldName, targets, BSDIFF_COMPRESS_BZIP2, suffixArrayName);
+            PATCH_CHECK(ret == 0 && access(suffixArrayName.c_str(), F_OK) == 0, return -1, "Failed to diff");
+            for (auto &target : targets) {
+                std::string singlePatch = target.second + ".single";
+                ret = UpdateDiff::DiffBlock(oldName, target.first, singlePatch);
+                PATCH_CHECK(ret == 0, return -1, "Failed to diff %s", target.first.c_str());
+                PATCH_CHECK(GeneraterHash(singlePatch) == GeneraterHash(target.second), return -1,
+                    "Patch mismatch %s", target.first.c_str());
+                ret = UpdatePatch::ApplyPatch(target.second, oldName, target.first + ".restore");
+                PATCH_CHECK(ret == 0 && GeneraterHash(target.first) == GeneraterHash(target.first + ".restore"),
+                    return -1, "Failed to apply %s", target.second.c_str());
+            }
+        }
+
+        // 旧镜像变化后不能再使用该后缀数组
+        std::vector<uint8_t> otherData(oldData.begin(), oldData.end());
+        otherData[0] ^= 0x5a;
+        BlockBuffer otherInfo = {otherData.data(), otherData.size()};
+        PATCH_CHECK(SuffixArrayBase::Load(suffixArrayName, otherInfo) == nullptr, return -1, "Invalid load");
+        BlockBuffer oldInfo = {const_cast<uint8_t *>(oldData.data()), oldData.size()};
+        PATCH_CHECK(SuffixArrayBase::Load(suffixArrayName, oldInfo) != nullptr, return -1, "Failed to load");
+        return 0;
+    }
+
+    int CreateZipFile(const std::string &zipName, const std::vector<std::vector<uint8_t>> &datas) const
+    {
+        PkgManager::PkgManagerPtr pkgManager = PkgManager::GetPackageInstance();
+        PATCH_CHECK(pkgManager != nullptr, return -1, "Failed to get pkg manager");
+        std::vector<std::pair<std::string, ZipFileInfo>> files;
+        for (size_t i = 0; i < datas.size(); i++) {
+            std::string fileName = zipName + ".entry" + std::to_string(i);
+            int32_t ret = WriteDataToFile(fileName, datas[i], datas[i].size());
+            PATCH_CHECK(ret == 0, return -1, "Failed to write %s", fileName.c_str());
+            ZipFileInfo file;
+            file.fileInfo.identity = "entry" + std::to_string(i);
+            file.fileInfo.packMethod = PKG_COMPRESS_METHOD_ZIP;
+            file.fileInfo.digestMethod = PKG_DIGEST_TYPE_CRC;
+            files.push_back(std::pair<std::string, ZipFileInfo>(fileName, file));
+        }
+        PkgInfo pkgInfo;
+        pkgInfo.signMethod = PKG_SIGN_METHOD_NONE;
+        pkgInfo.digestMethod = PKG_DIGEST_TYPE_SHA256;
+        pkgInfo.pkgType = PKG_PACK_TYPE_ZIP;
+        return pkgManager->CreatePackage(zipName, TEST_PATH_FROM, &pkgInfo, files);
+    }
+
+    // zip 中的文件后带 data descriptor 时, 文件之间的数据也要还原
+    int ZipDataDescriptorTest(const std::vector<std::vector<uint8_t>> &oldDatas,
+        const std::vector<std::vector<uint8_t>> &newDatas) const
+    {
+        std::string oldName = TEST_PATH_FROM + "ZipDataDescriptor_old.zip";
+        std::string newName = TEST_PATH_FROM + "ZipDataDescriptor_new.zip";
+        std::string patchName = TEST_PATH_FROM + "ZipDataDescriptor_zip.img_patch";
+        std::string restoreName = TEST_PATH_FROM + "ZipDataDescriptor_zip_new.zip";
+        int32_t ret = CreateZipFile(oldName, oldDatas);
+        ret |= CreateZipFile(newName, newDatas);
+        PATCH_CHECK(ret == 0, return -1, "Failed to create zip file");
+
+        // 第一个文件头中 general purpose flag 的 bit 3 表示带 data descriptor
+        MemMapInfo newData {};
+        ret = PatchMapFile(newName, newData);
+        const size_t flagOffset = 6;
+        const uint8_t dataDescFlag = 0x08;
+        PATCH_CHECK(ret == 0 && newData.length > flagOffset && (newData.memory[flagOffset] & dataDescFlag) != 0,
+            return -1, "No data descriptor in %s", newName.c_str());
+
+        ret = UpdateDiff::DiffImage(0, oldName, newName, patchName);
+        PATCH_CHECK(ret == 0, return -1, "Failed to diff %s", newName.c_str());
+        ret = UpdatePatch::ApplyPatch(patchName, oldName, restoreName);
+        PATCH_CHECK(ret == 0, return -1, "Failed to apply %s", patchName.c_str());
+        PATCH_CHECK(GeneraterHash(newName) == GeneraterHash(restoreName), return -1, "Failed to check restore data");
+        return 0;
+    }
+
+    template<class DataType>
+    int SuffixArraySearchTest(const std::vector<uint8_t> &oldData) const
+    {
+        SuffixArray<DataType> suffixArray;
+        BlockBuffer oldInfo = {const_cast<uint8_t *>(oldData.data()), oldData.size()};
+        suffixArray.Init(oldInfo);
+        const size_t step = 997;
+        const size_t matchLen = 64;
+        for (size_t offset = 0; offset + matchLen < oldData.size(); offset += step) {
+            BlockBuffer newInfo = {oldInfo.buffer + offset, matchLen};
+            int64_t pos = 0;
+            int64_t len = suffixArray.Search(newInfo, oldInfo, 0, oldInfo.length, pos);
+            PATCH_CHECK(len == static_cast<int64_t>(matchLen), return -1, "Failed to search %zu", offset);
+            PATCH_CHECK(memcmp(oldInfo.buffer + pos, newInfo.buffer, matchLen) == 0, return -1, "Invalid pos");
+        }
+        return 0;
+    }
 };
 
 TEST_F(DiffPatchUnitTest, BlockDiffPatchTest)
@@ -314,6 +520,29 @@ TEST_F(DiffPatchUnitTest, ImgageDiffPatchZipFile_4)
         "../diffpatch/ImgageDiffPatchZipFile_4_zip_new.zip"));
 }
 
+TEST_F(DiffPatchUnitTest, ImgageDiffPatchZipDataDescriptor)
+{
+    DiffPatchUnitTest test;
+    const size_t entryCount = 3;
+    const size_t entrySize = 64 * 1024;
+    std::vector<std::vector<uint8_t>> oldDatas(entryCount, std::vector<uint8_t>(entrySize));
+    uint32_t seed = 1;
+    for (auto &data : oldDatas) {
+        // 一半随机一半重复, 压缩后的大小不同
+        FillPseudoRandom(data, seed);
+        std::fill(data.begin() + data.size() / 2, data.end(), 'z');
+    }
+    std::vector<std::vector<uint8_t>> newDatas(oldDatas);
+    const size_t step = 4096;
+    for (auto &data : newDatas) {
+        for (size_t i = 0; i < data.size(); i += step) {
+            data[i] ^= 0x5a;
+        }
+    }
+    newDatas[1].insert(newDatas[1].begin() + 1000, 3000, 'x'); // 1000, 3000: 中间插入的数据
+    EXPECT_EQ(0, test.ZipDataDescriptorTest(oldDatas, newDatas));
+}
+
 TEST_F(DiffPatchUnitTest, ImgageDiffPatchGzFile2)
 {
     DiffPatchUnitTest test;
@@ -384,6 +613,157 @@ TEST_F(DiffPatchUnitTest, BlockDiffPatchTest_1)
         "../diffpatch/patchtest.new_2", false));
 }
 
+TEST_F(DiffPatchUnitTest, BlockDiffPatchCompressMethod)
+{
+    DiffPatchUnitTest test;
+    std::vector<uint8_t> oldData(256 * 1024);
+    for (size_t i = 0; i < oldData.size(); i++) {
+        oldData[i] = static_cast<uint8_t>(i % 251);
+    }
+    std::vector<uint8_t> newData(oldData.begin(), oldData.end());
+    newData.insert(newData.begin() + newData.size() / 2, 1000, 'x');
+    EXPECT_EQ(0, test.BlockDiffPatchBufferTest(oldData, newData, BSDIFF_COMPRESS_BZIP2));
+    EXPECT_EQ(0, test.BlockDiffPatchBufferTest(oldData, newData, BSDIFF_COMPRESS_ZSTD));
+    EXPECT_EQ(0, test.BlockDiffPatchBufferTest(oldData, newData, BSDIFF_COMPRESS_LZ4));
+
+    EXPECT_EQ(0, test.BlockDiffPatchTest(
+        "../diffpatch/patchtest.old",
+        "../diffpatch/patchtest.new",
+        "../diffpatch/patchtest.zstd_patch",
+        "../diffpatch/patchtest.new_zstd", BSDIFF_COMPRESS_ZSTD));
+    EXPECT_EQ(0, test.BlockDiffPatchTest(
+        "../diffpatch/patchtest.old",
+        "../diffpatch/patchtest.new",
+        "../diffpatch/patchtest.lz4_patch",
+        "../diffpatch/patchtest.new_lz4", BSDIFF_COMPRESS_LZ4));
+}
+
+TEST_F(DiffPatchUnitTest, SuffixArraySearchTest)
+{
+    DiffPatchUnitTest test;
+    const size_t blockSize = 4096;
+    std::vector<uint8_t> oldData(1024 * 1024);
+    uint32_t seed = 1;
+    FillPseudoRandom(oldData, seed);
+    for (size_t i = 0; i < oldData.size(); i++) {
+        // 奇数块重复前面的数据, 制造大量重复子串
+        if ((i / blockSize) % 2 == 1) {
+            oldData[i] = oldData[i / 2];
+        }
+    }
+    EXPECT_EQ(0, test.SuffixArraySearchTest<int32_t>(oldData));
+    EXPECT_EQ(0, test.SuffixArraySearchTest<int64_t>(oldData));
+    EXPECT_NE(nullptr, SuffixArrayBase::Create(oldData.size()));
+}
+
+TEST_F(DiffPatchUnitTest, SuffixArrayReuseTest)
+{
+    DiffPatchUnitTest test;
+    std::vector<uint8_t> oldData(1024 * 1024);
+    uint32_t seed = 1;
+    FillPseudoRandom(oldData, seed);
+    std::vector<std::vector<uint8_t>> newDatas(3, oldData); // 3: 多个版本
+    newDatas[0].insert(newDatas[0].begin() + newDatas[0].size() / 3, 1024, 'x');
+    for (size_t i = 0; i < newDatas[1].size(); i += 4096) { // 4096: 每块修改一个字节
+        newDatas[1][i] ^= 0x5a;
+    }
+    newDatas[2].erase(newDatas[2].begin(), newDatas[2].begin() + 8192); // 8192: 删除开头
+    EXPECT_EQ(0, test.SuffixArrayReuseTest(oldData, newDatas));
+}
+
+TEST_F(DiffPatchUnitTest, BlockDiffPatchMultiSegment)
+{
+    DiffPatchUnitTest test;
+    // 大于单个分段, 走多线程分段差分
+    std::vector<uint8_t> oldData(6 * 1024 * 1024);
+    uint32_t seed = 1;
+    FillPseudoRandom(oldData, seed);
+    std::vector<uint8_t> newData(oldData.begin(), oldData.end());
+    const size_t step = 65536;
+    for (size_t i = 0; i < newData.size(); i += step) {
+        newData[i] ^= 0x5a;
+    }
+    newData.insert(newData.begin() + newData.size() / 3, 1024, 'x');
+    newData.erase(newData.begin() + newData.size() / 2, newData.begin() + newData.size() / 2 + 4096);
+    newData.insert(newData.end(), 5000, 'y');
+    EXPECT_EQ(0, test.BlockDiffPatchBufferTest(oldData, newData));
+
+    // 新文件比旧文件大很多时, 后面的分段从旧文件末尾开始
+    std::vector<uint8_t> smallOld(oldData.begin(), oldData.begin() + oldData.size() / 4);
+    EXPECT_EQ(0, test.BlockDiffPatchBufferTest(smallOld, newData));
+}
+
+TEST_F(DiffPatchUnitTest, BlockStreamPatchWindow)
+{
+    DiffPatchUnitTest test;
+    // 大于输出窗口, 分多次交给 writer
+    std::vector<uint8_t> oldData(3 * 1024 * 1024);
+    uint32_t seed = 1;
+    FillPseudoRandom(oldData, seed);
+    std::vector<uint8_t> newData(oldData.begin(), oldData.end());
+    const size_t step = 32768;
+    for (size_t i = 0; i < newData.size(); i += step) {
+        newData[i] ^= 0x5a;
+    }
+    newData.insert(newData.begin() + newData.size() / 3, 1024 * 1024 + 100, 'x');
+    newData.erase(newData.begin(), newData.begin() + 4096);
+    EXPECT_EQ(0, test.BlockDiffPatchStreamTest(oldData, newData, "BlockStreamPatchWindow.old"));
+}
+
+TEST_F(DiffPatchUnitTest, AddDiffDataTest)
+{
+    const size_t oldSize = 4096;
+    std::vector<uint8_t> oldData(oldSize);
+    uint32_t seed = 1;
+    FillPseudoRandom(oldData, seed);
+    const int round = 2000;
+    for (int n = 0; n < round; n++) {
+        int64_t length = static_cast<int64_t>(NextPseudoRandom(seed) % 600); // 600: 覆盖各向量宽度及尾部
+        // oldOffset 覆盖负数及超出旧数据的情况
+        int64_t oldOffset = static_cast<int64_t>(NextPseudoRandom(seed) % (oldSize + 1200)) - 600;
+        size_t dstOffset = NextPseudoRandom(seed) % 32; // 32: 非对齐起始地址
+        std::vector<uint8_t> expected(length + dstOffset);
+        for (size_t i = 0; i < expected.size(); i++) {
+            expected[i] = static_cast<uint8_t>(i * 7 + n);
+        }
+        std::vector<uint8_t> actual(expected.begin(), expected.end());
+
+        // 原逐字节实现
+        for (int64_t i = 0; i < length; i++) {
+            if ((oldOffset + i >= 0) && (static_cast<size_t>(oldOffset + i) < oldSize)) {
+                expected[dstOffset + i] += oldData[oldOffset + i];
+            }
+        }
+        int64_t start = std::max(static_cast<int64_t>(0), -oldOffset);
+        int64_t end = std::min(length, static_cast<int64_t>(oldSize) - oldOffset);
+        if (start < end) {
+            AddDiffData(actual.data() + dstOffset + start, oldData.data() + oldOffset + start,
+                static_cast<size_t>(end - start));
+        }
+        ASSERT_EQ(expected, actual);
+    }
+}
+
+TEST_F(DiffPatchUnitTest, WriteDataToBufferTest)
+{
+    std::vector<uint8_t> expected;
+    std::vector<uint8_t> buffer;
+    std::vector<uint8_t> data(1000);
+    for (size_t i = 0; i < 100; i++) { // 100: 追加次数
+        for (size_t j = 0; j < data.size(); j++) {
+            data[j] = static_cast<uint8_t>(i + j);
+        }
+        EXPECT_EQ(0, WriteDataToBuffer(buffer, expected.size(), data.data(), data.size()));
+        expected.insert(expected.end(), data.begin(), data.end());
+    }
+    ASSERT_GE(buffer.size(), expected.size());
+    EXPECT_EQ(0, memcmp(buffer.data(), expected.data(), expected.size()));
+    // 覆盖已有数据不扩容
+    size_t size = buffer.size();
+    EXPECT_EQ(0, WriteDataToBuffer(buffer, 0, data.data(), data.size()));
+    EXPECT_EQ(size, buffer.size());
+}
+
 TEST_F(DiffPatchUnitTest, BlockDiffPatchTest_2)
 {
     std::vector<uint8_t> testDate;
@@ -37,6 +37,7 @@ namespace {
 constexpr uint32_t MAX_FILE_NAME = 256;
 constexpr uint32_t CENTRAL_SIGNATURE = 0x02014b50;
 constexpr uint32_t END_CENTRAL_SIGNATURE = 0x06054b50;
+constexpr uint32_t MANY_ZIP_ENTRIES = 10000;
 
 class TestFile : public PkgFile {
 public:
@@ -62,6 +63,19 @@ public:
     }
 };
 
+// 用于检查延迟加载时已经创建的entry个数
+class TestUpgradeFile : public UpgradePkgFile {
+public:
+    explicit TestUpgradeFile(PkgStreamPtr stream) : UpgradePkgFile(stream, nullptr) {}
+
+    ~TestUpgradeFile() override {}
+
+    size_t GetLoadedEntryCount() const
+    {
+        return pkgEntryMapId_.size();
+    }
+};
+
 class PkgPackageTest : public PkgTest {
 public:
     PkgPackageTest() {}
@@ -220,6 +234,163 @@ public:
         EXPECT_EQ(ret, 0);
         return 0;
     }
+
+    int CreateManyEntriesZip(const std::string &packagePath, uint32_t entryCount)
+    {
+        PkgManager::StreamPtr stream = nullptr;
+        int32_t ret = pkgManager_->CreatePkgStream(stream, packagePath, 0, PkgStream::PkgStreamType_Write);
+        EXPECT_EQ(ret, 0);
+        std::unique_ptr<ZipPkgFile> zipFile = std::make_unique<ZipPkgFile>(PkgStreamImpl::ConvertPkgStream(stream));
+        std::vector<uint8_t> content(64, 'a'); // 64 bytes per entry
+        for (uint32_t i = 0; i < entryCount && ret == 0; i++) {
+            ZipFileInfo info;
+            info.fileInfo.identity = "entry_" + std::to_string(i);
+            info.fileInfo.unpackedSize = content.size();
+            info.fileInfo.packMethod = PKG_COMPRESS_METHOD_ZIP;
+            info.fileInfo.digestMethod = PKG_DIGEST_TYPE_CRC;
+            PkgManager::StreamPtr inStream = nullptr;
+            pkgManager_->CreatePkgStream(inStream, info.fileInfo.identity, PkgBuffer(content));
+            ret = zipFile->AddEntry(&info.fileInfo, PkgStreamImpl::ConvertPkgStream(inStream));
+            pkgManager_->ClosePkgStream(inStream);
+        }
+        EXPECT_EQ(ret, 0);
+        size_t signOffset = 0;
+        return zipFile->SavePackage(signOffset);
+    }
+
+    int TestZipLoadManyEntries()
+    {
+        pkgManager_ = static_cast<PkgManagerImpl*>(PkgManager::GetPackageInstance());
+        EXPECT_NE(pkgManager_, nullptr);
+        std::string packagePath = TEST_PATH_TO + "many_entries.zip";
+        EXPECT_EQ(CreateManyEntriesZip(packagePath, MANY_ZIP_ENTRIES), 0);
+
+        PkgManager::StreamPtr stream = nullptr;
+        int32_t ret = pkgManager_->CreatePkgStream(stream, packagePath, 0, PkgStream::PkgStreamType_Read);
+        EXPECT_EQ(ret, 0);
+        std::unique_ptr<ZipPkgFile> zipFile = std::make_unique<ZipPkgFile>(PkgStreamImpl::ConvertPkgStream(stream));
+        std::vector<std::string> components;
+        ret = zipFile->LoadPackage(components);
+        EXPECT_EQ(ret, 0);
+        EXPECT_EQ(components.size(), MANY_ZIP_ENTRIES);
+        EXPECT_NE(zipFile->FindPkgEntry("entry_0"), nullptr);
+        EXPECT_NE(zipFile->FindPkgEntry("entry_" + std::to_string(MANY_ZIP_ENTRIES - 1)), nullptr);
+        return 0;
+    }
+
+    int TestZipLazyLoad()
+    {
+        pkgManager_ = static_cast<PkgManagerImpl*>(PkgManager::GetPackageInstance());
+        EXPECT_NE(pkgManager_, nullptr);
+        constexpr uint32_t entryCount = 100;
+        std::string packagePath = TEST_PATH_TO + "lazy_entries.zip";
+        EXPECT_EQ(CreateManyEntriesZip(packagePath, entryCount), 0);
+
+        PkgManager::StreamPtr stream = nullptr;
+        int32_t ret = pkgManager_->CreatePkgStream(stream, packagePath, 0, PkgStream::PkgStreamType_Read);
+        EXPECT_EQ(ret, 0);
+        std::unique_ptr<ZipPkgFile> zipFile = std::make_unique<ZipPkgFile>(PkgStreamImpl::ConvertPkgStream(stream));
+        zipFile->SetLazyLoad(true);
+        std::vector<std::string> components;
+        ret = zipFile->LoadPackage(components);
+        EXPECT_EQ(ret, 0);
+        EXPECT_EQ(components.size(), entryCount);
+
+        PkgEntryPtr entry = zipFile->FindPkgEntry("entry_42");
+        EXPECT_NE(entry, nullptr);
+        if (entry == nullptr) {
+            return -1;
+        }
+        EXPECT_EQ(entry->GetFileName(), "entry_42");
+        EXPECT_EQ(entry->GetFileInfo()->unpackedSize, 64); // 64 bytes per entry
+        EXPECT_EQ(zipFile->FindPkgEntry("entry_42"), entry);
+        EXPECT_EQ(zipFile->FindPkgEntry("entry_not_exist"), nullptr);
+
+        std::vector<uint8_t> content(64, 0);
+        PkgManager::StreamPtr outStream = nullptr;
+        pkgManager_->CreatePkgStream(outStream, "entry_42", PkgBuffer(content));
+        ret = zipFile->ExtractFile(entry, PkgStreamImpl::ConvertPkgStream(outStream));
+        EXPECT_EQ(ret, 0);
+        EXPECT_EQ(content, std::vector<uint8_t>(64, 'a'));
+        pkgManager_->ClosePkgStream(outStream);
+        return 0;
+    }
+
+    std::unique_ptr<TestUpgradeFile> LoadUpgradeFile(bool lazyLoad, std::vector<std::string> &components)
+    {
+        PkgManager::StreamPtr stream = nullptr;
+        int32_t ret = pkgManager_->CreatePkgStream(stream, TEST_PATH_TO + testPackageName, 0,
+            PkgStream::PkgStreamType_Read);
+        EXPECT_EQ(ret, 0);
+        auto upgradeFile = std::make_unique<TestUpgradeFile>(PkgStreamImpl::ConvertPkgStream(stream));
+        upgradeFile->SetLazyLoad(lazyLoad);
+        // 只检查entry的创建时机，签名校验由其他用例覆盖
+        auto verifier = [](const PkgManager::PkgInfoPtr info, const std::vector<uint8_t> &digest,
+            const std::vector<uint8_t> &signature) {
+            return 0;
+        };
+        ret = upgradeFile->LoadPackage(components, verifier);
+        EXPECT_EQ(ret, 0);
+        return upgradeFile;
+    }
+
+    int TestUpgradeLazyLoad()
+    {
+        pkgManager_ = static_cast<PkgManagerImpl*>(PkgManager::GetPackageInstance());
+        EXPECT_NE(pkgManager_, nullptr);
+        std::vector<std::string> components;
+        std::unique_ptr<TestUpgradeFile> lazyFile = LoadUpgradeFile(true, components);
+        std::vector<std::string> eagerComponents;
+        std::unique_ptr<TestUpgradeFile> eagerFile = LoadUpgradeFile(false, eagerComponents);
+        EXPECT_EQ(components, eagerComponents);
+        EXPECT_FALSE(components.empty());
+        EXPECT_EQ(eagerFile->GetLoadedEntryCount(), components.size());
+        // LoadPackage 不解析组件头，只建立索引
+        EXPECT_EQ(lazyFile->GetLoadedEntryCount(), 0);
+        if (components.empty()) {
+            return -1;
+        }
+
+        const std::string &fileName = components.back();
+        PkgEntryPtr entry = lazyFile->FindPkgEntry(fileName);
+        EXPECT_NE(entry, nullptr);
+        if (entry == nullptr) {
+            return -1;
+        }
+        EXPECT_EQ(lazyFile->GetLoadedEntryCount(), 1);
+        EXPECT_EQ(lazyFile->FindPkgEntry(fileName), entry);
+        EXPECT_EQ(lazyFile->GetLoadedEntryCount(), 1);
+        EXPECT_EQ(lazyFile->FindPkgEntry("entry_not_exist"), nullptr);
+
+        // 第一次访问时解析出的信息与直接加载一致
+        PkgEntryPtr eagerEntry = eagerFile->FindPkgEntry(fileName);
+        EXPECT_NE(eagerEntry, nullptr);
+        if (eagerEntry == nullptr) {
+            return -1;
+        }
+        EXPECT_EQ(entry->GetFileName(), eagerEntry->GetFileName());
+        EXPECT_EQ(entry->GetFileInfo()->packedSize, eagerEntry->GetFileInfo()->packedSize);
+        EXPECT_EQ(entry->GetFileInfo()->unpackedSize, eagerEntry->GetFileInfo()->unpackedSize);
+        EXPECT_EQ(entry->GetFileInfo()->headerOffset, eagerEntry->GetFileInfo()->headerOffset);
+        EXPECT_EQ(entry->GetFileInfo()->dataOffset, eagerEntry->GetFileInfo()->dataOffset);
+        EXPECT_EQ(entry->GetNodeId(), eagerEntry->GetNodeId());
+
+        // 按节点号查找同样在第一次访问时创建 entry
+        PkgEntryPtr firstEntry = eagerFile->FindPkgEntry(components.front());
+        EXPECT_NE(firstEntry, nullptr);
+        if (firstEntry == nullptr) {
+            return -1;
+        }
+        entry = lazyFile->FindPkgEntry(firstEntry->GetNodeId());
+        EXPECT_NE(entry, nullptr);
+        if (entry == nullptr) {
+            return -1;
+        }
+        EXPECT_EQ(entry->GetFileName(), components.front());
+        EXPECT_EQ(lazyFile->FindPkgEntry(components.front()), entry);
+        EXPECT_EQ(lazyFile->FindPkgEntry(firstEntry->GetNodeId()), entry);
+        return 0;
+    }
 };
 
 TEST_F(PkgPackageTest, TestPkgFile)
@@ -245,4 +416,22 @@ TEST_F(PkgPackageTest, TestBigZipFile)
     PkgPackageTest test;
     EXPECT_EQ(0, test.TestBigZipFile());
 }
+
+TEST_F(PkgPackageTest, TestZipLoadManyEntries)
+{
+    PkgPackageTest test;
+    EXPECT_EQ(0, test.TestZipLoadManyEntries());
+}
+
+TEST_F(PkgPackageTest, TestZipLazyLoad)
+{
+    PkgPackageTest test;
+    EXPECT_EQ(0, test.TestZipLazyLoad());
+}
+
+TEST_F(PkgPackageTest, TestUpgradeLazyLoad)
+{
+    PkgPackageTest test;
+    EXPECT_EQ(0, test.TestUpgradeLazyLoad());
+}
 }
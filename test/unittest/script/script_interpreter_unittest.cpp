@@ -15,16 +15,22 @@
 
 #include <cstring>
 #include <fcntl.h>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include "log.h"
+#include "script_cache.h"
 #include "script_context.h"
 #include "script_expression.h"
 #include "script_instruction.h"
+#include "script_instructionhelper.h"
+#include "script_interpreter.h"
 #include "script_manager.h"
+#include "script_manager_impl.h"
+#include "script_profiler.h"
 #include "unittest_comm.h"
 
 using namespace std;
@@ -33,6 +39,29 @@ using namespace uscript;
 using namespace updater;
 
 namespace {
+class TestScriptEnv : public UScriptEnv {
+public:
+    explicit TestScriptEnv(hpackage::PkgManager::PkgManagerPtr pkgManager) : UScriptEnv(pkgManager) {}
+    ~TestScriptEnv() override {}
+
+    void PostMessage(const std::string &cmd, std::string content) override {}
+
+    UScriptInstructionFactoryPtr GetInstructionFactory() override
+    {
+        return nullptr;
+    }
+
+    const std::vector<std::string> GetInstructionNames() const override
+    {
+        return {};
+    }
+
+    bool IsRetry() const override
+    {
+        return false;
+    }
+};
+
 class ScriptInterpreterUnitTest : public ::testing::Test {
 public:
     ScriptInterpreterUnitTest() {}
@@ -110,6 +139,14 @@ public:
         int32_t outOfIndex = 3;
         ret = funcContext->GetParamType(outOfIndex);
         EXPECT_EQ(UScriptContext::PARAM_TYPE_INVALID, ret);
+
+        // 重复使用前清空输入输出
+        funcContext->AddInputParam(std::make_shared<IntegerValue>(intValue));
+        funcContext->AddProcessedBytes(intValue);
+        funcContext->Reset();
+        EXPECT_EQ(0, funcContext->GetParamCount());
+        EXPECT_EQ(0, funcContext->GetOutVar().size());
+        EXPECT_EQ(0, funcContext->GetProcessedBytes());
         return 0;
     }
 
@@ -185,8 +222,322 @@ public:
         return 0;
     }
 
+    int TestScriptValue() const
+    {
+        // 短字符串保存在对象内，长字符串复制时共享
+        std::string shortStr = "system";
+        std::string longStr = "/dev/block/by-name/system_image";
+        ScriptValue shortValue(shortStr);
+        ScriptValue longValue(longStr);
+        ScriptValue copyValue = longValue;
+        EXPECT_EQ(shortStr, shortValue.GetString());
+        EXPECT_EQ(longStr, copyValue.GetString());
+        EXPECT_EQ(shortStr + longStr, shortValue.Computer(UScriptExpression::ADD_OPERATOR, longValue).GetString());
+        EXPECT_EQ(1, longValue.Computer(UScriptExpression::LT_OPERATOR, shortValue).GetInteger());
+        EXPECT_EQ(1, ScriptValue(std::string("abc")).Computer(UScriptExpression::LT_OPERATOR,
+            ScriptValue(std::string("abcd"))).GetInteger());
+
+        // 计算结果与 UScriptValue 一致
+        ScriptValue intValue(10);
+        ScriptValue floatValue(2.5f);
+        EXPECT_EQ(5, intValue.Computer(UScriptExpression::DIV_OPERATOR, ScriptValue(2)).GetInteger());
+        ScriptValue result = intValue.Computer(UScriptExpression::MUL_OPERATOR, floatValue);
+        EXPECT_EQ(UScriptValue::VALUE_TYPE_FLOAT, result.GetValueType());
+        EXPECT_FLOAT_EQ(25.0f, result.GetFloat());
+        result = floatValue.Computer(UScriptExpression::GT_OPERATOR, ScriptValue(1));
+        EXPECT_EQ(UScriptValue::VALUE_TYPE_FLOAT, result.GetValueType());
+        EXPECT_EQ(1, floatValue.Computer(UScriptExpression::EQ_OPERATOR, ScriptValue(2.50001f)).GetInteger());
+        EXPECT_EQ(UScriptValue::VALUE_TYPE_ERROR,
+            intValue.Computer(UScriptExpression::DIV_OPERATOR, ScriptValue(0)).GetValueType());
+        EXPECT_EQ(UScriptValue::VALUE_TYPE_ERROR,
+            intValue.Computer(UScriptExpression::ADD_OPERATOR, shortValue).GetValueType());
+        EXPECT_EQ("10" + shortStr, ScriptValue(std::string("10")).Computer(UScriptExpression::ADD_OPERATOR,
+            shortValue).GetString());
+
+        // 只有一个值的列表参与计算，转换成 UScriptValuePtr 后结果不变
+        ScriptValue list(std::vector<ScriptValue> { intValue });
+        EXPECT_EQ(11, list.Computer(UScriptExpression::ADD_OPERATOR, ScriptValue(1)).GetInteger());
+        EXPECT_FALSE(list.IsTrue());
+        UScriptValuePtr ptr = ScriptValue(std::vector<ScriptValue> { intValue, longValue }).ToPtr();
+        EXPECT_EQ(UScriptValue::VALUE_TYPE_LIST, ptr->GetValueType());
+        ScriptValue back = ScriptValue::FromPtr(ptr);
+        EXPECT_EQ(2, back.GetValues().size());
+        EXPECT_EQ(longStr, back.GetValues()[1].GetString());
+        EXPECT_EQ(USCRIPT_NOTEXIST_INSTRUCTION, ScriptValue::FromPtr(
+            std::make_shared<ErrorValue>(USCRIPT_NOTEXIST_INSTRUCTION)).GetError());
+        EXPECT_TRUE(ScriptValue::FromPtr(nullptr).IsNull());
+
+        // 指令参数类型不匹配时返回错误
+        UScriptInstructionContext context;
+        context.AddInputParam(shortValue);
+        int32_t param = 0;
+        EXPECT_EQ(USCRIPT_INVALID_PARAM, context.GetParam(0, param));
+        std::string strParam;
+        EXPECT_EQ(USCRIPT_SUCCESS, context.GetParam(0, strParam));
+        EXPECT_EQ(shortStr, strParam);
+        return 0;
+    }
+
+    int32_t ExecuteScript(const std::string &content, bool bytecode) const
+    {
+        return ExecuteScripts({ content }, bytecode);
+    }
+
+    // 使用同一个脚本管理器依次执行多个脚本，返回最后一个脚本的结果
+    int32_t ExecuteScripts(const std::vector<std::string> &contents, bool bytecode) const
+    {
+        PkgManager::PkgManagerPtr pkgManager = PkgManager::GetPackageInstance();
+        TestScriptEnv env(pkgManager);
+        ScriptManagerImpl manager(&env);
+        ScriptInstructionHelper::GetBasicInstructionHelper(&manager)->RegisterInstructions();
+        ScriptInterpreter::EnableBytecode(bytecode);
+        int32_t ret = USCRIPT_SUCCESS;
+        for (auto &content : contents) {
+            std::string fileName = TEST_PATH_TO + "test_bytecode.us";
+            std::ofstream script(fileName, std::ios::out | std::ios::trunc);
+            script << content;
+            script.close();
+
+            PkgManager::StreamPtr stream = nullptr;
+            ret = pkgManager->CreatePkgStream(stream, fileName, 0, PkgStream::PkgStreamType_Read);
+            if (ret != PKG_SUCCESS) {
+                break;
+            }
+            ret = ScriptInterpreter::ExecuteScript(&manager, stream);
+            pkgManager->ClosePkgStream(stream);
+        }
+        ScriptInterpreter::EnableBytecode(true);
+        PkgManager::ReleasePackageInstance(pkgManager);
+        return ret;
+    }
+
+    int TestBytecodeExecute() const
+    {
+        const std::string content =
+            "function Fib(n) {\n"
+            "    if (n < 2) {\n"
+            "        return n;\n"
+            "    }\n"
+            "    return Fib(n - 1) + Fib(n - 2);\n"
+            "}\n"
+            "function Swap(a, b) {\n"
+            "    return b, a;\n"
+            "}\n"
+            "function Count() {\n"
+            "    counter = counter + 1;\n"
+            "    return 1;\n"
+            "}\n"
+            "counter = 0;\n"
+            "Assert(Fib(10) == 55);\n"
+            "x, y = Swap(1, 2);\n"
+            "Assert(x == 2 && y == 1);\n"
+            "sum = 0;\n"
+            "for (i = 0; i < 10; i = i + 1) {\n"
+            "    if (i == 2) {\n"
+            "        continue;\n"
+            "    } else if (i == 8) {\n"
+            "        break;\n"
+            "    }\n"
+            "    sum = sum + i;\n"
+            "}\n"
+            "Assert(sum == 26);\n"
+            "while (sum > 20) {\n"
+            "    sum = sum - 1;\n"
+            "}\n"
+            "Assert(sum == 20);\n"
+            "t = 1 || Count();\n"
+            "t = 0 || Count();\n"
+            "Assert(counter == 1);\n"
+            "s = \"ab\" + 2 * 3;\n"
+            "Assert(s == \"ab6\");\n"
+            "Abort(0);\n";
+        // 脚本最后主动 Abort，确认前面的语句都已执行
+        EXPECT_EQ(USCRIPT_ABOART, ExecuteScript(content, true));
+        EXPECT_EQ(USCRIPT_ABOART, ExecuteScript(content, false));
+        return 0;
+    }
+
+    int TestBytecodeErrorCode() const
+    {
+        // 字节码执行与语法树执行的返回值保持一致，break 在循环外时回退到语法树执行
+        const std::vector<std::pair<std::string, int32_t>> scripts = {
+            { "Assert(1 == 2);\n", USCRIPT_ASSERT },
+            { "Abort(0);\nAssert(1 == 2);\n", USCRIPT_ABOART },
+            { "x = NotExist(1);\n", USCRIPT_NOTEXIST_INSTRUCTION },
+            { "break;\nAbort(0);\n", USCRIPT_SUCCESS },
+        };
+        for (auto &script : scripts) {
+            EXPECT_EQ(script.second, ExecuteScript(script.first, true));
+            EXPECT_EQ(script.second, ExecuteScript(script.first, false));
+        }
+        // 函数内的错误作为返回值传给调用者
+        const std::string content = "function Check(a) {\n    Assert(a);\n    return 1;\n}\nCheck(0);\n";
+        EXPECT_EQ(USCRIPT_ASSERT, ExecuteScript(content, true));
+        EXPECT_EQ(USCRIPT_ASSERT, ExecuteScript(content, false));
+        return 0;
+    }
+
+    int TestScriptCache() const
+    {
+        // 内容相同的脚本只解析一次，再次执行时结果不变
+        ScriptCache::Clear();
+        const std::string content = "function Add(a, b) {\n    return a + b;\n}\nAssert(Add(1, 2) == 3);\nAbort(0);\n";
+        EXPECT_EQ(USCRIPT_ABOART, ExecuteScript(content, true));
+        EXPECT_EQ(1, ScriptCache::GetSize());
+        EXPECT_EQ(USCRIPT_ABOART, ExecuteScript(content, true));
+        EXPECT_EQ(USCRIPT_ABOART, ExecuteScript(content, false));
+        EXPECT_EQ(1, ScriptCache::GetSize());
+
+        EXPECT_EQ(USCRIPT_ASSERT, ExecuteScript("Assert(1 == 2);\n", true));
+        EXPECT_EQ(2, ScriptCache::GetSize());
+        // 解析失败的脚本不缓存
+        EXPECT_NE(USCRIPT_SUCCESS, ExecuteScript("Assert(1 == ;\n", true));
+        EXPECT_EQ(2, ScriptCache::GetSize());
+
+        // 超过上限时淘汰最早加入的脚本
+        ScriptCache::Clear();
+        for (size_t i = 0; i <= ScriptCache::MAX_SCRIPTS; i++) {
+            ScriptCache::Add(std::to_string(i), std::make_shared<ParsedScript>());
+        }
+        EXPECT_EQ(ScriptCache::MAX_SCRIPTS, ScriptCache::GetSize());
+        EXPECT_EQ(nullptr, ScriptCache::Find("0"));
+        EXPECT_NE(nullptr, ScriptCache::Find(std::to_string(ScriptCache::MAX_SCRIPTS)));
+        ScriptCache::Clear();
+        return 0;
+    }
+
+    int TestScriptProfiler() const
+    {
+        // 两种执行方式都按指令名和行号统计调用次数
+        ScriptProfiler &profiler = ScriptProfiler::GetInstance();
+        const std::string content =
+            "for (i = 0; i < 3; i = i + 1) {\n"
+            "    Assert(i < 3);\n"
+            "}\n"
+            "Abort(0);\n";
+        for (auto bytecode : { true, false }) {
+            profiler.Reset();
+            profiler.Enable(true);
+            EXPECT_EQ(USCRIPT_ABOART, ExecuteScript(content, bytecode));
+            profiler.Enable(false);
+            std::vector<ScriptProfiler::ProfileRecord> records = profiler.GetRecords();
+            EXPECT_EQ(2, records.size());
+            for (auto &record : records) {
+                EXPECT_EQ(TEST_PATH_TO + "test_bytecode.us", record.script);
+                EXPECT_EQ((record.name == "Assert") ? 3 : 1, record.count);
+                EXPECT_EQ((record.name == "Assert") ? 2 : 4, record.line);
+                EXPECT_GE(record.totalNs, record.maxNs);
+            }
+        }
+
+        // 关闭时不记录
+        profiler.Reset();
+        EXPECT_EQ(USCRIPT_ABOART, ExecuteScript(content, true));
+        EXPECT_EQ(0, profiler.GetRecords().size());
+
+        UScriptInstructionContext context;
+        context.AddProcessedBytes(100);
+        context.AddProcessedBytes(24);
+        EXPECT_EQ(124, context.GetProcessedBytes());
+        profiler.AddRecord("raw_image_write", "test.us", 1, 2000, 124);
+        profiler.AddRecord("raw_image_write", "test.us", 1, 5000, 0);
+        std::vector<ScriptProfiler::ProfileRecord> records = profiler.GetRecords();
+        EXPECT_EQ(1, records.size());
+        EXPECT_EQ(2, records[0].count);
+        EXPECT_EQ(7000, records[0].totalNs);
+        EXPECT_EQ(5000, records[0].maxNs);
+        EXPECT_EQ(124, records[0].bytes);
+        EXPECT_NE(std::string::npos, profiler.DumpTable().find("raw_image_write"));
+        EXPECT_NE(std::string::npos, profiler.DumpJson().find(
+            "{\"instruction\": \"raw_image_write\", \"script\": \"test.us\", \"line\": 1, \"count\": 2, "
+            "\"total_us\": 7, \"max_us\": 5, \"bytes\": 124}"));
+        profiler.Reset();
+        return 0;
+    }
+
+    int TestAsyncInstruction() const
+    {
+        // wait 的返回值与直接调用指令相同，没有 wait 的调用在脚本结束后等待
+        const std::string content =
+            "h1 = async(\"Concat\", \"a\", 1);\n"
+            "h2 = async(\"Sleep\", 0);\n"
+            "h3 = async(\"Concat\", \"b\", 2.5);\n"
+            "Assert(wait(h1) == \"a1\");\n"
+            "wait(h2);\n"
+            "Abort(0);\n";
+        EXPECT_EQ(USCRIPT_ABOART, ExecuteScript(content, true));
+        EXPECT_EQ(USCRIPT_ABOART, ExecuteScript(content, false));
+
+        const std::vector<std::pair<std::string, int32_t>> scripts = {
+            { "h = async(\"Assert\", 0);\nwait(h);\nAbort(0);\n", USCRIPT_ASSERT },
+            { "h = async(\"NotExist\", 0);\nAbort(0);\n", USCRIPT_NOTEXIST_INSTRUCTION },
+            { "h = async(\"Sleep\", 0);\nwait(h);\nwait(h);\nAbort(0);\n", USCRIPT_INVALID_PARAM },
+            { "wait(\"h\");\nAbort(0);\n", USCRIPT_INVALID_PARAM },
+            { "h = async(\"Assert\", 0);\n", USCRIPT_ASSERT },
+        };
+        for (auto &script : scripts) {
+            EXPECT_EQ(script.second, ExecuteScript(script.first, true));
+            EXPECT_EQ(script.second, ExecuteScript(script.first, false));
+        }
+
+        // handle 只在创建它的脚本中有效，脚本结束时已经等待完成
+        const std::vector<std::string> sequence = {
+            "h = async(\"Sleep\", 0);\n",
+            "wait(0);\nAbort(0);\n",
+        };
+        EXPECT_EQ(USCRIPT_INVALID_PARAM, ExecuteScripts(sequence, true));
+        EXPECT_EQ(USCRIPT_INVALID_PARAM, ExecuteScripts(sequence, false));
+        return 0;
+    }
+
+    int TestBytecodeScope() const
+    {
+        // 变量按槽位访问后，函数内仍然可以更新调用者的变量，分支中定义的变量在分支结束后失效
+        const std::string content =
+            "function Inc(n) {\n"
+            "    count = count + n;\n"
+            "    return count;\n"
+            "}\n"
+            "function Pair() {\n"
+            "    return Inc(1), 7;\n"
+            "}\n"
+            "count = 1;\n"
+            "Assert(Inc(2) == 3);\n"
+            "Assert(count == 3);\n"
+            "if (count == 3) {\n"
+            "    inner = 5;\n"
+            "    count = count + inner;\n"
+            "}\n"
+            "Assert(count == 8);\n"
+            "i = 0;\n"
+            "while (i < 3) {\n"
+            "    if (i > 0) {\n"
+            "        Assert(last == i - 1);\n"
+            "    }\n"
+            "    last = i;\n"
+            "    i = i + 1;\n"
+            "}\n"
+            "Assert(last == 2);\n"
+            "a, b = Pair();\n"
+            "Assert(a == 9);\n"
+            "Assert(b == 7);\n"
+            "Abort(0);\n";
+        EXPECT_EQ(USCRIPT_ABOART, ExecuteScript(content, true));
+        EXPECT_EQ(USCRIPT_ABOART, ExecuteScript(content, false));
+
+        // 语法树执行找不到变量时返回的错误值没有错误码，这里只检查字节码执行
+        const std::string outOfScope = "if (1) {\n    inner = 1;\n}\nvalue = inner;\nAbort(0);\n";
+        EXPECT_EQ(USCRIPT_ERROR_INTERPRET, ExecuteScript(outOfScope, true));
+        return 0;
+    }
+
 protected:
-    void SetUp() {}
+    void SetUp()
+    {
+        if (access(TEST_PATH_TO.c_str(), R_OK | W_OK) == -1) {
+            mkdir(TEST_PATH_TO.c_str(), S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+        }
+    }
     void TearDown() {}
     void TestBody() {}
 };
@@ -221,6 +572,48 @@ TEST_F(ScriptInterpreterUnitTest, TestStringValueComputer)
     EXPECT_EQ(0, test.TestStringValueComputer());
 }
 
+TEST_F(ScriptInterpreterUnitTest, TestScriptValue)
+{
+    ScriptInterpreterUnitTest test;
+    EXPECT_EQ(0, test.TestScriptValue());
+}
+
+TEST_F(ScriptInterpreterUnitTest, TestBytecodeExecute)
+{
+    ScriptInterpreterUnitTest test;
+    EXPECT_EQ(0, test.TestBytecodeExecute());
+}
+
+TEST_F(ScriptInterpreterUnitTest, TestBytecodeErrorCode)
+{
+    ScriptInterpreterUnitTest test;
+    EXPECT_EQ(0, test.TestBytecodeErrorCode());
+}
+
+TEST_F(ScriptInterpreterUnitTest, TestBytecodeScope)
+{
+    ScriptInterpreterUnitTest test;
+    EXPECT_EQ(0, test.TestBytecodeScope());
+}
+
+TEST_F(ScriptInterpreterUnitTest, TestScriptCache)
+{
+    ScriptInterpreterUnitTest test;
+    EXPECT_EQ(0, test.TestScriptCache());
+}
+
+TEST_F(ScriptInterpreterUnitTest, TestScriptProfiler)
+{
+    ScriptInterpreterUnitTest test;
+    EXPECT_EQ(0, test.TestScriptProfiler());
+}
+
+TEST_F(ScriptInterpreterUnitTest, TestAsyncInstruction)
+{
+    ScriptInterpreterUnitTest test;
+    EXPECT_EQ(0, test.TestAsyncInstruction());
+}
+
 TEST_F(ScriptInterpreterUnitTest, SomeDestructor)
 {
     IntegerValue a1(0);
@@ -62,6 +62,70 @@ public:
         return ret;
     }
 
+    int TestParallelFor(const int32_t count)
+    {
+        USCRIPT_CHECK(threadPool_ != nullptr, return USCRIPT_INVALID_PARAM, "Fail to create thread pool");
+        std::vector<std::atomic<int32_t>> hits(count);
+        threadPool_->ParallelFor(count, [&hits](int32_t index) {
+            hits[index]++;
+        });
+        // 每个下标只执行一次
+        for (int32_t i = 0; i < count; i++) {
+            USCRIPT_CHECK(hits[i] == 1, return USCRIPT_ERROR_EXECUTE, "Invalid hit %d for %d", hits[i].load(), i);
+        }
+        return USCRIPT_SUCCESS;
+    }
+
+    int TestNestedParallelFor()
+    {
+        USCRIPT_CHECK(threadPool_ != nullptr, return USCRIPT_INVALID_PARAM, "Fail to create thread pool");
+        const int32_t count = 16;
+        std::atomic<int32_t> total { 0 };
+        threadPool_->ParallelFor(count, [this, &total, count](int32_t) {
+            threadPool_->ParallelFor(count, [&total](int32_t) {
+                total++;
+            });
+        });
+        return (total == count * count) ? USCRIPT_SUCCESS : USCRIPT_ERROR_EXECUTE;
+    }
+
+    int TestSubmit()
+    {
+        USCRIPT_CHECK(threadPool_ != nullptr, return USCRIPT_INVALID_PARAM, "Fail to create thread pool");
+        const int32_t count = 64;
+        std::vector<std::future<int32_t>> results;
+        for (int32_t i = 0; i < count; i++) {
+            results.push_back(threadPool_->Submit([i]() {
+                return i * i;
+            }));
+        }
+        for (int32_t i = 0; i < count; i++) {
+            USCRIPT_CHECK(results[i].get() == i * i, return USCRIPT_ERROR_EXECUTE, "Invalid result for %d", i);
+        }
+        return USCRIPT_SUCCESS;
+    }
+
+    int TestWaitInTask()
+    {
+        USCRIPT_CHECK(threadPool_ != nullptr, return USCRIPT_INVALID_PARAM, "Fail to create thread pool");
+        // 任务数多于工作线程，任务中等待的子任务由等待的线程执行，不会死锁
+        const int32_t count = 32;
+        std::vector<std::future<int32_t>> results;
+        for (int32_t i = 0; i < count; i++) {
+            results.push_back(threadPool_->Submit([this, i]() {
+                std::future<int32_t> inner = threadPool_->Submit([i]() {
+                    return i + 1;
+                });
+                return threadPool_->Wait(inner) * 2;
+            }));
+        }
+        for (int32_t i = 0; i < count; i++) {
+            int32_t result = threadPool_->Wait(results[i]);
+            USCRIPT_CHECK(result == (i + 1) * 2, return USCRIPT_ERROR_EXECUTE, "Invalid result for %d", i);
+        }
+        return USCRIPT_SUCCESS;
+    }
+
 protected:
     void SetUp() {}
     void TearDown() {}
@@ -84,4 +148,30 @@ TEST_F(ThreadPoolUnitTest, TestThreadOneCreate)
     ThreadPoolUnitTest test;
     EXPECT_EQ(0, test.TestThreadPoolCreate(1));
 }
+
+TEST_F(ThreadPoolUnitTest, TestParallelFor)
+{
+    ThreadPoolUnitTest test;
+    EXPECT_EQ(0, test.TestParallelFor(1));
+    EXPECT_EQ(0, test.TestParallelFor(MAX_TASK_NUMBER - 1));
+    EXPECT_EQ(0, test.TestParallelFor(1000));
+}
+
+TEST_F(ThreadPoolUnitTest, TestNestedParallelFor)
+{
+    ThreadPoolUnitTest test;
+    EXPECT_EQ(0, test.TestNestedParallelFor());
+}
+
+TEST_F(ThreadPoolUnitTest, TestSubmit)
+{
+    ThreadPoolUnitTest test;
+    EXPECT_EQ(0, test.TestSubmit());
+}
+
+TEST_F(ThreadPoolUnitTest, TestWaitInTask)
+{
+    ThreadPoolUnitTest test;
+    EXPECT_EQ(0, test.TestWaitInTask());
+}
 }
@@ -14,18 +14,24 @@
  */
 
 #include "update_processor_unittest.h"
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
+#include <future>
 #include <iostream>
+#include <mutex>
 #include <sys/mount.h>
 #include <unistd.h>
+#include <vector>
 #include "fs_manager/mount.h"
 #include "log/log.h"
 #include "package/pkg_manager.h"
 #include "unittest_comm.h"
+#include "update_partition_scheduler.h"
 #include "update_processor.h"
 #include "updater_main.h"
 #include "updater/updater.h"
+#include "updater/updater_message.h"
 #include "utils.h"
 
 using namespace updater;
@@ -82,4 +88,176 @@ TEST(UpdateProcessorUnitTest, UpdateProcessor_001)
     ScriptManager::ReleaseScriptManager();
     PkgManager::ReleasePackageInstance(pkgManager);
 }
+
+TEST(UpdateProcessorUnitTest, UpdateProcessor_002)
+{
+    // 每个指令名都能创建实例，未知的指令名返回错误
+    UpdaterEnv env(nullptr, nullptr, false);
+    UScriptInstructionFactoryPtr factory = env.GetInstructionFactory();
+    ASSERT_NE(factory, nullptr);
+    for (auto &name : env.GetInstructionNames()) {
+        UScriptInstructionPtr instr = nullptr;
+        EXPECT_EQ(USCRIPT_SUCCESS, factory->CreateInstructionInstance(instr, name));
+        EXPECT_NE(instr, nullptr);
+        delete instr;
+    }
+    EXPECT_EQ(7, env.GetInstructionNames().size());
+    UScriptInstructionPtr instr = nullptr;
+    EXPECT_EQ(USCRIPT_NOTEXIST_INSTRUCTION, factory->CreateInstructionInstance(instr, "not_exist"));
+    EXPECT_EQ(instr, nullptr);
+}
+
+static void PostTestMessages(FILE *pipe, uint8_t version)
+{
+    // 频繁的进度消息被合并，其他消息发送前先发出合并的进度
+    UpdaterEnv env(nullptr, pipe, false, version);
+    constexpr int32_t count = 1000;
+    for (int32_t i = 1; i <= count / 2; i++) {
+        env.PostProgress(static_cast<float>(i) / count);
+    }
+    env.PostMessage("ui_log", "half");
+    for (int32_t i = count / 2 + 1; i <= count; i++) {
+        env.PostMessage("set_progress", std::to_string(static_cast<float>(i) / count));
+    }
+}
+
+static void ParseTestMessages(FILE *pipe, std::vector<std::string> &texts, std::vector<float> &progress)
+{
+    MessageParser parser([&texts](const std::string &message) {
+        texts.push_back(message);
+    }, [&progress](float value) {
+        progress.push_back(value);
+    });
+    rewind(pipe);
+    // 每次只传入少量数据，验证跨越多次读取的帧
+    char buffer[7];
+    size_t n = 0;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        parser.Parse(buffer, n);
+    }
+    parser.Finish();
+}
+
+TEST(UpdateProcessorUnitTest, UpdateProcessor_003)
+{
+    FILE *pipe = tmpfile();
+    ASSERT_NE(pipe, nullptr);
+    PostTestMessages(pipe, MESSAGE_VERSION);
+    std::vector<std::string> texts;
+    std::vector<float> progress;
+    ParseTestMessages(pipe, texts, progress);
+    fclose(pipe);
+    ASSERT_EQ(1, texts.size());
+    EXPECT_EQ("ui_log:half", texts[0]);
+    EXPECT_LE(progress.size(), 110);
+    ASSERT_FALSE(progress.empty());
+    EXPECT_FLOAT_EQ(1.0, progress.back());
+
+    // 不支持二进制帧时输出文本，解析结果相同
+    pipe = tmpfile();
+    ASSERT_NE(pipe, nullptr);
+    PostTestMessages(pipe, 0);
+    texts.clear();
+    progress.clear();
+    ParseTestMessages(pipe, texts, progress);
+    fclose(pipe);
+    EXPECT_TRUE(progress.empty());
+    EXPECT_LE(texts.size(), 110);
+    ASSERT_FALSE(texts.empty());
+    EXPECT_EQ("set_progress:1.000000", texts.back());
+    EXPECT_NE(std::find(texts.begin(), texts.end(), "ui_log:half"), texts.end());
+}
+
+class ProgressTestEnv : public UpdaterEnv {
+public:
+    ProgressTestEnv() : UpdaterEnv(nullptr, nullptr, false) {}
+    void PostProgress(float progress) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        progress_.push_back(progress);
+    }
+    std::vector<float> GetProgress()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return progress_;
+    }
+private:
+    std::mutex mutex_;
+    std::vector<float> progress_;
+};
+
+// 等待另一个分区开始后才返回，任务没有并发执行时等待超时并失败
+class PartitionTestInstruction : public UScriptInstruction {
+public:
+    PartitionTestInstruction(std::promise<void> &started, std::shared_future<void> other, int32_t result)
+        : started_(started), other_(other), result_(result) {}
+    int32_t Execute(UScriptEnv &env, UScriptContext &context) override
+    {
+        started_.set_value();
+        env.PostProgress(0.5);
+        if (other_.wait_for(std::chrono::seconds(5)) != std::future_status::ready) { // 5 : timeout
+            return USCRIPT_ERROR_EXECUTE;
+        }
+        context.AddProcessedBytes(1);
+        return result_;
+    }
+private:
+    std::promise<void> &started_;
+    std::shared_future<void> other_;
+    int32_t result_;
+};
+
+static std::unique_ptr<UScriptInstructionContext> CreateTaskContext(const std::string &partitionName)
+{
+    std::unique_ptr<UScriptInstructionContext> context = std::make_unique<UScriptInstructionContext>();
+    context->AddInputParam(ScriptValue(partitionName));
+    return context;
+}
+
+static int32_t RunPartitionTasks(ProgressTestEnv &env, int32_t secondResult)
+{
+    std::promise<void> first;
+    std::promise<void> second;
+    std::shared_future<void> firstStarted = first.get_future().share();
+    std::shared_future<void> secondStarted = second.get_future().share();
+    PartitionScheduler scheduler(env);
+    EXPECT_EQ(USCRIPT_SUCCESS, scheduler.AddTask(3, std::make_unique<PartitionTestInstruction>(first,
+        secondStarted, USCRIPT_SUCCESS), CreateTaskContext("/system")));
+    EXPECT_EQ(USCRIPT_SUCCESS, scheduler.AddTask(1, std::make_unique<PartitionTestInstruction>(second,
+        firstStarted, secondResult), CreateTaskContext("/vendor")));
+    int32_t ret = scheduler.Run();
+    EXPECT_EQ(2, scheduler.GetProcessedBytes());
+    return ret;
+}
+
+TEST(UpdateProcessorUnitTest, UpdateProcessor_004)
+{
+    // 两个分区同时更新，进度按权重合并，全部成功后只上报一次 1
+    ProgressTestEnv env;
+    EXPECT_EQ(USCRIPT_SUCCESS, RunPartitionTasks(env, USCRIPT_SUCCESS));
+    std::vector<float> progress = env.GetProgress();
+    ASSERT_FALSE(progress.empty());
+    EXPECT_FLOAT_EQ(1.0, progress.back());
+    EXPECT_EQ(1, std::count(progress.begin(), progress.end(), 1.0f));
+    EXPECT_TRUE(std::is_sorted(progress.begin(), progress.end()));
+
+    // 一个分区失败时其他分区继续完成，返回失败分区的错误码
+    ProgressTestEnv failedEnv;
+    EXPECT_EQ(USCRIPT_ERROR_EXECUTE, RunPartitionTasks(failedEnv, USCRIPT_ERROR_EXECUTE));
+    progress = failedEnv.GetProgress();
+    ASSERT_FALSE(progress.empty());
+    EXPECT_FLOAT_EQ(0.875, progress.back());
+    EXPECT_EQ(progress.end(), std::find(progress.begin(), progress.end(), 1.0f));
+
+    // 同一个分区不能重复添加
+    PartitionScheduler scheduler(env);
+    std::promise<void> started;
+    std::shared_future<void> other;
+    EXPECT_EQ(USCRIPT_SUCCESS, scheduler.AddTask(1, std::make_unique<PartitionTestInstruction>(started, other,
+        USCRIPT_SUCCESS), CreateTaskContext("/system")));
+    EXPECT_EQ(USCRIPT_INVALID_PARAM, scheduler.AddTask(1, std::make_unique<PartitionTestInstruction>(started,
+        other, USCRIPT_SUCCESS), CreateTaskContext("/system")));
+    EXPECT_EQ(USCRIPT_INVALID_PARAM, scheduler.AddTask(1, std::make_unique<PartitionTestInstruction>(started,
+        other, USCRIPT_SUCCESS), std::make_unique<UScriptInstructionContext>()));
+}
 } // namespace updater_ut